@@ -38,6 +38,9 @@ LutAddresser::LutAddresser()
     m_sLutMask(0),
     m_blockBits(0),
     m_blockSize(),
+    m_maxExpandX(1),
+    m_microBlockXBits(0),
+    m_microBlockYBits(0),
     m_bpeLog2(0),
     m_bit(),
     m_lutData()
@@ -117,6 +120,34 @@ void LutAddresser::InitSwizzleProps()
             m_maxExpandX *= 2;
         }
     }
+
+    // Find the pixel rectangle covered by each 256B micro-block. The equation is linear, so it is enough to look at
+    // where each x/y bit on its own lands: if the low x and y bits all stay within the first 256B and together with
+    // the element bits account for all 8 bits of it, every aligned rectangle of that size fills exactly one 256B
+    // micro-block, and the higher bits only pick which one (and possibly XOR the position within it).
+    m_microBlockXBits = 0;
+    m_microBlockYBits = 0;
+    if ((m_sLutMask == 0) && (m_blockBits >= MicroBlockBits))
+    {
+        UINT_32 xBits = 0;
+        UINT_32 yBits = 0;
+        while ((xBits < GetBlockXBits()) && (EvalEquation(1u << xBits, 0, 0, 0) != 0) &&
+               (EvalEquation(1u << xBits, 0, 0, 0) < (1u << MicroBlockBits)))
+        {
+            xBits++;
+        }
+        while ((yBits < GetBlockYBits()) && (EvalEquation(0, 1u << yBits, 0, 0) != 0) &&
+               (EvalEquation(0, 1u << yBits, 0, 0) < (1u << MicroBlockBits)))
+        {
+            yBits++;
+        }
+
+        if ((m_bpeLog2 + xBits + yBits) == MicroBlockBits)
+        {
+            m_microBlockXBits = xBits;
+            m_microBlockYBits = yBits;
+        }
+    }
 }
 
 /**
@@ -269,14 +300,14 @@ UINT_32 LutAddresser::EvalEquation(
 
 /**
 ****************************************************************************************************
-*   Copy2DSliceUnaligned
+*   Copy2DRowsUnaligned
 *
 *   @brief
-*       Copies an arbitrary 2D pixel region to or from a surface.
+*       Copies an arbitrary 2D pixel region to or from a surface, one row at a time.
 ****************************************************************************************************
 */
 template <int BPELog2, int ExpandX, bool ImgIsDest>
-void Copy2DSliceUnaligned(
+static void Copy2DRowsUnaligned(
     void*               pImgBlockSliceStart, // Block corresponding to beginning of slice
     void*               pBuf,                // Pointer to data starting from the copy origin.
     size_t              bufStrideY,          // Stride of each row in pBuf
@@ -360,6 +391,215 @@ void Copy2DSliceUnaligned(
     }
 }
 
+/**
+****************************************************************************************************
+*   Copy2DMicroBlocks
+*
+*   @brief
+*       Copies a row of whole 256B micro-blocks to or from a surface. x and y must be aligned to the
+*       micro-block size.
+*
+*       The micro-blocks are handled in strips: the address of each micro-block in the strip is computed
+*       once, and the position of every chunk of ExpandX pixels within a micro-block is precomputed, so
+*       each chunk is a single fixed-size move the compiler turns into vector loads and stores. Within a
+*       strip the linear data is still walked row by row, which keeps it streaming. Chunks smaller than 16B
+*       are shuffled in a local buffer first and each micro-block is then moved as one contiguous 256B
+*       access, which is what write-combined or uncached mappings of the surface want.
+****************************************************************************************************
+*/
+template <int BPELog2, int ExpandX, bool ImgIsDest>
+static void Copy2DMicroBlocks(
+    void*               pImgBlockSliceStart, // Block corresponding to beginning of slice
+    void*               pBuf,                // Pointer to the data for pixel (xStart, y).
+    size_t              bufStrideY,          // Stride of each row in pBuf
+    UINT_32             imageBlocksY,        // Width of the image slice, in blocks.
+    UINT_32             xStart,              // Absolute x of the first micro-block, in elements
+    UINT_32             xEnd,                // Absolute x past the last micro-block, in elements
+    UINT_32             y,                   // Absolute y of the micro-blocks, in elements
+    UINT_32             sliceXor,            // Includes pipeBankXor and z XOR
+    const UINT_8*       pChunkOffsets,       // Offset of each chunk within a micro-block, in row-major order
+    const LutAddresser& addresser)
+{
+    constexpr UINT_32  PixBytes       = (1 << BPELog2);
+    constexpr UINT_32  ChunkBytes     = PixBytes * ExpandX;
+    constexpr UINT_32  MicroBlockSize = (1u << LutAddresser::MicroBlockBits);
+    constexpr bool     Stage          = (ChunkBytes < 16);
+    constexpr UINT_32  StripBlocks    = 32;
+
+    const UINT_32 microW        = 1u << addresser.GetMicroBlockXBits();
+    const UINT_32 microH        = 1u << addresser.GetMicroBlockYBits();
+    const UINT_32 chunksPerRow  = microW / ExpandX;
+    const UINT_32 blockXBits    = addresser.GetBlockXBits();
+    const UINT_32 blockBits     = addresser.GetBlockBits();
+    const UINT_32 yBlk          = (y >> addresser.GetBlockYBits()) * imageBlocksY;
+    const UINT_32 rowXor        = sliceXor ^ addresser.GetAddressY(y);
+
+    UINT_8* pMicro[StripBlocks];
+    UINT_32 lowXor[StripBlocks];
+    alignas(64) UINT_8 staging[Stage ? (StripBlocks * MicroBlockSize) : 1];
+
+    for (UINT_32 x = xStart; x < xEnd; x += StripBlocks * microW)
+    {
+        const UINT_32 numBlocks = Min(StripBlocks, (xEnd - x) >> addresser.GetMicroBlockXBits());
+
+        for (UINT_32 m = 0; m < numBlocks; m++)
+        {
+            UINT_32 mx       = x + (m * microW);
+            UINT_32 blk      = (yBlk + (mx >> blockXBits));
+            UINT_32 microXor = rowXor ^ addresser.GetAddressX(mx);
+            // The high bits pick the micro-block, the low ones can still shuffle things around within it.
+            pMicro[m] = static_cast<UINT_8*>(VoidPtrInc(pImgBlockSliceStart,
+                                                        (blk << blockBits) + (microXor & ~(MicroBlockSize - 1))));
+            lowXor[m] = microXor & (MicroBlockSize - 1);
+
+            if (Stage && (ImgIsDest == false))
+            {
+                memcpy(&staging[m * MicroBlockSize], pMicro[m], MicroBlockSize);
+            }
+        }
+
+        void* pRow = VoidPtrInc(pBuf, (x - xStart) * PixBytes);
+        for (UINT_32 yi = 0; yi < microH; yi++)
+        {
+            const UINT_8* pRowOffsets = &pChunkOffsets[yi * chunksPerRow];
+            void*         pPix        = pRow;
+
+            for (UINT_32 m = 0; m < numBlocks; m++)
+            {
+                UINT_8* pDst = Stage ? &staging[m * MicroBlockSize] : pMicro[m];
+                for (UINT_32 c = 0; c < chunksPerRow; c++)
+                {
+                    UINT_8* pChunk = &pDst[pRowOffsets[c] ^ lowXor[m]];
+                    if (ImgIsDest)
+                    {
+                        memcpy(pChunk, pPix, ChunkBytes);
+                    }
+                    else
+                    {
+                        memcpy(pPix, pChunk, ChunkBytes);
+                    }
+                    pPix = VoidPtrInc(pPix, ChunkBytes);
+                }
+            }
+            pRow = VoidPtrInc(pRow, bufStrideY);
+        }
+
+        if (Stage && ImgIsDest)
+        {
+            for (UINT_32 m = 0; m < numBlocks; m++)
+            {
+                memcpy(pMicro[m], &staging[m * MicroBlockSize], MicroBlockSize);
+            }
+        }
+    }
+}
+
+/**
+****************************************************************************************************
+*   Copy2DSliceUnaligned
+*
+*   @brief
+*       Copies an arbitrary 2D pixel region to or from a surface.
+*
+*       When pixels come in small chunks, the part of the region made of whole micro-blocks is copied a
+*       micro-block at a time, and only the edges around it go row by row. Larger chunks already amortize
+*       the address calculation well enough on their own.
+****************************************************************************************************
+*/
+template <int BPELog2, int ExpandX, bool ImgIsDest>
+void Copy2DSliceUnaligned(
+    void*               pImgBlockSliceStart, // Block corresponding to beginning of slice
+    void*               pBuf,                // Pointer to data starting from the copy origin.
+    size_t              bufStrideY,          // Stride of each row in pBuf
+    UINT_32             imageBlocksY,        // Width of the image slice, in blocks.
+    ADDR_COORD2D        origin,              // Absolute origin, in elements
+    ADDR_EXTENT2D       extent,              // Size to copy, in elements
+    UINT_32             sliceXor,            // Includes pipeBankXor and z XOR
+    const LutAddresser& addresser)
+{
+    constexpr UINT_32  PixBytes   = (1 << BPELog2);
+    constexpr UINT_32  ChunkBytes = PixBytes * ExpandX;
+
+    const UINT_32 xEnd = origin.x + extent.width;
+    const UINT_32 yEnd = origin.y + extent.height;
+
+    UINT_32 xMicroStart = 0;
+    UINT_32 xMicroEnd   = 0;
+    UINT_32 yMicroStart = 0;
+    UINT_32 yMicroEnd   = 0;
+    // Only worth it if it saves enough address calculations. Writing 16B chunks into scattered micro-blocks
+    // loses to plain rows once the surface no longer fits in cache.
+    constexpr bool UseMicroBlocks = ImgIsDest ? (ChunkBytes < 16) : (ChunkBytes <= 16);
+
+    if (UseMicroBlocks && addresser.HasMicroBlocks())
+    {
+        const UINT_32 microW = 1u << addresser.GetMicroBlockXBits();
+        const UINT_32 microH = 1u << addresser.GetMicroBlockYBits();
+        xMicroStart = PowTwoAlign(origin.x, microW);
+        xMicroEnd   = PowTwoAlignDown(xEnd, microW);
+        yMicroStart = PowTwoAlign(origin.y, microH);
+        yMicroEnd   = PowTwoAlignDown(yEnd, microH);
+    }
+
+    if ((xMicroStart >= xMicroEnd) || (yMicroStart >= yMicroEnd))
+    {
+        Copy2DRowsUnaligned<BPELog2, ExpandX, ImgIsDest>(pImgBlockSliceStart, pBuf, bufStrideY, imageBlocksY,
+                                                         origin, extent, sliceXor, addresser);
+        return;
+    }
+
+    constexpr UINT_32  NumChunks  = (1u << LutAddresser::MicroBlockBits) / ChunkBytes;
+
+    const UINT_32 microW = 1u << addresser.GetMicroBlockXBits();
+    const UINT_32 microH = 1u << addresser.GetMicroBlockYBits();
+
+    // Position of each chunk of ExpandX pixels within a micro-block, before the XOR from the higher bits.
+    UINT_8 chunkOffsets[NumChunks];
+    for (UINT_32 i = 0; i < NumChunks; i++)
+    {
+        UINT_32 xi = (i * ExpandX) & (microW - 1);
+        UINT_32 yi = (i * ExpandX) >> addresser.GetMicroBlockXBits();
+        chunkOffsets[i] = static_cast<UINT_8>(addresser.GetAddressX(xi) ^ addresser.GetAddressY(yi));
+    }
+
+    // Copies the sub-rectangle [x0, x1) x [y0, y1) row by row.
+    auto copyRows = [&](UINT_32 x0, UINT_32 x1, UINT_32 y0, UINT_32 y1)
+    {
+        if ((x0 < x1) && (y0 < y1))
+        {
+            void* pSubBuf = VoidPtrInc(pBuf, ((y0 - origin.y) * bufStrideY) + ((x0 - origin.x) * PixBytes));
+            ADDR_COORD2D  subOrigin = { x0, y0 };
+            ADDR_EXTENT2D subExtent = { x1 - x0, y1 - y0 };
+            Copy2DRowsUnaligned<BPELog2, ExpandX, ImgIsDest>(pImgBlockSliceStart, pSubBuf, bufStrideY,
+                                                             imageBlocksY, subOrigin, subExtent, sliceXor,
+                                                             addresser);
+        }
+    };
+
+    // Rows above the micro-block aligned part
+    copyRows(origin.x, xEnd, origin.y, yMicroStart);
+
+    for (UINT_32 y = yMicroStart; y < yMicroEnd; y += microH)
+    {
+        copyRows(origin.x, xMicroStart, y, y + microH);
+        Copy2DMicroBlocks<BPELog2, ExpandX, ImgIsDest>(
+            pImgBlockSliceStart,
+            VoidPtrInc(pBuf, ((y - origin.y) * bufStrideY) + ((xMicroStart - origin.x) * PixBytes)),
+            bufStrideY,
+            imageBlocksY,
+            xMicroStart,
+            xMicroEnd,
+            y,
+            sliceXor,
+            chunkOffsets,
+            addresser);
+        copyRows(xMicroEnd, xEnd, y, y + microH);
+    }
+
+    // Rows below it
+    copyRows(origin.x, xEnd, yMicroEnd, yEnd);
+}
+
 /**
 ****************************************************************************************************
 *   LutAddresser::GetCopyMemImgFunc
@@ -41,6 +41,7 @@ class LutAddresser
 {
 public:
     constexpr static UINT_32 MaxLutSize = 2100; // Sized to fit the largest non-VAR LUT size
+    constexpr static UINT_32 MicroBlockBits = 8; // 256B micro-blocks
 
     LutAddresser();
 
@@ -64,6 +65,14 @@ public:
     UINT_32  GetBlockYBits() const { return Log2(m_blockSize.height); }
     UINT_32  GetBlockZBits() const { return Log2(m_blockSize.depth); }
 
+    // Size of the pixel rectangle covered by each 256B micro-block. Only valid if HasMicroBlocks().
+    UINT_32  GetMicroBlockXBits() const { return m_microBlockXBits; }
+    UINT_32  GetMicroBlockYBits() const { return m_microBlockYBits; }
+
+    // Whether the low x/y bits alone select the position within each 256B micro-block, such that
+    // micro-block aligned rectangles can be copied one whole micro-block at a time.
+    BOOL_32  HasMicroBlocks() const { return (m_microBlockXBits + m_microBlockYBits) != 0; }
+
     // "Fast single channel" functions to get the part that each channel contributes to be XORd together.
     UINT_32  GetAddressX(UINT_32  x) const { return m_pXLut[x & m_xLutMask];}
     UINT_32  GetAddressY(UINT_32  y) const { return m_pYLut[y & m_yLutMask];}
@@ -104,6 +113,10 @@ private:
     // This will be used as a simple optimization to batch together operations on adjacent x pixels.
     UINT_32  m_maxExpandX;
 
+    // Log2 of the width/height in pixels of each 256B micro-block, or 0 if micro-blocks aren't rectangles.
+    UINT_32  m_microBlockXBits;
+    UINT_32  m_microBlockYBits;
+
     // BPE for this equation.
     UINT_32  m_bpeLog2;
 
@@ -17,9 +17,12 @@
 #include "util/macros.h"
 #include "util/simple_mtx.h"
 #include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_debug.h"
 #include "util/format/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
+#include "util/u_queue.h"
 
 #include <errno.h>
 #include <stdio.h>
@@ -87,6 +90,9 @@
 struct ac_addrlib {
    ADDR_HANDLE handle;
    simple_mtx_t lock;
+
+   /* Most threads, including the calling one, working on a host copy. */
+   unsigned num_copy_threads;
 };
 
 unsigned ac_pipe_config_to_num_pipes(unsigned pipe_config)
@@ -693,6 +699,8 @@ struct ac_addrlib *ac_addrlib_create(const struct radeon_info *info,
 
    addrlib->handle = addrCreateOutput.hLib;
    simple_mtx_init(&addrlib->lock, mtx_plain);
+   addrlib->num_copy_threads = debug_get_num_option("AMD_HOST_COPY_THREADS",
+                                                    MIN2(util_get_cpu_caps()->nr_cpus, 4));
    return addrlib;
 }
 
@@ -4526,12 +4534,77 @@ ac_surface_copy_mem_surface(struct ac_addrlib *addrlib, const struct radeon_info
    }
 }
 
+/* Copies smaller than this aren't worth waking up other threads for. */
+#define AC_SURFACE_COPY_MIN_THREADED_SIZE (4 * 1024 * 1024)
+/* Smallest amount of data handed to a single thread. */
+#define AC_SURFACE_COPY_MIN_BAND_SIZE     (1024 * 1024)
+
+struct ac_surface_copy_job {
+   struct ac_addrlib *addrlib;
+   const struct radeon_info *info;
+   const struct radeon_surf *surf;
+   const struct ac_surf_info *surf_info;
+   const struct ac_surface_copy_region *region;
+   bool surface_is_dst;
+};
+
+static bool
+ac_surface_copy_band(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct ac_surface_copy_job *job = (const struct ac_surface_copy_job *)data;
+   struct ac_surface_copy_region region = *job->region;
+
+   region.offset.y += first_row;
+   region.extent.height = num_rows;
+   region.host_ptr = (const uint8_t *)job->region->host_ptr +
+                     (uint64_t)first_row * job->region->mem_row_pitch;
+
+   return ac_surface_copy_mem_surface(job->addrlib, job->info, job->surf, job->surf_info,
+                                      &region, job->surface_is_dst);
+}
+
+/* Large copies are split into horizontal bands that are swizzled in parallel.
+ * Every band covers all the slices of the region.
+ */
+static bool
+ac_surface_copy_mem_surface_threaded(struct ac_addrlib *addrlib, const struct radeon_info *info,
+                                     const struct radeon_surf *surf,
+                                     const struct ac_surf_info *surf_info,
+                                     const struct ac_surface_copy_region *surf_copy_region,
+                                     bool surface_is_dst)
+{
+   const uint32_t height = surf_copy_region->extent.height;
+   const uint64_t size = (uint64_t)surf_copy_region->extent.width * height *
+                         MAX2(surf_copy_region->extent.depth, 1) *
+                         MAX2(surf_copy_region->num_layers, 1) * surf->bpe;
+
+   if (size < AC_SURFACE_COPY_MIN_THREADED_SIZE || height <= 1)
+      return ac_surface_copy_mem_surface(addrlib, info, surf, surf_info, surf_copy_region,
+                                         surface_is_dst);
+
+   unsigned max_bands = MIN2(addrlib->num_copy_threads, size / AC_SURFACE_COPY_MIN_BAND_SIZE);
+
+   struct ac_surface_copy_job job = {
+      .addrlib = addrlib,
+      .info = info,
+      .surf = surf,
+      .surf_info = surf_info,
+      .region = surf_copy_region,
+      .surface_is_dst = surface_is_dst,
+   };
+
+   /* Keep band boundaries on whole micro-blocks where the image allows it. */
+   return util_queue_run_bands(height, height >= 16 * max_bands ? 16 : 1, max_bands,
+                               ac_surface_copy_band, &job);
+}
+
 bool
 ac_surface_copy_mem_to_surface(struct ac_addrlib *addrlib, const struct radeon_info *info,
                                const struct radeon_surf *surf, const struct ac_surf_info *surf_info,
                                const struct ac_surface_copy_region *surf_copy_region)
 {
-   return ac_surface_copy_mem_surface(addrlib, info, surf, surf_info, surf_copy_region, true);
+   return ac_surface_copy_mem_surface_threaded(addrlib, info, surf, surf_info, surf_copy_region,
+                                               true);
 }
 
 bool
@@ -4539,7 +4612,8 @@ ac_surface_copy_surface_to_mem(struct ac_addrlib *addrlib, const struct radeon_i
                                const struct radeon_surf *surf, const struct ac_surf_info *surf_info,
                                const struct ac_surface_copy_region *surf_copy_region)
 {
-   return ac_surface_copy_mem_surface(addrlib, info, surf, surf_info, surf_copy_region, false);
+   return ac_surface_copy_mem_surface_threaded(addrlib, info, surf, surf_info, surf_copy_region,
+                                               false);
 }
 
 void ac_surface_print_info(FILE *out, const struct radeon_info *info,
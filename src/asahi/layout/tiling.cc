@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include "util/macros.h"
+#include "util/u_atomic.h"
+#include "util/u_tiled_memcpy.h"
 #include "layout.h"
 
 /* Z-order with rectangular (NxN or 2NxN) tiles, at most 128x128:
@@ -113,6 +115,103 @@ memcpy_small(void *_tiled, void *_linear, const struct ail_layout *tiled_layout,
    }
 }
 
+/*
+ * Tiled memcpy layouts, built on first use for each block size and tile shape
+ * and kept for the lifetime of the process. Blocks are 1 to 16 bytes and tiles
+ * are NxN or 2NxN, with N a power of two. Tiles the tables can't describe are
+ * cached as ail_tiled_unsupported, so they fail straight away next time.
+ */
+#define AIL_TILED_LAYOUT_HEIGHTS 16
+
+static struct util_tiled_layout *
+   ail_tiled_layouts[5 * AIL_TILED_LAYOUT_HEIGHTS * 2];
+static struct util_tiled_layout ail_tiled_unsupported;
+
+static const struct util_tiled_layout *
+ail_get_tiled_layout(unsigned blocksize_B, struct ail_tile tile_size)
+{
+   unsigned height_log2 = util_logbase2(tile_size.height_el);
+   bool wide = tile_size.width_el != tile_size.height_el;
+
+   if (!util_is_power_of_two_nonzero(blocksize_B) || blocksize_B > 16 ||
+       !util_is_power_of_two_nonzero(tile_size.height_el) ||
+       height_log2 >= AIL_TILED_LAYOUT_HEIGHTS)
+      return NULL;
+
+   struct util_tiled_layout **slot =
+      &ail_tiled_layouts[(util_logbase2(blocksize_B) * AIL_TILED_LAYOUT_HEIGHTS +
+                          height_log2) * 2 + wide];
+   struct util_tiled_layout *layout = p_atomic_read(slot);
+
+   if (!layout) {
+      layout = (struct util_tiled_layout *)malloc(sizeof(*layout));
+      if (!layout)
+         return NULL;
+
+      if (!util_tiled_layout_init(layout, blocksize_B, tile_size.width_el,
+                                  tile_size.height_el,
+                                  ail_space_mask(tile_size.width_el),
+                                  ail_space_mask(tile_size.height_el) << 1,
+                                  0)) {
+         free(layout);
+         layout = &ail_tiled_unsupported;
+      }
+
+      struct util_tiled_layout *old = (struct util_tiled_layout *)
+         p_atomic_cmpxchg_ptr(slot, (struct util_tiled_layout *)NULL, layout);
+      if (old) {
+         if (layout != &ail_tiled_unsupported)
+            free(layout);
+         layout = old;
+      }
+   }
+
+   return layout != &ail_tiled_unsupported ? layout : NULL;
+}
+
+/*
+ * Copy with the common tiled memcpy, which moves a pair of elements at a time
+ * along the curve. Returns false for tiles it has no tables for, which are
+ * the large tiles of fully twiddled images.
+ */
+static bool
+ail_tiled_memcpy(void *_tiled, void *_linear, const struct ail_layout *tiled_layout,
+                 unsigned level, unsigned blocksize_B, unsigned linear_pitch_B,
+                 unsigned sx_px, unsigned sy_px, unsigned swidth_px,
+                 unsigned sheight_px, bool is_store)
+{
+   enum pipe_format format = tiled_layout->format;
+   struct ail_tile tile_size = tiled_layout->tilesize_el[level];
+
+   /* The masks below describe NxN and 2NxN tiles */
+   if (tile_size.width_el != tile_size.height_el &&
+       tile_size.width_el != 2 * tile_size.height_el)
+      return false;
+
+   const struct util_tiled_layout *layout =
+      ail_get_tiled_layout(blocksize_B, tile_size);
+   if (!layout)
+      return false;
+
+   unsigned tiles_per_row =
+      DIV_ROUND_UP(tiled_layout->stride_el[level], tile_size.width_el);
+   uint32_t tiled_stride_B = tiles_per_row * layout->tile_size_B;
+   unsigned sx_el = util_format_get_nblocksx(format, sx_px);
+   unsigned sy_el = util_format_get_nblocksy(format, sy_px);
+   unsigned swidth_el = util_format_get_nblocksx(format, swidth_px);
+   unsigned sheight_el = util_format_get_nblocksy(format, sheight_px);
+
+   if (is_store) {
+      util_tiled_store(layout, _tiled, tiled_stride_B, _linear, linear_pitch_B,
+                       sx_el, sy_el, swidth_el, sheight_el);
+   } else {
+      util_tiled_load(layout, _linear, linear_pitch_B, _tiled, tiled_stride_B,
+                      sx_el, sy_el, swidth_el, sheight_el);
+   }
+
+   return true;
+}
+
 #define TILED_UNALIGNED_TYPES(blocksize_B, store)                              \
    if (blocksize_B == 1) {                                                     \
       memcpy_small<uint8_t, store>(_tiled, _linear, tiled_layout, level,       \
@@ -153,6 +252,11 @@ ail_detile(void *_tiled, void *_linear, const struct ail_layout *tiled_layout,
    assert((sx_px + swidth_px) <= width_px && "Invalid usage");
    assert((sy_px + sheight_px) <= height_px && "Invalid usage");
 
+   if (ail_tiled_memcpy(_tiled, _linear, tiled_layout, level, blocksize_B,
+                        linear_pitch_B, sx_px, sy_px, swidth_px, sheight_px,
+                        false))
+      return;
+
    TILED_UNALIGNED_TYPES(blocksize_B, false);
 }
 
@@ -171,5 +275,10 @@ ail_tile(void *_tiled, void *_linear, const struct ail_layout *tiled_layout,
    assert((sx_px + swidth_px) <= width_px && "Invalid usage");
    assert((sy_px + sheight_px) <= height_px && "Invalid usage");
 
+   if (ail_tiled_memcpy(_tiled, _linear, tiled_layout, level, blocksize_B,
+                        linear_pitch_B, sx_px, sy_px, swidth_px, sheight_px,
+                        true))
+      return;
+
    TILED_UNALIGNED_TYPES(blocksize_B, true);
 }
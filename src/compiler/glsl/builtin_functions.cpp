@@ -78,6 +78,7 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 #include "main/consts_exts.h"
 #include "main/shader_types.h"
 #include "main/shaderobj.h"
@@ -1152,25 +1153,38 @@ public:
    ~builtin_builder();
    builtin_builder & operator=(const builtin_builder &) = delete;
 
-   void initialize();
    void release();
    ir_function_signature *find(_mesa_glsl_parse_state *state,
                                const char *name, ir_exec_list *actual_parameters);
 
    /**
-    * A symbol table to hold all the built-in signatures; created by this
-    * module.
+    * Returns the symbol table holding all the built-in signatures, generating
+    * it on first use.
     *
     * This includes signatures for every built-in, regardless of version or
     * enabled extensions.  The availability predicate associated with each
     * signature allows matching_signature() to filter out the irrelevant ones.
+    *
+    * Once generated, the table is never modified until release(), so it can
+    * be read from any number of compiler threads without locking.
     */
-   struct glsl_symbol_table *symbols;
+   struct glsl_symbol_table *get_symbols();
 
 private:
    void *mem_ctx;
    linear_ctx *linalloc;
 
+   /** The table create_builtins() and friends are filling in. */
+   struct glsl_symbol_table *symbols;
+
+   /**
+    * Same as symbols, but only set once the table is complete.  This is what
+    * lock-free readers look at.
+    */
+   struct glsl_symbol_table *published_symbols;
+
+   void initialize();
+
    void create_shader();
    void create_intrinsics();
    void create_builtins();
@@ -1617,7 +1631,7 @@ enum image_function_flags {
  *  @{
  */
 builtin_builder::builtin_builder()
-   : symbols(NULL)
+   : symbols(NULL), published_symbols(NULL)
 {
    mem_ctx = NULL;
    linalloc = NULL;
@@ -1631,6 +1645,7 @@ builtin_builder::~builtin_builder()
    mem_ctx = NULL;
    linalloc = NULL;
    symbols = NULL;
+   published_symbols = NULL;
 
    simple_mtx_unlock(&builtins_lock);
 }
@@ -1648,7 +1663,7 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
     */
    state->uses_builtin_functions = true;
 
-   ir_function *f = symbols->get_function(name);
+   ir_function *f = get_symbols()->get_function(name);
    if (f == NULL)
       return NULL;
 
@@ -1663,6 +1678,28 @@ builtin_builder::find(_mesa_glsl_parse_state *state,
    return sig;
 }
 
+struct glsl_symbol_table *
+builtin_builder::get_symbols()
+{
+   struct glsl_symbol_table *table = p_atomic_read(&published_symbols);
+   if (likely(table != NULL))
+      return table;
+
+   simple_mtx_lock(&builtins_lock);
+   initialize();
+   simple_mtx_unlock(&builtins_lock);
+
+   return published_symbols;
+}
+
+/**
+ * Generates the IR for every built-in.  This is a few megabytes of IR, so it
+ * is deferred until a shader actually calls a built-in rather than done when
+ * the first context takes a reference: many processes never compile a shader
+ * that isn't already in the shader cache.
+ *
+ * Must be called with builtins_lock held.
+ */
 void
 builtin_builder::initialize()
 {
@@ -1670,15 +1707,19 @@ builtin_builder::initialize()
    if (mem_ctx != NULL)
       return;
 
-   glsl_type_singleton_init_or_ref();
-
    mem_ctx = ralloc_context(NULL);
    linalloc = linear_context(mem_ctx);
    create_shader();
    create_intrinsics();
    create_builtins();
+
+   p_atomic_set(&published_symbols, symbols);
 }
 
+/**
+ * Must be called with builtins_lock held, and only once no compile can be
+ * looking at the built-ins anymore.
+ */
 void
 builtin_builder::release()
 {
@@ -1686,8 +1727,7 @@ builtin_builder::release()
    mem_ctx = NULL;
    linalloc = NULL;
    symbols = NULL;
-
-   glsl_type_singleton_decref();
+   published_symbols = NULL;
 }
 
 void
@@ -9573,7 +9613,7 @@ _mesa_glsl_builtin_functions_init_or_ref()
 {
    simple_mtx_lock(&builtins_lock);
    if (builtin_users++ == 0)
-      builtins.initialize();
+      glsl_type_singleton_init_or_ref();
    simple_mtx_unlock(&builtins_lock);
 }
 
@@ -9582,8 +9622,10 @@ _mesa_glsl_builtin_functions_decref()
 {
    simple_mtx_lock(&builtins_lock);
    assert(builtin_users != 0);
-   if (--builtin_users == 0)
+   if (--builtin_users == 0) {
       builtins.release();
+      glsl_type_singleton_decref();
+   }
    simple_mtx_unlock(&builtins_lock);
 }
 
@@ -9591,38 +9633,27 @@ ir_function_signature *
 _mesa_glsl_find_builtin_function(_mesa_glsl_parse_state *state,
                                  const char *name, ir_exec_list *actual_parameters)
 {
-   ir_function_signature *s;
-   simple_mtx_lock(&builtins_lock);
-   s = builtins.find(state, name, actual_parameters);
-   simple_mtx_unlock(&builtins_lock);
-
-   return s;
+   return builtins.find(state, name, actual_parameters);
 }
 
 bool
 _mesa_glsl_has_builtin_function(_mesa_glsl_parse_state *state, const char *name)
 {
-   ir_function *f;
-   bool ret = false;
-   simple_mtx_lock(&builtins_lock);
-   f = builtins.symbols->get_function(name);
+   ir_function *f = builtins.get_symbols()->get_function(name);
    if (f != NULL) {
       ir_foreach_in_list(ir_function_signature, sig, &f->signatures) {
-         if (sig->is_builtin_available(state)) {
-            ret = true;
-            break;
-         }
+         if (sig->is_builtin_available(state))
+            return true;
       }
    }
-   simple_mtx_unlock(&builtins_lock);
 
-   return ret;
+   return false;
 }
 
 struct glsl_symbol_table *
 _mesa_glsl_get_builtin_function_symbols()
 {
-   return builtins.symbols;
+   return builtins.get_symbols();
 }
 
 
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "util/os_time.h"
+#include "ir.h"
+#include "builtin_functions.h"
+#include "glsl_symbol_table.h"
+
+/* Resident set size in KiB, or 0 where we don't know how to get it. */
+static long
+get_rss_kb(void)
+{
+#ifdef __linux__
+   long pages = 0, resident = 0;
+   FILE *f = fopen("/proc/self/statm", "r");
+   if (!f)
+      return 0;
+   if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+      resident = 0;
+   fclose(f);
+   return resident * (sysconf(_SC_PAGESIZE) / 1024);
+#else
+   return 0;
+#endif
+}
+
+/* Taking a reference is what context creation does, and has to stay cheap.
+ * The IR is only generated by the first lookup, which any number of compile
+ * threads may race on.
+ */
+TEST(builtin_functions, lazy_concurrent_lookup)
+{
+   long rss0 = get_rss_kb();
+   int64_t t0 = os_time_get_nano();
+   _mesa_glsl_builtin_functions_init_or_ref();
+   int64_t t1 = os_time_get_nano();
+   long rss1 = get_rss_kb();
+
+   const unsigned num_threads = 8;
+   std::vector<std::thread> threads;
+   std::vector<glsl_symbol_table *> tables(num_threads);
+   std::vector<ir_function *> funcs(num_threads);
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      threads.emplace_back([&, i]() {
+         tables[i] = _mesa_glsl_get_builtin_function_symbols();
+         funcs[i] = tables[i]->get_function("texture");
+      });
+   }
+   for (auto &t : threads)
+      t.join();
+
+   int64_t t2 = os_time_get_nano();
+   long rss2 = get_rss_kb();
+
+   for (unsigned i = 0; i < num_threads; i++) {
+      EXPECT_NE(tables[i], nullptr);
+      EXPECT_EQ(tables[i], tables[0]);
+      EXPECT_NE(funcs[i], nullptr);
+      EXPECT_EQ(funcs[i], funcs[0]);
+   }
+
+   printf("init_or_ref: %.3f ms, %ld KiB; first lookup: %.3f ms, %ld KiB\n",
+          (t1 - t0) / 1000000.0, rss1 - rss0,
+          (t2 - t1) / 1000000.0, rss2 - rss1);
+
+   _mesa_glsl_builtin_functions_decref();
+}
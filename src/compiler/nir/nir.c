@@ -206,6 +206,7 @@ nir_shader_create(void *mem_ctx,
 #ifndef NDEBUG
    nir_process_debug_variable();
 #endif
+   nir_pass_stats_init_shader(shader);
 
    exec_list_make_empty(&shader->variables);
 
@@ -3830,6 +3830,9 @@ typedef struct nir_shader {
    u_printf_info *printf_info;
 
    bool has_debug_info;
+
+   /** Identifies the shader in NIR_PASS_STATS, 0 if they are disabled. */
+   uint32_t pass_stats_id;
 } nir_shader;
 
 #define nir_foreach_function(func, shader) \
@@ -4752,6 +4755,26 @@ should_print_nir(UNUSED nir_shader *shader)
 }
 #endif /* NDEBUG */
 
+/* Per-pass statistics, enabled by the NIR_PASS_STATS environment variable.
+ * See nir_pass_stats.c.
+ */
+extern bool nir_pass_stats_enabled;
+
+typedef struct nir_pass_stats_sample {
+   int64_t start_ns;
+   unsigned num_instrs;
+} nir_pass_stats_sample;
+
+void nir_pass_stats_init_shader(nir_shader *shader);
+void nir_pass_stats_begin(nir_shader *shader, nir_pass_stats_sample *sample);
+void nir_pass_stats_end(nir_shader *shader, const char *pass,
+                        const char *file, unsigned line, bool progress,
+                        const nir_pass_stats_sample *sample);
+void nir_pass_stats_skipped(nir_shader *shader, const char *pass,
+                            const char *file, unsigned line);
+void nir_pass_stats_dump(FILE *fp);
+void nir_pass_stats_reset(void);
+
 #define _PASS(pass, nir, do_pass)                                       \
    do {                                                                 \
       if (should_skip_nir(#pass)) {                                     \
@@ -4779,7 +4802,15 @@ should_print_nir(UNUSED nir_shader *shader)
    nir_metadata_set_validation_flag(nir);                                                   \
    if (should_print_nir(nir))                                                               \
       printf("%s\n", #pass);                                                                \
-   if (pass(nir, ##__VA_ARGS__)) {                                                          \
+   const bool _nir_pass_stats = nir_pass_stats_enabled;                                     \
+   nir_pass_stats_sample _nir_pass_sample = { 0 };                                          \
+   if (unlikely(_nir_pass_stats))                                                           \
+      nir_pass_stats_begin(nir, &_nir_pass_sample);                                         \
+   const bool _nir_pass_progress = pass(nir, ##__VA_ARGS__);                                \
+   if (unlikely(_nir_pass_stats))                                                           \
+      nir_pass_stats_end(nir, #pass, __FILE__, __LINE__, _nir_pass_progress,                \
+                         &_nir_pass_sample);                                                \
+   if (_nir_pass_progress) {                                                                \
       nir_validate_shader(nir, "after " #pass " in " __FILE__ ":" NIR_STRINGIZE(__LINE__)); \
       UNUSED bool _;                                                                        \
       progress = true;                                                                      \
@@ -4794,12 +4825,14 @@ should_print_nir(UNUSED nir_shader *shader)
 #define _NIR_LOOP_PASS(progress, idempotent, skip, nir, pass, ...)   \
 do {                                                                 \
    bool nir_loop_pass_progress = false;                              \
-   if (!_mesa_set_search(skip, (void (*)())&pass))                   \
+   if (!_mesa_set_search(skip, (const void *)(uintptr_t)&pass))      \
       NIR_PASS(nir_loop_pass_progress, nir, pass, ##__VA_ARGS__);    \
+   else if (unlikely(nir_pass_stats_enabled))                        \
+      nir_pass_stats_skipped(nir, #pass, __FILE__, __LINE__);        \
    if (nir_loop_pass_progress)                                       \
       _mesa_set_clear(skip, NULL);                                   \
    if (idempotent || !nir_loop_pass_progress)                        \
-      _mesa_set_add(skip, (void (*)())&pass);                        \
+      _mesa_set_add(skip, (const void *)(uintptr_t)&pass);           \
    UNUSED bool _ = false;                                            \
    progress |= nir_loop_pass_progress;                               \
 } while (0)
@@ -880,7 +880,10 @@ nir_shader_replace(nir_shader *dst, nir_shader *src)
    /* Re-parent all of src's ralloc children to dst */
    ralloc_adopt(dst, src);
 
+   /* dst stays the same shader as far as NIR_PASS_STATS is concerned. */
+   uint32_t pass_stats_id = dst->pass_stats_id;
    memcpy(dst, src, sizeof(*dst));
+   dst->pass_stats_id = pass_stats_id;
 
    /* We have to move all the linked lists over separately because we need the
     * pointers in the list elements to point to the lists in dst and not src.
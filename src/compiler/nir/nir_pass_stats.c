@@ -0,0 +1,355 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * Per-pass statistics for NIR_PASS and NIR_LOOP_PASS.
+ *
+ * If NIR_PASS_STATS is set, every pass run through NIR_PASS records its
+ * wall time, whether it made progress and by how much it changed the number
+ * of instructions, per shader stage and call site.  NIR_LOOP_PASS also
+ * records the passes it skipped because nothing changed since their last
+ * run.  At exit, the statistics are written as JSON to the file named by
+ * NIR_PASS_STATS, or to stderr if it is "stderr".
+ *
+ * The number of times a call site runs for one shader is the number of
+ * iterations of the optimization loop around it, if there is one.  Time
+ * spent in passes which made no progress is reported as wasted.
+ */
+
+#include <stdlib.h>
+
+#include "nir.h"
+#include "c11/threads.h"
+#include "util/hash_table.h"
+#include "util/os_misc.h"
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+#include "util/u_atomic.h"
+
+struct pass_site {
+   /* Key */
+   mesa_shader_stage stage;
+   const char *pass;
+   const char *file;
+   unsigned line;
+
+   uint64_t calls;
+   uint64_t progress;
+   uint64_t skipped;
+   uint64_t time_ns;
+   uint64_t wasted_ns;
+   int64_t instr_delta;
+
+   /* Loop iterations, i.e. calls and skips per shader.  Shaders compiled
+    * on different threads run through the same sites at the same time, so
+    * the iterations are counted per shader id.
+    */
+   struct hash_table_u64 *shader_iterations;
+   uint64_t shaders;
+   unsigned max_iterations;
+};
+
+bool nir_pass_stats_enabled = false;
+
+static struct {
+   simple_mtx_t mutex;
+   struct hash_table *sites;
+   uint32_t next_shader_id;
+   const char *path;
+} stats = {
+   .mutex = SIMPLE_MTX_INITIALIZER,
+};
+
+static uint32_t
+site_hash(const void *key)
+{
+   const struct pass_site *site = key;
+
+   return _mesa_hash_string(site->pass) ^
+          (_mesa_hash_string(site->file) * 31) ^
+          (site->line << 4) ^ (uint32_t)site->stage;
+}
+
+static bool
+site_equal(const void *a, const void *b)
+{
+   const struct pass_site *sa = a, *sb = b;
+
+   return sa->stage == sb->stage && sa->line == sb->line &&
+          !strcmp(sa->pass, sb->pass) && !strcmp(sa->file, sb->file);
+}
+
+static unsigned
+count_instrs(nir_shader *shader)
+{
+   unsigned count = 0;
+
+   nir_foreach_function_impl(impl, shader) {
+      nir_foreach_block(block, impl)
+         count += exec_list_length(&block->instr_list);
+   }
+   return count;
+}
+
+/* Find or create the record of a call site, and count one more iteration
+ * for the shader.  Must be called with the mutex held.
+ */
+static struct pass_site *
+get_site(nir_shader *shader, const char *pass, const char *file,
+         unsigned line)
+{
+   struct pass_site key = {
+      .stage = shader->info.stage,
+      .pass = pass,
+      .file = file,
+      .line = line,
+   };
+
+   if (!stats.sites) {
+      stats.sites = _mesa_hash_table_create(NULL, site_hash, site_equal);
+      if (!stats.sites)
+         return NULL;
+   }
+
+   struct pass_site *site;
+   uint32_t hash = site_hash(&key);
+   struct hash_entry *entry =
+      _mesa_hash_table_search_pre_hashed(stats.sites, hash, &key);
+
+   if (entry) {
+      site = entry->data;
+   } else {
+      site = rzalloc(stats.sites, struct pass_site);
+      if (!site)
+         return NULL;
+
+      *site = key;
+      site->shader_iterations = _mesa_hash_table_u64_create(site);
+      if (!site->shader_iterations) {
+         ralloc_free(site);
+         return NULL;
+      }
+      _mesa_hash_table_insert_pre_hashed(stats.sites, hash, site, site);
+   }
+
+   unsigned iterations = (uintptr_t)
+      _mesa_hash_table_u64_search(site->shader_iterations,
+                                  shader->pass_stats_id);
+   if (iterations == 0)
+      site->shaders++;
+
+   iterations++;
+   _mesa_hash_table_u64_insert(site->shader_iterations, shader->pass_stats_id,
+                               (void *)(uintptr_t)iterations);
+   site->max_iterations = MAX2(site->max_iterations, iterations);
+
+   return site;
+}
+
+void
+nir_pass_stats_begin(nir_shader *shader, nir_pass_stats_sample *sample)
+{
+   sample->num_instrs = count_instrs(shader);
+   sample->start_ns = os_time_get_nano();
+}
+
+void
+nir_pass_stats_end(nir_shader *shader, const char *pass, const char *file,
+                   unsigned line, bool progress,
+                   const nir_pass_stats_sample *sample)
+{
+   uint64_t time_ns = os_time_get_nano() - sample->start_ns;
+   int64_t instr_delta =
+      progress ? (int64_t)count_instrs(shader) - sample->num_instrs : 0;
+
+   simple_mtx_lock(&stats.mutex);
+   struct pass_site *site = get_site(shader, pass, file, line);
+   if (site) {
+      site->calls++;
+      site->time_ns += time_ns;
+      site->instr_delta += instr_delta;
+      if (progress)
+         site->progress++;
+      else
+         site->wasted_ns += time_ns;
+   }
+   simple_mtx_unlock(&stats.mutex);
+}
+
+void
+nir_pass_stats_skipped(nir_shader *shader, const char *pass,
+                       const char *file, unsigned line)
+{
+   simple_mtx_lock(&stats.mutex);
+   struct pass_site *site = get_site(shader, pass, file, line);
+   if (site)
+      site->skipped++;
+   simple_mtx_unlock(&stats.mutex);
+}
+
+static void
+print_json_string(FILE *fp, const char *str)
+{
+   fputc('"', fp);
+   for (const char *c = str; *c; c++) {
+      if (*c == '"' || *c == '\\')
+         fprintf(fp, "\\%c", *c);
+      else if ((unsigned char)*c < 0x20)
+         fprintf(fp, "\\u%04x", *c);
+      else
+         fputc(*c, fp);
+   }
+   fputc('"', fp);
+}
+
+/* By stage, then by decreasing time. */
+static int
+compare_sites(const void *a, const void *b)
+{
+   const struct pass_site *sa = *(const struct pass_site **)a;
+   const struct pass_site *sb = *(const struct pass_site **)b;
+
+   if (sa->stage != sb->stage)
+      return sa->stage < sb->stage ? -1 : 1;
+   if (sa->time_ns != sb->time_ns)
+      return sa->time_ns > sb->time_ns ? -1 : 1;
+   return 0;
+}
+
+static void
+print_stage(FILE *fp, struct pass_site **sites, unsigned count)
+{
+   uint64_t time_ns = 0, wasted_ns = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      time_ns += sites[i]->time_ns;
+      wasted_ns += sites[i]->wasted_ns;
+   }
+
+   fprintf(fp, "    ");
+   print_json_string(fp, _mesa_shader_stage_to_string(sites[0]->stage));
+   fprintf(fp, ": {\n");
+   fprintf(fp, "      \"time_ns\": %" PRIu64 ",\n", time_ns);
+   fprintf(fp, "      \"wasted_ns\": %" PRIu64 ",\n", wasted_ns);
+   fprintf(fp, "      \"passes\": [\n");
+
+   for (unsigned i = 0; i < count; i++) {
+      const struct pass_site *site = sites[i];
+
+      fprintf(fp, "        {\"pass\": ");
+      print_json_string(fp, site->pass);
+      fprintf(fp, ", \"file\": ");
+      print_json_string(fp, site->file);
+      fprintf(fp, ", \"line\": %u", site->line);
+      fprintf(fp, ", \"calls\": %" PRIu64 ", \"progress\": %" PRIu64
+                  ", \"progress_ratio\": %.3f, \"skipped\": %" PRIu64,
+              site->calls, site->progress,
+              site->calls ? (double)site->progress / site->calls : 0.0,
+              site->skipped);
+      fprintf(fp, ", \"time_ns\": %" PRIu64 ", \"wasted_ns\": %" PRIu64
+                  ", \"instr_delta\": %" PRId64,
+              site->time_ns, site->wasted_ns, site->instr_delta);
+      fprintf(fp, ", \"shaders\": %" PRIu64 ", \"iterations_avg\": %.2f"
+                  ", \"iterations_max\": %u}%s\n",
+              site->shaders,
+              (double)(site->calls + site->skipped) / site->shaders,
+              site->max_iterations, i + 1 < count ? "," : "");
+   }
+
+   fprintf(fp, "      ]\n");
+   fprintf(fp, "    }");
+}
+
+/**
+ * Write the statistics recorded so far as JSON.
+ */
+void
+nir_pass_stats_dump(FILE *fp)
+{
+   simple_mtx_lock(&stats.mutex);
+
+   unsigned count = stats.sites ? stats.sites->entries : 0;
+   struct pass_site **sites = malloc(MAX2(count, 1) * sizeof(*sites));
+   if (!sites) {
+      simple_mtx_unlock(&stats.mutex);
+      return;
+   }
+
+   unsigned i = 0;
+   if (stats.sites) {
+      hash_table_foreach(stats.sites, entry)
+         sites[i++] = entry->data;
+   }
+   qsort(sites, count, sizeof(*sites), compare_sites);
+
+   fprintf(fp, "{\n  \"stages\": {\n");
+   for (unsigned first = 0, last; first < count; first = last) {
+      for (last = first + 1; last < count; last++) {
+         if (sites[last]->stage != sites[first]->stage)
+            break;
+      }
+
+      print_stage(fp, &sites[first], last - first);
+      fprintf(fp, "%s\n", last < count ? "," : "");
+   }
+   fprintf(fp, "  }\n}\n");
+   fflush(fp);
+
+   simple_mtx_unlock(&stats.mutex);
+   free(sites);
+}
+
+/**
+ * Forget the statistics recorded so far.
+ */
+void
+nir_pass_stats_reset(void)
+{
+   simple_mtx_lock(&stats.mutex);
+   _mesa_hash_table_destroy(stats.sites, NULL);
+   stats.sites = NULL;
+   simple_mtx_unlock(&stats.mutex);
+}
+
+static void
+pass_stats_exit(void)
+{
+   FILE *fp = strcmp(stats.path, "stderr") ? fopen(stats.path, "w") : stderr;
+
+   if (!fp) {
+      fprintf(stderr, "NIR_PASS_STATS: failed to open %s\n", stats.path);
+      return;
+   }
+
+   nir_pass_stats_dump(fp);
+   if (fp != stderr)
+      fclose(fp);
+}
+
+static void
+pass_stats_init_once(void)
+{
+   stats.path = os_get_option("NIR_PASS_STATS");
+   if (stats.path && stats.path[0]) {
+      nir_pass_stats_enabled = true;
+      atexit(pass_stats_exit);
+   }
+}
+
+/**
+ * Called for every new shader: reads NIR_PASS_STATS the first time, and
+ * gives the shader an identifier which tells loop iterations over one
+ * shader apart from runs over different shaders.
+ */
+void
+nir_pass_stats_init_shader(nir_shader *shader)
+{
+   static once_flag once = ONCE_FLAG_INIT;
+
+   call_once(&once, pass_stats_init_once);
+
+   if (unlikely(nir_pass_stats_enabled))
+      shader->pass_stats_id = p_atomic_inc_return(&stats.next_shader_id);
+}
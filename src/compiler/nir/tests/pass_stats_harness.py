@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+#
+# Copyright 2025 Mesa contributors
+# SPDX-License-Identifier: MIT
+
+"""Runs the NIR unit tests with NIR_PASS_STATS set, checks the statistics
+they write and prints the passes which took the most time in each stage.
+
+This can be pointed at any other program to profile its NIR passes the
+same way.
+"""
+
+import argparse
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+INT_FIELDS = ('line', 'calls', 'progress', 'skipped', 'time_ns',
+              'wasted_ns', 'instr_delta', 'shaders', 'iterations_max')
+
+
+def check_pass(stage, p):
+    where = '{}: {} at {}:{}'.format(stage, p.get('pass'), p.get('file'),
+                                     p.get('line'))
+    for field in INT_FIELDS:
+        assert isinstance(p.get(field), int), '{}: bad {}'.format(where, field)
+    assert isinstance(p['pass'], str) and isinstance(p['file'], str), where
+    assert p['calls'] + p['skipped'] > 0, where
+    assert 0 <= p['progress'] <= p['calls'], where
+    assert 0 <= p['wasted_ns'] <= p['time_ns'], where
+    assert p['progress'] or p['instr_delta'] == 0, where
+    assert 1 <= p['shaders'] <= p['calls'] + p['skipped'], where
+    assert 1 <= p['iterations_max'] <= p['calls'] + p['skipped'], where
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('program', nargs=argparse.REMAINDER,
+                        help='program to run, e.g. nir_tests')
+    parser.add_argument('--top', type=int, default=10,
+                        help='number of passes to print per stage')
+    args = parser.parse_args()
+    if not args.program:
+        parser.error('no program to run')
+
+    with tempfile.TemporaryDirectory() as tmp:
+        path = os.path.join(tmp, 'nir_pass_stats.json')
+        env = dict(os.environ, NIR_PASS_STATS=path)
+        subprocess.run(args.program, env=env, check=True,
+                       stdout=subprocess.DEVNULL)
+        with open(path) as f:
+            stats = json.load(f)
+
+    stages = stats['stages']
+    assert stages, 'no passes were recorded'
+
+    for stage, s in stages.items():
+        for p in s['passes']:
+            check_pass(stage, p)
+        assert s['time_ns'] == sum(p['time_ns'] for p in s['passes']), stage
+
+        print('{}: {:.3f} ms in passes, {:.3f} ms without progress'.format(
+            stage, s['time_ns'] / 1e6, s['wasted_ns'] / 1e6))
+        for p in s['passes'][:args.top]:
+            print('  {:>10.3f} ms {:6} calls {:6.1%} progress {:6} skipped '
+                  '{:6.2f} iter/shader  {} ({}:{})'.format(
+                      p['time_ns'] / 1e6, p['calls'], p['progress_ratio'],
+                      p['skipped'], p['iterations_avg'], p['pass'],
+                      os.path.basename(p['file']), p['line']))
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
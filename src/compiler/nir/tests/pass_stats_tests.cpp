@@ -0,0 +1,151 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string>
+#include <vector>
+
+#include "nir_test.h"
+
+class nir_pass_stats_test : public nir_test {
+protected:
+   nir_pass_stats_test()
+      : nir_test::nir_test("nir_pass_stats_test")
+   {
+      enabled = nir_pass_stats_enabled;
+      nir_pass_stats_enabled = true;
+      nir_pass_stats_reset();
+   }
+
+   ~nir_pass_stats_test()
+   {
+      nir_pass_stats_enabled = enabled;
+   }
+
+   /* The JSON lines of the call sites in this file. */
+   std::vector<std::string> dump_sites()
+   {
+      char *dump = NULL;
+      size_t size = 0;
+      struct u_memstream mem;
+      std::vector<std::string> sites;
+
+      if (!u_memstream_open(&mem, &dump, &size))
+         return sites;
+      nir_pass_stats_dump(u_memstream_get(&mem));
+      u_memstream_close(&mem);
+
+      std::string line;
+      for (const char *c = dump; *c; c++) {
+         if (*c != '\n') {
+            line += *c;
+            continue;
+         }
+         if (line.find("pass_stats_tests.cpp") != std::string::npos)
+            sites.push_back(line);
+         line.clear();
+      }
+
+      free(dump);
+      return sites;
+   }
+
+   bool enabled;
+};
+
+static bool
+contains(const std::string &str, const char *substr)
+{
+   return str.find(substr) != std::string::npos;
+}
+
+TEST_F(nir_pass_stats_test, passes)
+{
+   nir_def *x = nir_imm_int(b, 1);
+   nir_iadd(b, x, x);
+
+   bool progress = false;
+   NIR_PASS(progress, b->shader, nir_opt_dce);
+   EXPECT_TRUE(progress);
+
+   /* An optimization loop in which nothing makes progress anymore. */
+   struct set *skip = _mesa_pointer_set_create(NULL);
+   for (unsigned i = 0; i < 3; i++) {
+      NIR_PASS(progress, b->shader, nir_opt_dce);
+      NIR_LOOP_PASS(progress, skip, b->shader, nir_opt_cse);
+   }
+   _mesa_set_destroy(skip, NULL);
+
+   std::vector<std::string> sites = dump_sites();
+   ASSERT_EQ(sites.size(), 3u);
+
+   for (const std::string &site : sites) {
+      EXPECT_TRUE(contains(site, "\"shaders\": 1,")) << site;
+
+      if (contains(site, "\"nir_opt_cse\"")) {
+         EXPECT_TRUE(contains(site, "\"calls\": 1,")) << site;
+         EXPECT_TRUE(contains(site, "\"skipped\": 2,")) << site;
+         EXPECT_TRUE(contains(site, "\"iterations_max\": 3}")) << site;
+      } else if (contains(site, "\"progress\": 1,")) {
+         EXPECT_TRUE(contains(site, "\"calls\": 1,")) << site;
+         EXPECT_TRUE(contains(site, "\"instr_delta\": -2,")) << site;
+      } else {
+         EXPECT_TRUE(contains(site, "\"calls\": 3, \"progress\": 0,")) << site;
+         EXPECT_TRUE(contains(site, "\"wasted_ns\"")) << site;
+         EXPECT_TRUE(contains(site, "\"iterations_max\": 3}")) << site;
+      }
+   }
+}
+
+static bool
+optimize_once(nir_shader *shader, struct set *skip)
+{
+   bool progress = false;
+
+   NIR_LOOP_PASS(progress, skip, shader, nir_opt_dce);
+   NIR_LOOP_PASS(progress, skip, shader, nir_opt_cse);
+
+   return progress;
+}
+
+/* Shaders compiled on different threads go through the same sites at the
+ * same time, the iterations of one must not end the loop of the other.
+ */
+TEST_F(nir_pass_stats_test, interleaved_shaders)
+{
+   nir_def *x = nir_imm_int(b, 1);
+   nir_iadd(b, x, x);
+
+   nir_shader *shaders[2] = { b->shader, nir_shader_clone(NULL, b->shader) };
+   struct set *skip[2] = {
+      _mesa_pointer_set_create(NULL), _mesa_pointer_set_create(NULL),
+   };
+
+   /* One iteration with progress from nir_opt_dce, and one in which both
+    * passes are skipped.
+    */
+   for (unsigned i = 0; i < 2; i++) {
+      for (unsigned s = 0; s < 2; s++)
+         EXPECT_EQ(optimize_once(shaders[s], skip[s]), i == 0);
+   }
+
+   std::vector<std::string> sites = dump_sites();
+   ASSERT_EQ(sites.size(), 2u);
+
+   for (const std::string &site : sites) {
+      EXPECT_TRUE(contains(site, "\"skipped\": 2,")) << site;
+      EXPECT_TRUE(contains(site, "\"shaders\": 2,")) << site;
+      EXPECT_TRUE(contains(site, "\"iterations_avg\": 2.00")) << site;
+      EXPECT_TRUE(contains(site, "\"iterations_max\": 2}")) << site;
+
+      if (contains(site, "\"nir_opt_dce\""))
+         EXPECT_TRUE(contains(site, "\"calls\": 2, \"progress\": 2,")) << site;
+      else
+         EXPECT_TRUE(contains(site, "\"calls\": 2, \"progress\": 0,")) << site;
+   }
+
+   for (unsigned s = 0; s < 2; s++)
+      _mesa_set_destroy(skip[s], NULL);
+   ralloc_free(shaders[1]);
+}
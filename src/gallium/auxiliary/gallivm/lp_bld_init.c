@@ -156,7 +156,7 @@ init_gallivm_engine(struct gallivm_state *gallivm)
       char *error = NULL;
       int ret;
 
-      if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
+      if ((gallivm_perf & GALLIVM_PERF_NO_OPT) || gallivm->fast_compile) {
          optlevel = None;
       }
       else {
@@ -423,7 +423,8 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    lp_passmgr_run(gallivm->passmgr,
                   gallivm->module,
                   LLVMGetExecutionEngineTargetMachine(gallivm->engine),
-                  gallivm->module_name);
+                  gallivm->module_name,
+                  gallivm->fast_compile);
 
    /* Setting the module's DataLayout to an empty string will cause the
     * ExecutionEngine to copy to the DataLayout string from its target machine
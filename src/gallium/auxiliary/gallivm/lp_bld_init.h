@@ -71,6 +71,11 @@ struct gallivm_state
    LLVMDIBuilderRef di_builder;
    struct lp_cached_code *cache;
    unsigned compiled;
+   /* Compile with minimal optimization and fast instruction selection,
+    * for code which gets replaced by an optimized build if it turns out
+    * to matter.  Must be set before gallivm_compile_module().
+    */
+   bool fast_compile;
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
    LLVMValueRef debug_printf_hook;
@@ -43,6 +43,7 @@ static const struct debug_named_value lp_bld_perf_flags[] = {
    { "no_quad_lod", GALLIVM_PERF_NO_QUAD_LOD, "disable quad_lod optimization" },
    { "no_aos_sampling", GALLIVM_PERF_NO_AOS_SAMPLING, "disable aos sampling optimization" },
    { "nopt",   GALLIVM_PERF_NO_OPT, "disable optimization passes to speed up shader compilation" },
+   { "tiered", GALLIVM_PERF_TIERED, "compile shaders quickly first and optimize the ones which get used a lot in the background" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -302,14 +302,20 @@ void lpjit_exit()
    delete LPJit::jit;
 }
 
+/* Module flag carrying gallivm_state::fast_compile into the transform */
+static const char fast_compile_flag[] = "lp.fast_compile";
+
 LLVMErrorRef module_transform(void *Ctx, LLVMModuleRef mod) {
    struct lp_passmgr *mgr;
+   bool fast = LLVMGetModuleFlag(mod, fast_compile_flag,
+                                 sizeof(fast_compile_flag) - 1) != NULL;
 
    lp_passmgr_create(mod, &mgr);
 
    lp_passmgr_run(mgr, mod,
                   LPJit::get_instance()->tm,
-                  get_module_name(mod));
+                  get_module_name(mod),
+                  fast);
 
    lp_passmgr_dispose(mgr);
    return LLVMErrorSuccess;
@@ -644,6 +650,14 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
    lp_build_coro_add_malloc_hooks(gallivm);
 
+   if (gallivm->fast_compile) {
+      LLVMValueRef one = LLVMConstInt(LLVMInt32TypeInContext(gallivm->context),
+                                      1, 0);
+      LLVMAddModuleFlag(gallivm->module, LLVMModuleFlagBehaviorOverride,
+                        fast_compile_flag, sizeof(fast_compile_flag) - 1,
+                        LLVMValueAsMetadata(one));
+   }
+
    LPJit::add_ir_module_to_jd(gallivm->_ts_context, gallivm->module,
       gallivm->_per_module_jd);
    /* ownership of module is now transferred into orc jit,
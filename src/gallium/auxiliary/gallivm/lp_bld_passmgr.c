@@ -127,11 +127,45 @@ lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr_p)
    return true;
 }
 
+/*
+ * Make the code generator treat the functions like at -O0, which also
+ * selects fast instruction selection.  The code generation level is
+ * shared by all modules with ORCJIT, so this can't be done there.
+ */
+static void
+mark_optnone(LLVMModuleRef module)
+{
+   LLVMContextRef context = LLVMGetModuleContext(module);
+   unsigned optnone = LLVMGetEnumAttributeKindForName("optnone", 7);
+   unsigned noinline = LLVMGetEnumAttributeKindForName("noinline", 8);
+   unsigned alwaysinline = LLVMGetEnumAttributeKindForName("alwaysinline", 12);
+
+   for (LLVMValueRef func = LLVMGetFirstFunction(module); func;
+        func = LLVMGetNextFunction(func)) {
+      if (LLVMIsDeclaration(func))
+         continue;
+
+      /* optnone requires noinline, which excludes alwaysinline */
+      LLVMRemoveEnumAttributeAtIndex(func, LLVMAttributeFunctionIndex,
+                                     alwaysinline);
+      LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex,
+                              LLVMCreateEnumAttribute(context, noinline, 0));
+      LLVMAddAttributeAtIndex(func, LLVMAttributeFunctionIndex,
+                              LLVMCreateEnumAttribute(context, optnone, 0));
+   }
+}
+
+/*
+ * With fast set only the passes the backends need are run, for code
+ * which is compiled quickly first and optimized later if it gets used
+ * a lot.
+ */
 void
 lp_passmgr_run(struct lp_passmgr *mgr,
                LLVMModuleRef module,
                LLVMTargetMachineRef tm,
-               const char *module_name)
+               const char *module_name,
+               bool fast)
 {
    int64_t time_begin;
 
@@ -151,7 +185,7 @@ lp_passmgr_run(struct lp_passmgr *mgr,
    LLVMPassBuilderOptionsRef opts = LLVMCreatePassBuilderOptions();
    LLVMRunPasses(module, passes, tm, opts);
 
-   if (!(gallivm_perf & GALLIVM_PERF_NO_OPT))
+   if (!fast && !(gallivm_perf & GALLIVM_PERF_NO_OPT))
 #if LLVM_VERSION_MAJOR >= 18
       strcpy(passes, "sroa,early-cse,simplifycfg,reassociate,mem2reg,instsimplify,instcombine<no-verify-fixpoint>");
 #else
@@ -163,9 +197,16 @@ lp_passmgr_run(struct lp_passmgr *mgr,
    LLVMRunPasses(module, passes, tm, opts);
    LLVMDisposePassBuilderOptions(opts);
 #else
+   LLVMPassManagerRef passmgr = mgr->passmgr;
+   if (fast) {
+      passmgr = LLVMCreateFunctionPassManagerForModule(module);
+      LLVMAddPromoteMemoryToRegisterPass(passmgr);
+      LLVMAddCoroCleanupPass(passmgr);
+   }
+
    LLVMRunPassManager(mgr->cgpassmgr, module);
    /* Run optimization passes */
-   LLVMInitializeFunctionPassManager(mgr->passmgr);
+   LLVMInitializeFunctionPassManager(passmgr);
    LLVMValueRef func;
    func = LLVMGetFirstFunction(module);
    while (func) {
@@ -180,18 +221,24 @@ lp_passmgr_run(struct lp_passmgr *mgr,
       LLVMAddTargetDependentFunctionAttr(func, "no-frame-pointer-elim-non-leaf", "true");
 #endif
 
-      LLVMRunFunctionPassManager(mgr->passmgr, func);
+      LLVMRunFunctionPassManager(passmgr, func);
       func = LLVMGetNextFunction(func);
    }
-   LLVMFinalizeFunctionPassManager(mgr->passmgr);
+   LLVMFinalizeFunctionPassManager(passmgr);
+
+   if (fast)
+      LLVMDisposePassManager(passmgr);
 #endif
 
+   if (fast)
+      mark_optnone(module);
+
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
       int64_t time_end = os_time_get();
       int time_msec = (int)((time_end - time_begin) / 1000);
       assert(module_name);
-      debug_printf("optimizing module %s took %d msec\n",
-                   module_name, time_msec);
+      debug_printf("optimizing module %s%s took %d msec\n",
+                   module_name, fast ? " (fast)" : "", time_msec);
    }
 }
 
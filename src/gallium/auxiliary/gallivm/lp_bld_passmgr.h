@@ -45,7 +45,8 @@ bool lp_passmgr_create(LLVMModuleRef module, struct lp_passmgr **mgr);
 void lp_passmgr_run(struct lp_passmgr *mgr,
                     LLVMModuleRef module,
                     LLVMTargetMachineRef tm,
-                    const char *module_name);
+                    const char *module_name,
+                    bool fast);
 void lp_passmgr_dispose(struct lp_passmgr *mgr);
 
 #ifdef __cplusplus
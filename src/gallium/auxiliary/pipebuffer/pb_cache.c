@@ -27,8 +27,28 @@
  **************************************************************************/
 
 #include "pb_cache.h"
+#include "util/cnd_monotonic.h"
+#include "util/u_atomic.h"
+#include "util/u_call_once.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
+#include "util/timespec.h"
+
+/*
+ * The expiry thread shared by all caches of the process.  It runs while
+ * there are caches, and only wakes up when one of them has buffers.
+ */
+static struct {
+   mtx_t mutex;
+   struct u_cnd_monotonic cond;
+   struct list_head caches;
+   thrd_t thread;
+   bool has_thread;
+   unsigned generation; /**< Bumped to stop the current thread */
+} expiry;
+
+static util_once_flag expiry_once = UTIL_ONCE_FLAG_INIT;
 
 /*
  * Helper function for detecting time outs, taking in account overflow.
@@ -53,6 +73,12 @@ time_get_ms(struct pb_cache *mgr)
    return os_time_get() / 1000 - mgr->msecs_base_time;
 }
 
+static uint64_t
+expiry_period_ns(struct pb_cache *mgr)
+{
+   return MAX2(mgr->msecs / 2, 1) * 1000000ull;
+}
+
 static struct pb_buffer_lean *
 get_buffer(struct pb_cache *mgr, struct pb_cache_entry *entry)
 {
@@ -60,49 +86,186 @@ get_buffer(struct pb_cache *mgr, struct pb_cache_entry *entry)
 }
 
 /**
- * Actually destroy the buffer.
+ * Size class of a buffer: four per power of two, so that the buffers
+ * within size_factor of a requested size are in a few adjacent lists.
+ */
+static unsigned
+size_class(pb_size size)
+{
+   if (size < 4)
+      return size;
+
+   unsigned log2 = util_logbase2_64(size);
+   unsigned index = log2 * 4 + ((size >> (log2 - 2)) & 3);
+
+   return MIN2(index, PB_CACHE_NUM_SIZE_CLASSES - 1);
+}
+
+static struct list_head *
+heap_class(struct pb_cache *mgr, struct pb_cache_entry *entry)
+{
+   struct pb_buffer_lean *buf = get_buffer(mgr, entry);
+
+   return &mgr->heaps[entry->bucket_index].classes[size_class(buf->size)];
+}
+
+/**
+ * Account for a buffer that is no longer in the cache.
  */
 static void
-destroy_buffer_locked(struct pb_cache *mgr, struct pb_cache_entry *entry)
+entry_removed(struct pb_cache *mgr, struct pb_cache_entry *entry)
 {
    struct pb_buffer_lean *buf = get_buffer(mgr, entry);
 
-   assert(!pipe_is_referenced(&buf->reference));
-   if (list_is_linked(&entry->head)) {
+   assert(p_atomic_read(&mgr->num_buffers));
+   p_atomic_add(&mgr->cache_size, -(int64_t)buf->size);
+   p_atomic_dec(&mgr->num_buffers);
+}
+
+/**
+ * Actually destroy the buffers of a list, which nothing else can reach
+ * anymore.  This is done without holding any of the cache's locks.
+ */
+static void
+destroy_buffers(struct pb_cache *mgr, struct list_head *list)
+{
+   list_for_each_entry_safe(struct pb_cache_entry, entry, list, head) {
+      struct pb_buffer_lean *buf = get_buffer(mgr, entry);
+
+      assert(!pipe_is_referenced(&buf->reference));
+      list_del(&entry->head);
+      mgr->destroy_buffer(mgr->winsys, buf);
+   }
+}
+
+/**
+ * Move as many expired buffers from the list head as possible to another
+ * list, and return how many there were.
+ */
+static unsigned
+collect_expired_buffers(struct pb_cache *mgr, struct list_head *cache,
+                        unsigned current_time_ms, struct list_head *expired)
+{
+   unsigned count = 0;
+
+   list_for_each_entry_safe(struct pb_cache_entry, entry, cache, head) {
+      if (!time_timeout_ms(entry->start_ms, mgr->msecs, current_time_ms))
+         break;
+
       list_del(&entry->head);
-      assert(mgr->num_buffers);
-      --mgr->num_buffers;
-      mgr->cache_size -= buf->size;
+      list_addtail(&entry->head, expired);
+      entry_removed(mgr, entry);
+      count++;
    }
-   mgr->destroy_buffer(mgr->winsys, buf);
+   return count;
 }
 
 /**
- * Free as many cache buffers from the list head as possible.
+ * Free the buffers of all heaps and front caches which have been unused
+ * for longer than mgr->msecs.
  */
 static void
-release_expired_buffers_locked(struct pb_cache *mgr, struct list_head *cache,
-                               unsigned current_time_ms)
+release_expired_buffers(struct pb_cache *mgr)
 {
-   struct list_head *curr, *next;
-   struct pb_cache_entry *entry;
+   unsigned current_time_ms = time_get_ms(mgr);
+   struct list_head expired;
 
-   curr = cache->next;
-   next = curr->next;
-   while (curr != cache) {
-      entry = list_entry(curr, struct pb_cache_entry, head);
+   list_inithead(&expired);
 
-      if (!time_timeout_ms(entry->start_ms, mgr->msecs,
-                           current_time_ms))
-         break;
+   for (unsigned i = 0; i < mgr->num_heaps; i++) {
+      struct pb_cache_heap *heap = &mgr->heaps[i];
+
+      simple_mtx_lock(&heap->mutex);
+      for (unsigned c = 0; c < PB_CACHE_NUM_SIZE_CLASSES; c++) {
+         collect_expired_buffers(mgr, &heap->classes[c], current_time_ms,
+                                 &expired);
+      }
+      simple_mtx_unlock(&heap->mutex);
+   }
+
+   simple_mtx_lock(&mgr->mutex);
+   list_for_each_entry(struct pb_cache_front, front, &mgr->fronts, link) {
+      simple_mtx_lock(&front->mutex);
+      front->num_entries -= collect_expired_buffers(mgr, &front->entries,
+                                                    current_time_ms, &expired);
+      simple_mtx_unlock(&front->mutex);
+   }
+   simple_mtx_unlock(&mgr->mutex);
 
-      destroy_buffer_locked(mgr, entry);
+   destroy_buffers(mgr, &expired);
+}
 
-      curr = next;
-      next = curr->next;
+/**
+ * Move buffers to the shared heaps.  They are stamped again, so that each
+ * size class stays ordered by time.
+ */
+static void
+add_to_heaps(struct pb_cache *mgr, struct list_head *list)
+{
+   unsigned current_time_ms = time_get_ms(mgr);
+
+   list_for_each_entry_safe(struct pb_cache_entry, entry, list, head) {
+      struct pb_cache_heap *heap = &mgr->heaps[entry->bucket_index];
+
+      list_del(&entry->head);
+      entry->start_ms = current_time_ms;
+
+      simple_mtx_lock(&heap->mutex);
+      list_addtail(&entry->head, heap_class(mgr, entry));
+      simple_mtx_unlock(&heap->mutex);
    }
 }
 
+/**
+ * Called when a thread with a front cache exits.
+ */
+static void
+front_destroy(void *data)
+{
+   struct pb_cache_front *front = data;
+   struct pb_cache *mgr = front->mgr;
+
+   simple_mtx_lock(&mgr->mutex);
+   list_del(&front->link);
+   simple_mtx_unlock(&mgr->mutex);
+
+   /* Nothing else can see the front cache now. */
+   add_to_heaps(mgr, &front->entries);
+
+   simple_mtx_destroy(&front->mutex);
+   FREE(front);
+}
+
+static struct pb_cache_front *
+get_front(struct pb_cache *mgr, bool create)
+{
+   if (!mgr->has_front_key)
+      return NULL;
+
+   struct pb_cache_front *front = tss_get(mgr->front_key);
+   if (front || !create)
+      return front;
+
+   front = CALLOC_STRUCT(pb_cache_front);
+   if (!front)
+      return NULL;
+
+   (void) simple_mtx_init(&front->mutex, mtx_plain);
+   front->mgr = mgr;
+   list_inithead(&front->entries);
+
+   if (tss_set(mgr->front_key, front) != thrd_success) {
+      simple_mtx_destroy(&front->mutex);
+      FREE(front);
+      return NULL;
+   }
+
+   simple_mtx_lock(&mgr->mutex);
+   list_addtail(&front->link, &mgr->fronts);
+   simple_mtx_unlock(&mgr->mutex);
+   return front;
+}
+
 /**
  * Add a buffer to the cache. This is typically done when the buffer is
  * being released.
@@ -110,30 +273,73 @@ release_expired_buffers_locked(struct pb_cache *mgr, struct list_head *cache,
 void
 pb_cache_add_buffer(struct pb_cache *mgr, struct pb_cache_entry *entry)
 {
-   struct list_head *cache = &mgr->buckets[entry->bucket_index];
    struct pb_buffer_lean *buf = get_buffer(mgr, entry);
-   unsigned i;
+   pb_size size = buf->size;
 
-   simple_mtx_lock(&mgr->mutex);
    assert(!pipe_is_referenced(&buf->reference));
 
-   unsigned current_time_ms = time_get_ms(mgr);
+   if (!mgr->has_expiry_thread) {
+      unsigned current_time_ms = time_get_ms(mgr);
 
-   for (i = 0; i < mgr->num_heaps; i++)
-      release_expired_buffers_locked(mgr, &mgr->buckets[i], current_time_ms);
+      if (time_timeout_ms(mgr->last_expiry_ms, MAX2(mgr->msecs / 2, 1),
+                          current_time_ms)) {
+         mgr->last_expiry_ms = current_time_ms;
+         release_expired_buffers(mgr);
+      }
+   }
 
    /* Directly release any buffer that exceeds the limit. */
-   if (mgr->cache_size + buf->size > mgr->max_cache_size) {
+   if (p_atomic_add_return(&mgr->cache_size, size) > mgr->max_cache_size) {
+      p_atomic_add(&mgr->cache_size, -(int64_t)size);
       mgr->destroy_buffer(mgr->winsys, buf);
-      simple_mtx_unlock(&mgr->mutex);
       return;
    }
 
+   /* Wake up the expiry thread if the cache was empty. */
+   if (p_atomic_inc_return(&mgr->num_buffers) == 1 && mgr->has_expiry_thread) {
+      mtx_lock(&expiry.mutex);
+      mgr->next_expiry_ns = os_time_get_nano() + expiry_period_ns(mgr);
+      u_cnd_monotonic_broadcast(&expiry.cond);
+      mtx_unlock(&expiry.mutex);
+   }
+
    entry->start_ms = time_get_ms(mgr);
-   list_addtail(&entry->head, cache);
-   ++mgr->num_buffers;
-   mgr->cache_size += buf->size;
-   simple_mtx_unlock(&mgr->mutex);
+
+   /* Threads which release buffers but never allocate any, like a winsys'
+    * submission thread, would only fill a front cache nobody looks at.
+    */
+   struct pb_cache_front *front =
+      size <= PB_CACHE_FRONT_MAX_SIZE ? get_front(mgr, false) : NULL;
+
+   if (front) {
+      struct list_head overflow;
+
+      list_inithead(&overflow);
+
+      simple_mtx_lock(&front->mutex);
+      list_addtail(&entry->head, &front->entries);
+
+      /* Return the oldest half to the shared heaps. */
+      if (++front->num_entries > PB_CACHE_FRONT_ENTRIES) {
+         for (unsigned i = 0; i < PB_CACHE_FRONT_ENTRIES / 2; i++) {
+            struct pb_cache_entry *old =
+               list_first_entry(&front->entries, struct pb_cache_entry, head);
+
+            list_del(&old->head);
+            list_addtail(&old->head, &overflow);
+         }
+         front->num_entries -= PB_CACHE_FRONT_ENTRIES / 2;
+      }
+      simple_mtx_unlock(&front->mutex);
+
+      add_to_heaps(mgr, &overflow);
+   } else {
+      struct pb_cache_heap *heap = &mgr->heaps[entry->bucket_index];
+
+      simple_mtx_lock(&heap->mutex);
+      list_addtail(&entry->head, heap_class(mgr, entry));
+      simple_mtx_unlock(&heap->mutex);
+   }
 }
 
 /**
@@ -152,10 +358,7 @@ pb_cache_is_buffer_compat(struct pb_cache *mgr, struct pb_cache_entry *entry,
 
    /* be lenient with size */
    if (buf->size < size ||
-       buf->size > (unsigned) (mgr->size_factor * size))
-      return 0;
-
-   if (usage & mgr->bypass_usage)
+       buf->size > (pb_size) (mgr->size_factor * size))
       return 0;
 
    if (!pb_check_alignment(alignment, 1u << buf->alignment_log2))
@@ -164,112 +367,129 @@ pb_cache_is_buffer_compat(struct pb_cache *mgr, struct pb_cache_entry *entry,
    return mgr->can_reclaim(mgr->winsys, buf) ? 1 : -1;
 }
 
+/**
+ * Find the oldest compatible buffer of a list.  The search stops at the
+ * first busy buffer, since the ones added after it are probably busy too.
+ */
+static struct pb_cache_entry *
+find_compat_buffer(struct pb_cache *mgr, struct list_head *cache,
+                   pb_size size, unsigned alignment, unsigned usage,
+                   unsigned bucket_index)
+{
+   list_for_each_entry(struct pb_cache_entry, entry, cache, head) {
+      if (entry->bucket_index != bucket_index)
+         continue;
+
+      int ret = pb_cache_is_buffer_compat(mgr, entry, size, alignment, usage);
+      if (ret > 0)
+         return entry;
+      if (ret == -1)
+         break;
+   }
+   return NULL;
+}
+
 /**
  * Find a compatible buffer in the cache, return it, and remove it
  * from the cache.
+ *
+ * The calling thread's front cache is searched first, then the size
+ * classes of the heap that can hold buffers between size and
+ * size_factor * size.  The calling thread gets a front cache for the
+ * small buffers it releases from now on.
  */
 struct pb_buffer_lean *
 pb_cache_reclaim_buffer(struct pb_cache *mgr, pb_size size,
                         unsigned alignment, unsigned usage,
                         unsigned bucket_index)
 {
-   struct pb_cache_entry *entry;
-   struct pb_cache_entry *cur_entry;
-   struct list_head *cur, *next;
-   int ret = 0;
+   struct pb_cache_entry *entry = NULL;
 
    assert(bucket_index < mgr->num_heaps);
-   struct list_head *cache = &mgr->buckets[bucket_index];
-
-   simple_mtx_lock(&mgr->mutex);
 
-   entry = NULL;
-   cur = cache->next;
-   next = cur->next;
-
-   /* search in the expired buffers, freeing them in the process */
-   unsigned now = time_get_ms(mgr);
-   while (cur != cache) {
-      cur_entry = list_entry(cur, struct pb_cache_entry, head);
-
-      if (!entry && (ret = pb_cache_is_buffer_compat(mgr, cur_entry, size,
-                                                     alignment, usage)) > 0)
-         entry = cur_entry;
-      else if (time_timeout_ms(cur_entry->start_ms, mgr->msecs, now))
-         destroy_buffer_locked(mgr, cur_entry);
-      else
-         /* This buffer (and all hereafter) are still hot in cache */
-         break;
-
-      /* the buffer is busy (and probably all remaining ones too) */
-      if (ret == -1)
-         break;
-
-      cur = next;
-      next = cur->next;
+   if (usage & mgr->bypass_usage)
+      return NULL;
+
+   if (size <= PB_CACHE_FRONT_MAX_SIZE) {
+      struct pb_cache_front *front = get_front(mgr, true);
+
+      if (front) {
+         simple_mtx_lock(&front->mutex);
+         entry = find_compat_buffer(mgr, &front->entries, size, alignment,
+                                    usage, bucket_index);
+         if (entry) {
+            list_del(&entry->head);
+            front->num_entries--;
+         }
+         simple_mtx_unlock(&front->mutex);
+      }
    }
 
-   /* keep searching in the hot buffers */
-   if (!entry && ret != -1) {
-      while (cur != cache) {
-         cur_entry = list_entry(cur, struct pb_cache_entry, head);
-         ret = pb_cache_is_buffer_compat(mgr, cur_entry, size, alignment, usage);
+   if (!entry) {
+      struct pb_cache_heap *heap = &mgr->heaps[bucket_index];
+      unsigned first = size_class(size);
+      unsigned last = size_class((pb_size) (mgr->size_factor * size));
 
-         if (ret > 0) {
-            entry = cur_entry;
-            break;
-         }
-         if (ret == -1)
-            break;
-         /* no need to check the timeout here */
-         cur = next;
-         next = cur->next;
+      simple_mtx_lock(&heap->mutex);
+      for (unsigned c = first; c <= last && !entry; c++) {
+         entry = find_compat_buffer(mgr, &heap->classes[c], size, alignment,
+                                    usage, bucket_index);
       }
+      if (entry)
+         list_del(&entry->head);
+      simple_mtx_unlock(&heap->mutex);
    }
 
-   /* found a compatible buffer, return it */
-   if (entry) {
-      struct pb_buffer_lean *buf = get_buffer(mgr, entry);
+   if (!entry)
+      return NULL;
 
-      mgr->cache_size -= buf->size;
-      list_del(&entry->head);
-      --mgr->num_buffers;
-      simple_mtx_unlock(&mgr->mutex);
-      /* Increase refcount */
-      pipe_reference_init(&buf->reference, 1);
-      return buf;
-   }
+   /* found a compatible buffer, return it */
+   struct pb_buffer_lean *buf = get_buffer(mgr, entry);
 
-   simple_mtx_unlock(&mgr->mutex);
-   return NULL;
+   entry_removed(mgr, entry);
+   /* Increase refcount */
+   pipe_reference_init(&buf->reference, 1);
+   return buf;
 }
 
 /**
- * Empty the cache. Useful when there is not enough memory.
+ * Empty the cache, including the front caches of all threads. Useful when
+ * there is not enough memory.
  */
 unsigned
 pb_cache_release_all_buffers(struct pb_cache *mgr)
 {
-   struct list_head *curr, *next;
-   struct pb_cache_entry *buf;
+   struct list_head buffers;
    unsigned num_reclaims = 0;
-   unsigned i;
 
-   simple_mtx_lock(&mgr->mutex);
-   for (i = 0; i < mgr->num_heaps; i++) {
-      struct list_head *cache = &mgr->buckets[i];
-
-      curr = cache->next;
-      next = curr->next;
-      while (curr != cache) {
-         buf = list_entry(curr, struct pb_cache_entry, head);
-         destroy_buffer_locked(mgr, buf);
-         num_reclaims++;
-         curr = next;
-         next = curr->next;
+   list_inithead(&buffers);
+
+   for (unsigned i = 0; i < mgr->num_heaps; i++) {
+      struct pb_cache_heap *heap = &mgr->heaps[i];
+
+      simple_mtx_lock(&heap->mutex);
+      for (unsigned c = 0; c < PB_CACHE_NUM_SIZE_CLASSES; c++) {
+         list_splicetail(&heap->classes[c], &buffers);
+         list_inithead(&heap->classes[c]);
       }
+      simple_mtx_unlock(&heap->mutex);
+   }
+
+   simple_mtx_lock(&mgr->mutex);
+   list_for_each_entry(struct pb_cache_front, front, &mgr->fronts, link) {
+      simple_mtx_lock(&front->mutex);
+      list_splicetail(&front->entries, &buffers);
+      list_inithead(&front->entries);
+      front->num_entries = 0;
+      simple_mtx_unlock(&front->mutex);
    }
    simple_mtx_unlock(&mgr->mutex);
+
+   list_for_each_entry(struct pb_cache_entry, entry, &buffers, head) {
+      entry_removed(mgr, entry);
+      num_reclaims++;
+   }
+   destroy_buffers(mgr, &buffers);
    return num_reclaims;
 }
 
@@ -283,6 +503,120 @@ pb_cache_init_entry(struct pb_cache *mgr, struct pb_cache_entry *entry,
    entry->bucket_index = bucket_index;
 }
 
+static void
+expiry_init_once(void)
+{
+   (void) mtx_init(&expiry.mutex, mtx_plain);
+   u_cnd_monotonic_init(&expiry.cond);
+   list_inithead(&expiry.caches);
+}
+
+/**
+ * Releases the expired buffers of each cache every msecs / 2 while it
+ * isn't empty, so that neither adding nor reclaiming buffers has to walk
+ * the cache.
+ */
+static int
+pb_cache_expiry_thread(void *data)
+{
+   const unsigned generation = (uintptr_t)data;
+
+   u_thread_setname("pb_cache");
+
+   mtx_lock(&expiry.mutex);
+   while (expiry.generation == generation) {
+      int64_t now = os_time_get_nano();
+      int64_t next = INT64_MAX;
+      struct pb_cache *due = NULL;
+
+      list_for_each_entry(struct pb_cache, mgr, &expiry.caches, expiry_link) {
+         if (!p_atomic_read(&mgr->num_buffers))
+            continue;
+
+         if (mgr->next_expiry_ns <= now) {
+            due = mgr;
+            break;
+         }
+         next = MIN2(next, mgr->next_expiry_ns);
+      }
+
+      if (due) {
+         /* pb_cache_deinit waits for this before the cache goes away. */
+         due->next_expiry_ns = now + expiry_period_ns(due);
+         due->expiring = true;
+         mtx_unlock(&expiry.mutex);
+
+         release_expired_buffers(due);
+
+         mtx_lock(&expiry.mutex);
+         due->expiring = false;
+         u_cnd_monotonic_broadcast(&expiry.cond);
+      } else if (next == INT64_MAX) {
+         u_cnd_monotonic_wait(&expiry.cond, &expiry.mutex);
+      } else {
+         struct timespec abs_time;
+         timespec_from_nsec(&abs_time, next);
+         u_cnd_monotonic_timedwait(&expiry.cond, &expiry.mutex, &abs_time);
+      }
+   }
+   mtx_unlock(&expiry.mutex);
+   return 0;
+}
+
+/**
+ * Hand the cache's expired buffers to the shared expiry thread, starting
+ * it if this is the only cache.
+ */
+static void
+expiry_add_cache(struct pb_cache *mgr)
+{
+   util_call_once(&expiry_once, expiry_init_once);
+
+   mtx_lock(&expiry.mutex);
+   if (!expiry.has_thread) {
+      void *data = (void *)(uintptr_t)expiry.generation;
+
+      expiry.has_thread =
+         u_thread_create(&expiry.thread, pb_cache_expiry_thread, data) == thrd_success;
+   }
+
+   mgr->has_expiry_thread = expiry.has_thread;
+   if (mgr->has_expiry_thread) {
+      mgr->expiring = false;
+      list_addtail(&mgr->expiry_link, &expiry.caches);
+   }
+   mtx_unlock(&expiry.mutex);
+}
+
+/**
+ * Take the cache away from the expiry thread, and stop the thread if this
+ * was the last cache, so that it doesn't outlive the driver.
+ */
+static void
+expiry_remove_cache(struct pb_cache *mgr)
+{
+   bool join = false;
+   thrd_t thread;
+
+   mtx_lock(&expiry.mutex);
+   list_del(&mgr->expiry_link);
+   while (mgr->expiring)
+      u_cnd_monotonic_wait(&expiry.cond, &expiry.mutex);
+
+   if (list_is_empty(&expiry.caches)) {
+      /* A cache created meanwhile starts a new thread. */
+      expiry.generation++;
+      expiry.has_thread = false;
+      thread = expiry.thread;
+      join = true;
+      u_cnd_monotonic_broadcast(&expiry.cond);
+   }
+   mtx_unlock(&expiry.mutex);
+
+   if (join)
+      thrd_join(thread, NULL);
+}
+
 /**
  * Initialize a caching buffer manager.
  *
@@ -299,7 +633,9 @@ pb_cache_init_entry(struct pb_cache *mgr, struct pb_cache_entry *entry,
  * @param maximum_cache_size  Maximum size of all unused buffers the cache can
  *                            hold.
  * @param offsetof_pb_cache_entry  offsetof(driver_bo, pb_cache_entry)
- * @param destroy_buffer  Function that destroys a buffer for good.
+ * @param destroy_buffer  Function that destroys a buffer for good. It may be
+ *                        called from the expiry thread, concurrently with
+ *                        the other functions of the cache.
  * @param can_reclaim     Whether a buffer can be reclaimed (e.g. is not busy)
  */
 void
@@ -312,14 +648,22 @@ pb_cache_init(struct pb_cache *mgr, unsigned num_heaps,
 {
    unsigned i;
 
-   mgr->buckets = CALLOC(num_heaps, sizeof(struct list_head));
-   if (!mgr->buckets)
+   mgr->heaps = CALLOC(num_heaps, sizeof(struct pb_cache_heap));
+   if (!mgr->heaps)
       return;
 
-   for (i = 0; i < num_heaps; i++)
-      list_inithead(&mgr->buckets[i]);
+   for (i = 0; i < num_heaps; i++) {
+      struct pb_cache_heap *heap = &mgr->heaps[i];
+
+      (void) simple_mtx_init(&heap->mutex, mtx_plain);
+      for (unsigned c = 0; c < PB_CACHE_NUM_SIZE_CLASSES; c++)
+         list_inithead(&heap->classes[c]);
+   }
 
    (void) simple_mtx_init(&mgr->mutex, mtx_plain);
+   list_inithead(&mgr->fronts);
+   mgr->has_front_key = tss_create(&mgr->front_key, front_destroy) == thrd_success;
+
    mgr->winsys = winsys;
    mgr->cache_size = 0;
    mgr->max_cache_size = maximum_cache_size;
@@ -332,6 +676,9 @@ pb_cache_init(struct pb_cache *mgr, unsigned num_heaps,
    mgr->offsetof_pb_cache_entry = offsetof_pb_cache_entry;
    mgr->destroy_buffer = destroy_buffer;
    mgr->can_reclaim = can_reclaim;
+
+   mgr->last_expiry_ms = 0;
+   expiry_add_cache(mgr);
 }
 
 /**
@@ -340,8 +687,28 @@ pb_cache_init(struct pb_cache *mgr, unsigned num_heaps,
 void
 pb_cache_deinit(struct pb_cache *mgr)
 {
+   if (!mgr->heaps)
+      return;
+
+   if (mgr->has_expiry_thread) {
+      expiry_remove_cache(mgr);
+      mgr->has_expiry_thread = false;
+   }
+
+   /* The front caches of threads which are still running are freed below. */
+   if (mgr->has_front_key)
+      tss_delete(mgr->front_key);
+
    pb_cache_release_all_buffers(mgr);
+
+   list_for_each_entry_safe(struct pb_cache_front, front, &mgr->fronts, link) {
+      simple_mtx_destroy(&front->mutex);
+      FREE(front);
+   }
+
    simple_mtx_destroy(&mgr->mutex);
-   FREE(mgr->buckets);
-   mgr->buckets = NULL;
+   for (unsigned i = 0; i < mgr->num_heaps; i++)
+      simple_mtx_destroy(&mgr->heaps[i].mutex);
+   FREE(mgr->heaps);
+   mgr->heaps = NULL;
 }
@@ -34,6 +34,22 @@
 #include "util/list.h"
 #include "util/u_thread.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Size classes per heap: four per power of two, sizes of 2^48 and larger
+ * all share the last one.
+ */
+#define PB_CACHE_NUM_SIZE_CLASSES (48 * 4)
+
+/* Per-thread front caches hold up to this many buffers no larger than
+ * PB_CACHE_FRONT_MAX_SIZE, and return the oldest half to the shared
+ * heaps when they overflow.
+ */
+#define PB_CACHE_FRONT_ENTRIES 16
+#define PB_CACHE_FRONT_MAX_SIZE (256 * 1024)
+
 /**
  * Statically inserted into the driver-specific buffer structure.
  */
@@ -44,21 +60,60 @@ struct pb_cache_entry
    unsigned bucket_index;
 };
 
+/**
+ * Unused buffers of one heap, in one list per size class, each ordered
+ * from the least to the most recently added buffer.
+ */
+struct pb_cache_heap
+{
+   simple_mtx_t mutex;
+   struct list_head classes[PB_CACHE_NUM_SIZE_CLASSES];
+};
+
+/**
+ * Recently released small buffers of one thread, checked before the
+ * shared heaps.  Only threads which reclaim buffers get one, buffers
+ * released by other threads go to the heaps.  The mutex is only ever
+ * contended by the expiry thread and pb_cache_release_all_buffers.
+ */
+struct pb_cache_front
+{
+   simple_mtx_t mutex;
+   struct list_head link; /**< In pb_cache::fronts */
+   struct pb_cache *mgr;
+   struct list_head entries;
+   unsigned num_entries;
+};
+
 struct pb_cache
 {
-   /* The cache is divided into buckets for minimizing cache misses.
-    * The driver controls which buffer goes into which bucket.
+   /* The cache is divided into heaps for minimizing cache misses.
+    * The driver controls which buffer goes into which heap.
     */
-   struct list_head *buckets;
+   struct pb_cache_heap *heaps;
 
+   /* Protects fronts. */
    simple_mtx_t mutex;
+   struct list_head fronts;
+   tss_t front_key;
+   bool has_front_key;
+
+   /* Expired buffers are released in the background by a thread shared
+    * by all caches.  These are protected by that thread's mutex.
+    */
+   struct list_head expiry_link;
+   int64_t next_expiry_ns;
+   bool expiring;
+   bool has_expiry_thread;
+   unsigned last_expiry_ms; /**< Without the thread, in pb_cache_add_buffer */
+
    void *winsys;
-   uint64_t cache_size;
+   uint64_t cache_size; /**< Atomic, including front caches */
    uint64_t max_cache_size;
    unsigned num_heaps;
    unsigned msecs;
    int64_t msecs_base_time;
-   unsigned num_buffers;
+   unsigned num_buffers; /**< Atomic, including front caches */
    unsigned bypass_usage;
    float size_factor;
    unsigned offsetof_pb_cache_entry; /* offsetof(driver_bo, pb_cache_entry) */
@@ -82,4 +137,8 @@ void pb_cache_init(struct pb_cache *mgr, unsigned num_heaps,
                    bool (*can_reclaim)(void *winsys, struct pb_buffer_lean *buf));
 void pb_cache_deinit(struct pb_cache *mgr);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
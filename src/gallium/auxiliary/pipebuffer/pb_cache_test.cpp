@@ -0,0 +1,360 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "pipebuffer/pb_cache.h"
+#include "util/os_time.h"
+
+#define USAGE_A       (1 << 0)
+#define USAGE_B       (1 << 1)
+#define USAGE_NOCACHE (1 << 3)
+
+struct mock_buffer {
+   struct pb_buffer_lean base;
+   struct pb_cache_entry cache_entry;
+   bool busy;
+};
+
+struct mock_winsys {
+   struct pb_cache cache;
+   std::atomic<unsigned> num_created;
+   std::atomic<unsigned> num_destroyed;
+};
+
+static void
+mock_destroy_buffer(void *winsys, struct pb_buffer_lean *buf)
+{
+   ((struct mock_winsys *)winsys)->num_destroyed++;
+   delete (struct mock_buffer *)buf;
+}
+
+static bool
+mock_can_reclaim(void *winsys, struct pb_buffer_lean *buf)
+{
+   return !((struct mock_buffer *)buf)->busy;
+}
+
+static void
+mock_init(struct mock_winsys *ws, unsigned num_heaps, unsigned usecs,
+          uint64_t max_cache_size)
+{
+   ws->num_created = 0;
+   ws->num_destroyed = 0;
+   pb_cache_init(&ws->cache, num_heaps, usecs, 2.0f, USAGE_NOCACHE,
+                 max_cache_size, offsetof(struct mock_buffer, cache_entry), ws,
+                 mock_destroy_buffer, mock_can_reclaim);
+}
+
+/* The allocation path of a winsys: reclaim a cached buffer if possible. */
+static struct mock_buffer *
+mock_alloc(struct mock_winsys *ws, pb_size size, unsigned alignment,
+           unsigned usage, unsigned heap)
+{
+   struct mock_buffer *buf = (struct mock_buffer *)
+      pb_cache_reclaim_buffer(&ws->cache, size, alignment, usage, heap);
+   if (buf)
+      return buf;
+
+   buf = new mock_buffer();
+   pipe_reference_init(&buf->base.reference, 1);
+   buf->base.alignment_log2 = util_logbase2(MAX2(alignment, 1));
+   buf->base.usage = usage;
+   buf->base.size = size;
+   pb_cache_init_entry(&ws->cache, &buf->cache_entry, &buf->base, heap);
+   ws->num_created++;
+   return buf;
+}
+
+static void
+mock_release(struct mock_winsys *ws, struct mock_buffer *buf)
+{
+   if (pipe_reference(&buf->base.reference, NULL))
+      pb_cache_add_buffer(&ws->cache, &buf->cache_entry);
+}
+
+/* Buffer sizes which go through the front cache and the heaps. */
+static const pb_size test_sizes[] = { 1000, 1 << 20 };
+
+/* Only buffers of a compatible size, alignment, usage and heap are
+ * reclaimed.
+ */
+TEST(pb_cache, compatible)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 2, 1000000, UINT64_MAX);
+
+   for (pb_size size : test_sizes) {
+      struct mock_buffer *buf = mock_alloc(&ws, size, 16, USAGE_A, 0);
+      mock_release(&ws, buf);
+
+      EXPECT_EQ(mock_alloc(&ws, size * 3 / 5, 16, USAGE_A, 0), buf);
+      mock_release(&ws, buf);
+
+      struct mock_buffer *other[] = {
+         mock_alloc(&ws, size / 3, 16, USAGE_A, 0),
+         mock_alloc(&ws, size + 1, 16, USAGE_A, 0),
+         mock_alloc(&ws, size, 32, USAGE_A, 0),
+         mock_alloc(&ws, size, 16, USAGE_B, 0),
+         mock_alloc(&ws, size, 16, USAGE_A | USAGE_NOCACHE, 0),
+         mock_alloc(&ws, size, 16, USAGE_A, 1),
+      };
+      for (struct mock_buffer *o : other)
+         EXPECT_NE(o, buf) << "size " << size;
+
+      EXPECT_EQ(mock_alloc(&ws, size, 4, USAGE_A, 0), buf);
+      mock_release(&ws, buf);
+      for (struct mock_buffer *o : other)
+         mock_release(&ws, o);
+   }
+
+   unsigned num_cached = ws.num_created - ws.num_destroyed;
+   EXPECT_EQ(pb_cache_release_all_buffers(&ws.cache), num_cached);
+   EXPECT_EQ(ws.num_created, ws.num_destroyed);
+   pb_cache_deinit(&ws.cache);
+}
+
+/* Busy buffers are not reclaimed. */
+TEST(pb_cache, busy)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 1, 1000000, UINT64_MAX);
+
+   for (pb_size size : test_sizes) {
+      struct mock_buffer *buf = mock_alloc(&ws, size, 0, USAGE_A, 0);
+      buf->busy = true;
+      mock_release(&ws, buf);
+
+      struct mock_buffer *other = mock_alloc(&ws, size, 0, USAGE_A, 0);
+      EXPECT_NE(other, buf);
+
+      buf->busy = false;
+      EXPECT_EQ(mock_alloc(&ws, size, 0, USAGE_A, 0), buf);
+      mock_release(&ws, buf);
+      mock_release(&ws, other);
+   }
+
+   pb_cache_deinit(&ws.cache);
+   EXPECT_EQ(ws.num_created, ws.num_destroyed);
+}
+
+/* Buffers which don't fit in the cache anymore are destroyed at once. */
+TEST(pb_cache, max_size)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 1, 1000000, 1500);
+
+   struct mock_buffer *a = mock_alloc(&ws, 1000, 0, USAGE_A, 0);
+   struct mock_buffer *b = mock_alloc(&ws, 1000, 0, USAGE_A, 0);
+   mock_release(&ws, a);
+   EXPECT_EQ(ws.num_destroyed, 0u);
+   mock_release(&ws, b);
+   EXPECT_EQ(ws.num_destroyed, 1u);
+
+   pb_cache_deinit(&ws.cache);
+   EXPECT_EQ(ws.num_destroyed, 2u);
+}
+
+/* Unused buffers are released in the background after a while. */
+TEST(pb_cache, expiry)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 1, 20000, UINT64_MAX);
+
+   for (pb_size size : test_sizes) {
+      for (unsigned i = 0; i < 4; i++)
+         mock_release(&ws, mock_alloc(&ws, size * (i + 1), 0, USAGE_A, 0));
+   }
+
+   int64_t end = os_time_get_nano() + 5000000000ll;
+   while (ws.num_destroyed < ws.num_created && os_time_get_nano() < end)
+      os_time_sleep(1000);
+
+   EXPECT_EQ(ws.num_destroyed, ws.num_created);
+   EXPECT_EQ(pb_cache_release_all_buffers(&ws.cache), 0u);
+   pb_cache_deinit(&ws.cache);
+}
+
+/* The expiry thread is shared by all caches, and stopped with the last. */
+TEST(pb_cache, expiry_multiple_caches)
+{
+   for (unsigned round = 0; round < 2; round++) {
+      struct mock_winsys ws[3];
+
+      for (struct mock_winsys &w : ws)
+         mock_init(&w, 1, 20000, UINT64_MAX);
+
+      for (struct mock_winsys &w : ws) {
+         for (pb_size size : test_sizes)
+            mock_release(&w, mock_alloc(&w, size, 0, USAGE_A, 0));
+      }
+
+      /* The others still expire after one cache is gone. */
+      pb_cache_deinit(&ws[1].cache);
+
+      int64_t end = os_time_get_nano() + 5000000000ll;
+      while ((ws[0].num_destroyed < ws[0].num_created ||
+              ws[2].num_destroyed < ws[2].num_created) &&
+             os_time_get_nano() < end)
+         os_time_sleep(1000);
+
+      for (struct mock_winsys &w : ws)
+         EXPECT_EQ(w.num_destroyed, w.num_created);
+
+      pb_cache_deinit(&ws[0].cache);
+      pb_cache_deinit(&ws[2].cache);
+   }
+}
+
+/* Buffers released by a thread which doesn't allocate any go to the
+ * heaps, where the allocating threads find them.
+ */
+TEST(pb_cache, release_only_thread)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 1, 1000000, UINT64_MAX);
+
+   std::mutex mutex;
+   std::condition_variable cond;
+   struct mock_buffer *buf = mock_alloc(&ws, 1000, 0, USAGE_A, 0);
+   unsigned step = 0;
+
+   std::thread thread([&] {
+      mock_release(&ws, buf);
+
+      std::unique_lock<std::mutex> lock(mutex);
+      step = 1;
+      cond.notify_all();
+      cond.wait(lock, [&] { return step == 2; });
+   });
+
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return step == 1; });
+   }
+
+   EXPECT_EQ(mock_alloc(&ws, 1000, 0, USAGE_A, 0), buf);
+   mock_release(&ws, buf);
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      step = 2;
+      cond.notify_all();
+   }
+   thread.join();
+
+   pb_cache_deinit(&ws.cache);
+   EXPECT_EQ(ws.num_created, ws.num_destroyed);
+}
+
+/* Emptying the cache includes the front caches of other threads. */
+TEST(pb_cache, release_all_threads)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 1, 1000000, UINT64_MAX);
+
+   std::mutex mutex;
+   std::condition_variable cond;
+   unsigned step = 0;
+
+   std::thread thread([&] {
+      mock_release(&ws, mock_alloc(&ws, 1000, 0, USAGE_A, 0));
+
+      std::unique_lock<std::mutex> lock(mutex);
+      step = 1;
+      cond.notify_all();
+      cond.wait(lock, [&] { return step == 2; });
+   });
+
+   {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&] { return step == 1; });
+   }
+
+   EXPECT_EQ(pb_cache_release_all_buffers(&ws.cache), 1u);
+   EXPECT_EQ(ws.num_destroyed, 1u);
+
+   {
+      std::lock_guard<std::mutex> lock(mutex);
+      step = 2;
+      cond.notify_all();
+   }
+   thread.join();
+
+   pb_cache_deinit(&ws.cache);
+}
+
+/* The front cache of a thread is returned to the heaps when it exits. */
+TEST(pb_cache, thread_exit)
+{
+   struct mock_winsys ws;
+   mock_init(&ws, 1, 1000000, UINT64_MAX);
+
+   struct mock_buffer *buf = NULL;
+   std::thread thread([&] {
+      buf = mock_alloc(&ws, 1000, 0, USAGE_A, 0);
+      mock_release(&ws, buf);
+   });
+   thread.join();
+
+   EXPECT_EQ(mock_alloc(&ws, 1000, 0, USAGE_A, 0), buf);
+   mock_release(&ws, buf);
+
+   pb_cache_deinit(&ws.cache);
+   EXPECT_EQ(ws.num_created, ws.num_destroyed);
+}
+
+/* Synthetic allocation pattern: threads allocating and releasing buffers
+ * of random sizes, keeping a few of them alive.
+ */
+TEST(pb_cache, throughput)
+{
+   const unsigned num_ops = 200000, num_live = 8;
+   const unsigned num_heaps = 4;
+
+   for (unsigned num_threads : { 1, 4 }) {
+      struct mock_winsys ws;
+      mock_init(&ws, num_heaps, 1000000, UINT64_MAX);
+
+      int64_t t0 = os_time_get_nano();
+      std::vector<std::thread> threads;
+      for (unsigned t = 0; t < num_threads; t++) {
+         threads.emplace_back([&, t] {
+            struct mock_buffer *live[num_live] = { NULL };
+            uint32_t seed = t + 1;
+
+            for (unsigned i = 0; i < num_ops; i++) {
+               seed = seed * 1103515245 + 12345;
+               unsigned slot = (seed >> 8) % num_live;
+               pb_size size = 4096ull << ((seed >> 16) % 10);
+               unsigned heap = (seed >> 24) % num_heaps;
+
+               if (live[slot])
+                  mock_release(&ws, live[slot]);
+               live[slot] = mock_alloc(&ws, size, 4096, USAGE_A, heap);
+            }
+            for (struct mock_buffer *buf : live)
+               mock_release(&ws, buf);
+         });
+      }
+      for (std::thread &thread : threads)
+         thread.join();
+      int64_t t1 = os_time_get_nano();
+
+      printf("%u thread(s): %6.1f ns/op, %u buffers created\n", num_threads,
+             (double)(t1 - t0) / (num_ops * num_threads),
+             ws.num_created.load());
+
+      pb_cache_deinit(&ws.cache);
+      EXPECT_EQ(ws.num_created, ws.num_destroyed);
+   }
+}
@@ -165,6 +165,11 @@ struct llvmpipe_context {
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
 
+   /** Time the rasterizer spent waiting for background variant compiles,
+    * in usecs, atomic
+    */
+   uint64_t fs_compile_stall_time;
+
    bool permit_linear_rasterizer;
    bool single_vp;
 
@@ -28,22 +28,177 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_thread.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
+#include "lp_debug.h"
+
+/* How many chunks each worker's share of a task is claimed in.  More
+ * chunks balance better, fewer mean less compare-and-swap traffic.
+ */
+#define LP_CS_TPOOL_CHUNKS_PER_THREAD 8
+
+static inline uint64_t
+range_pack(unsigned begin, unsigned end)
+{
+   return ((uint64_t)end << 32) | begin;
+}
+
+static inline unsigned
+range_begin(uint64_t range)
+{
+   return (unsigned)range;
+}
+
+static inline unsigned
+range_end(uint64_t range)
+{
+   return (unsigned)(range >> 32);
+}
+
+/**
+ * Take up to \p max iterations from the front of \p slot.
+ */
+static bool
+range_claim_front(uint64_t *slot, unsigned max,
+                  unsigned *begin, unsigned *end)
+{
+   uint64_t old = p_atomic_read(slot);
+
+   for (;;) {
+      const unsigned b = range_begin(old), e = range_end(old);
+      if (b >= e)
+         return false;
+
+      const unsigned n = MIN2(max, e - b);
+      const uint64_t prev = p_atomic_cmpxchg(slot, old, range_pack(b + n, e));
+      if (prev == old) {
+         *begin = b;
+         *end = b + n;
+         return true;
+      }
+      old = prev;
+   }
+}
+
+/**
+ * Take the back half of what is left in \p slot.
+ */
+static bool
+range_steal_back(uint64_t *slot, unsigned *begin, unsigned *end)
+{
+   uint64_t old = p_atomic_read(slot);
+
+   for (;;) {
+      const unsigned b = range_begin(old), e = range_end(old);
+      if (b >= e)
+         return false;
+
+      const unsigned n = DIV_ROUND_UP(e - b, 2);
+      const uint64_t prev = p_atomic_cmpxchg(slot, old, range_pack(b, e - n));
+      if (prev == old) {
+         *begin = e - n;
+         *end = e;
+         return true;
+      }
+      old = prev;
+   }
+}
+
+/**
+ * Look for another worker with iterations left and move half of them to
+ * our own range.  Workers sharing our L3 cache are tried first.
+ */
+static bool
+lp_cs_tpool_steal(struct lp_cs_tpool *pool, struct lp_cs_tpool_task *task,
+                  const struct lp_cs_tpool_worker *worker)
+{
+   for (unsigned pass = 0; pass < 2; pass++) {
+      const bool same_L3 = pass == 0;
+
+      for (unsigned i = 1; i < pool->num_threads; i++) {
+         const unsigned victim = (worker->index + i) % pool->num_threads;
+         if ((pool->workers[victim].L3_cache == worker->L3_cache) != same_L3)
+            continue;
+
+         unsigned begin, end;
+         if (range_steal_back(&task->ranges[victim].range, &begin, &end)) {
+            /* Nobody else grows our range, and nobody can shrink it while
+             * it is empty, so a plain store is enough.
+             */
+            p_atomic_set(&task->ranges[worker->index].range,
+                         range_pack(begin, end));
+            return true;
+         }
+      }
+   }
+   return false;
+}
+
+/**
+ * Run iterations of \p task until there are none left to claim or steal.
+ */
+static void
+lp_cs_tpool_run_task(struct lp_cs_tpool *pool, struct lp_cs_tpool_task *task,
+                     const struct lp_cs_tpool_worker *worker,
+                     struct lp_cs_local_mem *lmem)
+{
+   uint64_t *own = &task->ranges[worker->index].range;
+
+   do {
+      unsigned begin, end;
+      while (range_claim_front(own, task->iter_chunk, &begin, &end)) {
+         for (unsigned i = begin; i < end; i++)
+            task->work(task->data, i, lmem);
+         p_atomic_add(&task->iter_finished, end - begin);
+      }
+   } while (lp_cs_tpool_steal(pool, task, worker));
+}
+
+/**
+ * Keep the calling worker on the CPUs sharing \p L3_cache.  Only CPUs the
+ * thread was already allowed on are kept, so an affinity the process was
+ * started with (taskset, cpusets) is narrowed, never widened.  When it
+ * leaves none of them, the worker stays where it is.
+ */
+static void
+lp_cs_tpool_set_L3_affinity(unsigned L3_cache)
+{
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+   uint32_t mask[UTIL_MAX_CPUS / 32];
+   bool any = false;
+
+   if (!util_get_current_thread_affinity(mask, caps->num_cpu_mask_bits))
+      return;
+
+   for (unsigned i = 0; i < DIV_ROUND_UP(caps->num_cpu_mask_bits, 32); i++) {
+      mask[i] &= caps->L3_affinity_mask[L3_cache][i];
+      any |= mask[i] != 0;
+   }
+
+   if (any)
+      util_set_current_thread_affinity(mask, NULL, caps->num_cpu_mask_bits);
+}
 
 static int
 lp_cs_tpool_worker(void *data)
 {
-   struct lp_cs_tpool *pool = data;
+   const struct lp_cs_tpool_worker *worker = data;
+   struct lp_cs_tpool *pool = worker->pool;
    struct lp_cs_local_mem lmem;
 
+   if (util_get_cpu_caps()->num_L3_caches > 1 &&
+       !(LP_PERF & PERF_NO_AFFINITY))
+      lp_cs_tpool_set_L3_affinity(worker->L3_cache);
+
    memset(&lmem, 0, sizeof(lmem));
    mtx_lock(&pool->m);
 
    while (!pool->shutdown) {
       struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
 
       while (list_is_empty(&pool->workqueue) && !pool->shutdown)
          cnd_wait(&pool->new_work, &pool->m);
@@ -53,29 +208,20 @@ lp_cs_tpool_worker(void *data)
 
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
-
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
-      }
-
-      task->iter_start += iter_per_thread;
-
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
-
+      task->num_workers++;
       mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
+
+      lp_cs_tpool_run_task(pool, task, worker, &lmem);
 
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
+      /* Nothing is left to claim, the remaining iterations (if any) are
+       * being run by workers that already hold them.
+       */
+      if (task->queued) {
+         list_del(&task->list);
+         task->queued = false;
+      }
+      if (--task->num_workers == 0)
          cnd_broadcast(&task->finish);
    }
    mtx_unlock(&pool->m);
@@ -95,9 +241,19 @@ lp_cs_tpool_create(unsigned num_threads)
    cnd_init(&pool->new_work);
 
    list_inithead(&pool->workqueue);
-   assert (num_threads <= LP_MAX_THREADS);
+   assert (num_threads <= LP_MAX_CS_THREADS);
+
+   /* Spread the workers round-robin over the L3 caches. */
+   const unsigned num_L3_caches = MAX2(util_get_cpu_caps()->num_L3_caches, 1);
+   for (unsigned i = 0; i < num_threads; i++) {
+      pool->workers[i].pool = pool;
+      pool->workers[i].index = i;
+      pool->workers[i].L3_cache = i % num_L3_caches;
+   }
+
    for (unsigned i = 0; i < num_threads; i++) {
-      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker, pool)) {
+      if (thrd_success != u_thread_create(pool->threads + i, lp_cs_tpool_worker,
+                                          &pool->workers[i])) {
          num_threads = i;  /* previous thread is max */
          break;
       }
@@ -105,7 +261,6 @@ lp_cs_tpool_create(unsigned num_threads)
    pool->num_threads = num_threads;
    return pool;
 }
-
 void
 lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
 {
@@ -142,7 +297,9 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
       FREE(lmem.local_mem_ptr);
       return NULL;
    }
-   task = CALLOC_STRUCT(lp_cs_tpool_task);
+   task = align_calloc(sizeof(*task) +
+                       pool->num_threads * sizeof(task->ranges[0]),
+                       sizeof(task->ranges[0]));
    if (!task) {
       return NULL;
    }
@@ -151,14 +308,23 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
    task->data = data;
    task->iter_total = num_iters;
 
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   const unsigned iter_per_thread = num_iters / pool->num_threads;
+   const unsigned iter_remainder = num_iters % pool->num_threads;
+   unsigned begin = 0;
+   for (unsigned i = 0; i < pool->num_threads; i++) {
+      const unsigned count = iter_per_thread + (i < iter_remainder);
+      task->ranges[i].range = range_pack(begin, begin + count);
+      begin += count;
+   }
+
+   task->iter_chunk = MAX2(iter_per_thread / LP_CS_TPOOL_CHUNKS_PER_THREAD, 1);
 
    cnd_init(&task->finish);
 
    mtx_lock(&pool->m);
 
    list_addtail(&task->list, &pool->workqueue);
+   task->queued = true;
 
    cnd_broadcast(&pool->new_work);
    mtx_unlock(&pool->m);
@@ -174,12 +340,16 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
    if (!pool || !task)
       return;
 
+   /* Besides every iteration having run, the task must be off the queue
+    * and no worker may still be looking at it for something to steal.
+    */
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   while (p_atomic_read(&task->iter_finished) < task->iter_total ||
+          task->queued || task->num_workers)
       cnd_wait(&task->finish, &pool->m);
    mtx_unlock(&pool->m);
 
    cnd_destroy(&task->finish);
-   FREE(task);
+   align_free(task);
    *task_handle = NULL;
 }
@@ -30,6 +30,13 @@
  * structs with just unique indexes in them.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
+ *
+ * The iterations of a task are split evenly between the workers up front.
+ * Each worker claims chunks from the front of its own range and, once that
+ * is drained, steals half of what is left from the back of another
+ * worker's range, preferring workers on the same L3 cache.  All of this is
+ * done with compare-and-swap on the packed ranges, the pool mutex is only
+ * taken to pick up a new task and to retire it.
  */
 #ifndef LP_CS_QUEUE
 #define LP_CS_QUEUE
@@ -41,11 +48,20 @@
 
 #include "lp_limits.h"
 
+struct lp_cs_tpool;
+
+struct lp_cs_tpool_worker {
+   struct lp_cs_tpool *pool;
+   unsigned index;
+   unsigned L3_cache;
+};
+
 struct lp_cs_tpool {
    mtx_t m;
    cnd_t new_work;
 
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t threads[LP_MAX_CS_THREADS];
+   struct lp_cs_tpool_worker workers[LP_MAX_CS_THREADS];
    unsigned num_threads;
    struct list_head workqueue;
    bool shutdown;
@@ -58,16 +74,25 @@ struct lp_cs_local_mem {
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
 
+/* [begin, end) of the iterations a worker still owns, packed so it can be
+ * updated with a single compare-and-swap.  Padded to a cache line.
+ */
+struct lp_cs_tpool_range {
+   uint64_t range;
+   uint64_t pad[7];
+};
+
 struct lp_cs_tpool_task {
    lp_cs_tpool_task_func work;
    void *data;
    struct list_head list;
    cnd_t finish;
+   bool queued;             /* still on pool->workqueue */
+   unsigned num_workers;    /* workers running it, protected by pool->m */
    unsigned iter_total;
-   unsigned iter_start;
-   unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+   unsigned iter_finished;  /* atomic */
+   unsigned iter_chunk;     /* iterations claimed at a time */
+   struct lp_cs_tpool_range ranges[];  /* one per pool thread */
 };
 
 struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
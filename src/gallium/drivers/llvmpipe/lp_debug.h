@@ -65,6 +65,11 @@
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
 #define PERF_NO_RAST_LINEAR 0x100  	/* disable linear rast */
 #define PERF_NO_SHADE       0x200  	/* disable fragment shaders */
+#define PERF_NO_HIZ         0x400  	/* disable hierarchical depth culling */
+#define PERF_NO_MT_SETUP    0x800  	/* bin large draws on the context thread */
+#define PERF_NO_BIN_ORDER   0x1000 	/* rasterize bins in raster order */
+#define PERF_NO_COARSE_BINS 0x2000 	/* one tile per bin always */
+#define PERF_NO_AFFINITY    0x4000 	/* don't pin compute threads to an L3 */
 
 
 extern int LP_PERF;
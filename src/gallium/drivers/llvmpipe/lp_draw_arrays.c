@@ -146,6 +146,16 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
                                      lp->active_primgen_queries &&
                                      !lp->queries_disabled);
 
+   /* Large draws are set up and binned on the pool threads while the draw
+    * module goes on shading.
+    */
+   if (!indirect) {
+      uint64_t num_vertices = 0;
+      for (i = 0; i < num_draws; i++)
+         num_vertices += draws[i].count;
+      lp_setup_mt_begin(lp->setup, num_vertices * info->instance_count);
+   }
+
    /* draw! */
    draw_vbo(draw, info, drawid_offset, indirect, draws, num_draws,
             lp->patch_vertices);
@@ -184,6 +194,8 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info,
     * internally when this condition is seen?)
     */
    draw_flush(draw);
+
+   lp_setup_mt_end(lp->setup);
 }
 
 
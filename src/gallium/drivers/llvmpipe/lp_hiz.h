@@ -0,0 +1,119 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * Hierarchical depth ("Hi-Z") bounds.
+ *
+ * Setup keeps an upper bound of the depth values in every tile of the
+ * scene, in binning order, and each rasterizer task keeps one for every
+ * 16x16 block of the tile it is working on, in command order.  The bounds
+ * start out unknown (infinite), are set by depth clears, and are lowered
+ * by primitives which fully cover an area with a LESS/LEQUAL depth test
+ * and depth writes.  Any state which can raise depth values makes them
+ * unknown again.
+ *
+ * A primitive whose depth over an area is above the bound cannot pass a
+ * LESS/LEQUAL depth test anywhere in it, and if nothing else happens to
+ * failing fragments it is simply not drawn there.
+ */
+
+#ifndef LP_HIZ_H
+#define LP_HIZ_H
+
+#include <math.h>
+
+#include "util/format/u_format.h"
+#include "util/u_math.h"
+#include "util/u_pack_color.h"
+#include "lp_rast.h"
+#include "lp_state_fs.h"
+
+/* 16x16 blocks per tile */
+#define LP_HIZ_BLOCKS ((TILE_SIZE / 16) * (TILE_SIZE / 16))
+
+
+/**
+ * Bounds of a primitive's fragment depth over the pixels [x0, x1) x
+ * [y0, y1), from the position plane and the polygon offset the setup
+ * function stored in slot zero.  The bounds are widened to cover sample
+ * positions, pixel center conventions and the rounding of the fragment
+ * shader's own interpolation.
+ */
+static inline void
+lp_hiz_depth_range(const struct lp_rast_shader_inputs *inputs,
+                   int x0, int y0, int x1, int y1,
+                   float *zmin, float *zmax)
+{
+   const float a0 = GET_A0(inputs)[0][2];
+   const float offset = GET_A0(inputs)[0][0];
+   const float dzdx = GET_DADX(inputs)[0][2];
+   const float dzdy = GET_DADY(inputs)[0][2];
+   const float fx0 = x0 - 1, fy0 = y0 - 1;
+   const float w = x1 - x0 + 2, h = y1 - y0 + 2;
+
+   const float z = a0 + offset + dzdx * fx0 + dzdy * fy0;
+   const float ex = dzdx * w, ey = dzdy * h;
+   const float slack = (fabsf(a0) + fabsf(offset) +
+                        fabsf(dzdx) * (fabsf(fx0) + w) +
+                        fabsf(dzdy) * (fabsf(fy0) + h)) * (1.0f / (1 << 20));
+
+   *zmin = z + MIN2(ex, 0.0f) + MIN2(ey, 0.0f) - slack;
+   *zmax = z + MAX2(ex, 0.0f) + MAX2(ey, 0.0f) + slack;
+}
+
+
+/**
+ * Whether all fragments with a depth of at least zmin fail the depth test
+ * against a buffer whose depth values are at most bound.
+ */
+static inline bool
+lp_hiz_rejects(const struct lp_fragment_shader_variant *variant,
+               float zmin, float bound)
+{
+   if (variant->hiz_clamp)
+      zmin = MIN2(zmin, 1.0f);
+
+   return zmin > bound + variant->hiz_margin;
+}
+
+
+/**
+ * The bound of an area fully covered by a primitive whose depth is at most
+ * zmax, given the previous bound.
+ */
+static inline float
+lp_hiz_covered(const struct lp_fragment_shader_variant *variant,
+               float zmax, float bound)
+{
+   if (variant->hiz_clamp)
+      zmax = CLAMP(zmax, 0.0f, 1.0f);
+
+   /* This also keeps the old bound if zmax is NaN */
+   return zmax < bound ? zmax : bound;
+}
+
+
+/**
+ * The bound after a z/stencil clear with the given packed value and mask.
+ */
+static inline float
+lp_hiz_cleared(enum pipe_format format, uint64_t value, uint64_t mask,
+               float bound)
+{
+   const uint64_t zmask = util_pack64_mask_z(format, ~0u);
+
+   if (!(mask & zmask))
+      return bound;
+
+   if ((mask & zmask) != zmask)
+      return INFINITY;
+
+   float depth;
+   util_format_unpack_z_float(format, &depth, &value, 1);
+   return depth;
+}
+
+
+#endif /* LP_HIZ_H */
@@ -39,6 +39,12 @@
 #define TILE_ORDER 6
 #define TILE_SIZE (1 << TILE_ORDER)
 
+/**
+ * A scene bin covers up to (1 << LP_MAX_BIN_SHIFT)^2 tiles, see
+ * lp_scene_begin_binning().
+ */
+#define LP_MAX_BIN_SHIFT 1
+
 
 /**
  * Max texture sizes
@@ -68,6 +74,9 @@
 
 #define LP_MAX_THREADS 32
 
+/** Compute dispatches scale further than binned rasterization */
+#define LP_MAX_CS_THREADS 256
+
 
 /**
  * Max number of shader variants (for all shaders combined,
@@ -30,6 +30,7 @@
 
 #include "util/u_math.h"
 #include "util/u_cpu_detect.h"
+#include "util/format/u_format.h"
 #include "util/u_pack_color.h"
 #include "util/u_rect.h"
 #include "util/u_sse.h"
@@ -86,8 +87,8 @@ lp_fs_linear_run(const struct lp_rast_state *state,
    const struct lp_fragment_shader_variant *variant = state->variant;
    const struct lp_tgsi_info *info = &variant->shader->info;
    const struct lp_fragment_shader_variant_key *key = &variant->key;
-   bool rgba_order = (key->cbuf_format[0] == PIPE_FORMAT_R8G8B8A8_UNORM ||
-                      key->cbuf_format[0] == PIPE_FORMAT_R8G8B8X8_UNORM);
+   const enum pipe_format cbuf_format = key->cbuf_format[0];
+   bool rgba_order = lp_linear_rgba_order(cbuf_format);
    uint8_t constants[LP_MAX_LINEAR_CONSTANTS * 4];
 
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
@@ -195,9 +196,37 @@ lp_fs_linear_run(const struct lp_rast_state *state,
    }
 
    /* JIT function already does blending */
-   jit.color0 = color + x * 4 + y * stride;
    lp_jit_linear_llvm_func jit_func = variant->jit_linear_llvm;
 
+   if (lp_linear_staged_format(cbuf_format)) {
+      /* Shade each row into RGBA8 and convert it to the color buffer
+       * format afterwards.  The current contents are only needed if the
+       * variant isn't opaque.
+       */
+      const struct util_format_unpack_description *unpack =
+         util_format_unpack_description(cbuf_format);
+      const struct util_format_pack_description *pack =
+         util_format_pack_description(cbuf_format);
+      const unsigned bpp = util_format_get_blocksize(cbuf_format);
+      alignas(16) uint8_t row[TILE_SIZE * 4];
+      uint8_t *dst = color + x * bpp + y * stride;
+
+      assert(width <= TILE_SIZE);
+
+      for (unsigned iy = 0; iy < height; iy++) {
+         if (!variant->opaque)
+            unpack->unpack_rgba_8unorm(row, dst, width);
+         jit.color0 = row;
+         jit_func(&jit, 0, 0, width);  // x=0, y=0
+         pack->pack_rgba_8unorm(dst, stride, row, width * 4, width, 1);
+         dst += stride;
+      }
+
+      return true;
+   }
+
+   jit.color0 = color + x * 4 + y * stride;
+
    for (unsigned iy = 0; iy < height; iy++) {
       jit_func(&jit, 0, 0, width);  // x=0, y=0
       jit.color0 += stride;
@@ -208,7 +237,7 @@ lp_fs_linear_run(const struct lp_rast_state *state,
 fail:
    /* Visually distinguish this from other fallbacks:
     */
-   if (LP_DEBUG & DEBUG_LINEAR) {
+   if ((LP_DEBUG & DEBUG_LINEAR) && !lp_linear_staged_format(cbuf_format)) {
       return linear_fallback(state, x, y, width, height, color, stride);
    }
 
@@ -299,9 +328,10 @@ lp_linear_check_variant(struct lp_fragment_shader_variant *variant)
    }
 
    /* If we have a fastpath which implements the entire variant, use
-    * that.
+    * that.  These only write 8888 pixels.
     */
-   if (lp_linear_check_fastpath(variant)) {
+   if (!lp_linear_staged_format(key->cbuf_format[0]) &&
+       lp_linear_check_fastpath(variant)) {
       return;
    }
 
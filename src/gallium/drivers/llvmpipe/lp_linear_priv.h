@@ -28,6 +28,8 @@ struct lp_linear_sampler {
    int dtdy;                    /* 16.16 */
    int width;
    bool axis_aligned;
+   bool repeat_s;               /* PIPE_TEX_WRAP_REPEAT, else clamp to edge */
+   bool repeat_t;
 
    alignas(16) uint32_t row[64];
    alignas(16) uint32_t stretched_row[2][64];
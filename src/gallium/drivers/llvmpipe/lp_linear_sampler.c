@@ -79,6 +79,19 @@ fixed16_approx(int x, int y, int tol)
    return y - tol <= x && x <= y + tol;
 }
 
+/* texel index x wrapped into [0, size), either repeating or clamped to
+ * the edge.
+ */
+static inline int
+wrap_texel(int x, int size, bool repeat)
+{
+   if (!repeat)
+      return CLAMP(x, 0, size - 1);
+
+   x %= size;
+   return x < 0 ? x + size : x;
+}
+
 /* set alpha channel of rgba value to 0xff. */
 static inline uint32_t
 rgbx(uint32_t src_val)
@@ -454,6 +467,72 @@ fetch_clamp_linear_bgra(struct lp_linear_elem *elem)
    return row;
 }
 
+/* Repeating version of the above, for texture coordinates which wrap
+ * around on at least one axis.  The texel addresses are computed one
+ * pixel at a time, the filtering is still done four pixels at a time.
+ */
+static const uint32_t *
+fetch_wrap_linear_bgra(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const struct lp_jit_texture *texture = samp->texture;
+   const uint32_t *data  = (const uint32_t *)texture->base;
+   const int stride     = texture->row_stride[0] / sizeof(uint32_t);
+   const int tex_height = texture->height;
+   const int tex_width  = texture->width;
+   const bool repeat_s  = samp->repeat_s;
+   const bool repeat_t  = samp->repeat_t;
+   const int dsdx  = samp->dsdx;
+   const int dtdx  = samp->dtdx;
+   const int width = samp->width;
+   uint32_t *row   = samp->row;
+   int s = samp->s;
+   int t = samp->t;
+
+   for (int i = 0; i < width; i += 4) {
+      union m128i si[4], ws, wt;
+      __m128i wsl, wsh, wtl, wth;
+
+      for (int j = 0; j < 4; j++) {
+         const int s0 = s >> FIXED16_SHIFT;
+         const int t0 = t >> FIXED16_SHIFT;
+         const int cs0 = wrap_texel(s0,     tex_width,  repeat_s);
+         const int cs1 = wrap_texel(s0 + 1, tex_width,  repeat_s);
+         const int ct0 = wrap_texel(t0,     tex_height, repeat_t);
+         const int ct1 = wrap_texel(t0 + 1, tex_height, repeat_t);
+
+         si[0].ui[j] = data[ct0 * stride + cs0];
+         si[1].ui[j] = data[ct0 * stride + cs1];
+         si[2].ui[j] = data[ct1 * stride + cs0];
+         si[3].ui[j] = data[ct1 * stride + cs1];
+
+         ws.ui[j] = (s >> 8) & 0xff;
+         wt.ui[j] = (t >> 8) & 0xff;
+
+         s += dsdx;
+         t += dtdx;
+      }
+
+      ws.m = _mm_or_si128(ws.m, _mm_slli_epi32(ws.m, 16));
+      wsl = _mm_shuffle_epi32(ws.m, _MM_SHUFFLE(1,1,0,0));
+      wsh = _mm_shuffle_epi32(ws.m, _MM_SHUFFLE(3,3,2,2));
+
+      wt.m = _mm_or_si128(wt.m, _mm_slli_epi32(wt.m, 16));
+      wtl = _mm_shuffle_epi32(wt.m, _MM_SHUFFLE(1,1,0,0));
+      wth = _mm_shuffle_epi32(wt.m, _MM_SHUFFLE(3,3,2,2));
+
+      *(__m128i *)&row[i] = util_sse2_lerp_2d_epi8_fixed88(si[0].m, si[2].m,
+                                                           &si[1].m, &si[3].m,
+                                                           &wtl, &wth,
+                                                           &wsl, &wsh);
+   }
+
+   samp->s += samp->dsdy;
+   samp->t += samp->dtdy;
+
+   return row;
+}
+
 /* don't generate bgra 128-bits or memcpy ops they have their own path */
 #define FETCH_TYPE bgra
 #define OP
@@ -475,6 +554,14 @@ fetch_clamp_linear_bgra(struct lp_linear_elem *elem)
 #define OP128 rbx_swap_128
 #include "lp_linear_sampler_tmp.h"
 
+static inline bool
+is_clamp_or_repeat(unsigned wrap)
+{
+   return wrap == PIPE_TEX_WRAP_CLAMP_TO_EDGE ||
+          wrap == PIPE_TEX_WRAP_REPEAT;
+}
+
+
 static bool
 sampler_is_nearest(const struct lp_linear_sampler *samp,
                    const struct lp_sampler_static_state *sampler_state,
@@ -582,14 +669,30 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
 
    samp->texture = texture;
    samp->width = width;
+   samp->repeat_s =
+      sampler_state->sampler_state.wrap_s == PIPE_TEX_WRAP_REPEAT;
+   samp->repeat_t =
+      sampler_state->sampler_state.wrap_t == PIPE_TEX_WRAP_REPEAT;
+
+   float fs = fdsdx * x0 + fdsdy * y0 + s0 * width_oow;
+   float ft = fdtdx * x0 + fdtdy * y0 + t0 * height_oow;
 
-   samp->s = float_to_fixed16(fdsdx * x0 +
-                              fdsdy * y0 +
-                              s0 * width_oow);
+   /* Only the position within the texture matters when repeating, so
+    * start from the first period to keep tiled texture coordinates within
+    * the range of 16.16 fixed point.
+    */
+   if (samp->repeat_s)
+      fs -= floorf(fs / texture->width) * texture->width;
+   if (samp->repeat_t)
+      ft -= floorf(ft / texture->height) * texture->height;
+
+   const float fixed16_max = (float)((1 << (31 - FIXED16_SHIFT)) - 2);
+   if (fabsf(fs) + (fabsf(fdsdx) + fabsf(fdsdy)) * TILE_SIZE >= fixed16_max ||
+       fabsf(ft) + (fabsf(fdtdx) + fabsf(fdtdy)) * TILE_SIZE >= fixed16_max)
+      FAIL("texture coordinates out of fixed point range");
 
-   samp->t = float_to_fixed16(fdtdx * x0 +
-                              fdtdy * y0 +
-                              t0 * height_oow);
+   samp->s = float_to_fixed16(fs);
+   samp->t = float_to_fixed16(ft);
 
    samp->dsdx = float_to_fixed16(fdsdx);
    samp->dsdy = float_to_fixed16(fdsdy);
@@ -683,19 +786,24 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
       debug_printf("\n");
    }
 
-   /* We accept any mode below, but we only implement clamping.
+   /* We accept any mode below, but we only implement clamping and
+    * repeating.
     */
    if (need_wrap &&
-       (sampler_state->sampler_state.wrap_s != PIPE_TEX_WRAP_CLAMP_TO_EDGE ||
-        sampler_state->sampler_state.wrap_t != PIPE_TEX_WRAP_CLAMP_TO_EDGE)) {
+       (!is_clamp_or_repeat(sampler_state->sampler_state.wrap_s) ||
+        !is_clamp_or_repeat(sampler_state->sampler_state.wrap_t))) {
        return false;
    }
 
+   const bool need_repeat = need_wrap && (samp->repeat_s || samp->repeat_t);
+
    if (is_nearest) {
       switch (sampler_state->texture_state.format) {
       case PIPE_FORMAT_B8G8R8A8_UNORM:
          if (rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgra_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgra_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgra_swapped;
@@ -704,7 +812,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             else
                samp->base.fetch = fetch_memcpy_bgra_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgra;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgra;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgra;
@@ -716,7 +826,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
          return true;
       case PIPE_FORMAT_B8G8R8X8_UNORM:
          if (rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgrx_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgrx_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgrx_swapped;
@@ -725,7 +837,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             else
                samp->base.fetch = fetch_memcpy_bgrx_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgrx;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgrx;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgrx;
@@ -737,7 +851,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
          return true;
       case PIPE_FORMAT_R8G8B8A8_UNORM:
          if (!rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgra_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgra_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgra_swapped;
@@ -746,7 +862,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             else
                samp->base.fetch = fetch_memcpy_bgra_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgra;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgra;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgra;
@@ -758,7 +876,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
          return true;
       case PIPE_FORMAT_R8G8B8X8_UNORM:
          if (!rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgrx_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgrx_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgrx_swapped;
@@ -767,7 +887,9 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
             else
                samp->base.fetch = fetch_memcpy_bgrx_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_bgrx;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_bgrx;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_bgrx;
@@ -790,14 +912,18 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
       switch (sampler_state->texture_state.format) {
       case PIPE_FORMAT_B8G8R8A8_UNORM:
          if (rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgra_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgra_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgra_swapped;
             else
                samp->base.fetch = fetch_axis_aligned_linear_bgra_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgra;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgra;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgra;
@@ -807,14 +933,18 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
          return true;
       case PIPE_FORMAT_B8G8R8X8_UNORM:
          if (rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgrx_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgrx_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgrx_swapped;
             else
                samp->base.fetch = fetch_axis_aligned_linear_bgrx_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgrx;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgrx;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgrx;
@@ -824,14 +954,18 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
          return true;
       case PIPE_FORMAT_R8G8B8A8_UNORM:
          if (!rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgra_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgra_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgra_swapped;
             else
                samp->base.fetch = fetch_axis_aligned_linear_bgra_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgra;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgra;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgra;
@@ -841,14 +975,18 @@ lp_linear_init_sampler(struct lp_linear_sampler *samp,
          return true;
       case PIPE_FORMAT_R8G8B8X8_UNORM:
          if (!rgba_order) {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgrx_swapped;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgrx_swapped;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgrx_swapped;
             else
                samp->base.fetch = fetch_axis_aligned_linear_bgrx_swapped;
          } else {
-            if (need_wrap)
+            if (need_repeat)
+               samp->base.fetch = fetch_wrap_linear_bgrx;
+            else if (need_wrap)
                samp->base.fetch = fetch_clamp_linear_bgrx;
             else if (!samp->axis_aligned)
                samp->base.fetch = fetch_linear_bgrx;
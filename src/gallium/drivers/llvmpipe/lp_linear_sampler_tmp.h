@@ -126,6 +126,41 @@ CONCAT2(fetch_clamp_, FETCH_TYPE)(struct lp_linear_elem *elem)
    return row;
 }
 
+/* Non-axis aligned, repeating on at least one axis.
+ */
+static const uint32_t *
+CONCAT2(fetch_wrap_, FETCH_TYPE)(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const struct lp_jit_texture *texture = samp->texture;
+   const uint8_t *src   = texture->base;
+   const int stride     = texture->row_stride[0];
+   const int tex_height = texture->height;
+   const int tex_width  = texture->width;
+   const int dsdx  = samp->dsdx;
+   const int dtdx  = samp->dtdx;
+   const int width = samp->width;
+   uint32_t *row   = samp->row;
+   int s = samp->s;
+   int t = samp->t;
+
+   for (int i = 0; i < width; i++) {
+      int ct = wrap_texel(t>>FIXED16_SHIFT, tex_height, samp->repeat_t);
+      int cs = wrap_texel(s>>FIXED16_SHIFT, tex_width, samp->repeat_s);
+
+      const uint8_t *texel = src + ct * stride + cs * 4;
+
+      row[i] = OP(*(const uint32_t *)texel);
+
+      s += dsdx;
+      t += dtdx;
+   }
+
+   samp->s += samp->dsdy;
+   samp->t += samp->dtdy;
+   return row;
+}
+
 #ifdef OP128
 static const uint32_t *
 CONCAT2(fetch_axis_aligned_linear_, FETCH_TYPE)(struct lp_linear_elem *elem)
@@ -163,6 +198,24 @@ CONCAT2(fetch_clamp_linear_, FETCH_TYPE)(struct lp_linear_elem *elem)
    return row;
 }
 
+static const uint32_t *
+CONCAT2(fetch_wrap_linear_, FETCH_TYPE)(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   uint32_t *row = samp->row;
+   const int width = samp->width;
+
+   fetch_wrap_linear_bgra(&samp->base);
+
+   for (int i = 0; i < width; i += 4) {
+      __m128i bgra = *(__m128i *)&row[i];
+      __m128i rgba = OP128(bgra);
+      *(__m128i *)&row[i] = rgba;
+   }
+
+   return row;
+}
+
 static const uint32_t *
 CONCAT2(fetch_linear_, FETCH_TYPE)(struct lp_linear_elem *elem)
 {
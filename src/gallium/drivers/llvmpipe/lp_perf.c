@@ -52,6 +52,9 @@ lp_print_counters(void)
       debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
       debug_printf("llvmpipe: nr_rectangles:                %9u\n", lp_count.nr_rects);
       debug_printf("llvmpipe: nr_culled_rectangles:         %9u\n", lp_count.nr_culled_rects);
+      debug_printf("llvmpipe: nr_hiz_culled_triangles:      %9u\n", lp_count.nr_hiz_culled_tris);
+      debug_printf("llvmpipe: nr_hiz_culled_64x64:          %9u\n", lp_count.nr_hiz_culled_64);
+      debug_printf("llvmpipe: nr_hiz_culled_16x16:          %9u\n", lp_count.nr_hiz_culled_16);
 
       total_64 = (lp_count.nr_empty_64 + 
                   lp_count.nr_fully_covered_64 +
@@ -122,5 +125,11 @@ lp_print_counters(void)
       debug_printf("llvmpipe: total LLVM compile time:      %.2f sec\n", lp_count.llvm_compile_time / 1000000.0);
       debug_printf("llvmpipe: average LLVM compile time:    %.2f sec\n", lp_count.llvm_compile_time / 1000000.0 / lp_count.nr_llvm_compiles);
 
+      debug_printf("llvmpipe: nr_fs_variant_hits:           %9u\n", lp_count.nr_fs_variant_hits);
+      debug_printf("llvmpipe: nr_fs_variant_misses:         %9u\n", lp_count.nr_fs_variant_misses);
+      debug_printf("llvmpipe: nr_fs_variant_probes:         %9u\n", lp_count.nr_fs_variant_probes);
+      debug_printf("llvmpipe: fs compile stall time:        %.2f sec\n", lp_count.fs_compile_stall_time / 1000000.0);
+      debug_printf("llvmpipe: nr_fs_variants_optimized:     %9u\n", lp_count.nr_fs_variants_optimized);
+
    }
 }
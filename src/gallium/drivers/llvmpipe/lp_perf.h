@@ -44,6 +44,9 @@ struct lp_counters
    unsigned nr_culled_tris;
    unsigned nr_rects;
    unsigned nr_culled_rects;
+   unsigned nr_hiz_culled_tris;  /**< failed the depth test in all tiles */
+   unsigned nr_hiz_culled_64;
+   unsigned nr_hiz_culled_16;
    unsigned nr_empty_64;
    unsigned nr_fully_covered_64;
    unsigned nr_partially_covered_64;
@@ -65,6 +68,12 @@ struct lp_counters
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
 
+   unsigned nr_fs_variant_hits;
+   unsigned nr_fs_variant_misses;
+   unsigned nr_fs_variant_probes;  /**< key comparisons during lookups */
+   int64_t fs_compile_stall_time;  /**< waiting for LP_ASYNC_COMPILE, in usecs */
+   unsigned nr_fs_variants_optimized;  /**< GALLIVM_PERF=tiered rebuilds */
+
    unsigned nr_color_tile_clear;
    unsigned nr_color_tile_load;
    unsigned nr_color_tile_store;
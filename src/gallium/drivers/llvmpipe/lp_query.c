@@ -50,12 +50,64 @@ llvmpipe_query(struct pipe_query *p)
 }
 
 
+static const struct pipe_driver_query_info lp_driver_query_list[] = {
+   { "fs-compile-queue", LP_QUERY_FS_COMPILE_QUEUE_DEPTH, { 0 },
+     PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE },
+   { "fs-compile-stall", LP_QUERY_FS_COMPILE_STALL_TIME, { 0 },
+     PIPE_DRIVER_QUERY_TYPE_MICROSECONDS,
+     PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE },
+};
+
+
+int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen, unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   if (!info)
+      return ARRAY_SIZE(lp_driver_query_list);
+
+   if (index >= ARRAY_SIZE(lp_driver_query_list))
+      return 0;
+
+   *info = lp_driver_query_list[index];
+   return 1;
+}
+
+
+static bool
+is_driver_query(const struct llvmpipe_query *pq)
+{
+   return pq->type >= PIPE_QUERY_DRIVER_SPECIFIC;
+}
+
+
+/**
+ * Sample the current value of a driver specific query.
+ */
+static uint64_t
+driver_query_value(struct llvmpipe_context *llvmpipe,
+                   const struct llvmpipe_query *pq)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+
+   switch ((unsigned)pq->type) {
+   case LP_QUERY_FS_COMPILE_QUEUE_DEPTH:
+      return p_atomic_read(&screen->num_fs_compiles_pending);
+   case LP_QUERY_FS_COMPILE_STALL_TIME:
+      return p_atomic_read(&llvmpipe->fs_compile_stall_time);
+   default:
+      UNREACHABLE("unexpected driver query");
+   }
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          type - PIPE_QUERY_DRIVER_SPECIFIC < ARRAY_SIZE(lp_driver_query_list));
 
    struct llvmpipe_query *pq = CALLOC_STRUCT(llvmpipe_query);
    if (pq) {
@@ -118,6 +170,14 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
     */
    result->u64 = 0;
 
+   if (is_driver_query(pq)) {
+      if (pq->type == LP_QUERY_FS_COMPILE_QUEUE_DEPTH)
+         result->u64 = pq->end[0];
+      else
+         result->u64 = pq->end[0] - pq->start[0];
+      return true;
+   }
+
    /* Combine the per-thread results */
    switch (pq->type) {
    case PIPE_QUERY_OCCLUSION_COUNTER:
@@ -395,6 +455,11 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (is_driver_query(pq)) {
+      pq->start[0] = driver_query_value(llvmpipe, pq);
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
@@ -457,6 +522,11 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (is_driver_query(pq)) {
+      pq->end[0] = driver_query_value(llvmpipe, pq);
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -39,6 +39,13 @@
 
 
 struct llvmpipe_context;
+struct pipe_driver_query_info;
+struct pipe_screen;
+
+
+/* Driver specific queries, exposed to the HUD */
+#define LP_QUERY_FS_COMPILE_QUEUE_DEPTH (PIPE_QUERY_DRIVER_SPECIFIC + 0)
+#define LP_QUERY_FS_COMPILE_STALL_TIME  (PIPE_QUERY_DRIVER_SPECIFIC + 1)
 
 
 struct llvmpipe_query {
@@ -58,4 +65,8 @@ extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
 extern bool llvmpipe_check_render_cond(struct llvmpipe_context *);
 
+extern int
+llvmpipe_get_driver_query_info(struct pipe_screen *screen, unsigned index,
+                               struct pipe_driver_query_info *info);
+
 #endif /* LP_QUERY_H */
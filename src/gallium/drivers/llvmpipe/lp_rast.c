@@ -77,6 +77,9 @@ lp_rast_begin(struct lp_rasterizer *rast,
 
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
+   /* Draws get binned while their shaders compile in the background */
+   lp_scene_wait_frag_shaders(scene);
+
    lp_scene_begin_rasterization(scene);
    lp_scene_bin_iter_begin(scene);
 }
@@ -114,6 +117,14 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
+   /* Every bin binds its own state; the previous one may live in the
+    * data of a scene which has already been released.
+    */
+   task->state = NULL;
+
+   for (unsigned i = 0; i < LP_HIZ_BLOCKS; i++)
+      task->hiz[i] = INFINITY;
+
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       if (scene->fb.cbufs[i].texture) {
          task->color_tiles[i] = scene->cbufs[i].map +
@@ -285,6 +296,18 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             dst_layer += scene->zsbuf.layer_stride;
          }
       }
+
+      /* A state which invalidates the bounds may already be bound, and
+       * the clear would then tighten them behind its back.
+       */
+      if (scene->hiz_enabled &&
+          !(task->state && task->state->variant->hiz_invalidate)) {
+         for (unsigned i = 0; i < LP_HIZ_BLOCKS; i++)
+            task->hiz[i] = lp_hiz_cleared(scene->fb.zsbuf.format,
+                                          arg.clear_zstencil.value,
+                                          arg.clear_zstencil.mask,
+                                          task->hiz[i]);
+      }
    }
 }
 
@@ -317,10 +340,22 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
 
    const struct lp_fragment_shader_variant *variant = state->variant;
 
+   /* 16x16 blocks in which the primitive is entirely behind the depth buffer */
+   uint32_t hiz_culled = 0;
+   for (unsigned y = 0; y < task->height; y += 16) {
+      for (unsigned x = 0; x < task->width; x += 16) {
+         if (lp_rast_hiz_block(task, inputs, tile_x + x, tile_y + y, true))
+            hiz_culled |= 1u << ((y / 16) * (TILE_SIZE / 16) + x / 16);
+      }
+   }
+
    unsigned view_index = inputs->view_index;
    /* render the whole 64x64 tile in 4x4 chunks */
    for (unsigned y = 0; y < task->height; y += 4){
       for (unsigned x = 0; x < task->width; x += 4) {
+         if (hiz_culled & (1u << ((y / 16) * (TILE_SIZE / 16) + x / 16)))
+            continue;
+
          /* color buffer */
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
@@ -687,6 +722,11 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
    task->state = arg.set_state;
+
+   if (task->scene->hiz_enabled && task->state->variant->hiz_invalidate) {
+      for (unsigned i = 0; i < LP_HIZ_BLOCKS; i++)
+         task->hiz[i] = INFINITY;
+   }
 }
 
 
@@ -917,19 +957,23 @@ dispatch_tri_debug[] =
 struct lp_bin_info
 lp_characterize_bin(const struct cmd_bin *bin)
 {
-   unsigned andflags = ~0, j = 0;
+   unsigned andflags = ~0, j = 0, tiles = 0;
 
    STATIC_ASSERT(ARRAY_SIZE(rast_flags) == LP_RAST_OP_MAX);
 
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++, j++) {
-         andflags &= rast_flags[block->cmd[k]];
+         if (block->tiles[k])
+            andflags &= rast_flags[block->cmd[k]];
+         if (block->cmd[k] != LP_RAST_OP_SET_STATE)
+            tiles |= block->tiles[k];
       }
    }
 
    struct lp_bin_info info;
    info.type = andflags;
    info.count = j;
+   info.tiles = tiles;
 
    return info;
 }
@@ -944,7 +988,8 @@ blit_rasterize_bin(struct lp_rasterizer_task *task,
    if (0) debug_printf("%s\n", __func__);
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
-         dispatch_blit[block->cmd[k]](task, block->arg[k]);
+         if (block->tiles[k] & task->tile_mask)
+            dispatch_blit[block->cmd[k]](task, block->arg[k]);
       }
    }
 }
@@ -959,7 +1004,8 @@ tri_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
-         dispatch_tri[block->cmd[k]](task, block->arg[k]);
+         if (block->tiles[k] & task->tile_mask)
+            dispatch_tri[block->cmd[k]](task, block->arg[k]);
       }
    }
 }
@@ -973,7 +1019,8 @@ debug_rasterize_bin(struct lp_rasterizer_task *task,
 
    for (const struct cmd_block *block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
-         dispatch_tri_debug[block->cmd[k]](task, block->arg[k]);
+         if (block->tiles[k] & task->tile_mask)
+            dispatch_tri_debug[block->cmd[k]](task, block->arg[k]);
       }
    }
 }
@@ -981,7 +1028,7 @@ debug_rasterize_bin(struct lp_rasterizer_task *task,
 
 /**
  * Rasterize commands for a single bin.
- * \param x, y  position of the bin's tile in the framebuffer
+ * \param x, y  position of the bin in the scene, in bins
  * Must be called between lp_rast_begin() and lp_rast_end().
  * Called per thread.
  */
@@ -989,24 +1036,38 @@ static void
 rasterize_bin(struct lp_rasterizer_task *task,
               const struct cmd_bin *bin, int x, int y)
 {
+   const struct lp_scene *scene = task->scene;
+   const unsigned shift = scene->bin_shift;
    struct lp_bin_info info = lp_characterize_bin(bin);
 
-   lp_rast_tile_begin(task, bin, x, y);
+   /* Run the bin's commands for each of its tiles in turn.  Tiles which
+    * only get state changes are left alone, like empty bins.
+    */
+   u_foreach_bit(i, info.tiles) {
+      const unsigned tx = (x << shift) + (i & ((1 << shift) - 1));
+      const unsigned ty = (y << shift) + (i >> shift);
+
+      if (tx >= scene->tiles_x || ty >= scene->tiles_y)
+         continue;
+
+      task->tile_mask = 1 << i;
+      lp_rast_tile_begin(task, bin, tx, ty);
+
+      if (LP_DEBUG & DEBUG_NO_FASTPATH) {
+         debug_rasterize_bin(task, bin);
+      } else if (info.type & LP_RAST_FLAGS_BLIT) {
+         blit_rasterize_bin(task, bin);
+      } else if (scene->permit_linear_rasterizer &&
+               !(LP_PERF & PERF_NO_RAST_LINEAR) &&
+               (info.type & LP_RAST_FLAGS_RECT)) {
+         lp_linear_rasterize_bin(task, bin);
+      } else {
+         tri_rasterize_bin(task, bin, tx, ty);
+      }
 
-   if (LP_DEBUG & DEBUG_NO_FASTPATH) {
-      debug_rasterize_bin(task, bin);
-   } else if (info.type & LP_RAST_FLAGS_BLIT) {
-      blit_rasterize_bin(task, bin);
-   } else if (task->scene->permit_linear_rasterizer &&
-            !(LP_PERF & PERF_NO_RAST_LINEAR) &&
-            (info.type & LP_RAST_FLAGS_RECT)) {
-      lp_linear_rasterize_bin(task, bin);
-   } else {
-      tri_rasterize_bin(task, bin, x, y);
+      lp_rast_tile_end(task);
    }
 
-   lp_rast_tile_end(task);
-
 #if MESA_DEBUG
    /* Debug/Perf flags:
     */
@@ -419,6 +419,7 @@ enum lp_rast_op {
 struct lp_bin_info {
    unsigned type:8;    // bitmask of LP_RAST_FLAGS_x
    unsigned count:24;
+   unsigned tiles;     // tiles of the bin with commands other than state
 };
 
 struct lp_bin_info
@@ -52,7 +52,7 @@ lp_rast_linear_clear(struct lp_rasterizer_task *task,
 
    const struct lp_scene *scene = task->scene;
    util_fill_rect(scene->cbufs[0].map,
-                  PIPE_FORMAT_B8G8R8A8_UNORM,
+                  scene->fb.cbufs[0].format,
                   scene->cbufs[0].stride,
                   task->x,
                   task->y,
@@ -248,7 +248,8 @@ lp_linear_rasterize_bin(struct lp_rasterizer_task *task,
    for (block = bin->head; block; block = block->next) {
       for (unsigned k = 0; k < block->count; k++) {
          assert(dispatch_linear[block->cmd[k]]);
-         dispatch_linear[block->cmd[k]](task, block->arg[k]);
+         if (block->tiles[k] & task->tile_mask)
+            dispatch_linear[block->cmd[k]](task, block->arg[k]);
       }
    }
 }
@@ -31,7 +31,9 @@
 #include "util/format/u_format.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
+#include "lp_hiz.h"
 #include "lp_memory.h"
+#include "lp_perf.h"
 #include "lp_rast.h"
 #include "lp_scene.h"
 #include "lp_state.h"
@@ -87,10 +89,16 @@ struct lp_rasterizer_task
    struct lp_scene *scene;
    unsigned x, y;          /**< Pos of this tile in framebuffer, in pixels */
    unsigned width, height; /**< width, height of current tile, in pixels */
+   unsigned tile_mask;     /**< bit of this tile in the bin's tile masks */
 
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
+   /** Upper bounds of the depth values in each 16x16 block of the tile,
+    * see lp_hiz.h
+    */
+   float hiz[LP_HIZ_BLOCKS];
+
    /** "back" pointer */
    struct lp_rasterizer *rast;
 
@@ -218,6 +226,39 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 }
 
 
+/**
+ * Check a primitive against the depth bound of the 16x16 block at x, y
+ * (in window coords), and lower the bound if the block is fully covered.
+ * \return true if the primitive can be skipped in this block
+ */
+static inline bool
+lp_rast_hiz_block(struct lp_rasterizer_task *task,
+                  const struct lp_rast_shader_inputs *inputs,
+                  int x, int y, bool covered)
+{
+   const struct lp_fragment_shader_variant *variant = task->state->variant;
+
+   if (!task->scene->hiz_enabled || !(variant->hiz_cull || variant->hiz_update))
+      return false;
+
+   float *bound = &task->hiz[((y - (int)task->y) / 16) * (TILE_SIZE / 16) +
+                             (x - (int)task->x) / 16];
+   float zmin, zmax;
+
+   lp_hiz_depth_range(inputs, x, y, x + 16, y + 16, &zmin, &zmax);
+
+   if (variant->hiz_cull && lp_hiz_rejects(variant, zmin, *bound)) {
+      LP_COUNT(nr_hiz_culled_16);
+      return true;
+   }
+
+   if (covered && variant->hiz_update)
+      *bound = lp_hiz_covered(variant, zmax, *bound);
+
+   return false;
+}
+
+
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
  * triangle in/out tests.
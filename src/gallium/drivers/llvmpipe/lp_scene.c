@@ -26,6 +26,7 @@
  **************************************************************************/
 
 #include "util/u_framebuffer.h"
+#include "util/u_atomic.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/reallocarray.h"
@@ -103,6 +104,9 @@ lp_scene_destroy(struct lp_scene *scene)
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
    free(scene->tiles);
+   free(scene->bin_order);
+   free(scene->hiz);
+   free(scene->reset_tiles);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
 }
@@ -115,8 +119,8 @@ lp_scene_destroy(struct lp_scene *scene)
 bool
 lp_scene_is_empty(struct lp_scene *scene)
 {
-   for (unsigned y = 0; y < scene->tiles_y; y++) {
-      for (unsigned x = 0; x < scene->tiles_x; x++) {
+   for (unsigned y = 0; y < scene->bins_y; y++) {
+      for (unsigned x = 0; x < scene->bins_x; x++) {
          const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
          if (bin->head) {
             return false;
@@ -138,13 +142,35 @@ lp_scene_is_oom(struct lp_scene *scene)
 }
 
 
-/* Remove all commands from a bin.  Tries to reuse some of the memory
+/* Remove all commands from a tile.  Tries to reuse some of the memory
  * allocated to the bin, however.
  */
 void
 lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y)
 {
-   struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+   struct cmd_bin *bin = lp_scene_get_tile_bin(scene, x, y);
+
+   if (scene->reset_tiles)
+      BITSET_SET(scene->reset_tiles, y * scene->tiles_x + x);
+
+   if (scene->bin_shift) {
+      /* Other tiles may share the bin, so just drop this tile from the
+       * commands.  State changes stay as the following commands depend
+       * on them.
+       */
+      const unsigned tile = lp_scene_tile_bit(scene, x, y);
+      bool empty = true;
+      for (struct cmd_block *block = bin->head; block; block = block->next) {
+         for (unsigned k = 0; k < block->count; k++) {
+            if (block->cmd[k] != LP_RAST_OP_SET_STATE) {
+               block->tiles[k] &= ~tile;
+               empty = empty && !block->tiles[k];
+            }
+         }
+      }
+      if (!empty)
+         return;
+   }
 
    bin->last_state = NULL;
    bin->head = bin->tail;
@@ -362,6 +388,204 @@ lp_scene_new_data_block(struct lp_scene *scene)
 }
 
 
+/**
+ * Detach a chunk from its data blocks and the parent's framebuffer.
+ */
+static void
+end_chunk(struct lp_scene *chunk)
+{
+   chunk->data.head = &chunk->data.first;
+   memset(&chunk->fb, 0, sizeof chunk->fb);
+}
+
+
+/**
+ * Prepare a scene to bin a run of primitives into on behalf of the parent
+ * scene, see lp_setup_mt.c.  The chunk gets the parent's bin layout and
+ * depth bounds, but holds no references: all its data blocks are
+ * allocated so they can be handed over by lp_scene_merge_chunk().
+ */
+bool
+lp_scene_begin_chunk(struct lp_scene *chunk, const struct lp_scene *parent)
+{
+   const unsigned num_bins = parent->bins_x * parent->bins_y;
+   const unsigned num_tiles = parent->tiles_x * parent->tiles_y;
+
+   assert(chunk->data.head == &chunk->data.first);
+
+   if (chunk->num_alloced_tiles < num_bins) {
+      struct cmd_bin *tiles = reallocarray(chunk->tiles, num_bins,
+                                           sizeof(struct cmd_bin));
+      if (!tiles)
+         return false;
+      chunk->tiles = tiles;
+      chunk->num_alloced_tiles = num_bins;
+   }
+   memset(chunk->tiles, 0, sizeof(struct cmd_bin) * num_bins);
+
+   if (!chunk->reset_tiles) {
+      chunk->reset_tiles = calloc(BITSET_WORDS(TILES_X * TILES_Y),
+                                  sizeof(BITSET_WORD));
+      if (!chunk->reset_tiles)
+         return false;
+   }
+   memset(chunk->reset_tiles, 0,
+          BITSET_WORDS(num_tiles) * sizeof(BITSET_WORD));
+
+   if (parent->hiz_enabled) {
+      if (chunk->num_alloced_hiz < num_tiles) {
+         float *hiz = reallocarray(chunk->hiz, num_tiles, sizeof(float));
+         if (!hiz)
+            return false;
+         chunk->hiz = hiz;
+         chunk->num_alloced_hiz = num_tiles;
+      }
+      memcpy(chunk->hiz, parent->hiz, num_tiles * sizeof(float));
+   }
+
+   /* Only read by the setup code, never unreferenced */
+   chunk->fb = parent->fb;
+   chunk->fb_max_layer = parent->fb_max_layer;
+   chunk->fb_max_samples = parent->fb_max_samples;
+   memcpy(chunk->fixed_sample_pos, parent->fixed_sample_pos,
+          sizeof(chunk->fixed_sample_pos));
+   chunk->had_queries = parent->had_queries;
+   chunk->permit_linear_rasterizer = parent->permit_linear_rasterizer;
+   chunk->tiles_x = parent->tiles_x;
+   chunk->tiles_y = parent->tiles_y;
+   chunk->bin_shift = parent->bin_shift;
+   chunk->bins_x = parent->bins_x;
+   chunk->bins_y = parent->bins_y;
+   chunk->hiz_enabled = parent->hiz_enabled;
+
+   chunk->num_tile_cmds = 0;
+   chunk->scene_size = 0;
+   chunk->alloc_failed = false;
+
+   chunk->data.head = NULL;
+   if (!lp_scene_new_data_block(chunk)) {
+      end_chunk(chunk);
+      return false;
+   }
+
+   return true;
+}
+
+
+/**
+ * Whether the commands of a chunk begun for some scene can be merged into
+ * this one.  That isn't the case if the scene was flushed in the meantime
+ * and its successor uses another bin layout.
+ */
+bool
+lp_scene_chunk_compatible(const struct lp_scene *scene,
+                          const struct lp_scene *chunk)
+{
+   return scene->tiles_x == chunk->tiles_x &&
+          scene->tiles_y == chunk->tiles_y &&
+          scene->bin_shift == chunk->bin_shift &&
+          scene->fb_max_layer == chunk->fb_max_layer &&
+          scene->had_queries == chunk->had_queries &&
+          scene->hiz_enabled == chunk->hiz_enabled;
+}
+
+
+/**
+ * Append the commands of a chunk to the bins of the scene, as if they had
+ * been binned into it directly, and hand over the chunk's data blocks.
+ *
+ * The chunk's commands refer to chunk_state, which is replaced by state
+ * if the scene was restarted since the chunk was begun.  hiz_invalidate
+ * is that of the fragment shader variant the chunk was binned with.
+ */
+void
+lp_scene_merge_chunk(struct lp_scene *scene,
+                     struct lp_scene *chunk,
+                     const struct lp_rast_state *chunk_state,
+                     const struct lp_rast_state *state,
+                     bool hiz_invalidate)
+{
+   const unsigned num_bins = scene->bins_x * scene->bins_y;
+   const unsigned num_tiles = scene->tiles_x * scene->tiles_y;
+   unsigned i;
+
+   assert(lp_scene_chunk_compatible(scene, chunk));
+
+   /* Whole tiles the chunk overwrote drop everything binned before */
+   BITSET_FOREACH_SET(i, chunk->reset_tiles, num_tiles)
+      lp_scene_bin_reset(scene, i % scene->tiles_x, i / scene->tiles_x);
+
+   for (i = 0; i < num_bins; i++) {
+      const struct cmd_bin *src = &chunk->tiles[i];
+      struct cmd_bin *dst = &scene->tiles[i];
+
+      if (!src->head)
+         continue;
+
+      if (state != chunk_state) {
+         for (struct cmd_block *block = src->head; block;
+              block = block->next) {
+            for (unsigned k = 0; k < block->count; k++) {
+               if (block->cmd[k] == LP_RAST_OP_SET_STATE &&
+                   block->arg[k].set_state == chunk_state)
+                  block->arg[k].set_state = state;
+            }
+         }
+      }
+
+      if (dst->tail)
+         dst->tail->next = src->head;
+      else
+         dst->head = src->head;
+      dst->tail = src->tail;
+
+      if (src->last_state)
+         dst->last_state = src->last_state == chunk_state ?
+                           state : src->last_state;
+   }
+
+   if (scene->hiz_enabled) {
+      for (i = 0; i < num_tiles; i++) {
+         if (hiz_invalidate) {
+            if (chunk->hiz[i] == INFINITY)
+               scene->hiz[i] = INFINITY;
+         } else {
+            scene->hiz[i] = MIN2(scene->hiz[i], chunk->hiz[i]);
+         }
+      }
+   }
+
+   /* Keep allocating from the scene's current block */
+   struct data_block *last = chunk->data.head;
+   while (last->next)
+      last = last->next;
+   last->next = scene->data.head->next;
+   scene->data.head->next = chunk->data.head;
+   end_chunk(chunk);
+
+   scene->scene_size += chunk->scene_size;
+   scene->num_tile_cmds += chunk->num_tile_cmds;
+}
+
+
+/**
+ * Free the data blocks of a chunk whose commands won't be merged.
+ */
+void
+lp_scene_discard_chunk(struct lp_scene *chunk)
+{
+   struct data_block *block, *next;
+
+   for (block = chunk->data.head; block && block != &chunk->data.first;
+        block = next) {
+      next = block->next;
+      FREE(block);
+   }
+
+   end_chunk(chunk);
+}
+
+
 /**
  * Return number of bytes used for all bin data within a scene.
  * This does not include resources (textures) referenced by the scene.
@@ -460,6 +684,10 @@ lp_scene_add_frag_shader_reference(struct lp_scene *scene,
 {
    struct shader_ref *ref, **last = &scene->frag_shaders;
 
+   /* State bound for clears before the first draw has no variant */
+   if (!variant)
+      return true;
+
    /* Look at existing resource blocks:
     */
    for (ref = scene->frag_shaders; ref; ref = ref->next) {
@@ -499,6 +727,38 @@ lp_scene_add_frag_shader_reference(struct lp_scene *scene,
 }
 
 
+/**
+ * Count the scene as a use of each of its fragment shader variants, for
+ * tiered compilation.  Called from the context's thread when flushing.
+ */
+void
+lp_scene_use_frag_shaders(struct lp_scene *scene)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(scene->pipe);
+
+   for (struct shader_ref *ref = scene->frag_shaders; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         llvmpipe_fs_variant_used(lp, ref->variant[i]);
+   }
+}
+
+
+/**
+ * Wait for any background compiles of the scene's fragment shader
+ * variants.  Called by the rasterizer before it starts calling into them.
+ */
+void
+lp_scene_wait_frag_shaders(struct lp_scene *scene)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(scene->pipe);
+
+   for (struct shader_ref *ref = scene->frag_shaders; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++)
+         llvmpipe_fs_variant_wait_compile(lp, ref->variant[i]);
+   }
+}
+
+
 /**
  * Does this scene have a reference to the given resource?
  * Returns bitmask of LP_REFERENCED_FOR_READ/WRITE bits.
@@ -534,64 +794,173 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-/** advance curr_x,y to the next bin */
-static bool
-next_bin(struct lp_scene *scene)
+/** Bins are bucketed by the log2 of their command block count */
+#define LP_SCENE_BIN_WEIGHT_CLASSES 8
+
+
+static unsigned
+bin_weight_class(const struct cmd_bin *bin)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return false;
-   }
-   return true;
+   unsigned num_blocks = 0;
+   for (const struct cmd_block *block = bin->head; block; block = block->next)
+      num_blocks++;
+
+   return MIN2(util_logbase2(num_blocks), LP_SCENE_BIN_WEIGHT_CLASSES - 1);
 }
 
 
+/** Extract the even bits of a Morton code */
+static inline unsigned
+morton_compact(unsigned code)
+{
+   code &= 0x55555555;
+   code = (code | (code >> 1)) & 0x33333333;
+   code = (code | (code >> 2)) & 0x0f0f0f0f;
+   code = (code | (code >> 4)) & 0x00ff00ff;
+   code = (code | (code >> 8)) & 0x0000ffff;
+   return code;
+}
+
+
+/**
+ * Decide the order in which the rasterizer threads get the bins.
+ * Called once per scene by one thread, before any lp_scene_bin_iter_next().
+ *
+ * Empty bins are skipped.  The others are visited along a Morton curve so
+ * consecutive bins, which tend to end up on the same thread, are close to
+ * each other.  Bins with many more commands than the rest are moved to
+ * the front, so a single heavy tile doesn't start last and hold up the
+ * whole scene.  LP_PERF=no_bin_order keeps plain raster order instead.
+ */
 void
 lp_scene_bin_iter_begin(struct lp_scene *scene)
 {
-   scene->curr_x = scene->curr_y = -1;
+   unsigned class_count[LP_SCENE_BIN_WEIGHT_CLASSES] = { 0 };
+   const unsigned size = util_next_power_of_two(MAX2(scene->bins_x,
+                                                     scene->bins_y));
+   unsigned num_bins = 0;
+
+   if (LP_PERF & PERF_NO_BIN_ORDER) {
+      for (unsigned y = 0; y < scene->bins_y; y++) {
+         for (unsigned x = 0; x < scene->bins_x; x++) {
+            if (lp_scene_get_bin(scene, x, y)->head)
+               scene->bin_order[num_bins++] = (y << 16) | x;
+         }
+      }
+      scene->num_ordered_bins = num_bins;
+      scene->curr_bin = 0;
+      return;
+   }
+
+   /* Walk the tiles in Morton order, remembering the non-empty ones and
+    * their weight class in the scratch array.
+    */
+   for (unsigned code = 0; code < size * size; code++) {
+      const unsigned x = morton_compact(code);
+      const unsigned y = morton_compact(code >> 1);
+      if (x >= scene->bins_x || y >= scene->bins_y) {
+         /* The codes aligned to 4^n starting here cover a 2^n x 2^n square
+          * with this tile as its top left corner, so all of it is outside
+          * the bins too.  Skip the biggest one, which keeps wide or tall
+          * framebuffers from walking the whole size x size square.
+          */
+         code += (1u << ((ffs(code) - 1) & ~1)) - 1;
+         continue;
+      }
+
+      const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+      if (!bin->head)
+         continue;
+
+      const unsigned weight_class = bin_weight_class(bin);
+      class_count[weight_class]++;
+      scene->bin_order_scratch[num_bins++] =
+         (weight_class << 28) | (y << 14) | x;
+   }
+
+   /* Stable counting sort, heaviest class first. */
+   unsigned class_start[LP_SCENE_BIN_WEIGHT_CLASSES];
+   unsigned start = 0;
+   for (int c = LP_SCENE_BIN_WEIGHT_CLASSES - 1; c >= 0; c--) {
+      class_start[c] = start;
+      start += class_count[c];
+   }
+
+   for (unsigned i = 0; i < num_bins; i++) {
+      const unsigned packed = scene->bin_order_scratch[i];
+      const unsigned x = packed & 0x3fff;
+      const unsigned y = (packed >> 14) & 0x3fff;
+      scene->bin_order[class_start[packed >> 28]++] = (y << 16) | x;
+   }
+
+   scene->num_ordered_bins = num_bins;
+   scene->curr_bin = 0;
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
  * of work (a bin) to work on.
  */
 struct cmd_bin *
 lp_scene_bin_iter_next(struct lp_scene *scene , int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
+   const unsigned i = p_atomic_inc_return(&scene->curr_bin) - 1;
+   if (i >= scene->num_ordered_bins)
+      return NULL;
 
-   mtx_lock(&scene->mutex);
+   *x = scene->bin_order[i] & 0xffff;
+   *y = scene->bin_order[i] >> 16;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   } else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
-   }
+   return lp_scene_get_bin(scene, *x, *y);
+}
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+/** Want at least this many bins per rasterizer thread for load balancing */
+#define LP_MIN_BINS_PER_THREAD 8
+
+/** Above this many commands per tile binning isn't the bottleneck */
+#define LP_COARSE_BINS_MAX_DENSITY 8
+
+
+/**
+ * Pick the bin size for a new scene.
+ *
+ * Larger bins mean fewer commands, bins and bin iterations, which is what
+ * the time goes to when a large framebuffer gets few primitives per tile.
+ * They also mean less parallelism, so stay with one tile per bin if the
+ * previous scene was dense or there wouldn't be enough bins to keep all
+ * threads busy.
+ */
+static unsigned
+choose_bin_shift(const struct lp_scene *scene)
+{
+   const struct lp_setup_context *setup = scene->setup;
+
+   /* The bin dumps assume a tile per bin */
+   if (LP_DEBUG & DEBUG_SCENE)
+      return 0;
+
+   if (LP_PERF & PERF_NO_COARSE_BINS)
+      return 0;
+
+   if (setup->tile_cmd_density > LP_COARSE_BINS_MAX_DENSITY)
+      return 0;
+
+   for (unsigned shift = LP_MAX_BIN_SHIFT; shift > 0; shift--) {
+      const unsigned bin_size = 1 << shift;
+      const unsigned num_bins = DIV_ROUND_UP(scene->tiles_x, bin_size) *
+                                DIV_ROUND_UP(scene->tiles_y, bin_size);
+      if (num_bins >= MAX2(setup->num_threads, 1) * LP_MIN_BINS_PER_THREAD)
+         return shift;
+   }
+
+   return 0;
 }
 
 
-void
+bool
 lp_scene_begin_binning(struct lp_scene *scene,
                        struct pipe_framebuffer_state *fb)
 {
@@ -604,13 +973,32 @@ lp_scene_begin_binning(struct lp_scene *scene,
    assert(scene->tiles_x <= TILES_X);
    assert(scene->tiles_y <= TILES_Y);
 
-   unsigned num_required_tiles = scene->tiles_x * scene->tiles_y;
+   /* The tile masks are stored in a byte per command */
+   STATIC_ASSERT((1 << (2 * LP_MAX_BIN_SHIFT)) <= 8);
+
+   scene->bin_shift = choose_bin_shift(scene);
+   scene->bins_x = DIV_ROUND_UP(scene->tiles_x, 1 << scene->bin_shift);
+   scene->bins_y = DIV_ROUND_UP(scene->tiles_y, 1 << scene->bin_shift);
+   scene->num_tile_cmds = 0;
+
+   unsigned num_required_tiles = scene->bins_x * scene->bins_y;
    if (scene->num_alloced_tiles < num_required_tiles) {
-      scene->tiles = reallocarray(scene->tiles, num_required_tiles,
-                                  sizeof(struct cmd_bin));
-      if (!scene->tiles)
-         return;
+      struct cmd_bin *tiles = reallocarray(scene->tiles, num_required_tiles,
+                                           sizeof(struct cmd_bin));
+      if (!tiles)
+         goto fail;
+      scene->tiles = tiles;
       memset(scene->tiles, 0, sizeof(struct cmd_bin) * num_required_tiles);
+
+      /* bin_order and its scratch space share one allocation */
+      unsigned *bin_order = reallocarray(scene->bin_order,
+                                         2 * num_required_tiles,
+                                         sizeof(unsigned));
+      if (!bin_order)
+         goto fail;
+      scene->bin_order = bin_order;
+      scene->bin_order_scratch = bin_order + num_required_tiles;
+
       scene->num_alloced_tiles = num_required_tiles;
    }
 
@@ -640,18 +1028,49 @@ lp_scene_begin_binning(struct lp_scene *scene,
 
    scene->fb_max_layer = max_layer;
    scene->fb_max_samples = util_framebuffer_get_num_samples(fb);
+
+   /* The depth bounds start out unknown.  Layered depth buffers aren't
+    * tracked.
+    */
+   const unsigned num_tiles = scene->tiles_x * scene->tiles_y;
+   scene->hiz_enabled = false;
+   if (fb->zsbuf.texture && max_layer == 0) {
+      if (scene->num_alloced_hiz < num_tiles) {
+         float *hiz = reallocarray(scene->hiz, num_tiles, sizeof(float));
+         if (hiz) {
+            scene->hiz = hiz;
+            scene->num_alloced_hiz = num_tiles;
+         }
+      }
+      if (scene->num_alloced_hiz >= num_tiles) {
+         for (unsigned i = 0; i < num_tiles; i++)
+            scene->hiz[i] = INFINITY;
+         scene->hiz_enabled = true;
+      }
+   }
    if (scene->fb_max_samples == 4) {
       for (unsigned i = 0; i < 4; i++) {
          scene->fixed_sample_pos[i][0] = util_iround(lp_sample_pos_4x[i][0] * FIXED_ONE);
          scene->fixed_sample_pos[i][1] = util_iround(lp_sample_pos_4x[i][1] * FIXED_ONE);
       }
    }
+
+   return true;
+
+fail:
+   /* The old, smaller bin arrays are still in place.  Bin nothing. */
+   scene->bins_x = 0;
+   scene->bins_y = 0;
+   return false;
 }
 
 
 void
 lp_scene_end_binning(struct lp_scene *scene)
 {
+   scene->setup->tile_cmd_density =
+      scene->num_tile_cmds / MAX2(scene->tiles_x * scene->tiles_y, 1);
+
    if (LP_DEBUG & DEBUG_SCENE) {
       debug_printf("rasterize scene:\n");
       debug_printf("  scene_size: %u\n",
@@ -35,6 +35,7 @@
 #ifndef LP_SCENE_H
 #define LP_SCENE_H
 
+#include "util/bitset.h"
 #include "util/u_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
@@ -52,7 +53,7 @@ struct lp_rast_state;
 /* Commands per command block (ideally so sizeof(cmd_block) is a power of
  * two in size.)
  */
-#define CMD_BLOCK_MAX 29
+#define CMD_BLOCK_MAX 27
 
 /* Bytes per data block.  This effectively limits the maximum constant buffer
  * size.
@@ -77,6 +78,7 @@ typedef void (*lp_rast_cmd_func)(struct lp_rasterizer_task *,
 
 struct cmd_block {
    uint8_t cmd[CMD_BLOCK_MAX];  // LP_RAST_OP_x
+   uint8_t tiles[CMD_BLOCK_MAX];  // mask of the bin's tiles the cmd applies to
    union lp_rast_cmd_arg arg[CMD_BLOCK_MAX];
    unsigned count;
    struct cmd_block *next;
@@ -92,7 +94,8 @@ struct data_block {
 
 
 /**
- * For each screen tile we have one of these bins.
+ * For each group of 1 << (2 * lp_scene::bin_shift) screen tiles we have one
+ * of these bins.
  */
 struct cmd_bin {
    const struct lp_rast_state *last_state;  /* most recent state set in bin */
@@ -197,11 +200,45 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
+   /**
+    * Bins are (1 << bin_shift) x (1 << bin_shift) tiles.  Commands are
+    * still binned per tile, each one carries the mask of the tiles in its
+    * bin it applies to.  Tile i of a bin is at (i & mask, i >> bin_shift).
+    */
+   unsigned bin_shift;
+   unsigned bins_x, bins_y;
+
+   /** Number of per-tile commands binned, to estimate the scene density */
+   unsigned num_tile_cmds;
+
+   /**
+    * Non-empty bins in the order the rasterizer threads pick them up,
+    * packed as (y << 16) | x, see lp_scene_bin_iter_begin().
+    */
+   unsigned *bin_order;
+   unsigned *bin_order_scratch;
+   unsigned num_ordered_bins;
+   unsigned curr_bin;  /**< next bin_order entry to hand out, atomic */
    mtx_t mutex;
 
    unsigned num_alloced_tiles;
    struct cmd_bin *tiles;
+
+   /**
+    * Upper bound of the depth values of each tile, as of the commands
+    * binned so far, see lp_hiz.h.  Only valid if hiz_enabled.
+    */
+   bool hiz_enabled;
+   unsigned num_alloced_hiz;
+   float *hiz;
+
+   /**
+    * Tiles lp_scene_bin_reset() was called for, only allocated for the
+    * chunks of primitives binned by the threads of lp_setup_mt.c, which
+    * pass the resets on to their parent scene.
+    */
+   BITSET_WORD *reset_tiles;
+
    struct data_block_list data;
 };
 
@@ -231,6 +268,24 @@ unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
 bool lp_scene_add_frag_shader_reference(struct lp_scene *scene,
                                         struct lp_fragment_shader_variant *variant);
 
+void lp_scene_use_frag_shaders(struct lp_scene *scene);
+
+void lp_scene_wait_frag_shaders(struct lp_scene *scene);
+
+bool lp_scene_begin_chunk(struct lp_scene *chunk,
+                          const struct lp_scene *parent);
+
+bool lp_scene_chunk_compatible(const struct lp_scene *scene,
+                               const struct lp_scene *chunk);
+
+void lp_scene_merge_chunk(struct lp_scene *scene,
+                          struct lp_scene *chunk,
+                          const struct lp_rast_state *chunk_state,
+                          const struct lp_rast_state *state,
+                          bool hiz_invalidate);
+
+void lp_scene_discard_chunk(struct lp_scene *chunk);
+
 
 
 /**
@@ -300,33 +355,66 @@ lp_scene_alloc_aligned(struct lp_scene *scene, unsigned size,
 }
 
 
-/** Return pointer to a particular tile's bin. */
+/** Return pointer to the depth bound of a tile. */
+static inline float *
+lp_scene_get_hiz(struct lp_scene *scene, unsigned x, unsigned y)
+{
+   assert(scene->hiz_enabled);
+   return &scene->hiz[scene->tiles_x * y + x];
+}
+
+
+/** Return pointer to a particular bin. */
 static inline struct cmd_bin *
 lp_scene_get_bin(struct lp_scene *scene, unsigned x, unsigned y)
 {
-   unsigned idx = scene->tiles_x * y + x;
+   unsigned idx = scene->bins_x * y + x;
    return &scene->tiles[idx];
 }
 
 
-/** Remove all commands from a bin */
+/** Return pointer to the bin holding the commands of tile x, y. */
+static inline struct cmd_bin *
+lp_scene_get_tile_bin(struct lp_scene *scene, unsigned x, unsigned y)
+{
+   return lp_scene_get_bin(scene, x >> scene->bin_shift,
+                           y >> scene->bin_shift);
+}
+
+
+/** Bit of tile x, y in the tile mask of its bin's commands */
+static inline unsigned
+lp_scene_tile_bit(const struct lp_scene *scene, unsigned x, unsigned y)
+{
+   const unsigned mask = (1 << scene->bin_shift) - 1;
+   return 1 << (((y & mask) << scene->bin_shift) | (x & mask));
+}
+
+
+/** Tile mask for commands that apply to every tile of a bin */
+static inline unsigned
+lp_scene_all_tiles(const struct lp_scene *scene)
+{
+   return (1 << (1 << (2 * scene->bin_shift))) - 1;
+}
+
+
+/** Remove all commands from a tile */
 void
 lp_scene_bin_reset(struct lp_scene *scene, unsigned x, unsigned y);
 
 
-/* Add a command to bin[x][y].
+/* Append a command for the given tiles to a bin.
  */
 static inline bool
-lp_scene_bin_command(struct lp_scene *scene,
-                     unsigned x, unsigned y,
-                     enum lp_rast_op cmd,
-                     union lp_rast_cmd_arg arg)
+lp_scene_bin_push(struct lp_scene *scene,
+                  struct cmd_bin *bin,
+                  enum lp_rast_op cmd,
+                  union lp_rast_cmd_arg arg,
+                  unsigned tiles)
 {
-   struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
    struct cmd_block *tail = bin->tail;
 
-   assert(x < scene->tiles_x);
-   assert(y < scene->tiles_y);
    assert(cmd < LP_RAST_OP_MAX);
 
    if (tail == NULL || tail->count == CMD_BLOCK_MAX) {
@@ -340,6 +428,7 @@ lp_scene_bin_command(struct lp_scene *scene,
    {
       unsigned i = tail->count;
       tail->cmd[i] = cmd & LP_RAST_OP_MASK;
+      tail->tiles[i] = tiles;
       tail->arg[i] = arg;
       tail->count++;
    }
@@ -348,6 +437,75 @@ lp_scene_bin_command(struct lp_scene *scene,
 }
 
 
+/**
+ * Whether two commands binned for different tiles of a bin with the same
+ * op do the same thing, so that one command can serve both tiles.
+ */
+static inline bool
+lp_scene_cmd_args_match(enum lp_rast_op cmd,
+                        union lp_rast_cmd_arg a,
+                        union lp_rast_cmd_arg b)
+{
+   switch (cmd) {
+   case LP_RAST_OP_SHADE_TILE:
+   case LP_RAST_OP_SHADE_TILE_OPAQUE:
+   case LP_RAST_OP_BLIT:
+      return a.shade_tile == b.shade_tile;
+   case LP_RAST_OP_RECTANGLE:
+      return a.rectangle == b.rectangle;
+   default:
+      /* Triangles that are not contained in a single tile */
+      if ((cmd >= LP_RAST_OP_TRIANGLE_1 && cmd <= LP_RAST_OP_TRIANGLE_8) ||
+          (cmd >= LP_RAST_OP_TRIANGLE_32_1 && cmd <= LP_RAST_OP_TRIANGLE_32_8) ||
+          (cmd >= LP_RAST_OP_MS_TRIANGLE_1 && cmd <= LP_RAST_OP_MS_TRIANGLE_8))
+         return a.triangle.tri == b.triangle.tri &&
+                a.triangle.plane_mask == b.triangle.plane_mask;
+      return false;
+   }
+}
+
+
+/* Add a command to tile[x][y].
+ */
+static inline bool
+lp_scene_bin_command(struct lp_scene *scene,
+                     unsigned x, unsigned y,
+                     enum lp_rast_op cmd,
+                     union lp_rast_cmd_arg arg)
+{
+   struct cmd_bin *bin = lp_scene_get_tile_bin(scene, x, y);
+
+   assert(x < scene->tiles_x);
+   assert(y < scene->tiles_y);
+
+   /* State changes are in effect for all following commands of the bin,
+    * whichever tile they are for.
+    */
+   if (cmd == LP_RAST_OP_SET_STATE)
+      return lp_scene_bin_push(scene, bin, cmd, arg,
+                               lp_scene_all_tiles(scene));
+
+   scene->num_tile_cmds++;
+
+   const unsigned tile = lp_scene_tile_bit(scene, x, y);
+
+   /* Large primitives are binned to neighbouring tiles back to back, let
+    * those share the command.
+    */
+   struct cmd_block *tail = bin->tail;
+   if (scene->bin_shift && tail && tail->count) {
+      const unsigned i = tail->count - 1;
+      if (tail->cmd[i] == cmd &&
+          lp_scene_cmd_args_match(cmd, tail->arg[i], arg)) {
+         tail->tiles[i] |= tile;
+         return true;
+      }
+   }
+
+   return lp_scene_bin_push(scene, bin, cmd, arg, tile);
+}
+
+
 static inline bool
 lp_scene_bin_cmd_with_state(struct lp_scene *scene,
                             unsigned x, unsigned y,
@@ -355,7 +513,7 @@ lp_scene_bin_cmd_with_state(struct lp_scene *scene,
                             enum lp_rast_op cmd,
                             union lp_rast_cmd_arg arg)
 {
-   struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+   struct cmd_bin *bin = lp_scene_get_tile_bin(scene, x, y);
 
    if (state != bin->last_state) {
       bin->last_state = state;
@@ -379,9 +537,12 @@ lp_scene_bin_everywhere(struct lp_scene *scene,
                         enum lp_rast_op cmd,
                         const union lp_rast_cmd_arg arg)
 {
-   for (unsigned i = 0; i < scene->tiles_x; i++) {
-      for (unsigned j = 0; j < scene->tiles_y; j++) {
-         if (!lp_scene_bin_command(scene, i, j, cmd, arg))
+   const unsigned tiles = lp_scene_all_tiles(scene);
+
+   for (unsigned i = 0; i < scene->bins_x; i++) {
+      for (unsigned j = 0; j < scene->bins_y; j++) {
+         if (!lp_scene_bin_push(scene, lp_scene_get_bin(scene, i, j),
+                                cmd, arg, tiles))
             return false;
       }
    }
@@ -393,7 +554,7 @@ lp_scene_bin_everywhere(struct lp_scene *scene,
 static inline unsigned
 lp_scene_get_num_bins(const struct lp_scene *scene)
 {
-   return scene->tiles_x * scene->tiles_y;
+   return scene->bins_x * scene->bins_y;
 }
 
 
@@ -405,9 +566,10 @@ lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y);
 
 
 
-/* Begin/end binning of a scene
+/* Begin/end binning of a scene.  Begin returns false, and leaves the
+ * scene without bins, if the bins couldn't be allocated.
  */
-void
+bool
 lp_scene_begin_binning(struct lp_scene *scene,
                        struct pipe_framebuffer_state *fb);
 
@@ -37,6 +37,7 @@
 #include "pipe/p_screen.h"
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
+#include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_nir.h"
 #include "util/disk_cache.h"
 #include "util/hex.h"
@@ -55,6 +56,7 @@
 #include "lp_rast.h"
 #include "lp_cs_tpool.h"
 #include "lp_flush.h"
+#include "lp_query.h"
 
 #include "frontend/sw_winsys.h"
 
@@ -101,6 +103,11 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_hiz",         PERF_NO_HIZ, NULL },
+   { "no_mt_setup",    PERF_NO_MT_SETUP, NULL },
+   { "no_bin_order",   PERF_NO_BIN_ORDER, NULL },
+   { "no_coarse_bins", PERF_NO_COARSE_BINS, NULL },
+   { "no_affinity",    PERF_NO_AFFINITY, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -727,6 +734,12 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
    if (screen->cs_tpool)
       lp_cs_tpool_destroy(screen->cs_tpool);
 
+   if (util_queue_is_initialized(&screen->fs_compile_queue))
+      util_queue_destroy(&screen->fs_compile_queue);
+
+   if (util_queue_is_initialized(&screen->fs_optimize_queue))
+      util_queue_destroy(&screen->fs_optimize_queue);
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
@@ -910,7 +923,7 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
       goto out;
    }
 
-   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads);
+   screen->cs_tpool = lp_cs_tpool_create(screen->num_cs_threads);
    if (!screen->cs_tpool) {
       lp_rast_destroy(screen->rast);
       ret = false;
@@ -925,6 +938,20 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
    lp_build_init(); /* get lp_native_vector_width initialised */
 
    lp_disk_cache_create(screen);
+
+   /* Tiered compilation: variants are compiled with minimal optimization
+    * and the ones which get used a lot are recompiled on this thread.
+    * Background compiles do the same for every variant.
+    */
+   const unsigned perf_flags = gallivm_get_perf_flags();
+   if (((perf_flags & GALLIVM_PERF_TIERED) ||
+        util_queue_is_initialized(&screen->fs_compile_queue)) &&
+       !(perf_flags & GALLIVM_PERF_NO_OPT)) {
+      util_queue_init(&screen->fs_optimize_queue, "lpopt", 64, 1,
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                      UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY, NULL);
+   }
+
    screen->late_init_done = true;
 out:
    mtx_unlock(&screen->late_mutex);
@@ -975,14 +1002,26 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->base.finalize_nir = llvmpipe_finalize_nir;
 
    screen->base.get_disk_shader_cache = lp_get_disk_shader_cache;
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
    llvmpipe_init_screen_resource_funcs(&screen->base);
 
    screen->num_threads = util_get_cpu_caps()->nr_cpus > 1
       ? util_get_cpu_caps()->nr_cpus : 0;
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS",
                                               screen->num_threads);
+   screen->num_cs_threads = MIN2(screen->num_threads, LP_MAX_CS_THREADS);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   /* Opt-in: compile new fragment shader variants on this many background
+    * threads instead of stalling the draw call.
+    */
+   unsigned num_compile_threads = debug_get_num_option("LP_ASYNC_COMPILE", 0);
+   if (num_compile_threads) {
+      util_queue_init(&screen->fs_compile_queue, "lpfs", 64,
+                      MIN2(num_compile_threads, LP_MAX_THREADS),
+                      UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL);
+   }
+
    for (unsigned i = 0; i < MESA_SHADER_MESH_STAGES; i++)
       screen->base.nir_options[i] = &gallivm_nir_options;
 
@@ -38,6 +38,7 @@
 #include "pipe/p_defines.h"
 #include "util/u_thread.h"
 #include "util/list.h"
+#include "util/u_queue.h"
 #include "util/vma.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_misc.h"
@@ -52,6 +53,7 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_cs_threads;
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -63,6 +65,13 @@ struct llvmpipe_screen
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
+   /* Background fragment shader variant compilation (LP_ASYNC_COMPILE) */
+   struct util_queue fs_compile_queue;
+   unsigned num_fs_compiles_pending;  /**< atomic */
+
+   /* Recompiles hot fragment shader variants (GALLIVM_PERF=tiered) */
+   struct util_queue fs_optimize_queue;
+
    mtx_t late_mutex;
    bool late_init_done;
 
@@ -49,6 +49,7 @@
 #include "lp_texture.h"
 #include "lp_debug.h"
 #include "lp_fence.h"
+#include "lp_hiz.h"
 #include "lp_query.h"
 #include "lp_rast.h"
 #include "lp_setup_context.h"
@@ -77,7 +78,7 @@ lp_setup_wait_empty_scene(struct lp_setup_context *setup)
 }
 
 
-static void
+static bool
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
    assert(setup->scene == NULL);
@@ -113,7 +114,7 @@ lp_setup_get_empty_scene(struct lp_setup_context *setup)
 
    setup->scene = setup->scenes[i];
    setup->scene->permit_linear_rasterizer = setup->permit_linear_rasterizer;
-   lp_scene_begin_binning(setup->scene, &setup->fb);
+   return lp_scene_begin_binning(setup->scene, &setup->fb);
 }
 
 
@@ -207,6 +208,8 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
    memcpy(scene->active_queries, setup->active_queries,
           scene->num_active_queries * sizeof(scene->active_queries[0]));
 
+   lp_scene_use_frag_shaders(scene);
+
    lp_scene_end_binning(scene);
 
    mtx_lock(&screen->rast_mutex);
@@ -219,6 +222,21 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
 }
 
 
+/** Update the depth bounds of all tiles for a z/stencil clear */
+static void
+hiz_clear(struct lp_scene *scene, uint64_t zsvalue, uint64_t zsmask)
+{
+   if (!scene->hiz_enabled)
+      return;
+
+   const unsigned num_tiles = scene->tiles_x * scene->tiles_y;
+   for (unsigned i = 0; i < num_tiles; i++) {
+      scene->hiz[i] = lp_hiz_cleared(scene->fb.zsbuf.format,
+                                     zsvalue, zsmask, scene->hiz[i]);
+   }
+}
+
+
 static bool
 begin_binning(struct lp_setup_context *setup)
 {
@@ -283,6 +301,7 @@ begin_binning(struct lp_setup_context *setup)
                                          setup->clear.zsmask))) {
             return false;
          }
+         hiz_clear(scene, setup->clear.zsvalue, setup->clear.zsmask);
       }
    }
 
@@ -342,8 +361,8 @@ set_scene_state(struct lp_setup_context *setup,
 
    /* wait for a free/empty scene
     */
-   if (old_state == SETUP_FLUSHED)
-      lp_setup_get_empty_scene(setup);
+   if (old_state == SETUP_FLUSHED && !lp_setup_get_empty_scene(setup))
+      goto fail;
 
    switch (new_state) {
    case SETUP_CLEARED:
@@ -516,6 +535,7 @@ lp_setup_try_clear_zs(struct lp_setup_context *setup,
                                    LP_RAST_OP_CLEAR_ZSTENCIL,
                                    lp_rast_arg_clearzs(zsvalue, zsmask)))
          return false;
+      hiz_clear(scene, zsvalue, zsmask);
    } else {
       /* Put ourselves into the 'pre-clear' state, specifically to try
        * and accumulate multiple clears to color and depth_stencil
@@ -1301,6 +1321,8 @@ lp_setup_destroy(struct lp_setup_context *setup)
       pipe_resource_reference(&setup->images[i].current.resource, NULL);
    }
 
+   lp_setup_mt_destroy(setup);
+
    /* free the scenes in the 'empty' queue */
    for (unsigned i = 0; i < setup->num_active_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
@@ -1363,6 +1385,8 @@ lp_setup_create(struct pipe_context *pipe,
    }
    setup->num_active_scenes++;
 
+   setup->mt = lp_setup_mt_create(setup);
+
    setup->triangle = first_triangle;
    setup->line     = first_line;
    setup->point    = first_point;
@@ -1518,6 +1542,14 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup)
 {
    if (0) debug_printf("%s\n", __func__);
 
+   /* The copies binning on the pool threads can't flush, their chunk is
+    * binned again on the context thread instead.
+    */
+   if (setup->mt_chunk) {
+      setup->scene->alloc_failed = true;
+      return false;
+   }
+
    assert(setup->state == SETUP_ACTIVE);
 
    if (!set_scene_state(setup, SETUP_FLUSHED, __func__))
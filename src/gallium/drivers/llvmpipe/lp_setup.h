@@ -52,6 +52,12 @@ struct lp_setup_context *
 lp_setup_create(struct pipe_context *pipe,
                 struct draw_context *draw);
 
+void
+lp_setup_mt_begin(struct lp_setup_context *setup, uint64_t num_vertices);
+
+void
+lp_setup_mt_end(struct lp_setup_context *setup);
+
 void
 lp_setup_clear(struct lp_setup_context *setup,
                const union pipe_color_union *clear_color,
@@ -91,6 +91,9 @@ struct lp_setup_context
    unsigned num_threads;
    unsigned scene_idx;
 
+   /** Commands per tile in the last binned scene, for picking bin sizes */
+   unsigned tile_cmd_density;
+
    struct slab_mempool scene_slab;
    int num_active_scenes;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
@@ -174,6 +177,11 @@ struct lp_setup_context
 
    unsigned dirty;   /**< bitmask of LP_SETUP_NEW_x bits */
 
+   /** Binning of large draws on the screen's thread pool, see lp_setup_mt.c */
+   struct lp_setup_mt *mt;
+   bool mt_active;   /**< primitives are queued for the pool threads */
+   bool mt_chunk;    /**< a pool thread's copy, binning into a chunk scene */
+
    void (*point)(struct lp_setup_context *,
                  const float (*v0)[4]);
 
@@ -232,6 +240,36 @@ lp_setup_choose_rect(struct lp_setup_context *setup);
 void
 lp_setup_init_vbuf(struct lp_setup_context *setup);
 
+void
+lp_setup_emit_elements(struct lp_setup_context *setup,
+                       const void *vertex_buffer, unsigned stride,
+                       const uint16_t *indices, unsigned nr);
+
+void
+lp_setup_emit_arrays(struct lp_setup_context *setup,
+                     const void *vertex_buffer, unsigned stride,
+                     unsigned nr);
+
+struct lp_setup_mt *
+lp_setup_mt_create(struct lp_setup_context *setup);
+
+void
+lp_setup_mt_destroy(struct lp_setup_context *setup);
+
+void
+lp_setup_mt_sync_state(struct lp_setup_context *setup);
+
+void
+lp_setup_mt_new_vertices(struct lp_setup_context *setup);
+
+void
+lp_setup_mt_queue_elements(struct lp_setup_context *setup, unsigned stride,
+                           const uint16_t *indices, unsigned nr);
+
+void
+lp_setup_mt_queue_arrays(struct lp_setup_context *setup, unsigned stride,
+                         const void *vertices, unsigned nr);
+
 bool
 lp_setup_update_state(struct lp_setup_context *setup,
                       bool update_scene);
@@ -0,0 +1,568 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * Binning of large draws on the screen's thread pool.
+ *
+ * While a draw with many vertices is in flight, the primitives the draw
+ * module hands to the vbuf interface aren't set up right away but queued,
+ * along with a copy of their vertices, in groups of some ten thousand
+ * vertices.  A full group is split into chunks of consecutive primitives,
+ * each of which is run through the regular point/line/tri setup on a pool
+ * thread by a copy of the setup context, binning into a scene of its own.
+ * Meanwhile the draw module goes on fetching, shading and clipping the
+ * vertices of the next group on the context thread.
+ *
+ * The chunks are merged into the current scene in submission order, so
+ * each bin gets its commands in the same order as with serial binning.
+ * A chunk that ran out of memory, or whose scene was replaced by a
+ * differently laid out one in the meantime, is binned again on the context
+ * thread instead.
+ *
+ * All queued primitives are binned with the state current when they are
+ * handed to the pool, so whatever queued before a state change is binned
+ * first, see lp_setup_mt_sync_state().
+ */
+
+#include "util/u_dynarray.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "lp_context.h"
+#include "lp_cs_tpool.h"
+#include "lp_debug.h"
+#include "lp_scene.h"
+#include "lp_screen.h"
+#include "lp_setup.h"
+#include "lp_setup_context.h"
+#include "lp_state_fs.h"
+
+
+/** Draws with fewer vertices than this are binned right away */
+#define LP_SETUP_MT_MIN_VERTICES (16 * 1024)
+
+/** Vertices queued before a group is handed to the pool */
+#define LP_SETUP_MT_GROUP_VERTICES (64 * 1024)
+
+/** Fewest vertices worth binning on a thread */
+#define LP_SETUP_MT_CHUNK_VERTICES 2048
+
+#define LP_SETUP_MT_MAX_CHUNKS 16
+
+/** No data copied, or a draw_arrays() job */
+#define LP_SETUP_MT_NO_DATA ~0u
+
+
+/** A draw_elements() or draw_arrays() call of the draw module */
+struct lp_setup_mt_job {
+   enum mesa_prim prim;
+   unsigned view_index;
+   unsigned stride;
+   unsigned nr;
+   unsigned vertices;   /**< offset of the vertices in the group's data */
+   unsigned indices;    /**< offset of the indices, or LP_SETUP_MT_NO_DATA */
+};
+
+
+struct lp_setup_mt_chunk {
+   struct lp_setup_context setup;   /**< copy binning into scene */
+   struct lp_scene *scene;
+   unsigned first_job, num_jobs;
+   bool done;
+};
+
+
+/** Primitives queued to be binned together */
+struct lp_setup_mt_group {
+   struct lp_setup_mt *mt;
+   struct util_dynarray jobs;   /**< struct lp_setup_mt_job */
+   struct util_dynarray data;   /**< vertices and indices of the jobs */
+   unsigned num_vertices;
+
+   /** Set when handed to the pool */
+   unsigned num_chunks;
+   const struct lp_rast_state *stored;   /**< state the chunks bin */
+   struct lp_cs_tpool_task *task;
+};
+
+
+struct lp_setup_mt {
+   struct lp_cs_tpool *pool;
+   mtx_t *pool_mutex;
+   unsigned max_chunks;
+
+   /**
+    * The pool bins one group while the other one is queued to.  The
+    * chunks are those of the group being binned.
+    */
+   struct lp_setup_mt_group groups[2];
+   unsigned current;   /**< group being queued to */
+   struct lp_setup_mt_chunk *chunks[LP_SETUP_MT_MAX_CHUNKS];
+
+   /** Offset of the draw module's vertices in the current group's data */
+   unsigned vertices;
+};
+
+
+struct lp_setup_mt *
+lp_setup_mt_create(struct lp_setup_context *setup)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+
+   if (!screen->cs_tpool || screen->cs_tpool->num_threads < 2)
+      return NULL;
+
+   struct lp_setup_mt *mt = CALLOC_STRUCT(lp_setup_mt);
+   if (!mt)
+      return NULL;
+
+   mt->pool = screen->cs_tpool;
+   mt->pool_mutex = &screen->cs_mutex;
+   mt->max_chunks = MIN2(screen->cs_tpool->num_threads,
+                         LP_SETUP_MT_MAX_CHUNKS);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(mt->groups); i++) {
+      mt->groups[i].mt = mt;
+      util_dynarray_init(&mt->groups[i].jobs, NULL);
+      util_dynarray_init(&mt->groups[i].data, NULL);
+   }
+
+   mt->vertices = LP_SETUP_MT_NO_DATA;
+
+   return mt;
+}
+
+
+void
+lp_setup_mt_destroy(struct lp_setup_context *setup)
+{
+   struct lp_setup_mt *mt = setup->mt;
+
+   if (!mt)
+      return;
+
+   assert(!setup->mt_active);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(mt->groups); i++) {
+      assert(!mt->groups[i].task);
+      util_dynarray_fini(&mt->groups[i].jobs);
+      util_dynarray_fini(&mt->groups[i].data);
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(mt->chunks); i++) {
+      if (mt->chunks[i]) {
+         lp_scene_discard_chunk(mt->chunks[i]->scene);
+         lp_scene_destroy(mt->chunks[i]->scene);
+         FREE(mt->chunks[i]);
+      }
+   }
+
+   FREE(mt);
+   setup->mt = NULL;
+}
+
+
+static struct lp_setup_mt_chunk *
+get_chunk(struct lp_setup_context *setup, unsigned i)
+{
+   struct lp_setup_mt *mt = setup->mt;
+
+   if (!mt->chunks[i]) {
+      struct lp_setup_mt_chunk *chunk = CALLOC_STRUCT(lp_setup_mt_chunk);
+      if (!chunk)
+         return NULL;
+
+      chunk->scene = lp_scene_create(setup);
+      if (!chunk->scene) {
+         FREE(chunk);
+         return NULL;
+      }
+
+      mt->chunks[i] = chunk;
+   }
+
+   return mt->chunks[i];
+}
+
+
+static void
+emit_job(struct lp_setup_context *setup,
+         const struct lp_setup_mt_group *group,
+         const struct lp_setup_mt_job *job)
+{
+   const uint8_t *data = group->data.data;
+
+   setup->prim = job->prim;
+   setup->view_index = job->view_index;
+
+   if (job->indices == LP_SETUP_MT_NO_DATA)
+      lp_setup_emit_arrays(setup, data + job->vertices, job->stride,
+                           job->nr);
+   else
+      lp_setup_emit_elements(setup, data + job->vertices, job->stride,
+                             (const uint16_t *)(data + job->indices),
+                             job->nr);
+}
+
+
+/**
+ * Bin jobs on the context thread, into the current scene.
+ */
+static void
+emit_jobs(struct lp_setup_context *setup,
+          const struct lp_setup_mt_group *group,
+          unsigned first_job, unsigned num_jobs)
+{
+   const struct lp_setup_mt_job *jobs = util_dynarray_begin(&group->jobs);
+   const enum mesa_prim prim = setup->prim;
+   const unsigned view_index = setup->view_index;
+
+   /* Not lp_setup_update_state() unless needed, state changes wait for
+    * this.
+    */
+   if (setup->state != SETUP_ACTIVE &&
+       !lp_setup_update_state(setup, true))
+      return;
+
+   for (unsigned i = first_job; i < first_job + num_jobs; i++)
+      emit_job(setup, group, &jobs[i]);
+
+   setup->prim = prim;
+   setup->view_index = view_index;
+}
+
+
+/** Thread pool task binning a chunk of a group */
+static void
+bin_chunk(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   struct lp_setup_mt_group *group = data;
+   struct lp_setup_mt_chunk *chunk = group->mt->chunks[iter_idx];
+   const struct lp_setup_mt_job *jobs = util_dynarray_begin(&group->jobs);
+
+   for (unsigned i = 0; i < chunk->num_jobs; i++) {
+      emit_job(&chunk->setup, group, &jobs[chunk->first_job + i]);
+
+      /* It will be binned again anyway */
+      if (lp_scene_is_oom(chunk->scene))
+         break;
+   }
+
+   chunk->done = true;
+}
+
+
+/**
+ * Split a group into chunks of about the same number of vertices and hand
+ * them to the pool.  Small groups are left to finish_group().
+ */
+static void
+bin_group(struct lp_setup_context *setup, struct lp_setup_mt_group *group)
+{
+   struct lp_setup_mt *mt = setup->mt;
+   const struct lp_setup_mt_job *jobs = util_dynarray_begin(&group->jobs);
+   const unsigned num_jobs =
+      util_dynarray_num_elements(&group->jobs, struct lp_setup_mt_job);
+   const unsigned num_chunks =
+      MIN3(mt->max_chunks,
+           group->num_vertices / LP_SETUP_MT_CHUNK_VERTICES, num_jobs);
+   unsigned job = 0, vertices = 0;
+
+   group->num_chunks = 0;
+
+   if (num_chunks < 2 || setup->state != SETUP_ACTIVE)
+      return;
+
+   for (unsigned i = 0; i < num_chunks; i++) {
+      struct lp_setup_mt_chunk *chunk = get_chunk(setup, i);
+
+      if (!chunk || !lp_scene_begin_chunk(chunk->scene, setup->scene)) {
+         for (unsigned j = 0; j < i; j++)
+            lp_scene_discard_chunk(mt->chunks[j]->scene);
+         return;
+      }
+
+      /* At least a job each, the last chunk takes the rest */
+      const unsigned end =
+         (uint64_t)group->num_vertices * (i + 1) / num_chunks;
+      chunk->first_job = job;
+      do {
+         vertices += jobs[job++].nr;
+      } while (job < num_jobs - (num_chunks - 1 - i) && vertices < end);
+      if (i == num_chunks - 1)
+         job = num_jobs;
+      chunk->num_jobs = job - chunk->first_job;
+
+      memcpy(&chunk->setup, setup, sizeof *setup);
+      chunk->setup.scene = chunk->scene;
+      chunk->setup.mt = NULL;
+      chunk->setup.mt_active = false;
+      chunk->setup.mt_chunk = true;
+      chunk->done = false;
+   }
+
+   group->stored = setup->fs.stored;
+   group->num_chunks = num_chunks;
+
+   mtx_lock(mt->pool_mutex);
+   group->task = lp_cs_tpool_queue_task(mt->pool, bin_chunk, group,
+                                        num_chunks);
+   mtx_unlock(mt->pool_mutex);
+}
+
+
+/**
+ * Move the commands of a chunk into the current scene, flushing it first
+ * if they don't fit anymore.
+ */
+static bool
+merge_chunk(struct lp_setup_context *setup,
+            const struct lp_setup_mt_group *group,
+            struct lp_setup_mt_chunk *chunk)
+{
+   struct lp_scene *scene;
+
+   if (!chunk->done || lp_scene_is_oom(chunk->scene))
+      return false;
+
+   if (setup->state != SETUP_ACTIVE &&
+       !lp_setup_update_state(setup, true))
+      return false;
+
+   scene = setup->scene;
+   if (!lp_scene_chunk_compatible(scene, chunk->scene))
+      return false;
+
+   if (scene->scene_size + chunk->scene->scene_size > LP_SCENE_MAX_SIZE) {
+      if (!lp_setup_flush_and_restart(setup))
+         return false;
+
+      scene = setup->scene;
+      if (!lp_scene_chunk_compatible(scene, chunk->scene))
+         return false;
+   }
+
+   lp_scene_merge_chunk(scene, chunk->scene, group->stored,
+                        setup->fs.stored,
+                        chunk->setup.fs.current.variant->hiz_invalidate);
+
+   return true;
+}
+
+
+/**
+ * Wait for the pool to bin a group and merge the result, or bin it here.
+ */
+static void
+finish_group(struct lp_setup_context *setup, struct lp_setup_mt_group *group)
+{
+   struct lp_setup_mt *mt = setup->mt;
+   const unsigned num_jobs =
+      util_dynarray_num_elements(&group->jobs, struct lp_setup_mt_job);
+
+   if (group->num_chunks) {
+      lp_cs_tpool_wait_for_task(mt->pool, &group->task);
+
+      for (unsigned i = 0; i < group->num_chunks; i++) {
+         struct lp_setup_mt_chunk *chunk = mt->chunks[i];
+
+         if (!merge_chunk(setup, group, chunk)) {
+            lp_scene_discard_chunk(chunk->scene);
+            emit_jobs(setup, group, chunk->first_job, chunk->num_jobs);
+         }
+      }
+   } else if (num_jobs) {
+      emit_jobs(setup, group, 0, num_jobs);
+   }
+
+   util_dynarray_clear(&group->jobs);
+   util_dynarray_clear(&group->data);
+   group->num_vertices = 0;
+   group->num_chunks = 0;
+   group->task = NULL;
+}
+
+
+/**
+ * Bin everything queued so far, in order.
+ */
+static void
+flush_queued(struct lp_setup_context *setup)
+{
+   struct lp_setup_mt *mt = setup->mt;
+   struct lp_setup_mt_group *group = &mt->groups[mt->current];
+
+   finish_group(setup, &mt->groups[mt->current ^ 1]);
+   bin_group(setup, group);
+   finish_group(setup, group);
+
+   mt->vertices = LP_SETUP_MT_NO_DATA;
+}
+
+
+/**
+ * Hand the current group to the pool once the previous one is merged,
+ * and start queueing to the other.
+ */
+static void
+switch_groups(struct lp_setup_context *setup)
+{
+   struct lp_setup_mt *mt = setup->mt;
+
+   finish_group(setup, &mt->groups[mt->current ^ 1]);
+   bin_group(setup, &mt->groups[mt->current]);
+
+   mt->current ^= 1;
+   mt->vertices = LP_SETUP_MT_NO_DATA;
+}
+
+
+/**
+ * Bin the queued primitives if the state is about to change.
+ */
+void
+lp_setup_mt_sync_state(struct lp_setup_context *setup)
+{
+   const struct llvmpipe_context *lp = llvmpipe_context(setup->pipe);
+
+   if (lp->dirty || setup->dirty)
+      flush_queued(setup);
+}
+
+
+/**
+ * The draw module refilled its vertex buffer.
+ */
+void
+lp_setup_mt_new_vertices(struct lp_setup_context *setup)
+{
+   setup->mt->vertices = LP_SETUP_MT_NO_DATA;
+}
+
+
+static unsigned
+copy_data(struct lp_setup_mt_group *group, const void *data, unsigned size)
+{
+   const unsigned offset = group->data.size;
+
+   /* Keep the vertices aligned as in the vertex buffer */
+   void *dst = util_dynarray_grow_bytes(&group->data, 1, align(size, 16));
+   if (!dst)
+      return LP_SETUP_MT_NO_DATA;
+
+   memcpy(dst, data, size);
+   return offset;
+}
+
+
+static void
+queue_job(struct lp_setup_context *setup, struct lp_setup_mt_group *group,
+          unsigned stride, unsigned vertices, unsigned indices, unsigned nr)
+{
+   struct lp_setup_mt_job *job =
+      util_dynarray_grow(&group->jobs, struct lp_setup_mt_job, 1);
+   if (!job)
+      return;
+
+   job->prim = setup->prim;
+   job->view_index = setup->view_index;
+   job->stride = stride;
+   job->nr = nr;
+   job->vertices = vertices;
+   job->indices = indices;
+
+   group->num_vertices += nr;
+   if (group->num_vertices >= LP_SETUP_MT_GROUP_VERTICES)
+      switch_groups(setup);
+}
+
+
+void
+lp_setup_mt_queue_elements(struct lp_setup_context *setup, unsigned stride,
+                           const uint16_t *indices, unsigned nr)
+{
+   struct lp_setup_mt *mt = setup->mt;
+
+   lp_setup_mt_sync_state(setup);
+   if (!lp_setup_update_state(setup, true))
+      return;
+
+   struct lp_setup_mt_group *group = &mt->groups[mt->current];
+
+   /* The draw module may index the same vertices several times */
+   if (mt->vertices == LP_SETUP_MT_NO_DATA) {
+      mt->vertices = copy_data(group, setup->vertex_buffer,
+                               setup->vertex_size * setup->nr_vertices);
+      if (mt->vertices == LP_SETUP_MT_NO_DATA)
+         return;
+   }
+
+   const unsigned offset = copy_data(group, indices, nr * sizeof *indices);
+   if (offset == LP_SETUP_MT_NO_DATA)
+      return;
+
+   queue_job(setup, group, stride, mt->vertices, offset, nr);
+}
+
+
+void
+lp_setup_mt_queue_arrays(struct lp_setup_context *setup, unsigned stride,
+                         const void *vertices, unsigned nr)
+{
+   struct lp_setup_mt *mt = setup->mt;
+
+   lp_setup_mt_sync_state(setup);
+   if (!lp_setup_update_state(setup, true))
+      return;
+
+   struct lp_setup_mt_group *group = &mt->groups[mt->current];
+
+   const unsigned offset = copy_data(group, vertices, nr * stride);
+   if (offset == LP_SETUP_MT_NO_DATA)
+      return;
+
+   queue_job(setup, group, stride, offset, LP_SETUP_MT_NO_DATA, nr);
+}
+
+
+/**
+ * Queue the primitives of a draw for the pool threads from here on if it
+ * has enough vertices to be worth it.
+ */
+void
+lp_setup_mt_begin(struct lp_setup_context *setup, uint64_t num_vertices)
+{
+   const struct llvmpipe_context *lp = llvmpipe_context(setup->pipe);
+   const struct pipe_rasterizer_state *rast = lp->rasterizer;
+
+   assert(!setup->mt_active);
+
+   /* Statistics are counted as primitives are set up, and the draw
+    * module's AA and stipple stages change the state in mid-draw.
+    */
+   if (!setup->mt ||
+       num_vertices < LP_SETUP_MT_MIN_VERTICES ||
+       (LP_PERF & PERF_NO_MT_SETUP) ||
+       lp->active_statistics_queries ||
+       !rast || rast->line_smooth || rast->point_smooth ||
+       rast->poly_stipple_enable)
+      return;
+
+   setup->mt->vertices = LP_SETUP_MT_NO_DATA;
+   setup->mt_active = true;
+}
+
+
+/**
+ * Bin the primitives still queued at the end of a draw.
+ */
+void
+lp_setup_mt_end(struct lp_setup_context *setup)
+{
+   if (!setup->mt_active)
+      return;
+
+   flush_queued(setup);
+   setup->mt_active = false;
+}
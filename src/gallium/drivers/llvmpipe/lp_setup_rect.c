@@ -392,6 +392,16 @@ lp_setup_bin_rectangle(struct lp_setup_context *setup,
    if (iy1 * TILE_SIZE + TILE_SIZE - 1 != rect->box.y1)
       bottom_mask = RECT_PLANE_BOTTOM;
 
+   /* Rectangles don't take part in hierarchical depth culling, they only
+    * need to forget the depth bounds of the tiles they could raise.
+    */
+   if (scene->hiz_enabled && setup->fs.current.variant->hiz_invalidate) {
+      for (unsigned j = iy0; j <= iy1; j++) {
+         for (unsigned i = ix0; i <= ix1; i++)
+            *lp_scene_get_hiz(scene, i, j) = INFINITY;
+      }
+   }
+
    /* Determine which tile(s) intersect the rectangle's bounding box
     */
    if (iy0 == iy1 && ix0 == ix1) {
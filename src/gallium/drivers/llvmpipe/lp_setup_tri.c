@@ -48,6 +48,7 @@ altivec.h inclusion in -std=c++98..11 causes bool to be redefined
 #include "util/u_memory.h"
 #include "util/u_rect.h"
 #include "util/u_sse.h"
+#include "lp_hiz.h"
 #include "lp_perf.h"
 #include "lp_setup_context.h"
 #include "lp_rast.h"
@@ -777,6 +778,39 @@ floor_pot(uint32_t n)
 }
 
 
+/**
+ * Check a primitive against the depth bound of a tile, over the part of
+ * the tile in box, and update the bound for it.  Returns false if the
+ * primitive fails the depth test everywhere in there.
+ */
+static bool
+hiz_bin_tile(struct lp_setup_context *setup,
+             const struct lp_rast_shader_inputs *inputs,
+             int tx, int ty, const struct u_rect *box, bool covered)
+{
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   float *bound = lp_scene_get_hiz(setup->scene, tx, ty);
+
+   if (variant->hiz_invalidate) {
+      *bound = INFINITY;
+      return true;
+   }
+
+   float zmin, zmax;
+   lp_hiz_depth_range(inputs, box->x0, box->y0, box->x1 + 1, box->y1 + 1,
+                      &zmin, &zmax);
+
+   if (variant->hiz_cull && lp_hiz_rejects(variant, zmin, *bound))
+      return false;
+
+   if (covered && variant->hiz_update)
+      *bound = lp_hiz_covered(variant, zmax, *bound);
+
+   return true;
+}
+
+
 bool
 lp_setup_bin_triangle(struct lp_setup_context *setup,
                       struct lp_rast_triangle *tri,
@@ -787,6 +821,10 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                       unsigned viewport_index)
 {
    struct lp_scene *scene = setup->scene;
+   const struct lp_fragment_shader_variant *variant =
+      setup->fs.current.variant;
+   const bool hiz = scene->hiz_enabled &&
+      (variant->hiz_cull || variant->hiz_update || variant->hiz_invalidate);
    unsigned cmd;
 
    /* What is the largest power-of-two boundary this triangle crosses:
@@ -828,6 +866,11 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
              ix0 == bbox->x1 / TILE_SIZE);
 
+      if (hiz && !hiz_bin_tile(setup, &tri->inputs, ix0, iy0, &trimmed_box, false)) {
+         LP_COUNT(nr_hiz_culled_tris);
+         return true;
+      }
+
       if (nr_planes == 3) {
          if (sz < 4) {
             /* Triangle is contained in a single 4x4 stamp:
@@ -922,6 +965,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
 
       tri->inputs.is_blit = lp_setup_is_blit(setup, &tri->inputs);
 
+      bool binned = false;
+
       /* Test tile-sized blocks against the triangle.
        * Discard blocks fully outside the tri.  If the block is fully
        * contained inside the tri, bin an lp_rast_shade_tile command.
@@ -944,11 +989,24 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                partial |= ((int) (planepartial >> 63)) & (1<<i);
             }
 
+            struct u_rect tile_box;
+            if (hiz && !out) {
+               tile_box.x0 = MAX2(trimmed_box.x0, x * TILE_SIZE);
+               tile_box.y0 = MAX2(trimmed_box.y0, y * TILE_SIZE);
+               tile_box.x1 = MIN2(trimmed_box.x1, x * TILE_SIZE + TILE_SIZE - 1);
+               tile_box.y1 = MIN2(trimmed_box.y1, y * TILE_SIZE + TILE_SIZE - 1);
+            }
+
             if (out) {
                /* do nothing */
                if (in)
                   break;  /* exiting triangle, all done with this row */
                LP_COUNT(nr_empty_64);
+            } else if (hiz && !hiz_bin_tile(setup, &tri->inputs, x, y,
+                                            &tile_box, !partial)) {
+               /* fails the depth test everywhere in the tile */
+               in = true;
+               LP_COUNT(nr_hiz_culled_64);
             } else if (partial) {
                /* Not trivially accepted by at least one plane -
                 * rasterize/shade partial tile
@@ -966,12 +1024,14 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                   goto fail;
 
                LP_COUNT(nr_partially_covered_64);
+               binned = true;
             } else {
                /* triangle covers the whole tile- shade whole tile */
                LP_COUNT(nr_fully_covered_64);
                in = true;
                if (!lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque))
                   goto fail;
+               binned = true;
             }
 
             /* Iterate cx values across the region: */
@@ -983,6 +1043,9 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
          for (int i = 0; i < nr_planes; i++)
             c[i] += ystep[i];
       }
+
+      if (hiz && !binned)
+         LP_COUNT(nr_hiz_culled_tris);
    }
 
    return true;
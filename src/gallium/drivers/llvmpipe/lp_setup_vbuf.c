@@ -72,6 +72,9 @@ lp_setup_get_vertex_info(struct vbuf_render *vbr)
    /* Vertex size/info depends on the latest state.
     * The draw module may have issued additional state-change commands.
     */
+   if (setup->mt_active)
+      lp_setup_mt_sync_state(setup);
+
    lp_setup_update_state(setup, false);
 
    return setup->vertex_info;
@@ -118,9 +121,12 @@ lp_setup_unmap_vertices(struct vbuf_render *vbr,
                         uint16_t min_index,
                         uint16_t max_index)
 {
-   ASSERTED struct lp_setup_context *setup = lp_setup_context(vbr);
+   struct lp_setup_context *setup = lp_setup_context(vbr);
    assert(setup->vertex_buffer_size >= (max_index+1) * setup->vertex_size);
-   /* do nothing */
+
+   /* Queued primitives refer to a copy of the vertices */
+   if (setup->mt_active)
+      lp_setup_mt_new_vertices(setup);
 }
 
 
@@ -166,22 +172,17 @@ rect(struct lp_setup_context *setup,
 
 
 /**
- * draw elements / indexed primitives
+ * Run indexed primitives of the current primitive type through the
+ * point/line/tri setup functions.
  */
-static void
-lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr)
+void
+lp_setup_emit_elements(struct lp_setup_context *setup,
+                       const void *vertex_buffer, unsigned stride,
+                       const uint16_t *indices, unsigned nr)
 {
-   struct lp_setup_context *setup = lp_setup_context(vbr);
-   const unsigned stride = setup->vertex_info->size * sizeof(float);
-   const void *vertex_buffer = setup->vertex_buffer;
    const bool flatshade_first = setup->flatshade_first;
    unsigned i;
 
-   assert(setup->setup.variant);
-
-   if (!lp_setup_update_state(setup, true))
-      return;
-
    const bool uses_constant_interp =
       setup->setup.variant->key.uses_constant_interp;
 
@@ -374,22 +375,40 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
 
 
 /**
- * This function is hit when the draw module is working in pass-through mode.
- * It's up to us to convert the vertex array into point/line/tri prims.
+ * draw elements / indexed primitives
  */
 static void
-lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
+lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr)
 {
    struct lp_setup_context *setup = lp_setup_context(vbr);
    const unsigned stride = setup->vertex_info->size * sizeof(float);
-   const void *vertex_buffer =
-      (void *) get_vert(setup->vertex_buffer, start, stride);
-   const bool flatshade_first = setup->flatshade_first;
-   unsigned i;
+
+   assert(setup->setup.variant);
+
+   if (setup->mt_active) {
+      lp_setup_mt_queue_elements(setup, stride, indices, nr);
+      return;
+   }
 
    if (!lp_setup_update_state(setup, true))
       return;
 
+   lp_setup_emit_elements(setup, setup->vertex_buffer, stride, indices, nr);
+}
+
+
+/**
+ * Run nr consecutive vertices as primitives of the current primitive type
+ * through the point/line/tri setup functions.
+ */
+void
+lp_setup_emit_arrays(struct lp_setup_context *setup,
+                     const void *vertex_buffer, unsigned stride,
+                     unsigned nr)
+{
+   const bool flatshade_first = setup->flatshade_first;
+   unsigned i;
+
    const bool uses_constant_interp =
       setup->setup.variant->key.uses_constant_interp;
 
@@ -635,6 +654,30 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
 }
 
 
+/**
+ * This function is hit when the draw module is working in pass-through mode.
+ * It's up to us to convert the vertex array into point/line/tri prims.
+ */
+static void
+lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
+{
+   struct lp_setup_context *setup = lp_setup_context(vbr);
+   const unsigned stride = setup->vertex_info->size * sizeof(float);
+   const void *vertex_buffer =
+      (void *) get_vert(setup->vertex_buffer, start, stride);
+
+   if (setup->mt_active) {
+      lp_setup_mt_queue_arrays(setup, stride, vertex_buffer, nr);
+      return;
+   }
+
+   if (!lp_setup_update_state(setup, true))
+      return;
+
+   lp_setup_emit_arrays(setup, vertex_buffer, stride, nr);
+}
+
+
 static void
 lp_setup_vbuf_destroy(struct vbuf_render *vbr)
 {
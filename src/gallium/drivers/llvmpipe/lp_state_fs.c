@@ -3151,12 +3151,12 @@ static void
 generate_fragment(struct llvmpipe_context *lp,
                   struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
+                  struct nir_shader *nir,
                   unsigned partial_mask)
 {
    assert(partial_mask == RAST_WHOLE ||
           partial_mask == RAST_EDGE_TEST);
 
-   struct nir_shader *nir = shader->base.ir.nir;
    struct gallivm_state *gallivm = variant->gallivm;
    struct lp_fragment_shader_variant_key *key = &variant->key;
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
@@ -3761,6 +3761,354 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
 }
 
 
+/**
+ * State handed from generate_variant() to compile_variant(), either
+ * directly or through the background compiler queue.
+ */
+struct lp_fs_compile_job
+{
+   struct llvmpipe_context *lp;
+   struct lp_fragment_shader_variant *variant;
+   struct lp_cached_code cached;
+   unsigned char ir_sha1_cache_key[20];
+   bool needs_caching;
+   bool linear_pipeline;
+   bool linear_fastpath;
+};
+
+
+/**
+ * Build and JIT the variant's functions.  Only touches the variant, its
+ * private gallivm state and the given NIR, so it can run on a compiler
+ * thread.
+ */
+static void
+compile_variant(struct lp_fs_compile_job *job, struct nir_shader *nir)
+{
+   struct llvmpipe_context *lp = job->lp;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader *shader = variant->shader;
+
+   llvmpipe_fs_variant_fastpath(variant);
+
+   lp_jit_init_types(variant);
+
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(lp, shader, variant, nir, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(lp, shader, variant, nir, RAST_WHOLE);
+      }
+   }
+
+   if (job->linear_pipeline) {
+      /* Currently keeping both the old fastpaths and new linear path
+       * active.  The older code is still somewhat faster for the cases
+       * it covers.
+       *
+       * XXX: consider restricting this to aero-mode only.
+       */
+      if (job->linear_fastpath) {
+         llvmpipe_fs_variant_linear_fastpath(variant);
+      }
+
+      /* If the original fastpath doesn't cover this variant, try the new
+       * code:
+       */
+      if (variant->jit_linear == NULL) {
+         if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
+             shader->kind == LP_FS_KIND_BLIT_RGB1 ||
+             shader->kind == LP_FS_KIND_LLVM_LINEAR) {
+            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
+         }
+      }
+   } else {
+      if (LP_DEBUG & DEBUG_LINEAR) {
+         lp_debug_fs_variant(variant);
+         debug_printf("    ----> no linear path for this variant\n");
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+#if GALLIVM_USE_ORCJIT
+/* module has been moved into ORCJIT after gallivm_compile_module */
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   gallivm_compile_module(variant->gallivm);
+#else
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+#endif
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST],
+                                 variant->function_name[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+         gallivm_jit_function(variant->gallivm,
+                              variant->function[RAST_WHOLE],
+                              variant->function_name[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+         variant->jit_function[RAST_EDGE_TEST];
+   }
+
+   if (job->linear_pipeline) {
+      if (variant->linear_function) {
+         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
+            gallivm_jit_function(variant->gallivm, variant->linear_function,
+                                 variant->linear_function_name);
+      }
+
+      /*
+       * This must be done after LLVM compilation, as it will call the JIT'ed
+       * code to determine active inputs.
+       */
+      lp_linear_check_variant(variant);
+   }
+
+   if (job->needs_caching) {
+      lp_disk_cache_insert_shader(llvmpipe_screen(lp->pipe.screen),
+                                  &job->cached, job->ir_sha1_cache_key);
+   }
+
+   gallivm_free_ir(variant->gallivm);
+}
+
+
+static void
+queue_optimize_variant(struct llvmpipe_context *lp,
+                       struct lp_fragment_shader_variant *variant);
+
+
+static void
+compile_variant_job(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_compile_job *job = data;
+   struct llvmpipe_screen *screen = llvmpipe_screen(job->lp->pipe.screen);
+
+   /* lp_build_nir_soa() lowers the shader in place, so work on a copy to
+    * not race with other variants of the same shader.
+    */
+   struct nir_shader *nir =
+      nir_shader_clone(NULL, job->variant->shader->base.ir.nir);
+
+   compile_variant(job, nir);
+
+   ralloc_free(nir);
+
+   /* Scenes can run the fast code from now on, until the optimized code
+    * gets swapped in.
+    */
+   if (job->variant->optimize_when_ready)
+      queue_optimize_variant(job->lp, job->variant);
+
+   p_atomic_dec(&screen->num_fs_compiles_pending);
+}
+
+
+static void
+compile_variant_job_cleanup(void *data, void *gdata, int thread_index)
+{
+   FREE(data);
+}
+
+
+/**
+ * State for rebuilding a fast compiled variant at full optimization.
+ */
+struct lp_fs_optimize_job
+{
+   struct llvmpipe_context *lp;
+   struct lp_fragment_shader_variant *variant;
+   struct nir_shader *nir;
+   unsigned char ir_sha1_cache_key[20];
+};
+
+
+static void
+optimize_variant_job(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_optimize_job *job = data;
+   struct llvmpipe_context *lp = job->lp;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader *shader = variant->shader;
+   const size_t size =
+      sizeof *variant + shader->variant_key_size - sizeof variant->key;
+   int64_t t0 = os_time_get();
+
+   /* Tiered variants may get enough uses to be rebuilt while their
+    * background compile is still running.
+    */
+   util_queue_fence_wait(&variant->compile_fence);
+
+   /* The code generators keep their LLVM state in the variant, which the
+    * draw and rasterizer threads are using, so build into a copy and
+    * only publish the new function pointers.  Only the functions which
+    * came from LLVM are rebuilt, fastpaths stay as they are; function[]
+    * and linear_function still say which ones, although their IR is gone.
+    */
+   struct lp_fragment_shader_variant *opt = MALLOC(size);
+   if (!opt)
+      return;
+
+   memcpy(opt, variant, size);
+   memset(opt->function, 0, sizeof opt->function);
+   memset(opt->function_name, 0, sizeof opt->function_name);
+   memset(opt->jit_function, 0, sizeof opt->jit_function);
+   opt->linear_function = NULL;
+   opt->linear_function_name = NULL;
+   opt->jit_linear_llvm = NULL;
+
+   struct lp_cached_code cached;
+   memset(&cached, 0, sizeof cached);
+
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u_opt",
+            shader->no, variant->no);
+   lp_context_create(&variant->context_opt);
+   opt->gallivm = gallivm_create(module_name, &variant->context_opt, &cached);
+   if (!opt->gallivm) {
+      FREE(opt);
+      return;
+   }
+
+   /* The copied LLVM types belong to the variant's LLVM context */
+   opt->jit_context_ptr_type = NULL;
+   lp_jit_init_types(opt);
+
+   if (variant->function[RAST_EDGE_TEST])
+      generate_fragment(lp, shader, opt, job->nir, RAST_EDGE_TEST);
+   if (variant->function[RAST_WHOLE])
+      generate_fragment(lp, shader, opt, job->nir, RAST_WHOLE);
+   if (variant->linear_function)
+      llvmpipe_fs_variant_linear_llvm(lp, shader, opt);
+
+   gallivm_compile_module(opt->gallivm);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(opt->function); i++) {
+      if (opt->function[i]) {
+         opt->jit_function[i] = (lp_jit_frag_func)
+            gallivm_jit_function(opt->gallivm, opt->function[i],
+                                 opt->function_name[i]);
+      }
+   }
+
+   if (opt->linear_function) {
+      opt->jit_linear_llvm = (lp_jit_linear_llvm_func)
+         gallivm_jit_function(opt->gallivm, opt->linear_function,
+                              opt->linear_function_name);
+   }
+
+   lp_disk_cache_insert_shader(llvmpipe_screen(lp->pipe.screen),
+                               &cached, job->ir_sha1_cache_key);
+
+   gallivm_free_ir(opt->gallivm);
+
+   /* Swap the functions over.  The old code stays around until the
+    * variant is destroyed, as scenes may still be running it.
+    */
+   if (opt->jit_function[RAST_EDGE_TEST]) {
+      if (!variant->function[RAST_WHOLE] &&
+          variant->jit_function[RAST_WHOLE] ==
+          variant->jit_function[RAST_EDGE_TEST])
+         opt->jit_function[RAST_WHOLE] = opt->jit_function[RAST_EDGE_TEST];
+   }
+   for (unsigned i = 0; i < ARRAY_SIZE(opt->jit_function); i++) {
+      if (opt->jit_function[i])
+         p_atomic_set(&variant->jit_function[i], opt->jit_function[i]);
+   }
+   if (opt->jit_linear_llvm)
+      p_atomic_set(&variant->jit_linear_llvm, opt->jit_linear_llvm);
+
+   variant->gallivm_opt = opt->gallivm;
+
+   if (gallivm_debug & GALLIVM_DEBUG_PERF) {
+      debug_printf("llvmpipe: optimized fs%u variant%u after %u scenes "
+                   "in %d msec\n", shader->no, variant->no,
+                   p_atomic_read(&variant->num_uses),
+                   (int)((os_time_get() - t0) / 1000));
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(opt->function_name); i++)
+      FREE(opt->function_name[i]);
+   FREE(opt->linear_function_name);
+   FREE(opt);
+}
+
+
+static void
+optimize_variant_job_cleanup(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_optimize_job *job = data;
+
+   ralloc_free(job->nir);
+   FREE(job);
+}
+
+
+/**
+ * Queue the optimized build of a fast compiled variant.  Called once per
+ * variant, from the context thread or, for background compiles, from the
+ * compiler thread.
+ */
+static void
+queue_optimize_variant(struct llvmpipe_context *lp,
+                       struct lp_fragment_shader_variant *variant)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fs_optimize_job *job = CALLOC_STRUCT(lp_fs_optimize_job);
+   if (!job)
+      return;
+
+   /* The shader's NIR may get lowered in place by synchronous compiles on
+    * the context thread, so the job gets its own copy.
+    */
+   job->lp = lp;
+   job->variant = variant;
+   job->nir = nir_shader_clone(NULL, variant->shader->base.ir.nir);
+   lp_fs_get_ir_cache_key(variant, job->ir_sha1_cache_key);
+
+   LP_COUNT(nr_fs_variants_optimized);
+   util_queue_add_job(&screen->fs_optimize_queue, job,
+                      &variant->optimize_fence,
+                      optimize_variant_job, optimize_variant_job_cleanup, 0);
+}
+
+
+/**
+ * Note that a scene is using the variant, and queue the optimized build
+ * of a fast compiled one once it has been used often enough.  Called from
+ * the context's thread when the scene is flushed, with the variant's
+ * background compile possibly still running.
+ */
+void
+llvmpipe_fs_variant_used(struct llvmpipe_context *lp,
+                         struct lp_fragment_shader_variant *variant)
+{
+   /* Account for background compiles which are done already */
+   if (variant->compile_pending &&
+       util_queue_fence_is_signalled(&variant->compile_fence))
+      llvmpipe_fs_variant_wait(lp, variant);
+
+   if (!variant->fast_compiled || variant->optimize_when_ready ||
+       p_atomic_inc_return(&variant->num_uses) != LP_FS_OPTIMIZE_USES)
+      return;
+
+   queue_optimize_variant(lp, variant);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
@@ -3784,26 +4132,69 @@ generate_variant(struct llvmpipe_context *lp,
    memcpy(&variant->key, key, shader->variant_key_size);
 
    struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
-   struct lp_cached_code cached = { 0 };
-   unsigned char ir_sha1_cache_key[20];
-   bool needs_caching = false;
+   const bool async = util_queue_is_initialized(&screen->fs_compile_queue);
+   struct lp_fs_compile_job sync_job;
+   struct lp_fs_compile_job *job = async ? CALLOC_STRUCT(lp_fs_compile_job)
+                                         : &sync_job;
+   if (!job) {
+      lp_fs_reference(lp, &variant->shader, NULL);
+      FREE(variant);
+      return NULL;
+   }
+
+   memset(job, 0, sizeof(*job));
+   job->lp = lp;
+   job->variant = variant;
+
    if (shader->base.ir.nir) {
-      lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
+      lp_fs_get_ir_cache_key(variant, job->ir_sha1_cache_key);
 
-      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
-      if (!cached.data_size)
-         needs_caching = true;
+      lp_disk_cache_find_shader(screen, &job->cached, job->ir_sha1_cache_key);
+      if (!job->cached.data_size)
+         job->needs_caching = true;
+   }
+
+   /* Code from the disk cache is optimized already, and fast compiled
+    * code is only cached once it has been optimized.  llvmpipe has no
+    * code which could stand in for a variant, every bit of the key is
+    * compiled into it, so background compiles build the fast code first
+    * for the scenes which wait for them, unless the variants are tiered
+    * anyway.
+    */
+   if (util_queue_is_initialized(&screen->fs_optimize_queue) &&
+       job->needs_caching) {
+      variant->fast_compiled = true;
+      variant->optimize_when_ready =
+         async && !(gallivm_get_perf_flags() & GALLIVM_PERF_TIERED);
+      job->needs_caching = false;
    }
 
+   /* A background compile gets its own LLVM context, the context's one
+    * is only safe to use from this thread.
+    */
+   if (async)
+      lp_context_create(&variant->context);
+
    char module_name[64];
    snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
             shader->no, shader->variants_created);
-   variant->gallivm = gallivm_create(module_name, &lp->context, &cached);
+   variant->gallivm = gallivm_create(module_name,
+                                     async ? &variant->context : &lp->context,
+                                     &job->cached);
    if (!variant->gallivm) {
+      lp_context_destroy(&variant->context);
+      lp_fs_reference(lp, &variant->shader, NULL);
+      if (async)
+         FREE(job);
       FREE(variant);
       return NULL;
    }
 
+   variant->gallivm->fast_compile = variant->fast_compiled;
+
+   util_queue_fence_init(&variant->compile_fence);
+   util_queue_fence_init(&variant->optimize_fence);
+
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
@@ -3893,122 +4284,108 @@ generate_variant(struct llvmpipe_context *lp,
       }
    }
 
+   /* Hierarchical depth, see lp_hiz.h.  Depth only ever goes down with a
+    * LESS/LEQUAL test, which is what keeps the bounds valid.  Dropping
+    * fragments which fail it is only invisible if the test would have
+    * run before the shader and failing fragments have no other effect,
+    * and lowering a bound needs every covered fragment to reach the
+    * depth write.
+    */
+   const bool depth_lowers = key->depth.enabled &&
+      (key->depth.func == PIPE_FUNC_LESS ||
+       key->depth.func == PIPE_FUNC_LEQUAL);
+   const bool early_depth =
+      !key->stencil[0].enabled &&
+      !key->depth_clamp &&
+      !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_DEPTH)) &&
+      !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_STENCIL)) &&
+      !nir->info.fs.uses_fbfetch_output &&
+      !nir->info.writes_memory;
+
+   if (!(LP_PERF & PERF_NO_HIZ)) {
+      variant->hiz_cull = depth_lowers && early_depth;
+      variant->hiz_update =
+         depth_lowers && early_depth &&
+         key->depth.writemask &&
+         !key->alpha.enabled &&
+         !key->multisample &&
+         !key->blend.alpha_to_coverage &&
+         !nir->info.fs.uses_discard &&
+         !(nir->info.outputs_written & BITFIELD64_BIT(FRAG_RESULT_SAMPLE_MASK));
+   }
+   variant->hiz_invalidate =
+      key->depth.enabled && key->depth.writemask &&
+      key->depth.func != PIPE_FUNC_NEVER &&
+      key->depth.func != PIPE_FUNC_EQUAL &&
+      !depth_lowers;
+   variant->hiz_clamp = key->restrict_depth_values;
+   if (key->depth.enabled) {
+      const unsigned bits =
+         util_format_get_component_bits(key->zsbuf_format,
+                                        UTIL_FORMAT_COLORSPACE_ZS, 0);
+      /* Two steps of unorm depth, to also absorb the float rounding of the
+       * conversion.
+       */
+      variant->hiz_margin = util_format_is_float(key->zsbuf_format) ?
+         0.0f : 2.0f / ((1ull << bits) - 1);
+   }
+
    /* Determine whether this shader + pipeline state is a candidate for
     * the linear path.
     */
-   const bool linear_pipeline =
+   job->linear_pipeline =
          !key->stencil[0].enabled &&
          !key->depth.enabled &&
          !nir->info.fs.uses_discard &&
          !key->blend.logicop_enable &&
-         (key->cbuf_format[0] == PIPE_FORMAT_B8G8R8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_B8G8R8X8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_R8G8B8A8_UNORM ||
-          key->cbuf_format[0] == PIPE_FORMAT_R8G8B8X8_UNORM);
+         lp_linear_cbuf_format(key->cbuf_format[0]);
 
    memcpy(&variant->key, key, sizeof *key);
 
+   /* The fastpaths write 8888 pixels directly. */
+   job->linear_fastpath =
+         !lp_linear_staged_format(key->cbuf_format[0]) &&
+         fullcolormask &&
+         !key->alpha.enabled &&
+         !key->blend.alpha_to_coverage;
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
 
-   llvmpipe_fs_variant_fastpath(variant);
-
-   lp_jit_init_types(variant);
-
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   if (linear_pipeline) {
-      /* Currently keeping both the old fastpaths and new linear path
-       * active.  The older code is still somewhat faster for the cases
-       * it covers.
-       *
-       * XXX: consider restricting this to aero-mode only.
-       */
-      if (fullcolormask &&
-          !key->alpha.enabled &&
-          !key->blend.alpha_to_coverage) {
-         llvmpipe_fs_variant_linear_fastpath(variant);
-      }
-
-      /* If the original fastpath doesn't cover this variant, try the new
-       * code:
+   if (async) {
+      /* The rasterizer waits for the fence before running the scene, see
+       * lp_scene_wait_frag_shaders(), so the draw can be binned right away.
        */
-      if (variant->jit_linear == NULL) {
-         if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
-             shader->kind == LP_FS_KIND_BLIT_RGB1 ||
-             shader->kind == LP_FS_KIND_LLVM_LINEAR) {
-            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
-         }
-      }
+      variant->compile_pending = true;
+      p_atomic_inc(&screen->num_fs_compiles_pending);
+      util_queue_add_job(&screen->fs_compile_queue, job,
+                         &variant->compile_fence,
+                         compile_variant_job, compile_variant_job_cleanup, 0);
    } else {
-      if (LP_DEBUG & DEBUG_LINEAR) {
-         lp_debug_fs_variant(variant);
-         debug_printf("    ----> no linear path for this variant\n");
-      }
+      compile_variant(job, shader->base.ir.nir);
    }
 
-   /*
-    * Compile everything
-    */
-
-#if GALLIVM_USE_ORCJIT
-/* module has been moved into ORCJIT after gallivm_compile_module */
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-
-   gallivm_compile_module(variant->gallivm);
-#else
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-#endif
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST],
-                                 variant->function_name[RAST_EDGE_TEST]);
-   }
+   return variant;
+}
 
-   if (variant->function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-         gallivm_jit_function(variant->gallivm,
-                              variant->function[RAST_WHOLE],
-                              variant->function_name[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-         variant->jit_function[RAST_EDGE_TEST];
-   }
 
-   if (linear_pipeline) {
-      if (variant->linear_function) {
-         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
-            gallivm_jit_function(variant->gallivm, variant->linear_function,
-                                 variant->linear_function_name);
-      }
+static uint32_t
+fs_variant_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, lp_fs_variant_key_size_from_key(key));
+}
 
-      /*
-       * This must be done after LLVM compilation, as it will call the JIT'ed
-       * code to determine active inputs.
-       */
-      lp_linear_check_variant(variant);
-   }
 
-   if (needs_caching) {
-      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
-   }
+static bool
+fs_variant_key_equal(const void *a, const void *b)
+{
+   const size_t size = lp_fs_variant_key_size_from_key(a);
 
-   gallivm_free_ir(variant->gallivm);
+   LP_COUNT(nr_fs_variant_probes);
 
-   return variant;
+   return size == lp_fs_variant_key_size_from_key(b) &&
+          memcmp(a, b, size) == 0;
 }
 
 
@@ -4025,6 +4402,12 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
    pipe_reference_init(&shader->reference, 1);
    shader->no = fs_no++;
    list_inithead(&shader->variants.list);
+   shader->variants_ht = _mesa_hash_table_create(NULL, fs_variant_key_hash,
+                                                 fs_variant_key_equal);
+   if (!shader->variants_ht) {
+      FREE(shader);
+      return NULL;
+   }
 
    shader->base.type = PIPE_SHADER_IR_NIR;
 
@@ -4046,6 +4429,7 @@ llvmpipe_create_fs_state(struct pipe_context *pipe,
 
    shader->draw_data = draw_create_fragment_shader(llvmpipe->draw, templ);
    if (shader->draw_data == NULL) {
+      _mesa_hash_table_destroy(shader->variants_ht, NULL);
       FREE(shader);
       return NULL;
    }
@@ -4142,6 +4526,8 @@ static void
 llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                                struct lp_fragment_shader_variant *variant)
 {
+   llvmpipe_fs_variant_wait(lp, variant);
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
                    "v total cached %u inst %u total inst %u\n",
@@ -4153,6 +4539,7 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 
    /* remove from shader's list */
    list_del(&variant->list_item_local.list);
+   _mesa_hash_table_remove_key(variant->shader->variants_ht, &variant->key);
    variant->shader->variants_cached--;
 
    /* remove from context's list */
@@ -4162,11 +4549,57 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 }
 
 
+/**
+ * Wait for a background compile of the variant to finish, from any
+ * thread.  The rasterizer calls this before running a scene, so that
+ * flushing doesn't stall the context's thread.
+ */
+void
+llvmpipe_fs_variant_wait_compile(struct llvmpipe_context *lp,
+                                 struct lp_fragment_shader_variant *variant)
+{
+   if (util_queue_fence_is_signalled(&variant->compile_fence))
+      return;
+
+   int64_t t0 = os_time_get();
+   util_queue_fence_wait(&variant->compile_fence);
+   int64_t dt = os_time_get() - t0;
+   p_atomic_add(&lp->fs_compile_stall_time, dt);
+   LP_COUNT_ADD(fs_compile_stall_time, dt);
+}
+
+
+/**
+ * Wait for a background compile of the variant to finish, and account for
+ * its instructions.  Must be called from the context's thread.
+ */
+void
+llvmpipe_fs_variant_wait(struct llvmpipe_context *lp,
+                         struct lp_fragment_shader_variant *variant)
+{
+   if (!variant->compile_pending)
+      return;
+
+   llvmpipe_fs_variant_wait_compile(lp, variant);
+
+   variant->compile_pending = false;
+   lp->nr_fs_instrs += variant->nr_instrs;
+}
+
+
 void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
+   util_queue_fence_wait(&variant->compile_fence);
+   util_queue_fence_destroy(&variant->compile_fence);
+   util_queue_fence_wait(&variant->optimize_fence);
+   util_queue_fence_destroy(&variant->optimize_fence);
    gallivm_destroy(variant->gallivm);
+   lp_context_destroy(&variant->context);
+   if (variant->gallivm_opt)
+      gallivm_destroy(variant->gallivm_opt);
+   lp_context_destroy(&variant->context_opt);
    lp_fs_reference(lp, &variant->shader, NULL);
    if (variant->function_name[RAST_EDGE_TEST])
       FREE(variant->function_name[RAST_EDGE_TEST]);
@@ -4187,6 +4620,7 @@ llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
 
    ralloc_free(shader->base.ir.nir);
    assert(shader->variants_cached == 0);
+   _mesa_hash_table_destroy(shader->variants_ht, NULL);
    FREE(shader);
 }
 
@@ -4690,24 +5124,24 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
    char store[LP_FS_MAX_VARIANT_KEY_SIZE];
    const struct lp_fragment_shader_variant_key *key =
       make_variant_key(lp, shader, store);
+   assert(lp_fs_variant_key_size_from_key(key) == shader->variant_key_size);
 
    struct lp_fragment_shader_variant *variant = NULL;
-   struct lp_fs_variant_list_item *li;
-   /* Search the variants for one which matches the key */
-   LIST_FOR_EACH_ENTRY(li, &shader->variants.list, list) {
-      if (memcmp(&li->base->key, key, shader->variant_key_size) == 0) {
-         variant = li->base;
-         break;
-      }
-   }
+   struct hash_entry *entry =
+      _mesa_hash_table_search(shader->variants_ht, key);
+   if (entry)
+      variant = entry->data;
 
    if (variant) {
+      LP_COUNT(nr_fs_variant_hits);
+
       /* Move this variant to the head of the list to implement LRU
        * deletion of shader's when we have too many.
        */
       list_move_to(&variant->list_item_global.list, &lp->fs_variants_list.list);
    } else {
       /* variant not found, create it now */
+      LP_COUNT(nr_fs_variant_misses);
 
       if (LP_DEBUG & DEBUG_FS) {
          debug_printf("%u variants,\t%u instrs,\t%u instrs/variant\n",
@@ -4770,9 +5204,11 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       /* Put the new variant into the list */
       if (variant) {
          list_add(&variant->list_item_local.list, &shader->variants.list);
+         _mesa_hash_table_insert(shader->variants_ht, &variant->key, variant);
          list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
+         if (!variant->compile_pending)
+            lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
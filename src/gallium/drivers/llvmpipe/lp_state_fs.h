@@ -32,6 +32,8 @@
 
 #include "util/list.h"
 #include "util/compiler.h"
+#include "util/hash_table.h"
+#include "util/u_queue.h"
 #include "pipe/p_state.h"
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_jit_sample.h"
@@ -111,6 +113,14 @@ lp_fs_variant_key_size(unsigned nr_samplers, unsigned nr_images)
            nr_images * sizeof(struct lp_image_static_state));
 }
 
+/* The size is the same for all the variant keys of a given shader */
+static inline size_t
+lp_fs_variant_key_size_from_key(const struct lp_fragment_shader_variant_key *key)
+{
+   return lp_fs_variant_key_size(MAX2(key->nr_samplers, key->nr_sampler_views),
+                                 key->nr_images);
+}
+
 static inline struct lp_sampler_static_state *
 lp_fs_variant_key_samplers(const struct lp_fragment_shader_variant_key *key)
 {
@@ -151,6 +161,19 @@ struct lp_fragment_shader_variant
    unsigned opaque:1;
    unsigned blit:1;
    unsigned linear_input_mask:16;
+
+   /*
+    * Interaction with the hierarchical depth bounds, see lp_hiz.h:
+    * hiz_cull - primitives may be dropped where they fail the depth test
+    * hiz_update - fully covered areas lower the bounds
+    * hiz_invalidate - depth values may be raised
+    * hiz_clamp - fragment depth is clamped to [0, 1]
+    */
+   unsigned hiz_cull:1;
+   unsigned hiz_update:1;
+   unsigned hiz_invalidate:1;
+   unsigned hiz_clamp:1;
+   float hiz_margin;  /**< depth buffer precision */
    struct pipe_reference reference;
 
    struct gallivm_state *gallivm;
@@ -187,6 +210,32 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* Background compilation (LP_ASYNC_COMPILE).  The variant owns its
+    * LLVM context in that case so the compiler thread doesn't share one
+    * with the draw thread.  compile_pending is only touched by the
+    * context thread and is cleared once it has waited for the fence.
+    */
+   lp_context_ref context;
+   struct util_queue_fence compile_fence;
+   bool compile_pending;
+
+   /* Tiered compilation (GALLIVM_PERF=tiered).  fast_compiled variants
+    * were built with minimal optimization.  Once enough scenes have used
+    * one it gets rebuilt at full optimization on the screen's optimize
+    * queue, in gallivm_opt with its own LLVM context, and the
+    * jit_function pointers are swapped over to the new code.
+    *
+    * Background compiles (without GALLIVM_PERF=tiered) are fast compiled
+    * as well, to get the scenes waiting for them going sooner, and queue
+    * the rebuild as soon as they are done: optimize_when_ready.
+    */
+   bool fast_compiled;
+   bool optimize_when_ready;
+   unsigned num_uses;  /**< scenes which used the variant, atomic */
+   struct gallivm_state *gallivm_opt;
+   lp_context_ref context_opt;
+   struct util_queue_fence optimize_fence;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -211,6 +260,9 @@ struct lp_fragment_shader
 
    struct lp_fs_variant_list_item variants;
 
+   /* Variants indexed by their key */
+   struct hash_table *variants_ht;
+
    struct draw_fragment_shader *draw_data;
 
    /* For debugging/profiling purposes */
@@ -247,6 +299,56 @@ lp_debug_fs_kind(enum lp_fs_kind kind);
 void
 lp_linear_check_variant(struct lp_fragment_shader_variant *variant);
 
+
+/**
+ * Color buffer formats the linear path works with.  8888 formats are
+ * shaded in place, the others go through an RGBA8 staging row, see
+ * lp_linear_staged_format().
+ */
+static inline bool
+lp_linear_cbuf_format(enum pipe_format format)
+{
+   switch (format) {
+   case PIPE_FORMAT_B8G8R8A8_UNORM:
+   case PIPE_FORMAT_B8G8R8X8_UNORM:
+   case PIPE_FORMAT_R8G8B8A8_UNORM:
+   case PIPE_FORMAT_R8G8B8X8_UNORM:
+   case PIPE_FORMAT_B5G6R5_UNORM:
+   case PIPE_FORMAT_A8_UNORM:
+   case PIPE_FORMAT_R8_UNORM:
+      return true;
+   default:
+      return false;
+   }
+}
+
+
+/**
+ * Whether the linear path shades the color buffer format into an RGBA8
+ * staging row and converts it back afterwards, rather than working on the
+ * color buffer directly.  None of these have more than 8 bits per channel,
+ * so nothing is lost on the way.
+ */
+static inline bool
+lp_linear_staged_format(enum pipe_format format)
+{
+   return format == PIPE_FORMAT_B5G6R5_UNORM ||
+          format == PIPE_FORMAT_A8_UNORM ||
+          format == PIPE_FORMAT_R8_UNORM;
+}
+
+
+/**
+ * Whether the linear path works in RGBA rather than BGRA channel order.
+ */
+static inline bool
+lp_linear_rgba_order(enum pipe_format format)
+{
+   return format == PIPE_FORMAT_R8G8B8A8_UNORM ||
+          format == PIPE_FORMAT_R8G8B8X8_UNORM ||
+          lp_linear_staged_format(format);
+}
+
 void
 llvmpipe_destroy_fs(struct llvmpipe_context *llvmpipe,
                     struct lp_fragment_shader *shader);
@@ -268,6 +370,23 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant);
 
+void
+llvmpipe_fs_variant_wait_compile(struct llvmpipe_context *lp,
+                                 struct lp_fragment_shader_variant *variant);
+
+void
+llvmpipe_fs_variant_wait(struct llvmpipe_context *lp,
+                         struct lp_fragment_shader_variant *variant);
+
+/* Scenes a fast compiled variant has to be used in before it gets
+ * optimized.
+ */
+#define LP_FS_OPTIMIZE_USES 8
+
+void
+llvmpipe_fs_variant_used(struct llvmpipe_context *lp,
+                         struct lp_fragment_shader_variant *variant);
+
 static inline void
 lp_fs_variant_reference(struct llvmpipe_context *llvmpipe,
                         struct lp_fragment_shader_variant **ptr,
@@ -152,21 +152,26 @@ get_texcoord_provenance(const nir_tex_src *texcoord,
 {
    assert(texcoord->src_type == nir_tex_src_coord);
 
-   // The parent instr of the coord should be an nir_op_vec2 alu op
+   // The parent instr of the coord should be an nir_op_vec2 alu op, or
+   // a two-component nir_op_mov swizzling a single input (as TGSI
+   // shaders sampling with the .xy of a vec4 input come out).
    const nir_instr *parent = texcoord->src.ssa->parent_instr;
    if (!parent || parent->type != nir_instr_type_alu) {
       return false;
    }
    const nir_alu_instr *alu = nir_instr_as_alu(parent);
-   if (!alu || alu->op != nir_op_vec2) {
+   if (!alu || (alu->op != nir_op_vec2 && alu->op != nir_op_mov) ||
+       alu->def.num_components != 2) {
       return false;
    }
 
-   // Loop over nir_op_vec2 instruction arguments to find the
-   // input register index and component.
+   // Loop over the texcoord components to find the input register
+   // index and component of each.
    unsigned input_reg_indexes[2];
    for (unsigned comp = 0; comp < 2; comp++) {
-      if (!get_nir_input_info(&alu->src[comp],
+      nir_alu_src src = alu->src[alu->op == nir_op_mov ? 0 : comp];
+      src.swizzle[0] = src.swizzle[alu->op == nir_op_mov ? comp : 0];
+      if (!get_nir_input_info(&src,
                               &input_reg_indexes[comp], &swizzle[comp])) {
          return false;
       }
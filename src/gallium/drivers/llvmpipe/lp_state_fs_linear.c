@@ -97,8 +97,9 @@ struct shader {
  * already been performed.  This routine then purely implements
  * blending.
  */
-static void
-blend_premul(struct color_blend *blend)
+static ALWAYS_INLINE void
+blend_row(struct color_blend *blend,
+          __m128i (*blend4)(const __m128i src, const __m128i dst))
 {
    const uint32_t *src = blend->src;  /* aligned */
    uint32_t *dst = (uint32_t *)blend->color;      /* unaligned */
@@ -111,8 +112,7 @@ blend_premul(struct color_blend *blend)
    for (i = 0; i + 3 < width; i += 4) {
       __m128i tmp;
       tmp = _mm_loadu_si128((const __m128i *)&dst[i]);  /* UNALIGNED READ */
-      dstreg.m128 = util_sse2_blend_premul_4(*(const __m128i *)&src[i],
-                                             tmp);
+      dstreg.m128 = blend4(*(const __m128i *)&src[i], tmp);
       _mm_storeu_si128((__m128i *)&dst[i], dstreg.m128); /* UNALIGNED WRITE */
    }
 
@@ -121,14 +121,30 @@ blend_premul(struct color_blend *blend)
       for (j = 0; j < width - i ; j++) {
          dstreg.ui[j] = dst[i+j];
       }
-      dstreg.m128 = util_sse2_blend_premul_4(*(const __m128i *)&src[i],
-                                             dstreg.m128);
+      dstreg.m128 = blend4(*(const __m128i *)&src[i], dstreg.m128);
       for (; i < width; i++)
          dst[i] = dstreg.ui[i&3];
    }
 }
 
 
+static void
+blend_premul(struct color_blend *blend)
+{
+   blend_row(blend, util_sse2_blend_premul_4);
+}
+
+
+/* As above, but for add/src_alpha/inv_src_alpha (ie non-premultiplied
+ * alpha) blending.
+ */
+static void
+blend_srcalpha(struct color_blend *blend)
+{
+   blend_row(blend, util_sse2_blend_srcalpha_4);
+}
+
+
 static void
 blend_noop(struct color_blend *blend)
 {
@@ -573,6 +589,46 @@ blit_rgba_blend_premul(const struct lp_rast_state *state,
 }
 
 
+/* Linear shader variant implementing the BLIT_RGBA shader with
+ * src_alpha/inv_src_alpha blending.
+ */
+static bool
+blit_rgba_blend_srcalpha(const struct lp_rast_state *state,
+                         unsigned x, unsigned y,
+                         unsigned width, unsigned height,
+                         const float (*a0)[4],
+                         const float (*dadx)[4],
+                         const float (*dady)[4],
+                         uint8_t *color,
+                         unsigned stride)
+{
+   const struct lp_jit_resources *resources = &state->jit_resources;
+   struct nearest_sampler samp;
+   struct color_blend blend;
+
+   LP_DBG(DEBUG_RAST, "%s\n", __func__);
+
+   if (!init_nearest_sampler(&samp,
+                             &resources->textures[0],
+                             x, y, width, height,
+                             a0[1][0], dadx[1][0], dady[1][0],
+                             a0[1][1], dadx[1][1], dady[1][1],
+                             a0[0][3], dadx[0][3], dady[0][3]))
+      return false;
+
+   init_blend(&blend, x, y, width, height, color, stride);
+
+   /* Rasterize the rectangle and run the shader:
+    */
+   for (y = 0; y < height; y++) {
+      blend.src = samp.fetch(&samp);
+      blend_srcalpha(&blend);
+   }
+
+   return true;
+}
+
+
 /* Linear shader which always emits red.  Used for debugging.
  */
 static bool
@@ -637,6 +693,25 @@ is_one_inv_src_alpha_blend(const struct lp_fragment_shader_variant *variant)
 }
 
 
+/* Check for ADD/SRC_ALPHA/INV_SRC_ALPHA, ie non-premultiplied alpha
+ * blending, on all channels.
+ */
+static bool
+is_src_alpha_inv_src_alpha_blend(const struct lp_fragment_shader_variant *variant)
+{
+   return
+      !variant->key.blend.logicop_enable &&
+      variant->key.blend.rt[0].blend_enable &&
+      variant->key.blend.rt[0].rgb_func == PIPE_BLEND_ADD &&
+      variant->key.blend.rt[0].rgb_src_factor == PIPE_BLENDFACTOR_SRC_ALPHA &&
+      variant->key.blend.rt[0].rgb_dst_factor == PIPE_BLENDFACTOR_INV_SRC_ALPHA &&
+      variant->key.blend.rt[0].alpha_func == PIPE_BLEND_ADD &&
+      variant->key.blend.rt[0].alpha_src_factor == PIPE_BLENDFACTOR_SRC_ALPHA &&
+      variant->key.blend.rt[0].alpha_dst_factor == PIPE_BLENDFACTOR_INV_SRC_ALPHA &&
+      variant->key.blend.rt[0].colormask == 0xf;
+}
+
+
 /* Examine the fragment shader variant and determine whether we can
  * substitute a fastpath linear shader implementation.
  */
@@ -663,6 +738,9 @@ llvmpipe_fs_variant_linear_fastpath(struct lp_fragment_shader_variant *variant)
       } else if (is_one_inv_src_alpha_blend(variant) &&
                  util_get_cpu_caps()->has_sse2) {
          variant->jit_linear = blit_rgba_blend_premul;
+      } else if (is_src_alpha_inv_src_alpha_blend(variant) &&
+                 util_get_cpu_caps()->has_sse2) {
+         variant->jit_linear = blit_rgba_blend_srcalpha;
       }
       return;
    }
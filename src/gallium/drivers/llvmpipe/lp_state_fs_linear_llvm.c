@@ -142,8 +142,7 @@ llvm_fragment_body(struct lp_build_context *bld,
    LLVMBuilderRef builder = bld->gallivm->builder;
    struct gallivm_state *gallivm = bld->gallivm;
    LLVMValueRef result = NULL;
-   bool rgba_order = (variant->key.cbuf_format[0] == PIPE_FORMAT_R8G8B8A8_UNORM ||
-                      variant->key.cbuf_format[0] == PIPE_FORMAT_R8G8B8X8_UNORM);
+   bool rgba_order = lp_linear_rgba_order(variant->key.cbuf_format[0]);
    struct nir_shader *nir = shader->base.ir.nir;
    sampler->instance = 0;
 
@@ -0,0 +1,603 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+
+/**
+ * @file
+ * Order in which the rasterizer threads pick up the bins, and their size.
+ *
+ * Renders a fill bound scene with very uneven per-tile cost, a stack of
+ * blended quads over one corner of the framebuffer on top of a few blended
+ * full-screen layers and scattered small quads, at 1080p, 4K and in wide
+ * and tall strips, for 1 to N threads.  Sparse scenes of just the full-screen layers or just the
+ * clear, which get 2x2 tile bins, are rendered the same way.  Each frame is
+ * rendered with the bins in raster order (LP_PERF=no_bin_order), in the
+ * default Morton, heaviest-first order and with one tile per bin
+ * (LP_PERF=no_coarse_bins).
+ * Checks the images match and measures the time per frame and the pixel
+ * rate.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "util/os_time.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+/** Blended full-screen layers, which give every tile some work */
+#define NUM_LAYERS 4
+
+/** Blended quads stacked over the bottom right corner */
+#define NUM_HOT_QUADS 64
+
+/** Small blended quads scattered over the framebuffer */
+#define NUM_SMALL_QUADS 256
+
+#define NUM_QUADS (NUM_LAYERS + NUM_HOT_QUADS + NUM_SMALL_QUADS)
+
+
+static const struct {
+   unsigned width;
+   unsigned height;
+} sizes[] = {
+   { 1920, 1080 },
+   { 8192, 64 },
+   { 64, 8192 },
+   { 3840, 2160 },
+};
+
+
+/**
+ * The scenes rendered: the first num_quads quads of the vertex buffer.
+ */
+static const struct {
+   const char *name;
+   unsigned num_quads;
+} workloads[] = {
+   { "hot_corner", NUM_QUADS },
+   { "sparse", NUM_LAYERS },
+   { "clear", 0 },
+};
+
+
+/**
+ * The bin orders and sizes compared.  The first one is the reference image.
+ */
+static const struct {
+   const char *name;
+   int perf;     /**< LP_PERF flags */
+} orders[] = {
+   { "raster", PERF_NO_BIN_ORDER },
+   { "morton", 0 },
+   { "tile_bins", PERF_NO_COARSE_BINS },
+};
+
+#define NUM_ORDERS ARRAY_SIZE(orders)
+
+#define ORDER_PERF_FLAGS (PERF_NO_BIN_ORDER | PERF_NO_COARSE_BINS)
+
+
+struct bin_order_test_state {
+   unsigned width;
+   unsigned height;
+
+   struct pipe_resource *cbuf;
+   struct pipe_resource *vbuf;
+   unsigned num_vertices;
+
+   void *blend;
+   void *dsa;
+   void *rast;
+   void *velems;
+   void *vs;
+   void *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "workload\t"
+           "width\t"
+           "height\t"
+           "threads");
+   for (unsigned o = 0; o < NUM_ORDERS; o++)
+      fprintf(fp, "\tmsecs_%s", orders[o].name);
+   for (unsigned o = 0; o < NUM_ORDERS; o++)
+      fprintf(fp, "\tmpixels_per_sec_%s", orders[o].name);
+   fprintf(fp, "\n");
+
+   fflush(fp);
+}
+
+
+static void
+set_num_threads(unsigned num_threads)
+{
+   char str[16];
+
+   snprintf(str, sizeof str, "%u", num_threads);
+#ifdef _WIN32
+   _putenv_s("LP_NUM_THREADS", str);
+#else
+   setenv("LP_NUM_THREADS", str, 1);
+#endif
+}
+
+
+/** Deterministic pseudo random number in [0, 1) */
+static float
+next_random(uint32_t *seed)
+{
+   *seed = *seed * 1664525u + 1013904223u;
+   return (*seed >> 8) / (float)(1 << 24);
+}
+
+
+/**
+ * Emit the two triangles of a quad, in window coordinates.
+ */
+static float *
+emit_quad(float *v, const struct bin_order_test_state *state,
+          float x0, float y0, float x1, float y1,
+          float r, float g, float b, float a)
+{
+   const float corners[6][2] = {
+      { x0, y0 }, { x1, y0 }, { x0, y1 },
+      { x1, y0 }, { x1, y1 }, { x0, y1 },
+   };
+
+   for (unsigned i = 0; i < 6; i++) {
+      v[0] = corners[i][0] * state->width;
+      v[1] = corners[i][1] * state->height;
+      v[2] = 0.0f;
+      v[3] = 1.0f;
+      v[4] = r;
+      v[5] = g;
+      v[6] = b;
+      v[7] = a;
+      v += 8;
+   }
+
+   return v;
+}
+
+
+static bool
+create_quads(struct pipe_context *pipe, struct bin_order_test_state *state)
+{
+   uint32_t seed = 1;
+
+   state->num_vertices = NUM_QUADS * 6;
+   float *vertices = MALLOC(state->num_vertices * 8 * sizeof(float));
+   if (!vertices)
+      return false;
+
+   float *v = vertices;
+   for (unsigned i = 0; i < NUM_LAYERS; i++) {
+      v = emit_quad(v, state, 0.0f, 0.0f, 1.0f, 1.0f,
+                    i & 1, (i >> 1) & 1, 0.5f, 0.25f);
+   }
+
+   /* Raster order gets to the corner last */
+   for (unsigned i = 0; i < NUM_HOT_QUADS; i++) {
+      const float dx = 0.05f * next_random(&seed);
+      const float dy = 0.05f * next_random(&seed);
+
+      v = emit_quad(v, state, 0.62f + dx, 0.58f + dy,
+                    0.93f + dx, 0.9f + dy,
+                    next_random(&seed), next_random(&seed),
+                    next_random(&seed), 0.125f);
+   }
+
+   for (unsigned i = 0; i < NUM_SMALL_QUADS; i++) {
+      const float x = 0.95f * next_random(&seed);
+      const float y = 0.95f * next_random(&seed);
+      const float w = 0.01f + 0.04f * next_random(&seed);
+      const float h = 0.01f + 0.04f * next_random(&seed);
+
+      v = emit_quad(v, state, x, y, x + w, y + h,
+                    next_random(&seed), next_random(&seed),
+                    next_random(&seed), 0.5f);
+   }
+
+   state->vbuf = pipe_buffer_create_with_data(pipe, PIPE_BIND_VERTEX_BUFFER,
+                                              PIPE_USAGE_IMMUTABLE,
+                                              state->num_vertices * 8 *
+                                              sizeof(float),
+                                              vertices);
+   FREE(vertices);
+
+   return state->vbuf != NULL;
+}
+
+
+static bool
+create_state(struct pipe_context *pipe, struct bin_order_test_state *state,
+             unsigned width, unsigned height)
+{
+   struct pipe_screen *screen = pipe->screen;
+
+   memset(state, 0, sizeof *state);
+   state->width = width;
+   state->height = height;
+
+   struct pipe_resource templ;
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   state->cbuf = screen->resource_create(screen, &templ);
+   if (!state->cbuf || !create_quads(pipe, state))
+      return false;
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = width;
+   fb.height = height;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0].format = state->cbuf->format;
+   fb.cbufs[0].texture = state->cbuf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = width / 2.0f;
+   vp.scale[1] = height / 2.0f;
+   vp.scale[2] = 0.5f;
+   vp.translate[0] = width / 2.0f;
+   vp.translate[1] = height / 2.0f;
+   vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   struct pipe_blend_state blend;
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].blend_enable = 1;
+   blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+   blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+   blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+   blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+   blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   state->blend = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, state->blend);
+
+   struct pipe_depth_stencil_alpha_state dsa;
+   memset(&dsa, 0, sizeof dsa);
+   state->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, state->dsa);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.fill_front = PIPE_POLYGON_MODE_FILL;
+   rast.fill_back = PIPE_POLYGON_MODE_FILL;
+   state->rast = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, state->rast);
+
+   pipe->set_sample_mask(pipe, ~0);
+
+   struct pipe_vertex_element velems[2];
+   memset(velems, 0, sizeof velems);
+   for (unsigned i = 0; i < 2; i++) {
+      velems[i].src_offset = i * 4 * sizeof(float);
+      velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      velems[i].src_stride = 8 * sizeof(float);
+   }
+   state->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, state->velems);
+
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   pipe_resource_reference(&vb.buffer.resource, state->vbuf);
+   pipe->set_vertex_buffers(pipe, 1, &vb);
+
+   const enum tgsi_semantic semantic_names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR
+   };
+   const unsigned semantic_indexes[] = { 0, 0 };
+   state->vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                                   semantic_indexes, true);
+   state->fs =
+      util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_COLOR,
+                                            TGSI_INTERPOLATE_PERSPECTIVE,
+                                            true);
+   if (!state->vs || !state->fs)
+      return false;
+
+   pipe->bind_vs_state(pipe, state->vs);
+   pipe->bind_fs_state(pipe, state->fs);
+
+   return true;
+}
+
+
+static void
+destroy_state(struct pipe_context *pipe, struct bin_order_test_state *state)
+{
+   struct pipe_framebuffer_state fb;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe->set_vertex_buffers(pipe, 0, NULL);
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   if (state->vs)
+      pipe->delete_vs_state(pipe, state->vs);
+   if (state->fs)
+      pipe->delete_fs_state(pipe, state->fs);
+   if (state->velems)
+      pipe->delete_vertex_elements_state(pipe, state->velems);
+   if (state->rast)
+      pipe->delete_rasterizer_state(pipe, state->rast);
+   if (state->dsa)
+      pipe->delete_depth_stencil_alpha_state(pipe, state->dsa);
+   if (state->blend)
+      pipe->delete_blend_state(pipe, state->blend);
+
+   pipe_resource_reference(&state->vbuf, NULL);
+   pipe_resource_reference(&state->cbuf, NULL);
+}
+
+
+static void
+draw_frame(struct pipe_context *pipe, const struct bin_order_test_state *state,
+           unsigned num_quads)
+{
+   struct pipe_screen *screen = pipe->screen;
+   union pipe_color_union color;
+   struct pipe_draw_info info;
+   struct pipe_draw_start_count_bias draw;
+   struct pipe_fence_handle *fence = NULL;
+
+   memset(&color, 0, sizeof color);
+   pipe->clear(pipe, PIPE_CLEAR_COLOR, NULL, &color, 1.0, 0);
+
+   memset(&info, 0, sizeof info);
+   info.mode = MESA_PRIM_TRIANGLES;
+   info.instance_count = 1;
+
+   memset(&draw, 0, sizeof draw);
+   draw.count = num_quads * 6;
+
+   pipe->draw_vbo(pipe, &info, 0, NULL, &draw, 1);
+
+   pipe->flush(pipe, &fence, 0);
+   screen->fence_finish(screen, NULL, fence, OS_TIMEOUT_INFINITE);
+   screen->fence_reference(screen, &fence, NULL);
+}
+
+
+static uint32_t *
+read_image(struct pipe_context *pipe, const struct bin_order_test_state *state)
+{
+   const unsigned width = state->width;
+   const unsigned height = state->height;
+   struct pipe_transfer *transfer;
+   uint32_t *image = MALLOC(width * height * sizeof(uint32_t));
+   const uint8_t *map;
+
+   if (!image)
+      return NULL;
+
+   map = pipe_texture_map(pipe, state->cbuf, 0, 0, PIPE_MAP_READ,
+                          0, 0, width, height, &transfer);
+   if (!map) {
+      FREE(image);
+      return NULL;
+   }
+
+   for (unsigned y = 0; y < height; y++)
+      memcpy(image + y * width, map + y * transfer->stride,
+             width * sizeof(uint32_t));
+
+   pipe_texture_unmap(pipe, transfer);
+
+   return image;
+}
+
+
+/**
+ * Render num_frames frames in each bin order.  The order and bin size are
+ * picked for each scene, so one context does for all of them.
+ */
+static bool
+render_orders(struct pipe_screen *screen, unsigned width, unsigned height,
+              unsigned num_quads, unsigned num_frames,
+              double *msecs, uint32_t **images)
+{
+   struct bin_order_test_state state;
+   const int saved_perf = LP_PERF;
+   const int perf = saved_perf & ~ORDER_PERF_FLAGS;
+   bool success = false;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe)
+      return false;
+
+   if (create_state(pipe, &state, width, height)) {
+      /* Compile the shader variants */
+      draw_frame(pipe, &state, num_quads);
+
+      success = true;
+      for (unsigned o = 0; o < NUM_ORDERS; o++) {
+         LP_PERF = perf | orders[o].perf;
+
+         int64_t t0 = os_time_get_nano();
+         for (unsigned f = 0; f < num_frames; f++)
+            draw_frame(pipe, &state, num_quads);
+         int64_t t1 = os_time_get_nano();
+
+         msecs[o] = (t1 - t0) / 1000000.0 / num_frames;
+
+         images[o] = read_image(pipe, &state);
+         if (!images[o])
+            success = false;
+      }
+
+      LP_PERF = saved_perf;
+   }
+
+   destroy_state(pipe, &state);
+   pipe->destroy(pipe);
+
+   return success;
+}
+
+
+static bool
+test_bin_order(unsigned verbose, FILE *fp, unsigned workload,
+               unsigned num_threads, unsigned width, unsigned height,
+               unsigned num_frames)
+{
+   uint32_t *images[NUM_ORDERS] = { NULL };
+   double msecs[NUM_ORDERS] = { 0.0 };
+   double mpixels[NUM_ORDERS] = { 0.0 };
+   bool success = false;
+
+   /* The number of threads is picked when the screen is set up */
+   set_num_threads(num_threads);
+
+   struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+   if (screen) {
+      success = render_orders(screen, width, height,
+                              workloads[workload].num_quads, num_frames,
+                              msecs, images);
+      screen->destroy(screen);
+   }
+
+   for (unsigned o = 1; success && o < NUM_ORDERS; o++) {
+      if (memcmp(images[0], images[o],
+                 width * height * sizeof(uint32_t)) != 0) {
+         if (verbose < 1)
+            fprintf(stderr, "%s %ux%u threads %u: %s image differs\n",
+                    workloads[workload].name, width, height, num_threads,
+                    orders[o].name);
+         success = false;
+      }
+   }
+
+   for (unsigned o = 0; o < NUM_ORDERS; o++) {
+      if (msecs[o] > 0.0)
+         mpixels[o] = width * height / (msecs[o] * 1000.0);
+   }
+
+   if (verbose >= 1) {
+      printf("%-10s %4ux%-4u threads %3u:", workloads[workload].name,
+             width, height, num_threads);
+      for (unsigned o = 0; o < NUM_ORDERS; o++)
+         printf(" %8.2f ms %7.1f Mpix/s %s", msecs[o], mpixels[o],
+                orders[o].name);
+      printf("  %s\n", success ? "PASS" : "FAIL");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%u\t%u\t%u", success ? "pass" : "fail",
+              workloads[workload].name, width, height, num_threads);
+      for (unsigned o = 0; o < NUM_ORDERS; o++)
+         fprintf(fp, "\t%.2f", msecs[o]);
+      for (unsigned o = 0; o < NUM_ORDERS; o++)
+         fprintf(fp, "\t%.1f", mpixels[o]);
+      fprintf(fp, "\n");
+      fflush(fp);
+   }
+
+   for (unsigned o = 0; o < NUM_ORDERS; o++)
+      FREE(images[o]);
+
+   return success;
+}
+
+
+/**
+ * The number of threads to test up to: the number of CPUs, but at least a
+ * few so that the scheduling gets covered on small machines too.
+ */
+static unsigned
+max_test_threads(void)
+{
+   return MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 4), LP_MAX_THREADS);
+}
+
+
+/**
+ * Render each workload at each framebuffer size with 1, 2, 4, ... threads
+ * up to max_test_threads().
+ */
+static bool
+test_scaling(unsigned verbose, FILE *fp, unsigned num_frames)
+{
+   const unsigned max_threads = max_test_threads();
+   bool success = true;
+
+   for (unsigned w = 0; w < ARRAY_SIZE(workloads); w++) {
+      for (unsigned s = 0; s < ARRAY_SIZE(sizes); s++) {
+         for (unsigned t = 1; ; t = MIN2(t * 2, max_threads)) {
+            if (!test_bin_order(verbose, fp, w, t, sizes[s].width,
+                                sizes[s].height, num_frames))
+               success = false;
+            if (t == max_threads)
+               break;
+         }
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_scaling(verbose, fp, 10);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   /* A couple of frames by default, so this stays quick as a unit test */
+   return test_scaling(verbose, fp, MAX2(n / 500, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_bin_order(verbose, fp, 0, max_test_threads(),
+                         sizes[ARRAY_SIZE(sizes) - 1].width,
+                         sizes[ARRAY_SIZE(sizes) - 1].height, 1);
+}
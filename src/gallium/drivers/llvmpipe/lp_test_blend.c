@@ -731,9 +731,64 @@ test_some(unsigned verbose, FILE *fp,
 }
 
 
+/*
+ * Porter-Duff operators on premultiplied alpha, plus non-premultiplied
+ * source-over, as used by compositors.
+ */
+static const struct {
+   unsigned rgb_src_factor;
+   unsigned rgb_dst_factor;
+   unsigned alpha_src_factor;
+   unsigned alpha_dst_factor;
+} compositor_ops[] = {
+#define PD(src, dst) \
+   { PIPE_BLENDFACTOR_##src, PIPE_BLENDFACTOR_##dst, \
+     PIPE_BLENDFACTOR_##src, PIPE_BLENDFACTOR_##dst }
+   PD(ONE, ZERO),                        /* src */
+   PD(ONE, INV_SRC_ALPHA),               /* src-over */
+   PD(INV_DST_ALPHA, ONE),               /* dst-over */
+   PD(DST_ALPHA, ZERO),                  /* src-in */
+   PD(ZERO, SRC_ALPHA),                  /* dst-in */
+   PD(INV_DST_ALPHA, ZERO),              /* src-out */
+   PD(ZERO, INV_SRC_ALPHA),              /* dst-out */
+   PD(DST_ALPHA, INV_SRC_ALPHA),         /* src-atop */
+   PD(INV_DST_ALPHA, SRC_ALPHA),         /* dst-atop */
+   PD(INV_DST_ALPHA, INV_SRC_ALPHA),     /* xor */
+   PD(ONE, ONE),                         /* add */
+   PD(DST_COLOR, ZERO),                  /* modulate */
+#undef PD
+   { PIPE_BLENDFACTOR_SRC_ALPHA, PIPE_BLENDFACTOR_INV_SRC_ALPHA,
+     PIPE_BLENDFACTOR_ONE, PIPE_BLENDFACTOR_INV_SRC_ALPHA }, /* non-premul over */
+};
+
+
+/*
+ * Compositor blend modes, on both the unorm8 type of the linear path and
+ * the float type of the SoA path.  Run with -o to compare their cost.
+ */
 bool
 test_single(unsigned verbose, FILE *fp)
 {
-   printf("no test_single()");
-   return true;
+   struct pipe_blend_state blend;
+   bool success = true;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(compositor_ops); ++i) {
+      for (const struct lp_type *type = blend_types;
+           type < &blend_types[num_types]; ++type) {
+         memset(&blend, 0, sizeof blend);
+         blend.rt[0].blend_enable      = 1;
+         blend.rt[0].rgb_func          = PIPE_BLEND_ADD;
+         blend.rt[0].rgb_src_factor    = compositor_ops[i].rgb_src_factor;
+         blend.rt[0].rgb_dst_factor    = compositor_ops[i].rgb_dst_factor;
+         blend.rt[0].alpha_func        = PIPE_BLEND_ADD;
+         blend.rt[0].alpha_src_factor  = compositor_ops[i].alpha_src_factor;
+         blend.rt[0].alpha_dst_factor  = compositor_ops[i].alpha_dst_factor;
+         blend.rt[0].colormask         = PIPE_MASK_RGBA;
+
+         if (!test_one(verbose, fp, &blend, *type))
+            success = false;
+      }
+   }
+
+   return success;
 }
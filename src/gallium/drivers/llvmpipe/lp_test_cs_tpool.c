@@ -0,0 +1,183 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+
+/**
+ * @file
+ * Compute thread pool dispatch scaling.
+ *
+ * Checks that every iteration of a dispatch runs exactly once and measures
+ * the time per dispatch for 1 to N worker threads.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/os_time.h"
+
+#include "lp_cs_tpool.h"
+#include "lp_test.h"
+
+
+struct cs_tpool_test_case {
+   unsigned num_iters;  /* workgroups per dispatch */
+   unsigned work;       /* busy loop iterations per workgroup */
+};
+
+
+static const struct cs_tpool_test_case test_cases[] = {
+   {     1,   0 },
+   {     7,   0 },
+   {  4096,   0 },
+   {  4096,  64 },
+   { 65536,   0 },
+   {  1000, 997 },
+};
+
+
+struct cs_tpool_test_data {
+   const struct cs_tpool_test_case *testcase;
+   unsigned *counts;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "threads\t"
+           "iters\t"
+           "work\t"
+           "usecs_per_dispatch\n");
+
+   fflush(fp);
+}
+
+
+static void
+cs_tpool_test_func(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   struct cs_tpool_test_data *test = data;
+   volatile unsigned sink = 0;
+
+   for (unsigned i = 0; i < test->testcase->work; i++)
+      sink += i;
+
+   p_atomic_inc(&test->counts[iter_idx]);
+}
+
+
+static bool
+test_cs_tpool(unsigned verbose, FILE *fp, unsigned num_threads,
+              const struct cs_tpool_test_case *testcase,
+              unsigned num_dispatches)
+{
+   struct lp_cs_tpool *pool = lp_cs_tpool_create(num_threads);
+   struct cs_tpool_test_data test;
+   bool success = true;
+
+   if (!pool)
+      return false;
+
+   test.testcase = testcase;
+   test.counts = CALLOC(testcase->num_iters, sizeof(*test.counts));
+   if (!test.counts) {
+      lp_cs_tpool_destroy(pool);
+      return false;
+   }
+
+   int64_t t0 = os_time_get_nano();
+   for (unsigned d = 0; d < num_dispatches; d++) {
+      struct lp_cs_tpool_task *task =
+         lp_cs_tpool_queue_task(pool, cs_tpool_test_func, &test,
+                                testcase->num_iters);
+      lp_cs_tpool_wait_for_task(pool, &task);
+   }
+   int64_t t1 = os_time_get_nano();
+
+   for (unsigned i = 0; i < testcase->num_iters; i++) {
+      if (test.counts[i] != num_dispatches) {
+         if (verbose < 1)
+            fprintf(stderr, "threads %u iters %u: iteration %u ran %u times, "
+                    "expected %u\n", num_threads, testcase->num_iters, i,
+                    test.counts[i], num_dispatches);
+         success = false;
+         break;
+      }
+   }
+
+   const double usecs = (t1 - t0) / 1000.0 / num_dispatches;
+
+   if (verbose >= 1) {
+      printf("threads %3u iters %6u work %4u: %10.2f us/dispatch  %s\n",
+             num_threads, testcase->num_iters, testcase->work, usecs,
+             success ? "PASS" : "FAIL");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%u\t%u\t%.2f\n", success ? "pass" : "fail",
+              num_threads, testcase->num_iters, testcase->work, usecs);
+      fflush(fp);
+   }
+
+   FREE(test.counts);
+   lp_cs_tpool_destroy(pool);
+
+   return success;
+}
+
+
+/**
+ * Run every test case with 1, 2, 4, ... threads up to the number of CPUs.
+ */
+static bool
+test_scaling(unsigned verbose, FILE *fp, unsigned num_dispatches)
+{
+   const unsigned max_threads =
+      MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 1), LP_MAX_CS_THREADS);
+   bool success = true;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_cases); i++) {
+      for (unsigned t = 1; ; t = MIN2(t * 2, max_threads)) {
+         if (!test_cs_tpool(verbose, fp, t, &test_cases[i], num_dispatches))
+            success = false;
+         if (t == max_threads)
+            break;
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_scaling(verbose, fp, 1000);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_scaling(verbose, fp, MAX2(n / 10, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   const unsigned max_threads =
+      MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 1), LP_MAX_CS_THREADS);
+
+   return test_cs_tpool(verbose, fp, max_threads, &test_cases[2], 100);
+}
@@ -0,0 +1,594 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+
+/**
+ * @file
+ * Tiered fragment shader compilation (GALLIVM_PERF=tiered).
+ *
+ * Renders a few triangles with a handful of blend, depth, alpha test and
+ * color buffer states.  With tiered compilation, the variants must be
+ * fast compiled at first, be left alone until they have been used in
+ * LP_FS_OPTIMIZE_USES scenes, and then get rebuilt at full optimization.
+ * The images drawn with the fast and with the optimized code must both
+ * match the one drawn by a screen without tiered compilation.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "util/format/u_format.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "util/os_time.h"
+#include "sw/null/null_sw_winsys.h"
+#include "gallivm/lp_bld_debug.h"
+
+#include "lp_context.h"
+#include "lp_limits.h"
+#include "lp_public.h"
+#include "lp_screen.h"
+#include "lp_state_fs.h"
+#include "lp_test.h"
+
+
+#define WIDTH  256
+#define HEIGHT 256
+
+#define NUM_TRIS 4
+
+
+/**
+ * The states the triangles are drawn with, each of which gets a fragment
+ * shader variant of its own.
+ */
+static const struct {
+   const char *name;
+   enum pipe_format cbuf_format;
+   bool blend;
+   bool depth;
+   bool alpha_test;
+} cases[] = {
+   { "opaque", PIPE_FORMAT_B8G8R8A8_UNORM, false, false, false },
+   { "blend", PIPE_FORMAT_B8G8R8A8_UNORM, true, false, false },
+   { "depth", PIPE_FORMAT_B8G8R8A8_UNORM, false, true, false },
+   { "alpha_test", PIPE_FORMAT_B8G8R8A8_UNORM, false, true, true },
+   { "float_blend", PIPE_FORMAT_R32G32B32A32_FLOAT, true, false, false },
+};
+
+
+/**
+ * Position and color of the triangles' vertices, in window coordinates.
+ * The first two cover the whole framebuffer, the others only parts of
+ * some tiles.
+ */
+static const float vertices[NUM_TRIS * 3][8] = {
+   {    0.0f,    0.0f, 0.5f, 1.0f,   0.1f, 0.2f, 0.9f, 1.0f },
+   { WIDTH,      0.0f, 0.5f, 1.0f,   0.9f, 0.2f, 0.1f, 1.0f },
+   {    0.0f, HEIGHT,  0.5f, 1.0f,   0.2f, 0.9f, 0.3f, 1.0f },
+
+   { WIDTH,      0.0f, 0.5f, 1.0f,   0.9f, 0.2f, 0.1f, 1.0f },
+   { WIDTH,   HEIGHT,  0.5f, 1.0f,   0.7f, 0.7f, 0.7f, 1.0f },
+   {    0.0f, HEIGHT,  0.5f, 1.0f,   0.2f, 0.9f, 0.3f, 1.0f },
+
+   {   13.0f,   21.0f, 0.2f, 1.0f,   1.0f, 0.0f, 0.0f, 0.0f },
+   {  241.5f,   60.0f, 0.8f, 1.0f,   0.0f, 1.0f, 0.0f, 0.6f },
+   {   90.0f,  230.3f, 0.4f, 1.0f,   0.0f, 0.0f, 1.0f, 1.0f },
+
+   {  200.0f,  140.0f, 0.1f, 1.0f,   0.3f, 0.3f, 0.8f, 0.9f },
+   {  250.0f,  250.0f, 0.9f, 1.0f,   0.8f, 0.3f, 0.3f, 0.2f },
+   {  130.7f,  201.0f, 0.6f, 1.0f,   0.3f, 0.8f, 0.3f, 0.5f },
+};
+
+
+struct tiered_test_state {
+   struct pipe_resource *cbuf;
+   struct pipe_resource *zsbuf;
+   struct pipe_resource *vbuf;
+
+   void *blend;
+   void *dsa;
+   void *rast;
+   void *velems;
+   void *vs;
+   void *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "case\t"
+           "threads\t"
+           "msecs_fast\t"
+           "msecs_optimized\n");
+
+   fflush(fp);
+}
+
+
+static void
+set_env(const char *name, const char *value)
+{
+#ifdef _WIN32
+   _putenv_s(name, value);
+#else
+   setenv(name, value, 1);
+#endif
+}
+
+
+static struct pipe_resource *
+create_texture(struct pipe_screen *screen, enum pipe_format format,
+               unsigned bind)
+{
+   struct pipe_resource templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = WIDTH;
+   templ.height0 = HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = bind;
+
+   return screen->resource_create(screen, &templ);
+}
+
+
+static bool
+create_state(struct pipe_context *pipe, struct tiered_test_state *state,
+             unsigned c)
+{
+   struct pipe_screen *screen = pipe->screen;
+
+   memset(state, 0, sizeof *state);
+
+   state->cbuf = create_texture(screen, cases[c].cbuf_format,
+                                PIPE_BIND_RENDER_TARGET);
+   state->zsbuf = create_texture(screen, PIPE_FORMAT_Z32_FLOAT,
+                                 PIPE_BIND_DEPTH_STENCIL);
+   if (!state->cbuf || !state->zsbuf)
+      return false;
+
+   state->vbuf = pipe_buffer_create_with_data(pipe, PIPE_BIND_VERTEX_BUFFER,
+                                              PIPE_USAGE_IMMUTABLE,
+                                              sizeof vertices, vertices);
+   if (!state->vbuf)
+      return false;
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0].format = state->cbuf->format;
+   fb.cbufs[0].texture = state->cbuf;
+   fb.zsbuf.format = state->zsbuf->format;
+   fb.zsbuf.texture = state->zsbuf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = WIDTH / 2.0f;
+   vp.scale[1] = HEIGHT / 2.0f;
+   vp.scale[2] = 0.5f;
+   vp.translate[0] = WIDTH / 2.0f;
+   vp.translate[1] = HEIGHT / 2.0f;
+   vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   struct pipe_blend_state blend;
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   if (cases[c].blend) {
+      blend.rt[0].blend_enable = 1;
+      blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+      blend.rt[0].rgb_src_factor = PIPE_BLENDFACTOR_SRC_ALPHA;
+      blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+      blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+      blend.rt[0].alpha_src_factor = PIPE_BLENDFACTOR_ONE;
+      blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   }
+   state->blend = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, state->blend);
+
+   struct pipe_depth_stencil_alpha_state dsa;
+   memset(&dsa, 0, sizeof dsa);
+   if (cases[c].depth) {
+      dsa.depth_enabled = 1;
+      dsa.depth_writemask = 1;
+      dsa.depth_func = PIPE_FUNC_LESS;
+   }
+   if (cases[c].alpha_test) {
+      dsa.alpha_enabled = 1;
+      dsa.alpha_func = PIPE_FUNC_GREATER;
+      dsa.alpha_ref_value = 0.4f;
+   }
+   state->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, state->dsa);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.fill_front = PIPE_POLYGON_MODE_FILL;
+   rast.fill_back = PIPE_POLYGON_MODE_FILL;
+   state->rast = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, state->rast);
+
+   pipe->set_sample_mask(pipe, ~0);
+
+   struct pipe_vertex_element velems[2];
+   memset(velems, 0, sizeof velems);
+   for (unsigned i = 0; i < 2; i++) {
+      velems[i].src_offset = i * 4 * sizeof(float);
+      velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      velems[i].src_stride = sizeof vertices[0];
+   }
+   state->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, state->velems);
+
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   pipe_resource_reference(&vb.buffer.resource, state->vbuf);
+   pipe->set_vertex_buffers(pipe, 1, &vb);
+
+   const enum tgsi_semantic semantic_names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR
+   };
+   const unsigned semantic_indexes[] = { 0, 0 };
+   state->vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                                   semantic_indexes, true);
+   state->fs =
+      util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_COLOR,
+                                            TGSI_INTERPOLATE_PERSPECTIVE,
+                                            true);
+   if (!state->vs || !state->fs)
+      return false;
+
+   pipe->bind_vs_state(pipe, state->vs);
+   pipe->bind_fs_state(pipe, state->fs);
+
+   return true;
+}
+
+
+static void
+destroy_state(struct pipe_context *pipe, struct tiered_test_state *state)
+{
+   struct pipe_framebuffer_state fb;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe->set_vertex_buffers(pipe, 0, NULL);
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   if (state->vs)
+      pipe->delete_vs_state(pipe, state->vs);
+   if (state->fs)
+      pipe->delete_fs_state(pipe, state->fs);
+   if (state->velems)
+      pipe->delete_vertex_elements_state(pipe, state->velems);
+   if (state->rast)
+      pipe->delete_rasterizer_state(pipe, state->rast);
+   if (state->dsa)
+      pipe->delete_depth_stencil_alpha_state(pipe, state->dsa);
+   if (state->blend)
+      pipe->delete_blend_state(pipe, state->blend);
+
+   pipe_resource_reference(&state->vbuf, NULL);
+   pipe_resource_reference(&state->zsbuf, NULL);
+   pipe_resource_reference(&state->cbuf, NULL);
+}
+
+
+/**
+ * Clear and draw the triangles in a single scene, which counts as one use
+ * of the fragment shader variant.
+ */
+static void
+draw_frame(struct pipe_context *pipe)
+{
+   struct pipe_screen *screen = pipe->screen;
+   union pipe_color_union color;
+   struct pipe_draw_info info;
+   struct pipe_draw_start_count_bias draw;
+   struct pipe_fence_handle *fence = NULL;
+
+   color.f[0] = 0.2f;
+   color.f[1] = 0.1f;
+   color.f[2] = 0.3f;
+   color.f[3] = 0.5f;
+   pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTHSTENCIL, NULL,
+               &color, 1.0, 0);
+
+   memset(&info, 0, sizeof info);
+   info.mode = MESA_PRIM_TRIANGLES;
+   info.instance_count = 1;
+
+   memset(&draw, 0, sizeof draw);
+   draw.count = NUM_TRIS * 3;
+   pipe->draw_vbo(pipe, &info, 0, NULL, &draw, 1);
+
+   pipe->flush(pipe, &fence, 0);
+   screen->fence_finish(screen, NULL, fence, OS_TIMEOUT_INFINITE);
+   screen->fence_reference(screen, &fence, NULL);
+}
+
+
+static uint8_t *
+read_image(struct pipe_context *pipe, struct pipe_resource *res)
+{
+   const unsigned row_size = WIDTH * util_format_get_blocksize(res->format);
+   struct pipe_transfer *transfer;
+   uint8_t *image = MALLOC(HEIGHT * row_size);
+   const uint8_t *map;
+
+   if (!image)
+      return NULL;
+
+   map = pipe_texture_map(pipe, res, 0, 0, PIPE_MAP_READ,
+                          0, 0, WIDTH, HEIGHT, &transfer);
+   if (!map) {
+      FREE(image);
+      return NULL;
+   }
+
+   for (unsigned y = 0; y < HEIGHT; y++)
+      memcpy(image + y * row_size, map + y * transfer->stride, row_size);
+
+   pipe_texture_unmap(pipe, transfer);
+
+   return image;
+}
+
+
+/**
+ * Check all of the context's fragment shader variants were fast compiled,
+ * and whether they have been optimized.
+ */
+static bool
+check_variants(struct pipe_context *pipe, bool optimized)
+{
+   struct llvmpipe_context *lp = llvmpipe_context(pipe);
+   struct lp_fs_variant_list_item *li;
+
+   if (!lp->nr_fs_variants)
+      return false;
+
+   LIST_FOR_EACH_ENTRY(li, &lp->fs_variants_list.list, list) {
+      if (!li->base->fast_compiled ||
+          (li->base->gallivm_opt != NULL) != optimized)
+         return false;
+   }
+
+   return true;
+}
+
+
+static double
+time_frames(struct pipe_context *pipe, unsigned num_frames)
+{
+   int64_t t0 = os_time_get_nano();
+   for (unsigned f = 0; f < num_frames; f++)
+      draw_frame(pipe);
+   int64_t t1 = os_time_get_nano();
+
+   return (t1 - t0) / 1000000.0 / num_frames;
+}
+
+
+/**
+ * Render on a screen without tiered compilation, for the reference image.
+ */
+static uint8_t *
+render_reference(unsigned c)
+{
+   struct tiered_test_state state;
+   uint8_t *image = NULL;
+
+   struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+   if (!screen)
+      return NULL;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (pipe) {
+      if (create_state(pipe, &state, c)) {
+         draw_frame(pipe);
+         image = read_image(pipe, state.cbuf);
+      }
+      destroy_state(pipe, &state);
+      pipe->destroy(pipe);
+   }
+
+   screen->destroy(screen);
+
+   return image;
+}
+
+
+/**
+ * Render with tiered compilation, reading back the image drawn with the
+ * fast code and the one drawn once the variant has been optimized.
+ */
+static const char *
+render_tiered(unsigned c, unsigned num_frames, double *msecs,
+              uint8_t **fast, uint8_t **optimized)
+{
+   struct tiered_test_state state;
+   const char *error = NULL;
+
+   struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+   if (!screen)
+      return "no screen";
+
+   struct llvmpipe_screen *lp_screen = llvmpipe_screen(screen);
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe) {
+      screen->destroy(screen);
+      return "no context";
+   }
+
+   if (!create_state(pipe, &state, c)) {
+      error = "no state";
+      goto out;
+   }
+
+   draw_frame(pipe);
+   *fast = read_image(pipe, state.cbuf);
+   if (!util_queue_is_initialized(&lp_screen->fs_optimize_queue) ||
+       !check_variants(pipe, false)) {
+      error = "not fast compiled";
+      goto out;
+   }
+
+   /* One use short of getting optimized */
+   msecs[0] = time_frames(pipe, LP_FS_OPTIMIZE_USES - 2);
+   util_queue_finish(&lp_screen->fs_optimize_queue);
+   if (!check_variants(pipe, false)) {
+      error = "optimized too early";
+      goto out;
+   }
+
+   draw_frame(pipe);
+   util_queue_finish(&lp_screen->fs_optimize_queue);
+   if (!check_variants(pipe, true)) {
+      error = "not optimized";
+      goto out;
+   }
+
+   msecs[1] = time_frames(pipe, num_frames);
+   *optimized = read_image(pipe, state.cbuf);
+
+out:
+   destroy_state(pipe, &state);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return error;
+}
+
+
+static bool
+test_tiered(unsigned verbose, FILE *fp, unsigned c, unsigned num_threads,
+            unsigned num_frames)
+{
+   const unsigned image_size =
+      WIDTH * HEIGHT * util_format_get_blocksize(cases[c].cbuf_format);
+   const unsigned saved_gallivm_perf = gallivm_perf;
+   uint8_t *reference, *fast = NULL, *optimized = NULL;
+   double msecs[2] = { 0.0 };
+   const char *error = NULL;
+   char str[16];
+
+   /* How variants get compiled is decided when the screen is set up.
+    * Variants found in the disk cache are never fast compiled.
+    */
+   snprintf(str, sizeof str, "%u", num_threads);
+   set_env("LP_NUM_THREADS", str);
+   set_env("MESA_SHADER_CACHE_DISABLE", "true");
+
+   gallivm_perf = saved_gallivm_perf & ~(GALLIVM_PERF_TIERED |
+                                         GALLIVM_PERF_NO_OPT);
+   reference = render_reference(c);
+
+   gallivm_perf |= GALLIVM_PERF_TIERED;
+   error = render_tiered(c, num_frames, msecs, &fast, &optimized);
+   gallivm_perf = saved_gallivm_perf;
+
+   if (!error) {
+      if (!reference || !fast || !optimized)
+         error = "no image";
+      else if (memcmp(reference, fast, image_size))
+         error = "fast image differs";
+      else if (memcmp(reference, optimized, image_size))
+         error = "optimized image differs";
+   }
+
+   if (error && verbose < 1)
+      fprintf(stderr, "%s threads %u: %s\n", cases[c].name, num_threads,
+              error);
+
+   if (verbose >= 1) {
+      printf("%-12s threads %3u: %8.3f ms fast %8.3f ms optimized  %s\n",
+             cases[c].name, num_threads, msecs[0], msecs[1],
+             error ? "FAIL" : "PASS");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%u\t%.3f\t%.3f\n", error ? "fail" : "pass",
+              cases[c].name, num_threads, msecs[0], msecs[1]);
+      fflush(fp);
+   }
+
+   FREE(reference);
+   FREE(fast);
+   FREE(optimized);
+
+   return !error;
+}
+
+
+/**
+ * Render every case on the calling thread and on a few rasterizer
+ * threads.
+ */
+static bool
+test_cases(unsigned verbose, FILE *fp, unsigned num_frames)
+{
+   const unsigned thread_counts[] = {
+      0, MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 4), LP_MAX_THREADS),
+   };
+   bool success = true;
+
+   for (unsigned c = 0; c < ARRAY_SIZE(cases); c++) {
+      for (unsigned t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+         if (!test_tiered(verbose, fp, c, thread_counts[t], num_frames))
+            success = false;
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_cases(verbose, fp, 10);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_cases(verbose, fp, MAX2(n / 500, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_tiered(verbose, fp, 0, 0, 1);
+}
@@ -0,0 +1,650 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+
+/**
+ * @file
+ * Hierarchical depth culling.
+ *
+ * Renders sequences of depth tested quads meant to catch Hi-Z bounds which
+ * are lower than the depth buffer: occluders behind which other quads get
+ * culled, coplanar quads with LEQUAL, depth raised by GREATER and ALWAYS
+ * tests, occluders without depth writes or with an alpha test, and depth
+ * clears in the middle of a scene.  Each sequence is rendered with and
+ * without Hi-Z (LP_PERF=no_hiz), for each depth format, and the color and
+ * depth buffers must match.  In debug builds, the occluded sequences must
+ * also get some primitives or blocks culled.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "util/format/u_format.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "util/os_time.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_perf.h"
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+#define WIDTH  512
+#define HEIGHT 512
+
+#define MAX_DRAWS 32
+
+
+/** The depth/alpha states the draws pick from */
+enum hiz_dsa {
+   DSA_LESS,
+   DSA_LEQUAL,
+   DSA_LESS_NO_WRITE,
+   DSA_GREATER,
+   DSA_ALWAYS,
+   DSA_LESS_ALPHA_TEST,
+   NUM_DSAS,
+};
+
+
+/**
+ * A quad in window coordinates, with its depth going from z0 on the left
+ * to z1 on the right, and its alpha from a0 at the top to a1 at the
+ * bottom.  A quad with clear set clears depth to z0 instead.
+ */
+struct hiz_draw {
+   enum hiz_dsa dsa;
+   float x0, y0, x1, y1;
+   float z0, z1;
+   float a0, a1;
+   bool clear;
+};
+
+
+static const struct {
+   const char *name;
+   bool culls;   /**< must get something culled */
+   unsigned num_draws;
+   struct hiz_draw draws[MAX_DRAWS];
+} sequences[] = {
+   {
+      "occluded", true, 4, {
+         { DSA_LESS, 0.05f, 0.05f, 0.95f, 0.95f, 0.3f, 0.3f, 1.0f, 1.0f },
+         { DSA_LESS, 0.1f, 0.1f, 0.9f, 0.9f, 0.6f, 0.6f, 1.0f, 1.0f },
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 0.5f, 0.2f, 0.8f, 1.0f, 1.0f },
+         { DSA_LEQUAL, 0.2f, 0.2f, 0.8f, 0.8f, 0.30001f, 0.5f, 1.0f, 1.0f },
+      },
+   },
+   {
+      "coplanar", false, 3, {
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.25f, 0.75f, 1.0f, 1.0f },
+         { DSA_LEQUAL, 0.0f, 0.0f, 1.0f, 1.0f, 0.25f, 0.75f, 1.0f, 1.0f },
+         { DSA_LEQUAL, 0.1f, 0.3f, 0.7f, 0.6f, 0.4f, 0.4f, 1.0f, 1.0f },
+      },
+   },
+   {
+      /* Above the occluder, but equal once rounded to 16 bit unorm */
+      "quantized", false, 2, {
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.25f, 0.25f, 1.0f, 1.0f },
+         { DSA_LEQUAL, 0.2f, 0.2f, 0.8f, 0.8f, 0.250003f, 0.250003f,
+           1.0f, 1.0f },
+      },
+   },
+   {
+      "raised_greater", true, 3, {
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.3f, 0.3f, 1.0f, 1.0f },
+         { DSA_GREATER, 0.2f, 0.2f, 0.6f, 0.6f, 0.8f, 0.8f, 1.0f, 1.0f },
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.5f, 0.5f, 1.0f, 1.0f },
+      },
+   },
+   {
+      "raised_always", true, 3, {
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.3f, 0.3f, 1.0f, 1.0f },
+         { DSA_ALWAYS, 0.4f, 0.1f, 0.9f, 0.5f, 0.9f, 0.7f, 1.0f, 1.0f },
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.5f, 0.5f, 1.0f, 1.0f },
+      },
+   },
+   {
+      "no_write", false, 2, {
+         { DSA_LESS_NO_WRITE, 0.0f, 0.0f, 1.0f, 1.0f, 0.3f, 0.3f, 1.0f, 1.0f },
+         { DSA_LESS, 0.1f, 0.1f, 0.9f, 0.9f, 0.6f, 0.6f, 1.0f, 1.0f },
+      },
+   },
+   {
+      "alpha_test", false, 2, {
+         { DSA_LESS_ALPHA_TEST, 0.0f, 0.0f, 1.0f, 1.0f, 0.3f, 0.3f, 1.0f, 0.0f },
+         { DSA_LESS, 0.1f, 0.1f, 0.9f, 0.9f, 0.6f, 0.6f, 1.0f, 1.0f },
+      },
+   },
+   {
+      "reclear", true, 5, {
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.2f, 0.2f, 1.0f, 1.0f },
+         { DSA_LESS, 0.3f, 0.3f, 0.7f, 0.7f, 0.5f, 0.5f, 1.0f, 1.0f },
+         { .clear = true, .z0 = 1.0f },
+         { DSA_LESS, 0.1f, 0.1f, 0.9f, 0.9f, 0.7f, 0.4f, 1.0f, 1.0f },
+         { DSA_LESS, 0.0f, 0.0f, 1.0f, 1.0f, 0.8f, 0.8f, 1.0f, 1.0f },
+      },
+   },
+};
+
+
+static const enum pipe_format formats[] = {
+   PIPE_FORMAT_Z32_FLOAT,
+   PIPE_FORMAT_Z24_UNORM_S8_UINT,
+   PIPE_FORMAT_Z16_UNORM,
+};
+
+
+struct hiz_test_state {
+   struct pipe_resource *cbuf;
+   struct pipe_resource *zsbuf;
+   struct pipe_resource *vbuf;
+
+   void *blend;
+   void *dsa[NUM_DSAS];
+   void *rast;
+   void *velems;
+   void *vs;
+   void *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "sequence\t"
+           "format\t"
+           "threads\t"
+           "culled\t"
+           "msecs_no_hiz\t"
+           "msecs_hiz\n");
+
+   fflush(fp);
+}
+
+
+static void
+set_num_threads(unsigned num_threads)
+{
+   char str[16];
+
+   snprintf(str, sizeof str, "%u", num_threads);
+#ifdef _WIN32
+   _putenv_s("LP_NUM_THREADS", str);
+#else
+   setenv("LP_NUM_THREADS", str, 1);
+#endif
+}
+
+
+static struct pipe_resource *
+create_texture(struct pipe_screen *screen, enum pipe_format format,
+               unsigned bind)
+{
+   struct pipe_resource templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = WIDTH;
+   templ.height0 = HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = bind;
+
+   return screen->resource_create(screen, &templ);
+}
+
+
+/**
+ * Emit the two triangles of a quad.  The color tells the draws apart.
+ */
+static float *
+emit_quad(float *v, const struct hiz_draw *draw, unsigned index)
+{
+   const float corners[6][2] = {
+      { 0, 0 }, { 1, 0 }, { 0, 1 },
+      { 1, 0 }, { 1, 1 }, { 0, 1 },
+   };
+
+   for (unsigned i = 0; i < 6; i++) {
+      const float s = corners[i][0], t = corners[i][1];
+
+      v[0] = (draw->x0 + (draw->x1 - draw->x0) * s) * WIDTH;
+      v[1] = (draw->y0 + (draw->y1 - draw->y0) * t) * HEIGHT;
+      v[2] = draw->z0 + (draw->z1 - draw->z0) * s;
+      v[3] = 1.0f;
+      v[4] = (index & 1) ? 1.0f : 0.25f;
+      v[5] = (index & 2) ? 1.0f : 0.25f;
+      v[6] = (index & 4) ? 1.0f : 0.25f;
+      v[7] = draw->a0 + (draw->a1 - draw->a0) * t;
+      v += 8;
+   }
+
+   return v;
+}
+
+
+static void *
+create_dsa(struct pipe_context *pipe, enum hiz_dsa kind)
+{
+   struct pipe_depth_stencil_alpha_state dsa;
+
+   memset(&dsa, 0, sizeof dsa);
+   dsa.depth_enabled = 1;
+   dsa.depth_writemask = kind != DSA_LESS_NO_WRITE;
+
+   switch (kind) {
+   case DSA_LEQUAL:
+      dsa.depth_func = PIPE_FUNC_LEQUAL;
+      break;
+   case DSA_GREATER:
+      dsa.depth_func = PIPE_FUNC_GREATER;
+      break;
+   case DSA_ALWAYS:
+      dsa.depth_func = PIPE_FUNC_ALWAYS;
+      break;
+   case DSA_LESS_ALPHA_TEST:
+      dsa.depth_func = PIPE_FUNC_LESS;
+      dsa.alpha_enabled = 1;
+      dsa.alpha_func = PIPE_FUNC_GREATER;
+      dsa.alpha_ref_value = 0.5f;
+      break;
+   default:
+      dsa.depth_func = PIPE_FUNC_LESS;
+      break;
+   }
+
+   return pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+}
+
+
+static bool
+create_state(struct pipe_context *pipe, struct hiz_test_state *state,
+             enum pipe_format zs_format, unsigned sequence)
+{
+   struct pipe_screen *screen = pipe->screen;
+
+   memset(state, 0, sizeof *state);
+
+   state->cbuf = create_texture(screen, PIPE_FORMAT_B8G8R8A8_UNORM,
+                                PIPE_BIND_RENDER_TARGET);
+   state->zsbuf = create_texture(screen, zs_format, PIPE_BIND_DEPTH_STENCIL);
+   if (!state->cbuf || !state->zsbuf)
+      return false;
+
+   const unsigned num_draws = sequences[sequence].num_draws;
+   float vertices[MAX_DRAWS * 6 * 8];
+   float *v = vertices;
+   for (unsigned d = 0; d < num_draws; d++)
+      v = emit_quad(v, &sequences[sequence].draws[d], d + 1);
+
+   state->vbuf = pipe_buffer_create_with_data(pipe, PIPE_BIND_VERTEX_BUFFER,
+                                              PIPE_USAGE_IMMUTABLE,
+                                              num_draws * 6 * 8 *
+                                              sizeof(float),
+                                              vertices);
+   if (!state->vbuf)
+      return false;
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0].format = state->cbuf->format;
+   fb.cbufs[0].texture = state->cbuf;
+   fb.zsbuf.format = state->zsbuf->format;
+   fb.zsbuf.texture = state->zsbuf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = WIDTH / 2.0f;
+   vp.scale[1] = HEIGHT / 2.0f;
+   vp.scale[2] = 0.5f;
+   vp.translate[0] = WIDTH / 2.0f;
+   vp.translate[1] = HEIGHT / 2.0f;
+   vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   struct pipe_blend_state blend;
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   state->blend = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, state->blend);
+
+   for (unsigned i = 0; i < NUM_DSAS; i++)
+      state->dsa[i] = create_dsa(pipe, i);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.fill_front = PIPE_POLYGON_MODE_FILL;
+   rast.fill_back = PIPE_POLYGON_MODE_FILL;
+   state->rast = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, state->rast);
+
+   pipe->set_sample_mask(pipe, ~0);
+
+   struct pipe_vertex_element velems[2];
+   memset(velems, 0, sizeof velems);
+   for (unsigned i = 0; i < 2; i++) {
+      velems[i].src_offset = i * 4 * sizeof(float);
+      velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      velems[i].src_stride = 8 * sizeof(float);
+   }
+   state->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, state->velems);
+
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   pipe_resource_reference(&vb.buffer.resource, state->vbuf);
+   pipe->set_vertex_buffers(pipe, 1, &vb);
+
+   const enum tgsi_semantic semantic_names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR
+   };
+   const unsigned semantic_indexes[] = { 0, 0 };
+   state->vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                                   semantic_indexes, true);
+   state->fs =
+      util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_COLOR,
+                                            TGSI_INTERPOLATE_PERSPECTIVE,
+                                            true);
+   if (!state->vs || !state->fs)
+      return false;
+
+   pipe->bind_vs_state(pipe, state->vs);
+   pipe->bind_fs_state(pipe, state->fs);
+
+   return true;
+}
+
+
+static void
+destroy_state(struct pipe_context *pipe, struct hiz_test_state *state)
+{
+   struct pipe_framebuffer_state fb;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe->set_vertex_buffers(pipe, 0, NULL);
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   if (state->vs)
+      pipe->delete_vs_state(pipe, state->vs);
+   if (state->fs)
+      pipe->delete_fs_state(pipe, state->fs);
+   if (state->velems)
+      pipe->delete_vertex_elements_state(pipe, state->velems);
+   if (state->rast)
+      pipe->delete_rasterizer_state(pipe, state->rast);
+   for (unsigned i = 0; i < NUM_DSAS; i++) {
+      if (state->dsa[i])
+         pipe->delete_depth_stencil_alpha_state(pipe, state->dsa[i]);
+   }
+   if (state->blend)
+      pipe->delete_blend_state(pipe, state->blend);
+
+   pipe_resource_reference(&state->vbuf, NULL);
+   pipe_resource_reference(&state->zsbuf, NULL);
+   pipe_resource_reference(&state->cbuf, NULL);
+}
+
+
+/**
+ * Clear, then draw the sequence in a single scene.
+ */
+static void
+draw_frame(struct pipe_context *pipe, const struct hiz_test_state *state,
+           unsigned sequence)
+{
+   struct pipe_screen *screen = pipe->screen;
+   union pipe_color_union color;
+   struct pipe_draw_info info;
+   struct pipe_draw_start_count_bias draw;
+   struct pipe_fence_handle *fence = NULL;
+
+   memset(&color, 0, sizeof color);
+   pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTHSTENCIL, NULL,
+               &color, 1.0, 0);
+
+   memset(&info, 0, sizeof info);
+   info.mode = MESA_PRIM_TRIANGLES;
+   info.instance_count = 1;
+
+   for (unsigned d = 0; d < sequences[sequence].num_draws; d++) {
+      const struct hiz_draw *step = &sequences[sequence].draws[d];
+
+      if (step->clear) {
+         pipe->clear(pipe, PIPE_CLEAR_DEPTH, NULL, &color, step->z0, 0);
+         continue;
+      }
+
+      pipe->bind_depth_stencil_alpha_state(pipe, state->dsa[step->dsa]);
+
+      memset(&draw, 0, sizeof draw);
+      draw.start = d * 6;
+      draw.count = 6;
+      pipe->draw_vbo(pipe, &info, 0, NULL, &draw, 1);
+   }
+
+   pipe->flush(pipe, &fence, 0);
+   screen->fence_finish(screen, NULL, fence, OS_TIMEOUT_INFINITE);
+   screen->fence_reference(screen, &fence, NULL);
+}
+
+
+static uint8_t *
+read_image(struct pipe_context *pipe, struct pipe_resource *res)
+{
+   const unsigned row_size = WIDTH * util_format_get_blocksize(res->format);
+   struct pipe_transfer *transfer;
+   uint8_t *image = MALLOC(HEIGHT * row_size);
+   const uint8_t *map;
+
+   if (!image)
+      return NULL;
+
+   map = pipe_texture_map(pipe, res, 0, 0, PIPE_MAP_READ,
+                          0, 0, WIDTH, HEIGHT, &transfer);
+   if (!map) {
+      FREE(image);
+      return NULL;
+   }
+
+   for (unsigned y = 0; y < HEIGHT; y++)
+      memcpy(image + y * row_size, map + y * transfer->stride, row_size);
+
+   pipe_texture_unmap(pipe, transfer);
+
+   return image;
+}
+
+
+/**
+ * Render the sequence num_frames times on a new context, so that the
+ * shader variants get compiled with the current LP_PERF flags, and read
+ * back the color and depth buffers.
+ */
+static bool
+render_sequence(struct pipe_screen *screen, enum pipe_format zs_format,
+                unsigned sequence, unsigned num_frames, double *msecs,
+                uint8_t **color, uint8_t **depth)
+{
+   struct hiz_test_state state;
+   bool success = false;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe)
+      return false;
+
+   if (create_state(pipe, &state, zs_format, sequence)) {
+      /* Compile the shader variants */
+      draw_frame(pipe, &state, sequence);
+
+      int64_t t0 = os_time_get_nano();
+      for (unsigned f = 0; f < num_frames; f++)
+         draw_frame(pipe, &state, sequence);
+      int64_t t1 = os_time_get_nano();
+
+      *msecs = (t1 - t0) / 1000000.0 / num_frames;
+
+      *color = read_image(pipe, state.cbuf);
+      *depth = read_image(pipe, state.zsbuf);
+      success = *color && *depth;
+   }
+
+   destroy_state(pipe, &state);
+   pipe->destroy(pipe);
+
+   return success;
+}
+
+
+static bool
+test_hiz(unsigned verbose, FILE *fp, unsigned sequence, unsigned format,
+         unsigned num_threads, unsigned num_frames)
+{
+   const enum pipe_format zs_format = formats[format];
+   const unsigned depth_size =
+      WIDTH * HEIGHT * util_format_get_blocksize(zs_format);
+   const int saved_perf = LP_PERF;
+   uint8_t *color[2] = { NULL }, *depth[2] = { NULL };
+   double msecs[2] = { 0.0 };
+   unsigned culled = 0;
+   bool success = false;
+
+   /* The number of threads is picked when the screen is set up */
+   set_num_threads(num_threads);
+
+   struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+   if (screen) {
+      success = true;
+      for (unsigned hiz = 0; hiz < 2; hiz++) {
+         LP_PERF = hiz ? saved_perf & ~PERF_NO_HIZ : saved_perf | PERF_NO_HIZ;
+         lp_reset_counters();
+
+         if (!render_sequence(screen, zs_format, sequence, num_frames,
+                              &msecs[hiz], &color[hiz], &depth[hiz]))
+            success = false;
+      }
+      LP_PERF = saved_perf;
+      screen->destroy(screen);
+   }
+
+   /* Counted only in debug builds, where triangles are counted too */
+   culled = LP_COUNT_GET(nr_hiz_culled_tris) + LP_COUNT_GET(nr_hiz_culled_64) +
+            LP_COUNT_GET(nr_hiz_culled_16);
+
+   if (success) {
+      const char *error = NULL;
+
+      if (memcmp(color[0], color[1], WIDTH * HEIGHT * sizeof(uint32_t)))
+         error = "color differs";
+      else if (memcmp(depth[0], depth[1], depth_size))
+         error = "depth differs";
+      else if (sequences[sequence].culls && LP_COUNT_GET(nr_tris) && !culled)
+         error = "nothing culled";
+
+      if (error) {
+         if (verbose < 1)
+            fprintf(stderr, "%s %s threads %u: %s\n",
+                    sequences[sequence].name,
+                    util_format_short_name(zs_format), num_threads, error);
+         success = false;
+      }
+   }
+
+   if (verbose >= 1) {
+      printf("%-14s %-20s threads %3u: culled %6u %8.3f ms no_hiz "
+             "%8.3f ms hiz  %s\n", sequences[sequence].name,
+             util_format_short_name(zs_format), num_threads, culled,
+             msecs[0], msecs[1], success ? "PASS" : "FAIL");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%s\t%u\t%u\t%.3f\t%.3f\n",
+              success ? "pass" : "fail", sequences[sequence].name,
+              util_format_short_name(zs_format), num_threads, culled,
+              msecs[0], msecs[1]);
+      fflush(fp);
+   }
+
+   for (unsigned hiz = 0; hiz < 2; hiz++) {
+      FREE(color[hiz]);
+      FREE(depth[hiz]);
+   }
+
+   return success;
+}
+
+
+/**
+ * Render every sequence with every depth format, on the calling thread and
+ * on a few rasterizer threads.
+ */
+static bool
+test_sequences(unsigned verbose, FILE *fp, unsigned num_frames)
+{
+   const unsigned thread_counts[] = {
+      0, MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 4), LP_MAX_THREADS),
+   };
+   bool success = true;
+
+   for (unsigned s = 0; s < ARRAY_SIZE(sequences); s++) {
+      for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+         for (unsigned t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+            if (!test_hiz(verbose, fp, s, f, thread_counts[t], num_frames))
+               success = false;
+         }
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_sequences(verbose, fp, 10);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_sequences(verbose, fp, MAX2(n / 500, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_hiz(verbose, fp, 0, 0, 0, 1);
+}
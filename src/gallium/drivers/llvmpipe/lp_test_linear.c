@@ -0,0 +1,716 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+
+/**
+ * @file
+ * Linear rasterizer against the SoA pipeline on a compositor workload.
+ *
+ * Draws a frame the way a desktop compositor does: a stretched wallpaper,
+ * overlapping windows blended with premultiplied alpha, some of them scaled
+ * and some copied texel for texel, and a panel tiling a repeated pattern
+ * with non-premultiplied alpha, all bilinearly filtered.  Each frame is
+ * rendered with the linear rasterizer and without it
+ * (LP_PERF=no_rast_linear), for each color buffer format the linear path
+ * handles, and the images must match to within rounding.  Measures the
+ * time per frame of both.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "tgsi/tgsi_ureg.h"
+#include "util/box.h"
+#include "util/format/u_format.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_sampler.h"
+#include "util/u_simple_shaders.h"
+#include "util/os_time.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_public.h"
+#include "lp_screen.h"
+#include "lp_test.h"
+
+
+#define WIDTH  512
+#define HEIGHT 512
+
+#define TEX_SIZE 256
+
+
+enum linear_texture {
+   TEX_WALLPAPER,
+   TEX_WINDOW,
+   NUM_TEXTURES,
+};
+
+
+enum linear_blend {
+   LINEAR_BLEND_NONE,
+   LINEAR_BLEND_PREMUL,      /**< ONE, INV_SRC_ALPHA */
+   LINEAR_BLEND_SRC_ALPHA,   /**< SRC_ALPHA, INV_SRC_ALPHA */
+   NUM_LINEAR_BLENDS,
+};
+
+
+/**
+ * A textured rectangle, in window coordinates relative to the framebuffer
+ * size.  A window of TEX_SIZE pixels with texture coordinates from 0 to 1
+ * is copied texel for texel.
+ */
+struct linear_draw {
+   enum linear_texture texture;
+   enum linear_blend blend;
+   bool repeat;
+   float x0, y0, x1, y1;
+   float s0, t0, s1, t1;
+};
+
+
+static const struct linear_draw draws[] = {
+   /* Wallpaper, stretched over the whole screen */
+   { TEX_WALLPAPER, LINEAR_BLEND_NONE, false, 0.0f, 0.0f, 1.0f, 1.0f,
+     0.0f, 0.0f, 1.0f, 1.0f },
+   /* Windows, unscaled */
+   { TEX_WINDOW, LINEAR_BLEND_PREMUL, false, 0.0625f, 0.125f, 0.5625f, 0.625f,
+     0.0f, 0.0f, 1.0f, 1.0f },
+   { TEX_WINDOW, LINEAR_BLEND_PREMUL, false, 0.375f, 0.25f, 0.875f, 0.75f,
+     0.0f, 0.0f, 1.0f, 1.0f },
+   /* Windows, scaled as when zooming in or out */
+   { TEX_WINDOW, LINEAR_BLEND_PREMUL, false, 0.125f, 0.5f, 0.4375f, 0.875f,
+     0.0f, 0.0f, 1.0f, 1.0f },
+   { TEX_WINDOW, LINEAR_BLEND_PREMUL, false, 0.5f, 0.0625f, 0.9375f, 0.9375f,
+     0.125f, 0.125f, 0.875f, 0.875f },
+   /* Panel, tiling the pattern along the bottom */
+   { TEX_WINDOW, LINEAR_BLEND_SRC_ALPHA, true, 0.0f, 0.9375f, 1.0f, 1.0f,
+     0.0f, 0.0f, 8.0f, 0.25f },
+};
+
+
+static const enum pipe_format formats[] = {
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_B8G8R8X8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B5G6R5_UNORM,
+};
+
+
+struct linear_test_state {
+   struct pipe_resource *cbuf;
+   struct pipe_resource *vbuf;
+   struct pipe_resource *tex[NUM_TEXTURES];
+   struct pipe_sampler_view *view[NUM_TEXTURES];
+
+   void *blend[NUM_LINEAR_BLENDS];
+   void *sampler[2];   /**< clamp, repeat */
+   void *dsa;
+   void *rast;
+   void *velems;
+   void *vs;
+   void *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "format\t"
+           "threads\t"
+           "max_diff\t"
+           "msecs_soa\t"
+           "msecs_linear\n");
+
+   fflush(fp);
+}
+
+
+static void
+set_num_threads(unsigned num_threads)
+{
+   char str[16];
+
+   snprintf(str, sizeof str, "%u", num_threads);
+#ifdef _WIN32
+   _putenv_s("LP_NUM_THREADS", str);
+#else
+   setenv("LP_NUM_THREADS", str, 1);
+#endif
+}
+
+
+static struct pipe_resource *
+create_texture(struct pipe_screen *screen, enum pipe_format format,
+               unsigned width, unsigned height, unsigned bind)
+{
+   struct pipe_resource templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = width;
+   templ.height0 = height;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = bind;
+
+   return screen->resource_create(screen, &templ);
+}
+
+
+/**
+ * Fill a texture: an opaque gradient for the wallpaper, and for the windows
+ * a premultiplied checkerboard whose alpha fades towards the edges, so that
+ * the filtering and the blending both show.
+ */
+static void
+upload_texture(struct pipe_context *pipe, struct pipe_resource *tex,
+               enum linear_texture kind)
+{
+   uint32_t *texels = MALLOC(TEX_SIZE * TEX_SIZE * sizeof(uint32_t));
+   struct pipe_box box;
+
+   if (!texels)
+      return;
+
+   for (unsigned y = 0; y < TEX_SIZE; y++) {
+      for (unsigned x = 0; x < TEX_SIZE; x++) {
+         unsigned r, g, b, a;
+
+         if (kind == TEX_WALLPAPER) {
+            r = x;
+            g = y;
+            b = 255 - (x + y) / 2;
+            a = 255;
+         } else {
+            const unsigned edge = MIN4(x, y, TEX_SIZE - 1 - x,
+                                       TEX_SIZE - 1 - y);
+            const bool check = ((x >> 4) ^ (y >> 4)) & 1;
+
+            a = MIN2(64 + edge * 4, 255);
+            r = (check ? 240 : 32) * a / 255;
+            g = ((x * 3) & 0xff) * a / 255;
+            b = (check ? 64 : 200) * a / 255;
+         }
+
+         /* B8G8R8A8 */
+         texels[y * TEX_SIZE + x] = b | g << 8 | r << 16 | a << 24;
+      }
+   }
+
+   u_box_2d(0, 0, TEX_SIZE, TEX_SIZE, &box);
+   pipe->texture_subdata(pipe, tex, 0, PIPE_MAP_WRITE, &box, texels,
+                         TEX_SIZE * sizeof(uint32_t), 0);
+
+   FREE(texels);
+}
+
+
+static float *
+emit_rect(float *v, const struct linear_draw *draw)
+{
+   const float corners[6][2] = {
+      { 0, 0 }, { 1, 0 }, { 0, 1 },
+      { 1, 0 }, { 1, 1 }, { 0, 1 },
+   };
+
+   for (unsigned i = 0; i < 6; i++) {
+      const float s = corners[i][0], t = corners[i][1];
+
+      v[0] = (draw->x0 + (draw->x1 - draw->x0) * s) * WIDTH;
+      v[1] = (draw->y0 + (draw->y1 - draw->y0) * t) * HEIGHT;
+      v[2] = 0.0f;
+      v[3] = 1.0f;
+      v[4] = draw->s0 + (draw->s1 - draw->s0) * s;
+      v[5] = draw->t0 + (draw->t1 - draw->t0) * t;
+      v[6] = 0.0f;
+      v[7] = 1.0f;
+      v += 8;
+   }
+
+   return v;
+}
+
+
+static void *
+create_blend(struct pipe_context *pipe, enum linear_blend kind)
+{
+   struct pipe_blend_state blend;
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+
+   if (kind != LINEAR_BLEND_NONE) {
+      blend.rt[0].blend_enable = 1;
+      blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+      blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+      blend.rt[0].rgb_src_factor = kind == LINEAR_BLEND_PREMUL ?
+         PIPE_BLENDFACTOR_ONE : PIPE_BLENDFACTOR_SRC_ALPHA;
+      blend.rt[0].alpha_src_factor = blend.rt[0].rgb_src_factor;
+      blend.rt[0].rgb_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+      blend.rt[0].alpha_dst_factor = PIPE_BLENDFACTOR_INV_SRC_ALPHA;
+   }
+
+   return pipe->create_blend_state(pipe, &blend);
+}
+
+
+static void *
+create_sampler(struct pipe_context *pipe, bool repeat)
+{
+   struct pipe_sampler_state sampler;
+   const unsigned wrap = repeat ? PIPE_TEX_WRAP_REPEAT
+                                : PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+
+   memset(&sampler, 0, sizeof sampler);
+   sampler.wrap_s = wrap;
+   sampler.wrap_t = wrap;
+   sampler.wrap_r = wrap;
+   sampler.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   sampler.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+
+   return pipe->create_sampler_state(pipe, &sampler);
+}
+
+
+/**
+ * Sample the texture at a perspective interpolated coordinate, which is
+ * what GL shaders get unless they ask for noperspective, and what the
+ * linear path takes.
+ */
+static void *
+create_tex_fs(struct pipe_context *pipe)
+{
+   struct ureg_program *ureg = ureg_create(MESA_SHADER_FRAGMENT);
+   if (!ureg)
+      return NULL;
+
+   struct ureg_src sampler = ureg_DECL_sampler(ureg, 0);
+   ureg_DECL_sampler_view(ureg, 0, TGSI_TEXTURE_2D,
+                          TGSI_RETURN_TYPE_FLOAT, TGSI_RETURN_TYPE_FLOAT,
+                          TGSI_RETURN_TYPE_FLOAT, TGSI_RETURN_TYPE_FLOAT);
+   struct ureg_src tex = ureg_DECL_fs_input(ureg, TGSI_SEMANTIC_GENERIC, 0,
+                                            TGSI_INTERPOLATE_PERSPECTIVE);
+   struct ureg_dst out = ureg_DECL_output(ureg, TGSI_SEMANTIC_COLOR, 0);
+
+   ureg_TEX(ureg, out, TGSI_TEXTURE_2D, tex, sampler);
+   ureg_END(ureg);
+
+   return ureg_create_shader_and_destroy(ureg, pipe);
+}
+
+
+static bool
+create_state(struct pipe_context *pipe, struct linear_test_state *state,
+             enum pipe_format cbuf_format)
+{
+   struct pipe_screen *screen = pipe->screen;
+
+   memset(state, 0, sizeof *state);
+
+   state->cbuf = create_texture(screen, cbuf_format, WIDTH, HEIGHT,
+                                PIPE_BIND_RENDER_TARGET);
+   if (!state->cbuf)
+      return false;
+
+   for (unsigned i = 0; i < NUM_TEXTURES; i++) {
+      struct pipe_sampler_view templ;
+
+      state->tex[i] = create_texture(screen, PIPE_FORMAT_B8G8R8A8_UNORM,
+                                     TEX_SIZE, TEX_SIZE,
+                                     PIPE_BIND_SAMPLER_VIEW);
+      if (!state->tex[i])
+         return false;
+
+      upload_texture(pipe, state->tex[i], i);
+
+      u_sampler_view_default_template(&templ, state->tex[i],
+                                      state->tex[i]->format);
+      state->view[i] = pipe->create_sampler_view(pipe, state->tex[i], &templ);
+      if (!state->view[i])
+         return false;
+   }
+
+   float vertices[ARRAY_SIZE(draws) * 6 * 8];
+   float *v = vertices;
+   for (unsigned d = 0; d < ARRAY_SIZE(draws); d++)
+      v = emit_rect(v, &draws[d]);
+
+   state->vbuf = pipe_buffer_create_with_data(pipe, PIPE_BIND_VERTEX_BUFFER,
+                                              PIPE_USAGE_IMMUTABLE,
+                                              sizeof vertices, vertices);
+   if (!state->vbuf)
+      return false;
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0].format = state->cbuf->format;
+   fb.cbufs[0].texture = state->cbuf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = WIDTH / 2.0f;
+   vp.scale[1] = HEIGHT / 2.0f;
+   vp.scale[2] = 0.5f;
+   vp.translate[0] = WIDTH / 2.0f;
+   vp.translate[1] = HEIGHT / 2.0f;
+   vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   for (unsigned i = 0; i < NUM_LINEAR_BLENDS; i++)
+      state->blend[i] = create_blend(pipe, i);
+
+   for (unsigned i = 0; i < 2; i++)
+      state->sampler[i] = create_sampler(pipe, i);
+
+   struct pipe_depth_stencil_alpha_state dsa;
+   memset(&dsa, 0, sizeof dsa);
+   state->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, state->dsa);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.fill_front = PIPE_POLYGON_MODE_FILL;
+   rast.fill_back = PIPE_POLYGON_MODE_FILL;
+   state->rast = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, state->rast);
+
+   pipe->set_sample_mask(pipe, ~0);
+
+   struct pipe_vertex_element velems[2];
+   memset(velems, 0, sizeof velems);
+   for (unsigned i = 0; i < 2; i++) {
+      velems[i].src_offset = i * 4 * sizeof(float);
+      velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      velems[i].src_stride = 8 * sizeof(float);
+   }
+   state->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, state->velems);
+
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   pipe_resource_reference(&vb.buffer.resource, state->vbuf);
+   pipe->set_vertex_buffers(pipe, 1, &vb);
+
+   const enum tgsi_semantic semantic_names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC
+   };
+   const unsigned semantic_indexes[] = { 0, 0 };
+   state->vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                                   semantic_indexes, true);
+   state->fs = create_tex_fs(pipe);
+   if (!state->vs || !state->fs)
+      return false;
+
+   pipe->bind_vs_state(pipe, state->vs);
+   pipe->bind_fs_state(pipe, state->fs);
+
+   return true;
+}
+
+
+static void
+destroy_state(struct pipe_context *pipe, struct linear_test_state *state)
+{
+   struct pipe_framebuffer_state fb;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe->set_vertex_buffers(pipe, 0, NULL);
+   pipe->set_sampler_views(pipe, MESA_SHADER_FRAGMENT, 0, 0, 1, NULL);
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   if (state->vs)
+      pipe->delete_vs_state(pipe, state->vs);
+   if (state->fs)
+      pipe->delete_fs_state(pipe, state->fs);
+   if (state->velems)
+      pipe->delete_vertex_elements_state(pipe, state->velems);
+   if (state->rast)
+      pipe->delete_rasterizer_state(pipe, state->rast);
+   if (state->dsa)
+      pipe->delete_depth_stencil_alpha_state(pipe, state->dsa);
+   for (unsigned i = 0; i < 2; i++) {
+      if (state->sampler[i])
+         pipe->delete_sampler_state(pipe, state->sampler[i]);
+   }
+   for (unsigned i = 0; i < NUM_LINEAR_BLENDS; i++) {
+      if (state->blend[i])
+         pipe->delete_blend_state(pipe, state->blend[i]);
+   }
+
+   for (unsigned i = 0; i < NUM_TEXTURES; i++) {
+      pipe_sampler_view_reference(&state->view[i], NULL);
+      pipe_resource_reference(&state->tex[i], NULL);
+   }
+   pipe_resource_reference(&state->vbuf, NULL);
+   pipe_resource_reference(&state->cbuf, NULL);
+}
+
+
+/**
+ * Clear, then draw every rectangle in a single scene.
+ */
+static void
+draw_frame(struct pipe_context *pipe, const struct linear_test_state *state)
+{
+   struct pipe_screen *screen = pipe->screen;
+   union pipe_color_union color;
+   struct pipe_draw_info info;
+   struct pipe_draw_start_count_bias draw;
+   struct pipe_fence_handle *fence = NULL;
+
+   memset(&color, 0, sizeof color);
+   pipe->clear(pipe, PIPE_CLEAR_COLOR, NULL, &color, 1.0, 0);
+
+   memset(&info, 0, sizeof info);
+   info.mode = MESA_PRIM_TRIANGLES;
+   info.instance_count = 1;
+
+   for (unsigned d = 0; d < ARRAY_SIZE(draws); d++) {
+      const struct linear_draw *step = &draws[d];
+      struct pipe_sampler_view *view = state->view[step->texture];
+      void *sampler = state->sampler[step->repeat];
+
+      pipe->bind_blend_state(pipe, state->blend[step->blend]);
+      pipe->set_sampler_views(pipe, MESA_SHADER_FRAGMENT, 0, 1, 0, &view);
+      pipe->bind_sampler_states(pipe, MESA_SHADER_FRAGMENT, 0, 1, &sampler);
+
+      memset(&draw, 0, sizeof draw);
+      draw.start = d * 6;
+      draw.count = 6;
+      pipe->draw_vbo(pipe, &info, 0, NULL, &draw, 1);
+   }
+
+   pipe->flush(pipe, &fence, 0);
+   screen->fence_finish(screen, NULL, fence, OS_TIMEOUT_INFINITE);
+   screen->fence_reference(screen, &fence, NULL);
+}
+
+
+/**
+ * Read the color buffer back as RGBA8, so that every format compares the
+ * same way.
+ */
+static uint8_t *
+read_image(struct pipe_context *pipe, struct pipe_resource *res)
+{
+   struct pipe_transfer *transfer;
+   uint8_t *image = MALLOC(WIDTH * HEIGHT * 4);
+   const uint8_t *map;
+
+   if (!image)
+      return NULL;
+
+   map = pipe_texture_map(pipe, res, 0, 0, PIPE_MAP_READ,
+                          0, 0, WIDTH, HEIGHT, &transfer);
+   if (!map) {
+      FREE(image);
+      return NULL;
+   }
+
+   util_format_unpack_rgba_8unorm_rect(res->format, image, WIDTH * 4,
+                                       map, transfer->stride, WIDTH, HEIGHT);
+
+   pipe_texture_unmap(pipe, transfer);
+
+   return image;
+}
+
+
+/**
+ * Render num_frames frames on a new context, so that the shader variants
+ * get compiled with the current LP_PERF flags, and read back the color
+ * buffer.
+ */
+static bool
+render_frames(struct pipe_screen *screen, enum pipe_format cbuf_format,
+              unsigned num_frames, double *msecs, uint8_t **color)
+{
+   struct llvmpipe_screen *lp_screen = llvmpipe_screen(screen);
+   struct linear_test_state state;
+   bool success = false;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe)
+      return false;
+
+   if (create_state(pipe, &state, cbuf_format)) {
+      /* Compile the shader variants, and time their optimized code */
+      draw_frame(pipe, &state);
+      if (util_queue_is_initialized(&lp_screen->fs_optimize_queue))
+         util_queue_finish(&lp_screen->fs_optimize_queue);
+
+      int64_t t0 = os_time_get_nano();
+      for (unsigned f = 0; f < num_frames; f++)
+         draw_frame(pipe, &state);
+      int64_t t1 = os_time_get_nano();
+
+      *msecs = (t1 - t0) / 1000000.0 / num_frames;
+
+      *color = read_image(pipe, state.cbuf);
+      success = *color != NULL;
+   }
+
+   destroy_state(pipe, &state);
+   pipe->destroy(pipe);
+
+   return success;
+}
+
+
+/**
+ * The linear path filters with 8-bit weights and blends in 8 bits, and
+ * the SoA pipeline in floats, so allow a few units in the last place of
+ * the narrowest channel.
+ */
+static unsigned
+max_allowed_diff(enum pipe_format format)
+{
+   const struct util_format_description *desc =
+      util_format_description(format);
+   unsigned bits = 8;
+
+   for (unsigned c = 0; c < desc->nr_channels; c++) {
+      if (desc->channel[c].size)
+         bits = MIN2(bits, desc->channel[c].size);
+   }
+
+   return DIV_ROUND_UP(4 * 255, (1 << bits) - 1);
+}
+
+
+static bool
+test_linear(unsigned verbose, FILE *fp, unsigned format,
+            unsigned num_threads, unsigned num_frames)
+{
+   const enum pipe_format cbuf_format = formats[format];
+   const int saved_perf = LP_PERF;
+   uint8_t *color[2] = { NULL };
+   double msecs[2] = { 0.0 };
+   unsigned max_diff = 0;
+   bool success = false;
+
+   /* The number of threads is picked when the screen is set up */
+   set_num_threads(num_threads);
+
+   struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+   if (screen) {
+      success = true;
+      for (unsigned linear = 0; linear < 2; linear++) {
+         LP_PERF = linear ? saved_perf & ~PERF_NO_RAST_LINEAR
+                          : saved_perf | PERF_NO_RAST_LINEAR;
+
+         if (!render_frames(screen, cbuf_format, num_frames,
+                            &msecs[linear], &color[linear]))
+            success = false;
+      }
+      LP_PERF = saved_perf;
+      screen->destroy(screen);
+   }
+
+   if (success) {
+      for (unsigned i = 0; i < WIDTH * HEIGHT * 4; i++)
+         max_diff = MAX2(max_diff, abs(color[0][i] - color[1][i]));
+
+      if (max_diff > max_allowed_diff(cbuf_format)) {
+         if (verbose < 1)
+            fprintf(stderr, "%s threads %u: linear differs by %u\n",
+                    util_format_short_name(cbuf_format), num_threads,
+                    max_diff);
+         success = false;
+      }
+   }
+
+   if (verbose >= 1) {
+      printf("%-20s threads %3u: max diff %3u %8.3f ms soa %8.3f ms linear "
+             "(%.2fx)  %s\n", util_format_short_name(cbuf_format),
+             num_threads, max_diff, msecs[0], msecs[1],
+             msecs[1] > 0.0 ? msecs[0] / msecs[1] : 0.0,
+             success ? "PASS" : "FAIL");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%u\t%u\t%.3f\t%.3f\n",
+              success ? "pass" : "fail", util_format_short_name(cbuf_format),
+              num_threads, max_diff, msecs[0], msecs[1]);
+      fflush(fp);
+   }
+
+   for (unsigned linear = 0; linear < 2; linear++)
+      FREE(color[linear]);
+
+   return success;
+}
+
+
+/**
+ * Render every format on the calling thread and on a few rasterizer
+ * threads.
+ */
+static bool
+test_formats(unsigned verbose, FILE *fp, unsigned num_frames)
+{
+   const unsigned thread_counts[] = {
+      0, MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 4), LP_MAX_THREADS),
+   };
+   bool success = true;
+
+   for (unsigned f = 0; f < ARRAY_SIZE(formats); f++) {
+      for (unsigned t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+         if (!test_linear(verbose, fp, f, thread_counts[t], num_frames))
+            success = false;
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_formats(verbose, fp, 20);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_formats(verbose, fp, MAX2(n / 500, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_linear(verbose, fp, 0, 0, 1);
+}
@@ -0,0 +1,581 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+
+/**
+ * @file
+ * Binning of large draws on the pool threads.
+ *
+ * Renders a mesh of about a million triangles, two wavy sheets crossing
+ * each other behind a couple of large occluders, with and without binning
+ * on the pool threads, for 1 to N threads.  Checks the images match the
+ * one rendered without hierarchical depth culling and measures the time
+ * per frame.
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_shader_tokens.h"
+#include "pipe/p_state.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+#include "util/os_time.h"
+#include "sw/null/null_sw_winsys.h"
+
+#include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+#define WIDTH  1920
+#define HEIGHT 1080
+
+/** Quads per side of each sheet, 2 * 500 * 500 * 2 triangles */
+#define GRID 500
+
+/** Large quads drawn ahead of the sheets, which hide parts of them */
+#define NUM_OCCLUDERS 2
+
+
+/**
+ * The passes rendered for each thread count.  The first one, without
+ * Hi-Z, is the reference for the others.
+ */
+static const struct {
+   const char *name;
+   int perf;     /**< LP_PERF flags */
+} passes[] = {
+   { "no_hiz", PERF_NO_HIZ | PERF_NO_MT_SETUP },
+   { "serial", PERF_NO_MT_SETUP },
+   { "mt", 0 },
+};
+
+#define NUM_PASSES ARRAY_SIZE(passes)
+
+
+struct setup_mt_test_state {
+   struct pipe_resource *cbuf;
+   struct pipe_resource *zsbuf;
+   struct pipe_resource *vbuf;
+   struct pipe_resource *ibuf;
+   unsigned num_indices;
+
+   void *blend;
+   void *dsa;
+   void *rast;
+   void *velems;
+   void *vs;
+   void *fs;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "threads\t"
+           "triangles\t"
+           "msecs_no_hiz\t"
+           "msecs_serial\t"
+           "msecs_mt\n");
+
+   fflush(fp);
+}
+
+
+static void
+set_num_threads(unsigned num_threads)
+{
+   char value[16];
+
+   snprintf(value, sizeof value, "%u", num_threads);
+#ifdef _WIN32
+   _putenv_s("LP_NUM_THREADS", value);
+#else
+   setenv("LP_NUM_THREADS", value, 1);
+#endif
+}
+
+
+static struct pipe_resource *
+create_texture(struct pipe_screen *screen, enum pipe_format format,
+               unsigned bind)
+{
+   struct pipe_resource templ;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = WIDTH;
+   templ.height0 = HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = bind;
+
+   return screen->resource_create(screen, &templ);
+}
+
+
+static void
+set_vertex(float *v, float x, float y, float z, float r, float g, float b)
+{
+   v[0] = x;
+   v[1] = y;
+   v[2] = z;
+   v[3] = 1.0f;
+   v[4] = r;
+   v[5] = g;
+   v[6] = b;
+   v[7] = 1.0f;
+}
+
+
+/**
+ * Two sheets of grid x grid quads across the framebuffer, in window
+ * coordinates, with the depth of one going up where the other goes down.
+ *
+ * They are preceded by the occluders: a flat quad whose edges are not
+ * tile aligned, and a sloped one.  Both cover whole tiles and 16x16
+ * blocks, so the sheets get culled behind them.
+ */
+static bool
+create_mesh(struct pipe_context *pipe, struct setup_mt_test_state *state,
+            unsigned grid)
+{
+   const unsigned n = grid + 1;
+   const unsigned num_vertices = 2 * n * n + NUM_OCCLUDERS * 4;
+   float *vertices = MALLOC(num_vertices * 8 * sizeof(float));
+   uint32_t *indices;
+
+   state->num_indices = NUM_OCCLUDERS * 6 + 2 * grid * grid * 6;
+   indices = MALLOC(state->num_indices * sizeof(uint32_t));
+
+   if (!vertices || !indices) {
+      FREE(vertices);
+      FREE(indices);
+      return false;
+   }
+
+   for (unsigned s = 0; s < 2; s++) {
+      for (unsigned y = 0; y < n; y++) {
+         for (unsigned x = 0; x < n; x++) {
+            float *v = vertices + ((s * n + y) * n + x) * 8;
+            const float u = (float)x / grid;
+            const float w = (float)y / grid;
+            const float z = 0.5f + 0.25f * sinf(u * 12.0f) * cosf(w * 9.0f);
+
+            set_vertex(v, u * WIDTH, w * HEIGHT, s ? 1.0f - z : z, u, w, s);
+         }
+      }
+   }
+
+   float *v = vertices + 2 * n * n * 8;
+   set_vertex(v + 0, 0.11f * WIDTH + 0.5f, 0.13f * HEIGHT + 0.25f, 0.45f,
+              1.0f, 1.0f, 1.0f);
+   set_vertex(v + 8, 0.47f * WIDTH + 0.5f, 0.13f * HEIGHT + 0.25f, 0.45f,
+              1.0f, 1.0f, 1.0f);
+   set_vertex(v + 16, 0.11f * WIDTH + 0.5f, 0.81f * HEIGHT + 0.25f, 0.45f,
+              1.0f, 1.0f, 1.0f);
+   set_vertex(v + 24, 0.47f * WIDTH + 0.5f, 0.81f * HEIGHT + 0.25f, 0.45f,
+              1.0f, 1.0f, 1.0f);
+   set_vertex(v + 32, 0.55f * WIDTH, 0.3f * HEIGHT, 0.3f,
+              0.5f, 0.5f, 0.5f);
+   set_vertex(v + 40, 0.95f * WIDTH, 0.3f * HEIGHT, 0.6f,
+              0.5f, 0.5f, 0.5f);
+   set_vertex(v + 48, 0.55f * WIDTH, 0.9f * HEIGHT, 0.4f,
+              0.5f, 0.5f, 0.5f);
+   set_vertex(v + 56, 0.95f * WIDTH, 0.9f * HEIGHT, 0.7f,
+              0.5f, 0.5f, 0.5f);
+
+   uint32_t *index = indices;
+   for (unsigned o = 0; o < NUM_OCCLUDERS; o++) {
+      const uint32_t base = 2 * n * n + o * 4;
+      *index++ = base;
+      *index++ = base + 1;
+      *index++ = base + 2;
+      *index++ = base + 1;
+      *index++ = base + 3;
+      *index++ = base + 2;
+   }
+   for (unsigned s = 0; s < 2; s++) {
+      for (unsigned y = 0; y < grid; y++) {
+         for (unsigned x = 0; x < grid; x++) {
+            const uint32_t base = (s * n + y) * n + x;
+            *index++ = base;
+            *index++ = base + 1;
+            *index++ = base + n;
+            *index++ = base + 1;
+            *index++ = base + n + 1;
+            *index++ = base + n;
+         }
+      }
+   }
+
+   state->vbuf = pipe_buffer_create_with_data(pipe, PIPE_BIND_VERTEX_BUFFER,
+                                              PIPE_USAGE_IMMUTABLE,
+                                              num_vertices * 8 * sizeof(float),
+                                              vertices);
+   state->ibuf = pipe_buffer_create_with_data(pipe, PIPE_BIND_INDEX_BUFFER,
+                                              PIPE_USAGE_IMMUTABLE,
+                                              state->num_indices *
+                                              sizeof(uint32_t),
+                                              indices);
+   FREE(vertices);
+   FREE(indices);
+
+   return state->vbuf && state->ibuf;
+}
+
+
+static bool
+create_state(struct pipe_context *pipe, struct setup_mt_test_state *state,
+             unsigned grid)
+{
+   struct pipe_screen *screen = pipe->screen;
+
+   memset(state, 0, sizeof *state);
+
+   state->cbuf = create_texture(screen, PIPE_FORMAT_B8G8R8A8_UNORM,
+                                PIPE_BIND_RENDER_TARGET);
+   state->zsbuf = create_texture(screen, PIPE_FORMAT_Z32_FLOAT,
+                                 PIPE_BIND_DEPTH_STENCIL);
+   if (!state->cbuf || !state->zsbuf || !create_mesh(pipe, state, grid))
+      return false;
+
+   struct pipe_framebuffer_state fb;
+   memset(&fb, 0, sizeof fb);
+   fb.width = WIDTH;
+   fb.height = HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0].format = state->cbuf->format;
+   fb.cbufs[0].texture = state->cbuf;
+   fb.zsbuf.format = state->zsbuf->format;
+   fb.zsbuf.texture = state->zsbuf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   struct pipe_viewport_state vp;
+   memset(&vp, 0, sizeof vp);
+   vp.scale[0] = WIDTH / 2.0f;
+   vp.scale[1] = HEIGHT / 2.0f;
+   vp.scale[2] = 0.5f;
+   vp.translate[0] = WIDTH / 2.0f;
+   vp.translate[1] = HEIGHT / 2.0f;
+   vp.translate[2] = 0.5f;
+   pipe->set_viewport_states(pipe, 0, 1, &vp);
+
+   struct pipe_blend_state blend;
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   state->blend = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, state->blend);
+
+   struct pipe_depth_stencil_alpha_state dsa;
+   memset(&dsa, 0, sizeof dsa);
+   dsa.depth_enabled = 1;
+   dsa.depth_writemask = 1;
+   dsa.depth_func = PIPE_FUNC_LESS;
+   state->dsa = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, state->dsa);
+
+   struct pipe_rasterizer_state rast;
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast.cull_face = PIPE_FACE_NONE;
+   rast.fill_front = PIPE_POLYGON_MODE_FILL;
+   rast.fill_back = PIPE_POLYGON_MODE_FILL;
+   state->rast = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, state->rast);
+
+   pipe->set_sample_mask(pipe, ~0);
+
+   struct pipe_vertex_element velems[2];
+   memset(velems, 0, sizeof velems);
+   for (unsigned i = 0; i < 2; i++) {
+      velems[i].src_offset = i * 4 * sizeof(float);
+      velems[i].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+      velems[i].src_stride = 8 * sizeof(float);
+   }
+   state->velems = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, state->velems);
+
+   struct pipe_vertex_buffer vb;
+   memset(&vb, 0, sizeof vb);
+   pipe_resource_reference(&vb.buffer.resource, state->vbuf);
+   pipe->set_vertex_buffers(pipe, 1, &vb);
+
+   const enum tgsi_semantic semantic_names[] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_COLOR
+   };
+   const unsigned semantic_indexes[] = { 0, 0 };
+   state->vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                                   semantic_indexes, true);
+   state->fs =
+      util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_COLOR,
+                                            TGSI_INTERPOLATE_PERSPECTIVE,
+                                            true);
+   if (!state->vs || !state->fs)
+      return false;
+
+   pipe->bind_vs_state(pipe, state->vs);
+   pipe->bind_fs_state(pipe, state->fs);
+
+   return true;
+}
+
+
+static void
+destroy_state(struct pipe_context *pipe, struct setup_mt_test_state *state)
+{
+   struct pipe_framebuffer_state fb;
+
+   memset(&fb, 0, sizeof fb);
+   pipe->set_framebuffer_state(pipe, &fb);
+   pipe->set_vertex_buffers(pipe, 0, NULL);
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->bind_fs_state(pipe, NULL);
+   if (state->vs)
+      pipe->delete_vs_state(pipe, state->vs);
+   if (state->fs)
+      pipe->delete_fs_state(pipe, state->fs);
+   if (state->velems)
+      pipe->delete_vertex_elements_state(pipe, state->velems);
+   if (state->rast)
+      pipe->delete_rasterizer_state(pipe, state->rast);
+   if (state->dsa)
+      pipe->delete_depth_stencil_alpha_state(pipe, state->dsa);
+   if (state->blend)
+      pipe->delete_blend_state(pipe, state->blend);
+
+   pipe_resource_reference(&state->ibuf, NULL);
+   pipe_resource_reference(&state->vbuf, NULL);
+   pipe_resource_reference(&state->zsbuf, NULL);
+   pipe_resource_reference(&state->cbuf, NULL);
+}
+
+
+static void
+draw_frame(struct pipe_context *pipe, const struct setup_mt_test_state *state)
+{
+   struct pipe_screen *screen = pipe->screen;
+   union pipe_color_union color;
+   struct pipe_draw_info info;
+   struct pipe_draw_start_count_bias draw;
+   struct pipe_fence_handle *fence = NULL;
+
+   memset(&color, 0, sizeof color);
+   pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTH, NULL, &color,
+               1.0, 0);
+
+   memset(&info, 0, sizeof info);
+   info.mode = MESA_PRIM_TRIANGLES;
+   info.index_size = 4;
+   info.index.resource = state->ibuf;
+   info.instance_count = 1;
+   info.max_index = ~0;
+
+   memset(&draw, 0, sizeof draw);
+   draw.count = state->num_indices;
+
+   pipe->draw_vbo(pipe, &info, 0, NULL, &draw, 1);
+
+   pipe->flush(pipe, &fence, 0);
+   screen->fence_finish(screen, NULL, fence, OS_TIMEOUT_INFINITE);
+   screen->fence_reference(screen, &fence, NULL);
+}
+
+
+static uint32_t *
+read_image(struct pipe_context *pipe, struct pipe_resource *cbuf)
+{
+   struct pipe_transfer *transfer;
+   uint32_t *image = MALLOC(WIDTH * HEIGHT * sizeof(uint32_t));
+   const uint8_t *map;
+
+   if (!image)
+      return NULL;
+
+   map = pipe_texture_map(pipe, cbuf, 0, 0, PIPE_MAP_READ,
+                          0, 0, WIDTH, HEIGHT, &transfer);
+   if (!map) {
+      FREE(image);
+      return NULL;
+   }
+
+   for (unsigned y = 0; y < HEIGHT; y++)
+      memcpy(image + y * WIDTH, map + y * transfer->stride,
+             WIDTH * sizeof(uint32_t));
+
+   pipe_texture_unmap(pipe, transfer);
+
+   return image;
+}
+
+
+/**
+ * Render num_frames frames on a new context, so that the shader variants
+ * get compiled with the LP_PERF flags of the pass.
+ */
+static bool
+render_pass(struct pipe_screen *screen, unsigned grid, unsigned num_frames,
+            double *msecs, uint32_t **image)
+{
+   struct setup_mt_test_state state;
+   bool success = false;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe)
+      return false;
+
+   if (create_state(pipe, &state, grid)) {
+      /* Compile the shader variants */
+      draw_frame(pipe, &state);
+
+      int64_t t0 = os_time_get_nano();
+      for (unsigned f = 0; f < num_frames; f++)
+         draw_frame(pipe, &state);
+      int64_t t1 = os_time_get_nano();
+
+      *msecs = (t1 - t0) / 1000000.0 / num_frames;
+
+      *image = read_image(pipe, state.cbuf);
+      success = *image != NULL;
+   }
+
+   destroy_state(pipe, &state);
+   pipe->destroy(pipe);
+
+   return success;
+}
+
+
+static bool
+test_setup_mt(unsigned verbose, FILE *fp, unsigned num_threads,
+              unsigned grid, unsigned num_frames)
+{
+   const unsigned num_tris = NUM_OCCLUDERS * 2 + 2 * grid * grid * 2;
+   const int saved_perf = LP_PERF;
+   const int perf = saved_perf & ~(PERF_NO_HIZ | PERF_NO_MT_SETUP);
+   uint32_t *images[NUM_PASSES] = { NULL };
+   double msecs[NUM_PASSES] = { 0.0 };
+   bool success = true;
+
+   set_num_threads(num_threads);
+
+   for (unsigned pass = 0; pass < NUM_PASSES; pass++) {
+      struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+      if (screen) {
+         LP_PERF = perf | passes[pass].perf;
+         if (!render_pass(screen, grid, num_frames, &msecs[pass],
+                          &images[pass]))
+            success = false;
+         screen->destroy(screen);
+      } else {
+         success = false;
+      }
+
+      LP_PERF = saved_perf;
+   }
+
+   for (unsigned pass = 1; success && pass < NUM_PASSES; pass++) {
+      if (memcmp(images[0], images[pass],
+                 WIDTH * HEIGHT * sizeof(uint32_t)) != 0) {
+         if (verbose < 1)
+            fprintf(stderr, "threads %u: %s image differs\n",
+                    num_threads, passes[pass].name);
+         success = false;
+      }
+   }
+
+   if (verbose >= 1) {
+      printf("threads %3u tris %8u:", num_threads, num_tris);
+      for (unsigned pass = 0; pass < NUM_PASSES; pass++)
+         printf(" %8.2f ms %s", msecs[pass], passes[pass].name);
+      printf("  %s\n", success ? "PASS" : "FAIL");
+      fflush(stdout);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%u", success ? "pass" : "fail",
+              num_threads, num_tris);
+      for (unsigned pass = 0; pass < NUM_PASSES; pass++)
+         fprintf(fp, "\t%.2f", msecs[pass]);
+      fprintf(fp, "\n");
+      fflush(fp);
+   }
+
+   for (unsigned pass = 0; pass < NUM_PASSES; pass++)
+      FREE(images[pass]);
+
+   return success;
+}
+
+
+/**
+ * The number of threads to test up to: the number of CPUs, but at least a
+ * few so that the threaded paths get covered on small machines too.
+ */
+static unsigned
+max_test_threads(void)
+{
+   return MIN2(MAX2(util_get_cpu_caps()->nr_cpus, 4), LP_MAX_CS_THREADS);
+}
+
+
+/**
+ * Render the mesh with 1, 2, 4, ... threads up to max_test_threads().
+ */
+static bool
+test_scaling(unsigned verbose, FILE *fp, unsigned grid, unsigned num_frames)
+{
+   const unsigned max_threads = max_test_threads();
+   bool success = true;
+
+   for (unsigned t = 1; ; t = MIN2(t * 2, max_threads)) {
+      if (!test_setup_mt(verbose, fp, t, grid, num_frames))
+         success = false;
+      if (t == max_threads)
+         break;
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_scaling(verbose, fp, GRID, 10);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   /* A couple of frames by default, so this stays quick as a unit test */
+   return test_scaling(verbose, fp, GRID, MAX2(n / 500, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_setup_mt(verbose, fp, max_test_threads(), GRID, 1);
+}
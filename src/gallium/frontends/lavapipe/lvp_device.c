@@ -1323,6 +1323,12 @@ lvp_physical_device_init(struct lvp_physical_device *device,
    for (unsigned i = 0; i < ARRAY_SIZE(device->drv_options); i++)
       device->drv_options[i] = device->pscreen->nir_options[MIN2(i, MESA_SHADER_COMPUTE)];
 
+   /* Share the llvmpipe shader cache, so that the lowered NIR and the JIT
+    * code end up next to each other. It's owned by the screen.
+    */
+   if (device->pscreen->get_disk_shader_cache)
+      device->vk.disk_cache = device->pscreen->get_disk_shader_cache(device->pscreen);
+
    device->sync_timeline_type = vk_sync_timeline_get_type(&lvp_pipe_sync_type);
    device->sync_types[0] = &lvp_pipe_sync_type;
    device->sync_types[1] = &device->sync_timeline_type.sync;
@@ -1837,6 +1843,15 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    lvp_device_init_accel_struct_state(device);
 
+   struct vk_pipeline_cache_create_info cache_info = {
+      .weak_ref = true,
+   };
+   device->vk.mem_cache = vk_pipeline_cache_create(&device->vk, &cache_info, NULL);
+   if (!device->vk.mem_cache) {
+      lvp_DestroyDevice(lvp_device_to_handle(device), pAllocator);
+      return vk_error(physical_device, VK_ERROR_OUT_OF_HOST_MEMORY);
+   }
+
    *pDevice = lvp_device_to_handle(device);
 
    return VK_SUCCESS;
@@ -1853,6 +1868,9 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
 
    vk_meta_device_finish(&device->vk, &device->meta);
 
+   if (device->vk.mem_cache)
+      vk_pipeline_cache_destroy(device->vk.mem_cache, NULL);
+
    util_dynarray_foreach(&device->bda_texture_handles, struct lp_texture_handle *, handle)
       device->queue.ctx->delete_texture_handle(device->queue.ctx, (uint64_t)(uintptr_t)*handle);
 
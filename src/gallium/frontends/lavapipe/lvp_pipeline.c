@@ -27,6 +27,7 @@
 #include "vk_render_pass.h"
 #include "vk_util.h"
 #include "glsl_types.h"
+#include "util/mesa-sha1.h"
 #include "util/os_time.h"
 #include "spirv/nir_spirv.h"
 #include "nir/nir_builder.h"
@@ -472,14 +473,69 @@ lvp_shader_init(struct lvp_shader *shader, nir_shader *nir)
    shader->pipeline_nir = lvp_create_pipeline_nir(nir);
 }
 
+/* Computes the key of the lowered NIR in the pipeline cache. Besides the
+ * stage itself, the lowering depends on the pipeline layout and type.
+ */
+static void
+lvp_hash_shader_stage(struct lvp_pipeline *pipeline, const void *pipeline_pNext,
+                      const VkPipelineShaderStageCreateInfo *sinfo,
+                      unsigned char *sha1)
+{
+   struct vk_pipeline_robustness_state robustness;
+   unsigned char stage_sha1[SHA1_DIGEST_LENGTH];
+   struct mesa_sha1 ctx;
+
+   vk_pipeline_robustness_state_fill(&pipeline->device->vk, &robustness,
+                                     pipeline_pNext, sinfo->pNext);
+   vk_pipeline_hash_shader_stage(pipeline->flags, sinfo, &robustness, stage_sha1);
+
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, stage_sha1, sizeof(stage_sha1));
+   _mesa_sha1_update(&ctx, &pipeline->type, sizeof(pipeline->type));
+
+   if (pipeline->layout) {
+      const struct vk_pipeline_layout *layout = &pipeline->layout->vk;
+
+      for (uint32_t i = 0; i < layout->set_count; i++) {
+         if (layout->set_layouts[i])
+            _mesa_sha1_update(&ctx, layout->set_layouts[i]->blake3,
+                              sizeof(layout->set_layouts[i]->blake3));
+      }
+      _mesa_sha1_update(&ctx, &pipeline->layout->push_constant_size,
+                        sizeof(pipeline->layout->push_constant_size));
+   }
+
+   _mesa_sha1_final(&ctx, sha1);
+}
+
 static VkResult
-lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline, const void *pipeline_pNext,
+lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline, struct vk_pipeline_cache *cache,
+                         const void *pipeline_pNext,
                          const VkPipelineShaderStageCreateInfo *sinfo)
 {
    mesa_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
    assert(stage <= LVP_SHADER_STAGES && stage != MESA_SHADER_NONE);
-   nir_shader *nir;
-   VkResult result = lvp_spirv_to_nir(pipeline, pipeline_pNext, sinfo, &nir);
+   unsigned char sha1[SHA1_DIGEST_LENGTH];
+   nir_shader *nir = NULL;
+   VkResult result = VK_SUCCESS;
+
+   /* Execution graph lowering depends on the other nodes of the graph. */
+   if (pipeline->type == LVP_PIPELINE_EXEC_GRAPH)
+      cache = NULL;
+
+   if (cache) {
+      lvp_hash_shader_stage(pipeline, pipeline_pNext, sinfo, sha1);
+      nir = vk_pipeline_cache_lookup_nir(cache, sha1, sizeof(sha1),
+                                         pipeline->device->physical_device->drv_options[stage],
+                                         NULL, NULL);
+   }
+
+   if (!nir) {
+      result = lvp_spirv_to_nir(pipeline, pipeline_pNext, sinfo, &nir);
+      if (result == VK_SUCCESS && cache)
+         vk_pipeline_cache_add_nir(cache, sha1, sizeof(sha1), nir);
+   }
+
    if (result == VK_SUCCESS) {
       struct lvp_shader *shader = &pipeline->shaders[stage];
       lvp_shader_init(shader, nir);
@@ -744,7 +800,7 @@ copy_shader_sanitized(struct lvp_shader *dst, const struct lvp_shader *src)
 static VkResult
 lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
                            struct lvp_device *device,
-                           struct lvp_pipeline_cache *cache,
+                           struct vk_pipeline_cache *cache,
                            const VkGraphicsPipelineCreateInfo *pCreateInfo,
                            VkPipelineCreateFlagBits2KHR flags)
 {
@@ -842,7 +898,7 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          if (!(pipeline->stages & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
             continue;
       }
-      result = lvp_shader_compile_to_ir(pipeline, pCreateInfo->pNext, sinfo);
+      result = lvp_shader_compile_to_ir(pipeline, cache, pCreateInfo->pNext, sinfo);
       if (result != VK_SUCCESS)
          goto fail;
 
@@ -941,10 +997,13 @@ lvp_graphics_pipeline_create(
    bool group)
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
    VkResult result;
 
+   if (!cache)
+      cache = device->vk.mem_cache;
+
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO);
 
    pipeline = vk_zalloc(&device->vk.alloc, sizeof(*pipeline), 8,
@@ -1013,7 +1072,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
 static VkResult
 lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
                           struct lvp_device *device,
-                          struct lvp_pipeline_cache *cache,
+                          struct vk_pipeline_cache *cache,
                           const VkComputePipelineCreateInfo *pCreateInfo,
                           VkPipelineCreateFlagBits2KHR flags)
 {
@@ -1025,7 +1084,7 @@ lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
 
    pipeline->type = LVP_PIPELINE_COMPUTE;
 
-   VkResult result = lvp_shader_compile_to_ir(pipeline, pCreateInfo->pNext, &pCreateInfo->stage);
+   VkResult result = lvp_shader_compile_to_ir(pipeline, cache, pCreateInfo->pNext, &pCreateInfo->stage);
    if (result != VK_SUCCESS)
       return result;
 
@@ -1046,10 +1105,13 @@ lvp_compute_pipeline_create(
    VkPipeline *pPipeline)
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
    VkResult result;
 
+   if (!cache)
+      cache = device->vk.mem_cache;
+
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO);
 
    pipeline = vk_zalloc(&device->vk.alloc, sizeof(*pipeline), 8,
@@ -201,6 +201,7 @@ struct st_config_options
    bool transcode_etc;
    bool transcode_astc;
    bool allow_compressed_fallback;
+   int bptc_compress_quality;
    char *force_gl_vendor;
    char *force_gl_renderer;
    char *mesa_extension_override;
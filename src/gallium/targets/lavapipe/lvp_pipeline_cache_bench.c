@@ -0,0 +1,207 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Creates compute pipelines from many threads against one VkPipelineCache,
+ * first with an empty cache and then again with every pipeline in it, and
+ * prints the pipeline creation rate of both rounds.
+ *
+ * usage: lvp_pipeline_cache_bench [-t threads] [-n pipelines] [-d] [icd]
+ *
+ * The ICD is loaded directly, without the Vulkan loader, and defaults to
+ * libvulkan_lvp.so.  The on-disk shader cache is disabled unless -d is
+ * given, so that the second round only hits the in-memory cache.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "c11/threads.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+
+#include "lvp_test_util.h"
+
+static struct {
+   PFN_vkCreateComputePipelines CreateComputePipelines;
+   PFN_vkDestroyPipeline DestroyPipeline;
+   VkDevice device;
+   VkPipelineCache cache;
+   VkPipelineLayout layout;
+   VkShaderModule module;
+   unsigned num_threads;
+   unsigned num_pipelines;
+} bench;
+
+struct bench_thread {
+   thrd_t thread;
+   unsigned index;
+   VkResult result;
+};
+
+static int
+create_pipelines(void *data)
+{
+   struct bench_thread *t = data;
+
+   t->result = VK_SUCCESS;
+   for (uint32_t p = t->index; p < bench.num_pipelines; p += bench.num_threads) {
+      const VkSpecializationMapEntry entry = {
+         .constantID = 0,
+         .offset = 0,
+         .size = sizeof(p),
+      };
+      const VkSpecializationInfo spec = {
+         .mapEntryCount = 1,
+         .pMapEntries = &entry,
+         .dataSize = sizeof(p),
+         .pData = &p,
+      };
+      const VkComputePipelineCreateInfo info = {
+         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+         .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = bench.module,
+            .pName = "main",
+            .pSpecializationInfo = &spec,
+         },
+         .layout = bench.layout,
+      };
+      VkPipeline pipeline;
+
+      t->result = bench.CreateComputePipelines(bench.device, bench.cache, 1,
+                                               &info, NULL, &pipeline);
+      if (t->result != VK_SUCCESS)
+         break;
+
+      bench.DestroyPipeline(bench.device, pipeline, NULL);
+   }
+
+   return 0;
+}
+
+/* Returns the number of pipelines created per second. */
+static double
+run_round(void)
+{
+   struct bench_thread *threads = calloc(bench.num_threads, sizeof(*threads));
+   if (!threads)
+      exit(1);
+
+   int64_t start = os_time_get_nano();
+
+   for (unsigned i = 0; i < bench.num_threads; i++) {
+      threads[i].index = i;
+      if (thrd_create(&threads[i].thread, create_pipelines,
+                      &threads[i]) != thrd_success) {
+         fprintf(stderr, "failed to create a thread\n");
+         exit(1);
+      }
+   }
+
+   for (unsigned i = 0; i < bench.num_threads; i++) {
+      thrd_join(threads[i].thread, NULL);
+      if (threads[i].result != VK_SUCCESS) {
+         fprintf(stderr, "vkCreateComputePipelines failed: %d\n",
+                 threads[i].result);
+         exit(1);
+      }
+   }
+
+   int64_t end = os_time_get_nano();
+   free(threads);
+
+   return bench.num_pipelines * 1e9 / (end - start);
+}
+
+int
+main(int argc, char **argv)
+{
+   const char *icd = LVP_TEST_DEFAULT_ICD;
+   bool disk_cache = false;
+   int opt;
+
+   bench.num_threads = 16;
+   bench.num_pipelines = 256;
+
+   while ((opt = getopt(argc, argv, "t:n:d")) != -1) {
+      switch (opt) {
+      case 't':
+         bench.num_threads = MAX2(atoi(optarg), 1);
+         break;
+      case 'n':
+         bench.num_pipelines = MAX2(atoi(optarg), 1);
+         break;
+      case 'd':
+         disk_cache = true;
+         break;
+      default:
+         fprintf(stderr, "usage: %s [-t threads] [-n pipelines] [-d] [icd]\n",
+                 argv[0]);
+         return 1;
+      }
+   }
+   if (optind < argc)
+      icd = argv[optind];
+
+   if (!disk_cache)
+      setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+
+   struct lvp_test_device dev;
+   const struct lvp_test_device_info dev_info = {
+      .app_name = "lvp_pipeline_cache_bench",
+      .api_version = VK_API_VERSION_1_1,
+   };
+   if (!lvp_test_load_icd(&dev, icd))
+      return 1;
+   if (!lvp_test_device_create(&dev, &dev_info))
+      return 1;
+
+   VkDevice device = dev.device;
+   bench.device = device;
+   bench.CreateComputePipelines =
+      LVP_TEST_DEVICE_PROC(&dev, CreateComputePipelines);
+   bench.DestroyPipeline = LVP_TEST_DEVICE_PROC(&dev, DestroyPipeline);
+
+   const VkShaderModuleCreateInfo module_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = lvp_test_cs_spirv_size,
+      .pCode = lvp_test_cs_spirv,
+   };
+   const VkPipelineLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+   };
+   const VkPipelineCacheCreateInfo cache_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+   };
+   if (LVP_TEST_DEVICE_PROC(&dev, CreateShaderModule)(
+          device, &module_info, NULL, &bench.module) != VK_SUCCESS ||
+       LVP_TEST_DEVICE_PROC(&dev, CreatePipelineLayout)(
+          device, &layout_info, NULL, &bench.layout) != VK_SUCCESS ||
+       LVP_TEST_DEVICE_PROC(&dev, CreatePipelineCache)(
+          device, &cache_info, NULL, &bench.cache) != VK_SUCCESS) {
+      fprintf(stderr, "failed to create the pipeline objects\n");
+      return 1;
+   }
+
+   double empty = run_round();
+   double full = run_round();
+
+   printf("%u threads, %u pipelines: %.1f pipelines/s with an empty cache, "
+          "%.1f pipelines/s with a full cache\n",
+          bench.num_threads, bench.num_pipelines, empty, full);
+
+   LVP_TEST_DEVICE_PROC(&dev, DestroyPipelineCache)(device, bench.cache, NULL);
+   LVP_TEST_DEVICE_PROC(&dev, DestroyPipelineLayout)(device, bench.layout,
+                                                     NULL);
+   LVP_TEST_DEVICE_PROC(&dev, DestroyShaderModule)(device, bench.module, NULL);
+   lvp_test_device_destroy(&dev);
+   lvp_test_unload_icd(&dev);
+
+   return 0;
+}
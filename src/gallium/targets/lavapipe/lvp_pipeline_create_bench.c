@@ -0,0 +1,415 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Measures the latency of vkCreateGraphicsPipelines and
+ * vkCreateComputePipelines, creating one pipeline at a time, first with an
+ * empty VkPipelineCache and then with a new cache created from the data
+ * vkGetPipelineCacheData returned for the first one, and prints the average
+ * and worst creation time of every round.  Only the calls themselves are
+ * timed; the create infos are filled in beforehand.
+ *
+ * usage: lvp_pipeline_create_bench [-n pipelines] [-d] [icd]
+ *
+ * The ICD is loaded directly, without the Vulkan loader, and defaults to
+ * libvulkan_lvp.so.  The on-disk shader cache is disabled unless -d is
+ * given, so that the warm rounds only hit the serialized cache data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+
+#include "lvp_test_util.h"
+
+/* The fixed-function state, which is the same for every graphics pipeline */
+static const VkVertexInputBindingDescription binding = {
+   .binding = 0,
+   .stride = 4 * sizeof(float),
+   .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+};
+static const VkVertexInputAttributeDescription attribute = {
+   .location = 0,
+   .binding = 0,
+   .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+};
+static const VkPipelineVertexInputStateCreateInfo vertex_input = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+   .vertexBindingDescriptionCount = 1,
+   .pVertexBindingDescriptions = &binding,
+   .vertexAttributeDescriptionCount = 1,
+   .pVertexAttributeDescriptions = &attribute,
+};
+static const VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+   .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+};
+static const VkPipelineViewportStateCreateInfo viewport = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+   .viewportCount = 1,
+   .scissorCount = 1,
+};
+static const VkPipelineRasterizationStateCreateInfo rasterization = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+   .polygonMode = VK_POLYGON_MODE_FILL,
+   .cullMode = VK_CULL_MODE_NONE,
+   .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+   .lineWidth = 1.0f,
+};
+static const VkPipelineMultisampleStateCreateInfo multisample = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+   .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+};
+static const VkPipelineColorBlendAttachmentState attachment = {
+   .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                     VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+};
+static const VkPipelineColorBlendStateCreateInfo color_blend = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+   .attachmentCount = 1,
+   .pAttachments = &attachment,
+};
+static const VkDynamicState dynamic_states[] = {
+   VK_DYNAMIC_STATE_VIEWPORT,
+   VK_DYNAMIC_STATE_SCISSOR,
+};
+static const VkPipelineDynamicStateCreateInfo dynamic = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+   .dynamicStateCount = ARRAY_SIZE(dynamic_states),
+   .pDynamicStates = dynamic_states,
+};
+static const VkFormat color_format = VK_FORMAT_B8G8R8A8_UNORM;
+static const VkPipelineRenderingCreateInfo rendering = {
+   .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+   .colorAttachmentCount = 1,
+   .pColorAttachmentFormats = &color_format,
+};
+
+/* Both the float of the fragment shader and the uint of the compute shader */
+static const VkSpecializationMapEntry spec_entry = {
+   .constantID = 0,
+   .offset = 0,
+   .size = sizeof(uint32_t),
+};
+
+/* What differs between the pipelines: the value of the specialization
+ * constant, which gives every one of them a different cache key.
+ */
+struct pipeline_spec {
+   union {
+      float f;
+      uint32_t u;
+   } value;
+   VkSpecializationInfo info;
+   VkPipelineShaderStageCreateInfo stages[2];
+};
+
+enum pipeline_kind {
+   PIPELINE_GRAPHICS,
+   PIPELINE_COMPUTE,
+};
+
+static struct {
+   PFN_vkCreateGraphicsPipelines CreateGraphicsPipelines;
+   PFN_vkCreateComputePipelines CreateComputePipelines;
+   PFN_vkDestroyPipeline DestroyPipeline;
+   VkDevice device;
+   VkPipelineLayout layout;
+   VkShaderModule vs;
+   VkShaderModule fs;
+   VkShaderModule cs;
+   unsigned num_pipelines;
+
+   struct pipeline_spec *graphics_specs;
+   struct pipeline_spec *compute_specs;
+   VkGraphicsPipelineCreateInfo *graphics_infos;
+   VkComputePipelineCreateInfo *compute_infos;
+} bench;
+
+struct round_stats {
+   double avg_ms;
+   double max_ms;
+};
+
+/* Fills in the create infos of every pipeline up front, so that a round
+ * only times the vkCreate*Pipelines calls.
+ */
+static void
+init_create_infos(void)
+{
+   bench.graphics_specs = calloc(bench.num_pipelines,
+                                 sizeof(*bench.graphics_specs));
+   bench.compute_specs = calloc(bench.num_pipelines,
+                                sizeof(*bench.compute_specs));
+   bench.graphics_infos = calloc(bench.num_pipelines,
+                                 sizeof(*bench.graphics_infos));
+   bench.compute_infos = calloc(bench.num_pipelines,
+                                sizeof(*bench.compute_infos));
+   if (!bench.graphics_specs || !bench.compute_specs ||
+       !bench.graphics_infos || !bench.compute_infos)
+      exit(1);
+
+   for (unsigned p = 0; p < bench.num_pipelines; p++) {
+      struct pipeline_spec *gfx = &bench.graphics_specs[p];
+
+      gfx->value.f = (float)p / bench.num_pipelines;
+      gfx->info = (VkSpecializationInfo) {
+         .mapEntryCount = 1,
+         .pMapEntries = &spec_entry,
+         .dataSize = sizeof(gfx->value),
+         .pData = &gfx->value,
+      };
+      gfx->stages[0] = (VkPipelineShaderStageCreateInfo) {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+         .stage = VK_SHADER_STAGE_VERTEX_BIT,
+         .module = bench.vs,
+         .pName = "main",
+      };
+      gfx->stages[1] = (VkPipelineShaderStageCreateInfo) {
+         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+         .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+         .module = bench.fs,
+         .pName = "main",
+         .pSpecializationInfo = &gfx->info,
+      };
+      bench.graphics_infos[p] = (VkGraphicsPipelineCreateInfo) {
+         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+         .pNext = &rendering,
+         .stageCount = ARRAY_SIZE(gfx->stages),
+         .pStages = gfx->stages,
+         .pVertexInputState = &vertex_input,
+         .pInputAssemblyState = &input_assembly,
+         .pViewportState = &viewport,
+         .pRasterizationState = &rasterization,
+         .pMultisampleState = &multisample,
+         .pColorBlendState = &color_blend,
+         .pDynamicState = &dynamic,
+         .layout = bench.layout,
+      };
+
+      struct pipeline_spec *cs = &bench.compute_specs[p];
+
+      cs->value.u = p;
+      cs->info = (VkSpecializationInfo) {
+         .mapEntryCount = 1,
+         .pMapEntries = &spec_entry,
+         .dataSize = sizeof(cs->value),
+         .pData = &cs->value,
+      };
+      bench.compute_infos[p] = (VkComputePipelineCreateInfo) {
+         .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+         .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = bench.cs,
+            .pName = "main",
+            .pSpecializationInfo = &cs->info,
+         },
+         .layout = bench.layout,
+      };
+   }
+}
+
+static void
+finish_create_infos(void)
+{
+   free(bench.compute_infos);
+   free(bench.graphics_infos);
+   free(bench.compute_specs);
+   free(bench.graphics_specs);
+}
+
+static struct round_stats
+run_round(VkPipelineCache cache, enum pipeline_kind kind)
+{
+   struct round_stats stats = { 0 };
+   int64_t total = 0;
+
+   for (unsigned p = 0; p < bench.num_pipelines; p++) {
+      VkPipeline pipeline;
+      VkResult result;
+      int64_t start, end;
+
+      if (kind == PIPELINE_GRAPHICS) {
+         start = os_time_get_nano();
+         result = bench.CreateGraphicsPipelines(bench.device, cache, 1,
+                                                &bench.graphics_infos[p],
+                                                NULL, &pipeline);
+         end = os_time_get_nano();
+      } else {
+         start = os_time_get_nano();
+         result = bench.CreateComputePipelines(bench.device, cache, 1,
+                                               &bench.compute_infos[p],
+                                               NULL, &pipeline);
+         end = os_time_get_nano();
+      }
+
+      if (result != VK_SUCCESS) {
+         fprintf(stderr, "vkCreate%sPipelines failed: %d\n",
+                 kind == PIPELINE_GRAPHICS ? "Graphics" : "Compute", result);
+         exit(1);
+      }
+      bench.DestroyPipeline(bench.device, pipeline, NULL);
+
+      total += end - start;
+      stats.max_ms = MAX2(stats.max_ms, (end - start) / 1e6);
+   }
+
+   stats.avg_ms = total / 1e6 / bench.num_pipelines;
+
+   return stats;
+}
+
+int
+main(int argc, char **argv)
+{
+   const char *icd = LVP_TEST_DEFAULT_ICD;
+   bool disk_cache = false;
+   int opt;
+
+   bench.num_pipelines = 64;
+
+   while ((opt = getopt(argc, argv, "n:d")) != -1) {
+      switch (opt) {
+      case 'n':
+         bench.num_pipelines = MAX2(atoi(optarg), 1);
+         break;
+      case 'd':
+         disk_cache = true;
+         break;
+      default:
+         fprintf(stderr, "usage: %s [-n pipelines] [-d] [icd]\n", argv[0]);
+         return 1;
+      }
+   }
+   if (optind < argc)
+      icd = argv[optind];
+
+   if (!disk_cache)
+      setenv("MESA_SHADER_CACHE_DISABLE", "true", 1);
+
+   const VkPhysicalDeviceVulkan13Features features13 = {
+      .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+      .dynamicRendering = VK_TRUE,
+   };
+   const struct lvp_test_device_info dev_info = {
+      .app_name = "lvp_pipeline_create_bench",
+      .api_version = VK_API_VERSION_1_3,
+      .device_pnext = &features13,
+   };
+   struct lvp_test_device dev;
+   if (!lvp_test_load_icd(&dev, icd))
+      return 1;
+   if (!lvp_test_device_create(&dev, &dev_info))
+      return 1;
+
+   VkDevice device = dev.device;
+   bench.device = device;
+   bench.CreateGraphicsPipelines =
+      LVP_TEST_DEVICE_PROC(&dev, CreateGraphicsPipelines);
+   bench.CreateComputePipelines =
+      LVP_TEST_DEVICE_PROC(&dev, CreateComputePipelines);
+   bench.DestroyPipeline = LVP_TEST_DEVICE_PROC(&dev, DestroyPipeline);
+   PFN_vkCreatePipelineCache CreatePipelineCache =
+      LVP_TEST_DEVICE_PROC(&dev, CreatePipelineCache);
+   PFN_vkDestroyPipelineCache DestroyPipelineCache =
+      LVP_TEST_DEVICE_PROC(&dev, DestroyPipelineCache);
+   PFN_vkGetPipelineCacheData GetPipelineCacheData =
+      LVP_TEST_DEVICE_PROC(&dev, GetPipelineCacheData);
+
+   const VkShaderModuleCreateInfo vs_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = lvp_test_vs_spirv_size,
+      .pCode = lvp_test_vs_spirv,
+   };
+   const VkShaderModuleCreateInfo fs_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = lvp_test_fs_spirv_size,
+      .pCode = lvp_test_fs_spirv,
+   };
+   const VkShaderModuleCreateInfo cs_info = {
+      .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+      .codeSize = lvp_test_cs_spirv_size,
+      .pCode = lvp_test_cs_spirv,
+   };
+   const VkPipelineLayoutCreateInfo layout_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+   };
+   VkPipelineCacheCreateInfo cache_info = {
+      .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+   };
+   VkPipelineCache cold_cache, warm_cache;
+   if (LVP_TEST_DEVICE_PROC(&dev, CreateShaderModule)(
+          device, &vs_info, NULL, &bench.vs) != VK_SUCCESS ||
+       LVP_TEST_DEVICE_PROC(&dev, CreateShaderModule)(
+          device, &fs_info, NULL, &bench.fs) != VK_SUCCESS ||
+       LVP_TEST_DEVICE_PROC(&dev, CreateShaderModule)(
+          device, &cs_info, NULL, &bench.cs) != VK_SUCCESS ||
+       LVP_TEST_DEVICE_PROC(&dev, CreatePipelineLayout)(
+          device, &layout_info, NULL, &bench.layout) != VK_SUCCESS ||
+       CreatePipelineCache(device, &cache_info, NULL,
+                           &cold_cache) != VK_SUCCESS) {
+      fprintf(stderr, "failed to create the pipeline objects\n");
+      return 1;
+   }
+
+   init_create_infos();
+
+   struct round_stats cold_gfx = run_round(cold_cache, PIPELINE_GRAPHICS);
+   struct round_stats cold_cs = run_round(cold_cache, PIPELINE_COMPUTE);
+
+   /* Round-trip the cache through its serialized data, the way an
+    * application would between runs.
+    */
+   size_t data_size = 0;
+   void *data = NULL;
+   if (GetPipelineCacheData(device, cold_cache, &data_size,
+                            NULL) != VK_SUCCESS ||
+       !(data = malloc(data_size)) ||
+       GetPipelineCacheData(device, cold_cache, &data_size,
+                            data) != VK_SUCCESS) {
+      fprintf(stderr, "vkGetPipelineCacheData failed\n");
+      return 1;
+   }
+   DestroyPipelineCache(device, cold_cache, NULL);
+
+   cache_info.initialDataSize = data_size;
+   cache_info.pInitialData = data;
+   if (CreatePipelineCache(device, &cache_info, NULL,
+                           &warm_cache) != VK_SUCCESS) {
+      fprintf(stderr, "vkCreatePipelineCache failed\n");
+      return 1;
+   }
+   free(data);
+
+   struct round_stats warm_gfx = run_round(warm_cache, PIPELINE_GRAPHICS);
+   struct round_stats warm_cs = run_round(warm_cache, PIPELINE_COMPUTE);
+
+   printf("%u pipelines of each kind, %zu bytes of cache data:\n",
+          bench.num_pipelines, data_size);
+   printf("  graphics: %.3f ms/pipeline (max %.3f) cold, "
+          "%.3f ms/pipeline (max %.3f) warm\n",
+          cold_gfx.avg_ms, cold_gfx.max_ms, warm_gfx.avg_ms, warm_gfx.max_ms);
+   printf("  compute:  %.3f ms/pipeline (max %.3f) cold, "
+          "%.3f ms/pipeline (max %.3f) warm\n",
+          cold_cs.avg_ms, cold_cs.max_ms, warm_cs.avg_ms, warm_cs.max_ms);
+
+   finish_create_infos();
+
+   DestroyPipelineCache(device, warm_cache, NULL);
+   LVP_TEST_DEVICE_PROC(&dev, DestroyPipelineLayout)(device, bench.layout,
+                                                     NULL);
+   LVP_TEST_DEVICE_PROC(&dev, DestroyShaderModule)(device, bench.cs, NULL);
+   LVP_TEST_DEVICE_PROC(&dev, DestroyShaderModule)(device, bench.fs, NULL);
+   LVP_TEST_DEVICE_PROC(&dev, DestroyShaderModule)(device, bench.vs, NULL);
+   lvp_test_device_destroy(&dev);
+   lvp_test_unload_icd(&dev);
+
+   return 0;
+}
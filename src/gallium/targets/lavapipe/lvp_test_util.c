@@ -0,0 +1,282 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "lvp_test_util.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/macros.h"
+
+bool
+lvp_test_load_icd(struct lvp_test_device *dev, const char *icd)
+{
+   memset(dev, 0, sizeof(*dev));
+
+   dev->lib = dlopen(icd, RTLD_NOW | RTLD_LOCAL);
+   if (!dev->lib) {
+      fprintf(stderr, "failed to load %s: %s\n", icd, dlerror());
+      return false;
+   }
+
+   dev->gipa = (PFN_vkGetInstanceProcAddr)dlsym(dev->lib,
+                                                "vk_icdGetInstanceProcAddr");
+   if (!dev->gipa) {
+      fprintf(stderr, "%s is not a Vulkan ICD\n", icd);
+      dlclose(dev->lib);
+      dev->lib = NULL;
+      return false;
+   }
+
+   return true;
+}
+
+void
+lvp_test_unload_icd(struct lvp_test_device *dev)
+{
+   dlclose(dev->lib);
+   dev->lib = NULL;
+   dev->gipa = NULL;
+}
+
+bool
+lvp_test_device_create(struct lvp_test_device *dev,
+                       const struct lvp_test_device_info *info)
+{
+   const char *instance_exts[] = {
+      VK_KHR_SURFACE_EXTENSION_NAME,
+      VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME,
+   };
+   const VkApplicationInfo app_info = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .pApplicationName = info->app_name,
+      .apiVersion = info->api_version,
+   };
+   const VkInstanceCreateInfo instance_info = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &app_info,
+      .enabledExtensionCount = info->headless ? ARRAY_SIZE(instance_exts) : 0,
+      .ppEnabledExtensionNames = instance_exts,
+   };
+   dev->instance = VK_NULL_HANDLE;
+   if (LVP_TEST_INSTANCE_PROC(dev, CreateInstance)(
+          &instance_info, NULL, &dev->instance) != VK_SUCCESS) {
+      fprintf(stderr, "vkCreateInstance failed\n");
+      return false;
+   }
+
+   dev->surface = VK_NULL_HANDLE;
+   if (info->headless) {
+      const VkHeadlessSurfaceCreateInfoEXT surface_info = {
+         .sType = VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT,
+      };
+      if (LVP_TEST_INSTANCE_PROC(dev, CreateHeadlessSurfaceEXT)(
+             dev->instance, &surface_info, NULL, &dev->surface) != VK_SUCCESS) {
+         fprintf(stderr, "vkCreateHeadlessSurfaceEXT failed\n");
+         goto fail_instance;
+      }
+   }
+
+   uint32_t num_pdevs = 1;
+   VkResult result =
+      LVP_TEST_INSTANCE_PROC(dev, EnumeratePhysicalDevices)(dev->instance,
+                                                            &num_pdevs,
+                                                            &dev->pdev);
+   if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || num_pdevs == 0) {
+      fprintf(stderr, "no physical device\n");
+      goto fail_surface;
+   }
+
+   const char *device_exts[] = {
+      VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+   };
+   const float priority = 1.0f;
+   const VkDeviceQueueCreateInfo queue_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueFamilyIndex = 0,
+      .queueCount = 1,
+      .pQueuePriorities = &priority,
+   };
+   const VkDeviceCreateInfo device_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .pNext = info->device_pnext,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queue_info,
+      .enabledExtensionCount = info->headless ? ARRAY_SIZE(device_exts) : 0,
+      .ppEnabledExtensionNames = device_exts,
+   };
+   if (LVP_TEST_INSTANCE_PROC(dev, CreateDevice)(
+          dev->pdev, &device_info, NULL, &dev->device) != VK_SUCCESS) {
+      fprintf(stderr, "vkCreateDevice failed\n");
+      goto fail_surface;
+   }
+
+   dev->gdpa = LVP_TEST_INSTANCE_PROC(dev, GetDeviceProcAddr);
+   LVP_TEST_DEVICE_PROC(dev, GetDeviceQueue)(dev->device, 0, 0, &dev->queue);
+
+   return true;
+
+fail_surface:
+   if (dev->surface != VK_NULL_HANDLE)
+      LVP_TEST_INSTANCE_PROC(dev, DestroySurfaceKHR)(dev->instance,
+                                                     dev->surface, NULL);
+fail_instance:
+   LVP_TEST_INSTANCE_PROC(dev, DestroyInstance)(dev->instance, NULL);
+   dev->instance = VK_NULL_HANDLE;
+   return false;
+}
+
+void
+lvp_test_device_destroy(struct lvp_test_device *dev)
+{
+   LVP_TEST_DEVICE_PROC(dev, DestroyDevice)(dev->device, NULL);
+   if (dev->surface != VK_NULL_HANDLE)
+      LVP_TEST_INSTANCE_PROC(dev, DestroySurfaceKHR)(dev->instance,
+                                                     dev->surface, NULL);
+   LVP_TEST_INSTANCE_PROC(dev, DestroyInstance)(dev->instance, NULL);
+
+   dev->device = VK_NULL_HANDLE;
+   dev->surface = VK_NULL_HANDLE;
+   dev->instance = VK_NULL_HANDLE;
+   dev->gdpa = NULL;
+}
+
+/*
+ *    OpCapability Shader
+ *    OpMemoryModel Logical GLSL450
+ *    OpEntryPoint GLCompute %main "main"
+ *    OpExecutionMode %main LocalSize 1 1 1
+ *    OpDecorate %sc SpecId 0
+ *    %void = OpTypeVoid
+ *    %fn = OpTypeFunction %void
+ *    %uint = OpTypeInt 32 0
+ *    %sc = OpSpecConstant %uint 0
+ *    %main = OpFunction %void None %fn
+ *    %label = OpLabel
+ *    OpReturn
+ *    OpFunctionEnd
+ */
+enum { CS_MAIN = 1, CS_SC, CS_VOID, CS_FN, CS_UINT, CS_LABEL, CS_BOUND };
+
+const uint32_t lvp_test_cs_spirv[] = {
+   0x07230203, 0x00010000, 0, CS_BOUND, 0,
+   (2 << 16) | 17, 1,
+   (3 << 16) | 14, 0, 1,
+   (5 << 16) | 15, 5, CS_MAIN, 0x6e69616d, 0,
+   (6 << 16) | 16, CS_MAIN, 17, 1, 1, 1,
+   (4 << 16) | 71, CS_SC, 1, 0,
+   (2 << 16) | 19, CS_VOID,
+   (3 << 16) | 33, CS_FN, CS_VOID,
+   (4 << 16) | 21, CS_UINT, 32, 0,
+   (4 << 16) | 50, CS_UINT, CS_SC, 0,
+   (5 << 16) | 54, CS_VOID, CS_MAIN, 0, CS_FN,
+   (2 << 16) | 248, CS_LABEL,
+   (1 << 16) | 253,
+   (1 << 16) | 56,
+};
+const size_t lvp_test_cs_spirv_size = sizeof(lvp_test_cs_spirv);
+
+/*
+ *    OpCapability Shader
+ *    OpMemoryModel Logical GLSL450
+ *    OpEntryPoint Vertex %main "main" %pos_in %pos_out
+ *    OpDecorate %pos_in Location 0
+ *    OpDecorate %pos_out BuiltIn Position
+ *    %void = OpTypeVoid
+ *    %fn = OpTypeFunction %void
+ *    %float = OpTypeFloat 32
+ *    %vec4 = OpTypeVector %float 4
+ *    %ptr_in = OpTypePointer Input %vec4
+ *    %ptr_out = OpTypePointer Output %vec4
+ *    %pos_in = OpVariable %ptr_in Input
+ *    %pos_out = OpVariable %ptr_out Output
+ *    %main = OpFunction %void None %fn
+ *    %label = OpLabel
+ *    %value = OpLoad %vec4 %pos_in
+ *    OpStore %pos_out %value
+ *    OpReturn
+ *    OpFunctionEnd
+ */
+enum {
+   VS_MAIN = 1, VS_POS_IN, VS_POS_OUT, VS_VOID, VS_FN, VS_FLOAT, VS_VEC4,
+   VS_PTR_IN, VS_PTR_OUT, VS_LABEL, VS_VALUE, VS_BOUND
+};
+
+const uint32_t lvp_test_vs_spirv[] = {
+   0x07230203, 0x00010000, 0, VS_BOUND, 0,
+   (2 << 16) | 17, 1,
+   (3 << 16) | 14, 0, 1,
+   (7 << 16) | 15, 0, VS_MAIN, 0x6e69616d, 0, VS_POS_IN, VS_POS_OUT,
+   (4 << 16) | 71, VS_POS_IN, 30, 0,
+   (4 << 16) | 71, VS_POS_OUT, 11, 0,
+   (2 << 16) | 19, VS_VOID,
+   (3 << 16) | 33, VS_FN, VS_VOID,
+   (3 << 16) | 22, VS_FLOAT, 32,
+   (4 << 16) | 23, VS_VEC4, VS_FLOAT, 4,
+   (4 << 16) | 32, VS_PTR_IN, 1, VS_VEC4,
+   (4 << 16) | 32, VS_PTR_OUT, 3, VS_VEC4,
+   (4 << 16) | 59, VS_PTR_IN, VS_POS_IN, 1,
+   (4 << 16) | 59, VS_PTR_OUT, VS_POS_OUT, 3,
+   (5 << 16) | 54, VS_VOID, VS_MAIN, 0, VS_FN,
+   (2 << 16) | 248, VS_LABEL,
+   (4 << 16) | 61, VS_VEC4, VS_VALUE, VS_POS_IN,
+   (3 << 16) | 62, VS_POS_OUT, VS_VALUE,
+   (1 << 16) | 253,
+   (1 << 16) | 56,
+};
+const size_t lvp_test_vs_spirv_size = sizeof(lvp_test_vs_spirv);
+
+/*
+ *    OpCapability Shader
+ *    OpMemoryModel Logical GLSL450
+ *    OpEntryPoint Fragment %main "main" %color
+ *    OpExecutionMode %main OriginUpperLeft
+ *    OpDecorate %color Location 0
+ *    OpDecorate %sc SpecId 0
+ *    %void = OpTypeVoid
+ *    %fn = OpTypeFunction %void
+ *    %float = OpTypeFloat 32
+ *    %vec4 = OpTypeVector %float 4
+ *    %ptr_out = OpTypePointer Output %vec4
+ *    %sc = OpSpecConstant %float 0
+ *    %one = OpConstant %float 1
+ *    %value = OpSpecConstantComposite %vec4 %sc %sc %sc %one
+ *    %color = OpVariable %ptr_out Output
+ *    %main = OpFunction %void None %fn
+ *    %label = OpLabel
+ *    OpStore %color %value
+ *    OpReturn
+ *    OpFunctionEnd
+ */
+enum {
+   FS_MAIN = 1, FS_COLOR, FS_SC, FS_ONE, FS_VALUE, FS_VOID, FS_FN, FS_FLOAT,
+   FS_VEC4, FS_PTR_OUT, FS_LABEL, FS_BOUND
+};
+
+const uint32_t lvp_test_fs_spirv[] = {
+   0x07230203, 0x00010000, 0, FS_BOUND, 0,
+   (2 << 16) | 17, 1,
+   (3 << 16) | 14, 0, 1,
+   (6 << 16) | 15, 4, FS_MAIN, 0x6e69616d, 0, FS_COLOR,
+   (3 << 16) | 16, FS_MAIN, 7,
+   (4 << 16) | 71, FS_COLOR, 30, 0,
+   (4 << 16) | 71, FS_SC, 1, 0,
+   (2 << 16) | 19, FS_VOID,
+   (3 << 16) | 33, FS_FN, FS_VOID,
+   (3 << 16) | 22, FS_FLOAT, 32,
+   (4 << 16) | 23, FS_VEC4, FS_FLOAT, 4,
+   (4 << 16) | 32, FS_PTR_OUT, 3, FS_VEC4,
+   (4 << 16) | 50, FS_FLOAT, FS_SC, 0,
+   (4 << 16) | 43, FS_FLOAT, FS_ONE, 0x3f800000,
+   (7 << 16) | 51, FS_VEC4, FS_VALUE, FS_SC, FS_SC, FS_SC, FS_ONE,
+   (4 << 16) | 59, FS_PTR_OUT, FS_COLOR, 3,
+   (5 << 16) | 54, FS_VOID, FS_MAIN, 0, FS_FN,
+   (2 << 16) | 248, FS_LABEL,
+   (3 << 16) | 62, FS_COLOR, FS_VALUE,
+   (1 << 16) | 253,
+   (1 << 16) | 56,
+};
+const size_t lvp_test_fs_spirv_size = sizeof(lvp_test_fs_spirv);
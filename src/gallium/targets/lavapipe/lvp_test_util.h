@@ -0,0 +1,88 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Set up shared by the lavapipe tests and benchmarks.  They load the ICD
+ * directly, without the Vulkan loader, and create an instance and a device
+ * with a single queue on its first physical device.
+ */
+
+#ifndef LVP_TEST_UTIL_H
+#define LVP_TEST_UTIL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan_core.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LVP_TEST_DEFAULT_ICD "libvulkan_lvp.so"
+
+struct lvp_test_device {
+   void *lib;
+   PFN_vkGetInstanceProcAddr gipa;
+   PFN_vkGetDeviceProcAddr gdpa;
+
+   VkInstance instance;
+   VkSurfaceKHR surface;
+   VkPhysicalDevice pdev;
+   VkDevice device;
+   VkQueue queue;
+};
+
+struct lvp_test_device_info {
+   const char *app_name;
+   uint32_t api_version;
+
+   /* Enables the swapchain extensions and creates a headless surface */
+   bool headless;
+
+   /* Chained to VkDeviceCreateInfo, e.g. to enable features */
+   const void *device_pnext;
+};
+
+#define LVP_TEST_INSTANCE_PROC(dev, name) \
+   ((PFN_vk##name)(dev)->gipa((dev)->instance, "vk" #name))
+#define LVP_TEST_DEVICE_PROC(dev, name) \
+   ((PFN_vk##name)(dev)->gdpa((dev)->device, "vk" #name))
+
+bool
+lvp_test_load_icd(struct lvp_test_device *dev, const char *icd);
+
+void
+lvp_test_unload_icd(struct lvp_test_device *dev);
+
+bool
+lvp_test_device_create(struct lvp_test_device *dev,
+                       const struct lvp_test_device_info *info);
+
+void
+lvp_test_device_destroy(struct lvp_test_device *dev);
+
+/* An empty compute shader with a 32-bit unsigned specialization constant
+ * with ID 0, which gives every pipeline a different cache key.
+ */
+extern const uint32_t lvp_test_cs_spirv[];
+extern const size_t lvp_test_cs_spirv_size;
+
+/* A vertex shader passing its vec4 position at location 0 through. */
+extern const uint32_t lvp_test_vs_spirv[];
+extern const size_t lvp_test_vs_spirv_size;
+
+/* A fragment shader writing a gray color made of a float specialization
+ * constant with ID 0 to location 0.
+ */
+extern const uint32_t lvp_test_fs_spirv[];
+extern const size_t lvp_test_fs_spirv_size;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LVP_TEST_UTIL_H */
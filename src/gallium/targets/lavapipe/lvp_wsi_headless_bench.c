@@ -0,0 +1,261 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Clears and presents the images of a headless swapchain in a loop, at 1080p
+ * and at 4K, and prints the number of frames presented per second.
+ *
+ * usage: lvp_wsi_headless_bench [-n frames] [-m] [-s sink] [icd]
+ *
+ * -m uses mailbox instead of FIFO presentation.  -s sets
+ * MESA_VK_WSI_HEADLESS_SINK, e.g. -s file:/dev/null measures the cost of
+ * writing out every frame.  The ICD is loaded directly, without the Vulkan
+ * loader, and defaults to libvulkan_lvp.so.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+
+#include "lvp_test_util.h"
+
+#define MAX_IMAGES 8
+
+static struct {
+   struct lvp_test_device dev;
+   VkPresentModeKHR present_mode;
+   unsigned num_frames;
+} bench;
+
+#define DEV_PROC(name) LVP_TEST_DEVICE_PROC(&bench.dev, name)
+
+static void
+check(VkResult result, const char *what)
+{
+   if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      fprintf(stderr, "%s failed: %d\n", what, result);
+      exit(1);
+   }
+}
+
+static void
+record_clear(VkCommandBuffer cmd, VkImage image, unsigned index)
+{
+   const VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+   };
+   const VkImageSubresourceRange range = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .levelCount = 1,
+      .layerCount = 1,
+   };
+   VkImageMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = image,
+      .subresourceRange = range,
+   };
+   const VkClearColorValue color = {
+      .float32 = { index & 1, (index >> 1) & 1, (index >> 2) & 1, 1.0f },
+   };
+
+   check(DEV_PROC(BeginCommandBuffer)(cmd, &begin_info),
+         "vkBeginCommandBuffer");
+
+   DEV_PROC(CmdPipelineBarrier)(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                0, NULL, 0, NULL, 1, &barrier);
+   DEV_PROC(CmdClearColorImage)(cmd, image,
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                &color, 1, &range);
+
+   barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.dstAccessMask = 0;
+   barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   DEV_PROC(CmdPipelineBarrier)(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                0, NULL, 0, NULL, 1, &barrier);
+
+   check(DEV_PROC(EndCommandBuffer)(cmd), "vkEndCommandBuffer");
+}
+
+/* Returns the number of frames presented per second. */
+static double
+run_size(uint32_t width, uint32_t height)
+{
+   VkDevice device = bench.dev.device;
+
+   const VkSwapchainCreateInfoKHR swapchain_info = {
+      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+      .surface = bench.dev.surface,
+      .minImageCount = 4,
+      .imageFormat = VK_FORMAT_B8G8R8A8_UNORM,
+      .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+      .imageExtent = { width, height },
+      .imageArrayLayers = 1,
+      .imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+      .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+      .presentMode = bench.present_mode,
+      .clipped = VK_TRUE,
+   };
+   VkSwapchainKHR swapchain;
+   check(DEV_PROC(CreateSwapchainKHR)(device, &swapchain_info, NULL,
+                                      &swapchain), "vkCreateSwapchainKHR");
+
+   uint32_t num_images = MAX_IMAGES;
+   VkImage images[MAX_IMAGES];
+   check(DEV_PROC(GetSwapchainImagesKHR)(device, swapchain, &num_images,
+                                         images), "vkGetSwapchainImagesKHR");
+
+   const VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .queueFamilyIndex = 0,
+   };
+   VkCommandPool pool;
+   check(DEV_PROC(CreateCommandPool)(device, &pool_info, NULL, &pool),
+         "vkCreateCommandPool");
+
+   const VkCommandBufferAllocateInfo cmd_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = num_images,
+   };
+   VkCommandBuffer cmds[MAX_IMAGES];
+   check(DEV_PROC(AllocateCommandBuffers)(device, &cmd_info, cmds),
+         "vkAllocateCommandBuffers");
+
+   const VkSemaphoreCreateInfo semaphore_info = {
+      .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+   };
+   const VkFenceCreateInfo fence_info = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+   };
+   VkSemaphore rendered[MAX_IMAGES];
+   VkFence acquired;
+   for (uint32_t i = 0; i < num_images; i++) {
+      record_clear(cmds[i], images[i], i);
+      check(DEV_PROC(CreateSemaphore)(device, &semaphore_info, NULL,
+                                      &rendered[i]), "vkCreateSemaphore");
+   }
+   check(DEV_PROC(CreateFence)(device, &fence_info, NULL, &acquired),
+         "vkCreateFence");
+
+   PFN_vkAcquireNextImageKHR AcquireNextImageKHR =
+      DEV_PROC(AcquireNextImageKHR);
+   PFN_vkWaitForFences WaitForFences = DEV_PROC(WaitForFences);
+   PFN_vkResetFences ResetFences = DEV_PROC(ResetFences);
+   PFN_vkQueueSubmit QueueSubmit = DEV_PROC(QueueSubmit);
+   PFN_vkQueuePresentKHR QueuePresentKHR = DEV_PROC(QueuePresentKHR);
+
+   int64_t start = os_time_get_nano();
+
+   for (unsigned f = 0; f < bench.num_frames; f++) {
+      uint32_t index;
+      check(AcquireNextImageKHR(device, swapchain, UINT64_MAX,
+                                VK_NULL_HANDLE, acquired, &index),
+            "vkAcquireNextImageKHR");
+      check(WaitForFences(device, 1, &acquired, VK_TRUE, UINT64_MAX),
+            "vkWaitForFences");
+      check(ResetFences(device, 1, &acquired), "vkResetFences");
+
+      const VkSubmitInfo submit_info = {
+         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+         .commandBufferCount = 1,
+         .pCommandBuffers = &cmds[index],
+         .signalSemaphoreCount = 1,
+         .pSignalSemaphores = &rendered[index],
+      };
+      check(QueueSubmit(bench.dev.queue, 1, &submit_info, VK_NULL_HANDLE),
+            "vkQueueSubmit");
+
+      const VkPresentInfoKHR present_info = {
+         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+         .waitSemaphoreCount = 1,
+         .pWaitSemaphores = &rendered[index],
+         .swapchainCount = 1,
+         .pSwapchains = &swapchain,
+         .pImageIndices = &index,
+      };
+      check(QueuePresentKHR(bench.dev.queue, &present_info),
+            "vkQueuePresentKHR");
+   }
+
+   /* Destroying the swapchain waits for the sink to take the last frames. */
+   check(DEV_PROC(DeviceWaitIdle)(device), "vkDeviceWaitIdle");
+   DEV_PROC(DestroySwapchainKHR)(device, swapchain, NULL);
+   int64_t end = os_time_get_nano();
+
+   DEV_PROC(DestroyFence)(device, acquired, NULL);
+   for (uint32_t i = 0; i < num_images; i++)
+      DEV_PROC(DestroySemaphore)(device, rendered[i], NULL);
+   DEV_PROC(DestroyCommandPool)(device, pool, NULL);
+
+   return bench.num_frames * 1e9 / (end - start);
+}
+
+int
+main(int argc, char **argv)
+{
+   const char *icd = LVP_TEST_DEFAULT_ICD;
+   int opt;
+
+   bench.num_frames = 300;
+   bench.present_mode = VK_PRESENT_MODE_FIFO_KHR;
+
+   while ((opt = getopt(argc, argv, "n:ms:")) != -1) {
+      switch (opt) {
+      case 'n':
+         bench.num_frames = MAX2(atoi(optarg), 1);
+         break;
+      case 'm':
+         bench.present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+         break;
+      case 's':
+         setenv("MESA_VK_WSI_HEADLESS_SINK", optarg, 1);
+         break;
+      default:
+         fprintf(stderr, "usage: %s [-n frames] [-m] [-s sink] [icd]\n",
+                 argv[0]);
+         return 1;
+      }
+   }
+   if (optind < argc)
+      icd = argv[optind];
+
+   const struct lvp_test_device_info dev_info = {
+      .app_name = "lvp_wsi_headless_bench",
+      .api_version = VK_API_VERSION_1_1,
+      .headless = true,
+   };
+   if (!lvp_test_load_icd(&bench.dev, icd) ||
+       !lvp_test_device_create(&bench.dev, &dev_info))
+      return 1;
+
+   double fps_1080p = run_size(1920, 1080);
+   double fps_4k = run_size(3840, 2160);
+
+   printf("%u frames, %s: %.1f frames/s at 1920x1080, "
+          "%.1f frames/s at 3840x2160\n",
+          bench.num_frames,
+          bench.present_mode == VK_PRESENT_MODE_MAILBOX_KHR ? "mailbox" : "fifo",
+          fps_1080p, fps_4k);
+
+   lvp_test_device_destroy(&bench.dev);
+   lvp_test_unload_icd(&bench.dev);
+
+   return 0;
+}
@@ -0,0 +1,558 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Checks the frames MESA_VK_WSI_HEADLESS_SINK hands out.  Every frame is a
+ * clear to a known color, which is read back from the file: sink and from
+ * the shared memory objects of the shm: sink, across a swapchain being
+ * recreated while the old one is still alive.
+ *
+ * usage: lvp_wsi_headless_sink_test [icd]
+ *
+ * The ICD is loaded directly, without the Vulkan loader, and defaults to
+ * libvulkan_lvp.so.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "vulkan/wsi/wsi_common_headless.h"
+
+#include "lvp_test_util.h"
+
+#define MAX_IMAGES 8
+
+static struct {
+   struct lvp_test_device dev;
+   VkCommandPool pool;
+   VkCommandBuffer cmd;
+   VkFence fence;
+} test;
+
+#define DEV_PROC(name) LVP_TEST_DEVICE_PROC(&test.dev, name)
+
+struct swapchain {
+   VkSwapchainKHR swapchain;
+   uint32_t width;
+   uint32_t height;
+   uint32_t num_images;
+   VkImage images[MAX_IMAGES];
+};
+
+static void
+check(VkResult result, const char *what)
+{
+   if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      fprintf(stderr, "%s failed: %d\n", what, result);
+      exit(1);
+   }
+}
+
+/* The B8G8R8A8 pixel frame f is cleared to, as it is laid out in memory */
+static uint32_t
+frame_pixel(unsigned f)
+{
+   const uint8_t b = 17 + f * 31, g = 200 - f * 23, r = 64 + f * 45;
+
+   return b | g << 8 | r << 16 | 0xffu << 24;
+}
+
+static void
+create_device(void)
+{
+   const struct lvp_test_device_info dev_info = {
+      .app_name = "lvp_wsi_headless_sink_test",
+      .api_version = VK_API_VERSION_1_1,
+      .headless = true,
+   };
+   if (!lvp_test_device_create(&test.dev, &dev_info))
+      exit(1);
+
+   const VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+      .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+      .queueFamilyIndex = 0,
+   };
+   check(DEV_PROC(CreateCommandPool)(test.dev.device, &pool_info, NULL,
+                                     &test.pool), "vkCreateCommandPool");
+
+   const VkCommandBufferAllocateInfo cmd_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = test.pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+   };
+   check(DEV_PROC(AllocateCommandBuffers)(test.dev.device, &cmd_info,
+                                          &test.cmd),
+         "vkAllocateCommandBuffers");
+
+   const VkFenceCreateInfo fence_info = {
+      .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+   };
+   check(DEV_PROC(CreateFence)(test.dev.device, &fence_info, NULL, &test.fence),
+         "vkCreateFence");
+}
+
+static void
+destroy_device(void)
+{
+   DEV_PROC(DestroyFence)(test.dev.device, test.fence, NULL);
+   DEV_PROC(DestroyCommandPool)(test.dev.device, test.pool, NULL);
+   lvp_test_device_destroy(&test.dev);
+}
+
+static void
+create_swapchain(struct swapchain *chain, uint32_t width, uint32_t height,
+                 VkSwapchainKHR old_swapchain)
+{
+   const VkSwapchainCreateInfoKHR swapchain_info = {
+      .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+      .surface = test.dev.surface,
+      .minImageCount = 3,
+      .imageFormat = VK_FORMAT_B8G8R8A8_UNORM,
+      .imageColorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR,
+      .imageExtent = { width, height },
+      .imageArrayLayers = 1,
+      .imageUsage = VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+      .preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
+      .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+      .presentMode = VK_PRESENT_MODE_FIFO_KHR,
+      .clipped = VK_TRUE,
+      .oldSwapchain = old_swapchain,
+   };
+   check(DEV_PROC(CreateSwapchainKHR)(test.dev.device, &swapchain_info, NULL,
+                                      &chain->swapchain),
+         "vkCreateSwapchainKHR");
+
+   chain->width = width;
+   chain->height = height;
+   chain->num_images = MAX_IMAGES;
+   check(DEV_PROC(GetSwapchainImagesKHR)(test.dev.device, chain->swapchain,
+                                         &chain->num_images, chain->images),
+         "vkGetSwapchainImagesKHR");
+}
+
+static void
+destroy_swapchain(struct swapchain *chain)
+{
+   DEV_PROC(DestroySwapchainKHR)(test.dev.device, chain->swapchain, NULL);
+}
+
+/* Acquires an image, clears it to the color of frame f and presents it. */
+static void
+present_frame(struct swapchain *chain, unsigned f)
+{
+   const uint32_t pixel = frame_pixel(f);
+   uint32_t index;
+
+   check(DEV_PROC(AcquireNextImageKHR)(test.dev.device, chain->swapchain,
+                                       UINT64_MAX, VK_NULL_HANDLE,
+                                       test.fence, &index),
+         "vkAcquireNextImageKHR");
+   check(DEV_PROC(WaitForFences)(test.dev.device, 1, &test.fence, VK_TRUE,
+                                 UINT64_MAX), "vkWaitForFences");
+   check(DEV_PROC(ResetFences)(test.dev.device, 1, &test.fence),
+         "vkResetFences");
+
+   const VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+      .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+   };
+   const VkImageSubresourceRange range = {
+      .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+      .levelCount = 1,
+      .layerCount = 1,
+   };
+   VkImageMemoryBarrier barrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+      .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+      .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+      .image = chain->images[index],
+      .subresourceRange = range,
+   };
+   const VkClearColorValue color = {
+      .float32 = {
+         ((pixel >> 16) & 0xff) / 255.0f,
+         ((pixel >> 8) & 0xff) / 255.0f,
+         (pixel & 0xff) / 255.0f,
+         1.0f,
+      },
+   };
+
+   check(DEV_PROC(BeginCommandBuffer)(test.cmd, &begin_info),
+         "vkBeginCommandBuffer");
+   DEV_PROC(CmdPipelineBarrier)(test.cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                0, NULL, 0, NULL, 1, &barrier);
+   DEV_PROC(CmdClearColorImage)(test.cmd, chain->images[index],
+                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                &color, 1, &range);
+   barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+   barrier.dstAccessMask = 0;
+   barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+   barrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+   DEV_PROC(CmdPipelineBarrier)(test.cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                                0, NULL, 0, NULL, 1, &barrier);
+   check(DEV_PROC(EndCommandBuffer)(test.cmd), "vkEndCommandBuffer");
+
+   const VkSubmitInfo submit_info = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &test.cmd,
+   };
+   check(DEV_PROC(QueueSubmit)(test.dev.queue, 1, &submit_info, VK_NULL_HANDLE),
+         "vkQueueSubmit");
+   check(DEV_PROC(QueueWaitIdle)(test.dev.queue), "vkQueueWaitIdle");
+
+   const VkPresentInfoKHR present_info = {
+      .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+      .swapchainCount = 1,
+      .pSwapchains = &chain->swapchain,
+      .pImageIndices = &index,
+   };
+   check(DEV_PROC(QueuePresentKHR)(test.dev.queue, &present_info),
+         "vkQueuePresentKHR");
+}
+
+/* Returns the number of pixels of a width x height frame which differ from
+ * the color of frame f.
+ */
+static unsigned
+count_wrong_pixels(const uint8_t *data, uint32_t row_pitch,
+                   uint32_t width, uint32_t height, unsigned f)
+{
+   const uint32_t pixel = frame_pixel(f);
+   unsigned wrong = 0;
+
+   for (uint32_t y = 0; y < height; y++) {
+      const uint32_t *row = (const uint32_t *)(data + (size_t)y * row_pitch);
+      for (uint32_t x = 0; x < width; x++)
+         wrong += row[x] != pixel;
+   }
+
+   return wrong;
+}
+
+/* Every frame is written out, one after the other, without row padding. */
+static bool
+test_file_sink(void)
+{
+   const uint32_t width = 67, height = 35;
+   const unsigned num_frames = 5;
+   char path[] = "/tmp/lvp_wsi_headless_XXXXXX";
+   bool success = true;
+
+   int fd = mkstemp(path);
+   if (fd < 0) {
+      fprintf(stderr, "file: failed to create %s: %s\n", path,
+              strerror(errno));
+      return false;
+   }
+
+   char sink[sizeof(path) + 5];
+   snprintf(sink, sizeof sink, "file:%s", path);
+   setenv("MESA_VK_WSI_HEADLESS_SINK", sink, 1);
+
+   create_device();
+
+   struct swapchain chain;
+   create_swapchain(&chain, width, height, VK_NULL_HANDLE);
+   for (unsigned f = 0; f < num_frames; f++)
+      present_frame(&chain, f);
+
+   /* Destroying the swapchain waits for the sink to take the last frames. */
+   destroy_swapchain(&chain);
+   destroy_device();
+
+   const size_t frame_size = (size_t)width * height * 4;
+   struct stat st;
+   if (fstat(fd, &st) < 0 || st.st_size != frame_size * num_frames) {
+      fprintf(stderr, "file: expected %zu bytes, got %lld\n",
+              frame_size * num_frames, (long long)st.st_size);
+      success = false;
+   } else {
+      uint8_t *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (data == MAP_FAILED) {
+         fprintf(stderr, "file: failed to map %s\n", path);
+         success = false;
+      } else {
+         for (unsigned f = 0; f < num_frames; f++) {
+            unsigned wrong = count_wrong_pixels(data + f * frame_size,
+                                                width * 4, width, height, f);
+            if (wrong) {
+               fprintf(stderr, "file: frame %u has %u wrong pixels\n",
+                       f, wrong);
+               success = false;
+            }
+         }
+         munmap(data, st.st_size);
+      }
+   }
+
+   close(fd);
+   unlink(path);
+
+   return success;
+}
+
+struct shm_object {
+   int fd;
+   size_t size;
+   void *map;
+};
+
+static bool
+map_shm(struct shm_object *obj, const char *name)
+{
+   struct stat st;
+
+   obj->fd = shm_open(name, O_RDONLY, 0);
+   if (obj->fd < 0)
+      return false;
+
+   if (fstat(obj->fd, &st) < 0 || st.st_size == 0) {
+      close(obj->fd);
+      return false;
+   }
+
+   obj->size = st.st_size;
+   obj->map = mmap(NULL, obj->size, PROT_READ, MAP_SHARED, obj->fd, 0);
+   if (obj->map == MAP_FAILED) {
+      close(obj->fd);
+      return false;
+   }
+
+   return true;
+}
+
+static void
+unmap_shm(struct shm_object *obj)
+{
+   munmap(obj->map, obj->size);
+   close(obj->fd);
+}
+
+/* Maps the object of the swapchain the index currently points to. */
+static bool
+map_current_swapchain(struct shm_object *obj, const char *name,
+                      const struct wsi_headless_shm_index *index,
+                      uint64_t *generation)
+{
+   char chain_name[256];
+
+   *generation = p_atomic_read(&index->current);
+   if (*generation == 0) {
+      fprintf(stderr, "shm: no current swapchain\n");
+      return false;
+   }
+
+   snprintf(chain_name, sizeof chain_name, "%s.%" PRIu64, name, *generation);
+   if (!map_shm(obj, chain_name)) {
+      fprintf(stderr, "shm: failed to map %s: %s\n", chain_name,
+              strerror(errno));
+      return false;
+   }
+
+   const struct wsi_headless_shm_header *header = obj->map;
+   if (p_atomic_read(&header->magic) != WSI_HEADLESS_SHM_MAGIC ||
+       header->version != WSI_HEADLESS_SHM_VERSION ||
+       header->generation != *generation) {
+      fprintf(stderr, "shm: bad header in %s\n", chain_name);
+      unmap_shm(obj);
+      return false;
+   }
+
+   return true;
+}
+
+/* Waits for the sink to publish frame_count frames, then checks the latest
+ * one has the color of frame f.
+ */
+static bool
+check_latest_frame(const struct shm_object *obj, const struct swapchain *chain,
+                   uint64_t frame_count, unsigned f, const char *what)
+{
+   const struct wsi_headless_shm_header *header = obj->map;
+   const int64_t deadline = os_time_get_nano() + 5000000000ll;
+
+   if (header->width != chain->width || header->height != chain->height ||
+       header->format != VK_FORMAT_B8G8R8A8_UNORM) {
+      fprintf(stderr, "shm: %s has a %ux%u image of format %u\n", what,
+              header->width, header->height, header->format);
+      return false;
+   }
+
+   while (p_atomic_read(&header->frame_count) < frame_count) {
+      if (os_time_get_nano() >= deadline) {
+         fprintf(stderr, "shm: %s only got %" PRIu64 " of %" PRIu64
+                 " frames\n", what, p_atomic_read(&header->frame_count),
+                 frame_count);
+         return false;
+      }
+      os_time_sleep(1000);
+   }
+
+   const uint32_t latest = p_atomic_read(&header->latest);
+   const uint64_t seqno = p_atomic_read(&header->images[latest].seqno);
+   if (latest >= header->image_count || seqno != frame_count) {
+      fprintf(stderr, "shm: %s latest image %u has seqno %" PRIu64 "\n",
+              what, latest, seqno);
+      return false;
+   }
+
+   const uint8_t *data = (const uint8_t *)obj->map +
+                         header->images[latest].offset;
+   unsigned wrong = count_wrong_pixels(data, header->images[latest].row_pitch,
+                                       chain->width, chain->height, f);
+   if (wrong) {
+      fprintf(stderr, "shm: %s frame %u has %u wrong pixels\n", what, f,
+              wrong);
+      return false;
+   }
+
+   return true;
+}
+
+/* Recreates the swapchain while the old one is alive, and checks neither
+ * gets in the way of the other.
+ */
+static bool
+run_shm_sink(const char *name, const struct wsi_headless_shm_index *index)
+{
+   struct swapchain old_chain, new_chain;
+   struct shm_object old_obj, new_obj;
+   uint64_t old_generation, new_generation;
+   bool success = false;
+
+   create_swapchain(&old_chain, 64, 32, VK_NULL_HANDLE);
+   for (unsigned f = 0; f < 3; f++)
+      present_frame(&old_chain, f);
+
+   if (!map_current_swapchain(&old_obj, name, index, &old_generation)) {
+      destroy_swapchain(&old_chain);
+      return false;
+   }
+
+   create_swapchain(&new_chain, 96, 48, old_chain.swapchain);
+   for (unsigned f = 3; f < 5; f++)
+      present_frame(&new_chain, f);
+
+   if (!map_current_swapchain(&new_obj, name, index, &new_generation)) {
+      destroy_swapchain(&new_chain);
+      destroy_swapchain(&old_chain);
+      unmap_shm(&old_obj);
+      return false;
+   }
+
+   if (new_generation == old_generation) {
+      fprintf(stderr, "shm: both swapchains use generation %" PRIu64 "\n",
+              new_generation);
+      destroy_swapchain(&old_chain);
+   } else if (check_latest_frame(&old_obj, &old_chain, 3, 2, "old swapchain")) {
+      destroy_swapchain(&old_chain);
+
+      /* The old frames are still mapped, the new ones must be untouched */
+      success = check_latest_frame(&old_obj, &old_chain, 3, 2,
+                                   "destroyed swapchain") &&
+                check_latest_frame(&new_obj, &new_chain, 2, 4,
+                                   "new swapchain");
+
+      if (success && p_atomic_read(&index->current) != new_generation) {
+         fprintf(stderr, "shm: destroying the old swapchain changed the "
+                 "index\n");
+         success = false;
+      }
+   } else {
+      destroy_swapchain(&old_chain);
+   }
+
+   destroy_swapchain(&new_chain);
+   if (success && p_atomic_read(&index->current) != 0) {
+      fprintf(stderr, "shm: index still points to a destroyed swapchain\n");
+      success = false;
+   }
+
+   unmap_shm(&new_obj);
+   unmap_shm(&old_obj);
+
+   return success;
+}
+
+static bool
+test_shm_sink(void)
+{
+   char name[64];
+   struct shm_object index_obj;
+   bool success = false;
+
+   snprintf(name, sizeof name, "/lvp_wsi_headless_%d", (int)getpid());
+
+   char sink[sizeof(name) + 4];
+   snprintf(sink, sizeof sink, "shm:%s", name);
+   setenv("MESA_VK_WSI_HEADLESS_SINK", sink, 1);
+
+   create_device();
+
+   if (!map_shm(&index_obj, name)) {
+      fprintf(stderr, "shm: failed to map the index %s: %s\n", name,
+              strerror(errno));
+   } else {
+      const struct wsi_headless_shm_index *index = index_obj.map;
+      if (p_atomic_read(&index->magic) != WSI_HEADLESS_SHM_INDEX_MAGIC)
+         fprintf(stderr, "shm: bad index header\n");
+      else
+         success = run_shm_sink(name, index);
+      unmap_shm(&index_obj);
+   }
+
+   destroy_device();
+
+   /* The last user of the index removes it */
+   int fd = shm_open(name, O_RDONLY, 0);
+   if (fd >= 0) {
+      fprintf(stderr, "shm: %s was not removed\n", name);
+      close(fd);
+      shm_unlink(name);
+      success = false;
+   }
+
+   return success;
+}
+
+int
+main(int argc, char **argv)
+{
+   const char *icd = argc > 1 ? argv[1] : LVP_TEST_DEFAULT_ICD;
+
+   if (!lvp_test_load_icd(&test.dev, icd))
+      return 1;
+
+   bool success = true;
+   if (!test_file_sink())
+      success = false;
+   if (!test_shm_sink())
+      success = false;
+
+   printf("%s\n", success ? "PASS" : "FAIL");
+
+   lvp_test_unload_icd(&test.dev);
+
+   return success ? 0 : 1;
+}
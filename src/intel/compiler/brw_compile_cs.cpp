@@ -120,6 +120,80 @@ brw_nir_uses_sampler(nir_shader *shader)
                                        NULL);
 }
 
+static std::unique_ptr<brw_shader>
+compile_cs_variant(const struct brw_compiler *compiler,
+                   const struct brw_compile_cs_params *params,
+                   const struct brw_compile_params *base,
+                   struct brw_cs_prog_data *prog_data,
+                   unsigned simd, bool allow_spilling,
+                   brw_shader *uniforms_from, bool debug_enabled,
+                   bool *compiled)
+{
+   const struct brw_cs_prog_key *key = params->key;
+   const unsigned dispatch_width = 8u << simd;
+
+   nir_shader *shader = nir_shader_clone(base->mem_ctx, params->base.nir);
+   brw_nir_apply_key(shader, compiler, &key->base,
+                     dispatch_width);
+
+   NIR_PASS(_, shader, brw_nir_lower_simd, dispatch_width);
+
+   /* Clean up after the local index and ID calculations. */
+   NIR_PASS(_, shader, nir_opt_constant_folding);
+   NIR_PASS(_, shader, nir_opt_dce);
+
+   brw_postprocess_nir(shader, compiler, debug_enabled,
+                       key->base.robust_flags);
+
+   auto v = std::make_unique<brw_shader>(compiler, base, &key->base,
+                                         &prog_data->base,
+                                         shader, dispatch_width,
+                                         params->base.stats != NULL,
+                                         debug_enabled);
+   if (uniforms_from)
+      v->import_uniforms(uniforms_from);
+
+   *compiled = run_cs(*v, allow_spilling);
+   return v;
+}
+
+/* A SIMD variant compiled ahead of the selection loop, concurrently with
+ * the others.  ralloc isn't thread-safe and the backend writes to
+ * prog_data, so it gets its own ralloc context and prog_data copy.
+ */
+struct cs_speculative_variant {
+   struct brw_compile_params params;
+   struct brw_cs_prog_data prog_data;
+   std::unique_ptr<brw_shader> v;
+   bool allow_spilling;
+   bool compiled;
+};
+
+/* Apply what compiling a speculative variant wrote to its prog_data copy
+ * the way compiling it in place would have.  Everything else in the copy
+ * is what prog_data held before the variants were compiled.
+ *
+ * The fields are listed by hand, so a new one breaks the build here until
+ * it has been checked for being written by the backend.
+ */
+static_assert(sizeof(void *) != 8 || sizeof(struct brw_cs_prog_data) == 192,
+              "brw_cs_prog_data changed, update cs_merge_variant_prog_data");
+
+static void
+cs_merge_variant_prog_data(struct brw_cs_prog_data *prog_data,
+                           const struct brw_cs_prog_data *variant)
+{
+   prog_data->base.curb_read_length = variant->base.curb_read_length;
+   prog_data->base.total_scratch = MAX2(prog_data->base.total_scratch,
+                                        variant->base.total_scratch);
+   prog_data->base.has_ubo_pull |= variant->base.has_ubo_pull;
+
+   prog_data->uses_inline_push_addr = variant->uses_inline_push_addr;
+   prog_data->uses_barrier |= variant->uses_barrier;
+   prog_data->uses_num_work_groups |= variant->uses_num_work_groups;
+   prog_data->uses_systolic |= variant->uses_systolic;
+}
+
 const unsigned *
 brw_compile_cs(const struct brw_compiler *compiler,
                struct brw_compile_cs_params *params)
@@ -155,46 +229,91 @@ brw_compile_cs(const struct brw_compiler *compiler,
 
    std::unique_ptr<brw_shader> v[3];
 
-   for (unsigned i = 0; i < 3; i++) {
-      const unsigned simd = devinfo->ver >= 30 ? 2 - i : i;
+   auto allow_spilling = [&](brw_simd_selection_state &state, unsigned simd) {
+      return simd == 0 ||
+         (!state.compiled[simd - 1] && !brw_simd_should_compile(state, simd - 1)) ||
+         nir->info.workgroup_size_variable;
+   };
 
-      if (!brw_simd_should_compile(simd_state, simd))
-         continue;
+   /* With a thread pool, compile every variant the loop below would try
+    * if all of them succeeded without spilling concurrently, then let the
+    * loop pick from the results.  The loop makes the same decisions as
+    * without the pool and compiles whatever the guess missed.
+    *
+    * Before Gfx12.5 the first compile appends the subgroup ID param to
+    * prog_data and the others import its uniforms, so keep those serial.
+    */
+   cs_speculative_variant spec[3];
+   unsigned spec_mask = 0;
+
+   if (compiler->simd_queue && devinfo->verx10 >= 125 && !debug_enabled) {
+      struct brw_cs_prog_data guess_prog_data = *prog_data;
+      brw_simd_selection_state guess = simd_state;
+      guess.prog_data = &guess_prog_data;
+
+      for (unsigned i = 0; i < 3; i++) {
+         const unsigned simd = devinfo->ver >= 30 ? 2 - i : i;
+         if (!brw_simd_should_compile(guess, simd))
+            continue;
+
+         spec[simd].allow_spilling = allow_spilling(guess, simd);
+         brw_simd_mark_compiled(guess, simd, false);
+         spec_mask |= 1u << simd;
+      }
 
-      const unsigned dispatch_width = 8u << simd;
+      if (util_bitcount(spec_mask) < 2)
+         spec_mask = 0;
+
+      u_foreach_bit(simd, spec_mask) {
+         spec[simd].params = params->base;
+         spec[simd].params.mem_ctx = ralloc_context(NULL);
+         spec[simd].prog_data = *prog_data;
+      }
 
-      nir_shader *shader = nir_shader_clone(params->base.mem_ctx, nir);
-      brw_nir_apply_key(shader, compiler, &key->base,
-                        dispatch_width);
+      brw_simd_run_parallel(compiler, spec_mask, [&](unsigned simd) {
+         spec[simd].v = compile_cs_variant(compiler, params,
+                                           &spec[simd].params,
+                                           &spec[simd].prog_data,
+                                           simd, spec[simd].allow_spilling,
+                                           NULL, false, &spec[simd].compiled);
+      });
 
-      NIR_PASS(_, shader, brw_nir_lower_simd, dispatch_width);
+      u_foreach_bit(simd, spec_mask)
+         ralloc_steal(params->base.mem_ctx, spec[simd].params.mem_ctx);
+   }
 
-      /* Clean up after the local index and ID calculations. */
-      NIR_PASS(_, shader, nir_opt_constant_folding);
-      NIR_PASS(_, shader, nir_opt_dce);
+   for (unsigned i = 0; i < 3; i++) {
+      const unsigned simd = devinfo->ver >= 30 ? 2 - i : i;
 
-      brw_postprocess_nir(shader, compiler, debug_enabled,
-                          key->base.robust_flags);
+      if (!brw_simd_should_compile(simd_state, simd))
+         continue;
 
-      v[simd] = std::make_unique<brw_shader>(compiler, &params->base,
-                                             &key->base,
-                                             &prog_data->base,
-                                             shader, dispatch_width,
-                                             params->base.stats != NULL,
-                                             debug_enabled);
+      const unsigned dispatch_width = 8u << simd;
+      const bool allow_spilling_simd = allow_spilling(simd_state, simd);
+      bool compiled;
+
+      if ((spec_mask & (1u << simd)) &&
+          spec[simd].allow_spilling == allow_spilling_simd) {
+         v[simd] = std::move(spec[simd].v);
+         compiled = spec[simd].compiled;
+         cs_merge_variant_prog_data(prog_data, &spec[simd].prog_data);
+      } else {
+         brw_shader *uniforms_from = NULL;
 
-      const bool allow_spilling = simd == 0 ||
-         (!simd_state.compiled[simd - 1] && !brw_simd_should_compile(simd_state, simd - 1)) ||
-         nir->info.workgroup_size_variable;
+         if (devinfo->ver < 30 || nir->info.workgroup_size_variable) {
+            const int first = brw_simd_first_compiled(simd_state);
+            if (first >= 0)
+               uniforms_from = v[first].get();
+            assert(allow_spilling_simd == (first < 0 || nir->info.workgroup_size_variable));
+         }
 
-      if (devinfo->ver < 30 || nir->info.workgroup_size_variable) {
-         const int first = brw_simd_first_compiled(simd_state);
-         if (first >= 0)
-            v[simd]->import_uniforms(v[first].get());
-         assert(allow_spilling == (first < 0 || nir->info.workgroup_size_variable));
+         v[simd] = compile_cs_variant(compiler, params, &params->base,
+                                      prog_data, simd, allow_spilling_simd,
+                                      uniforms_from, debug_enabled,
+                                      &compiled);
       }
 
-      if (run_cs(*v[simd], allow_spilling)) {
+      if (compiled) {
          cs_fill_push_const_info(compiler->devinfo, prog_data);
 
          brw_simd_mark_compiled(simd_state, simd, v[simd]->spilled_any_registers);
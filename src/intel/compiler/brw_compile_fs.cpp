@@ -1479,6 +1479,47 @@ brw_print_fs_urb_setup(FILE *fp, const struct brw_wm_prog_data *prog_data,
    }
 }
 
+/* A SIMD variant compiled ahead of time, concurrently with the others.
+ * See cs_speculative_variant.
+ */
+struct fs_speculative_variant {
+   struct brw_compile_params params;
+   struct brw_wm_prog_data prog_data;
+   std::unique_ptr<brw_shader> v;
+   bool allow_spilling;
+   bool compiled;
+};
+
+/* Apply what compiling a speculative variant wrote to its prog_data copy
+ * the way compiling it in place would have, see cs_merge_variant_prog_data.
+ */
+static_assert(sizeof(void *) != 8 || sizeof(struct brw_wm_prog_data) == 816,
+              "brw_wm_prog_data changed, update fs_merge_variant_prog_data");
+
+static void
+fs_merge_variant_prog_data(struct brw_wm_prog_data *prog_data,
+                           const struct brw_wm_prog_data *variant)
+{
+   prog_data->base.curb_read_length = variant->base.curb_read_length;
+   prog_data->base.total_scratch = MAX2(prog_data->base.total_scratch,
+                                        variant->base.total_scratch);
+   prog_data->base.has_ubo_pull |= variant->base.has_ubo_pull;
+
+   prog_data->dual_src_blend = variant->dual_src_blend;
+   prog_data->has_side_effects |= variant->has_side_effects;
+   prog_data->pulls_bary |= variant->pulls_bary;
+   prog_data->uses_nonperspective_interp_modes |=
+      variant->uses_nonperspective_interp_modes;
+
+   /* Set up by gfx9_ps_header_only_workaround. */
+   prog_data->num_varying_inputs = variant->num_varying_inputs;
+   memcpy(prog_data->urb_setup, variant->urb_setup,
+          sizeof(prog_data->urb_setup));
+   memcpy(prog_data->urb_setup_attribs, variant->urb_setup_attribs,
+          sizeof(prog_data->urb_setup_attribs));
+   prog_data->urb_setup_attribs_count = variant->urb_setup_attribs_count;
+}
+
 const unsigned *
 brw_compile_fs(const struct brw_compiler *compiler,
                struct brw_compile_fs_params *params)
@@ -1579,13 +1620,88 @@ brw_compile_fs(const struct brw_compiler *compiler,
    float throughput = 0;
    bool has_spilled = false;
 
+   /* With a thread pool, compile the SIMD8, SIMD16 and SIMD32 variants the
+    * code below tries when the narrower ones succeed concurrently, and let
+    * it pick from the results, like brw_compile_cs does.  Xe3+ and the
+    * multi-polygon variants depend on the results of the others, those
+    * stay serial.
+    */
+   fs_speculative_variant spec[3];
+   unsigned spec_mask = 0;
+
+   if (compiler->simd_queue && devinfo->ver < 30 && !debug_enabled) {
+      /* Coarse pixel shading limits the dispatch width through SIMD8. */
+      const bool coarse_limited = devinfo->ver < 20 && key->coarse_pixel;
+
+      if (devinfo->ver < 20)
+         spec_mask |= 1u << 0;
+      if ((INTEL_SIMD(FS, 16) &&
+           !(coarse_limited && prog_data->dual_src_blend)) ||
+          reqd_dispatch_width == SUBGROUP_SIZE_REQUIRE_16)
+         spec_mask |= 1u << 1;
+      if (reqd_dispatch_width == SUBGROUP_SIZE_VARYING &&
+          INTEL_SIMD(FS, 32) && !coarse_limited)
+         spec_mask |= 1u << 2;
+
+      /* Each variant that compiles turns spilling off for the wider ones. */
+      spec[0].allow_spilling = allow_spilling;
+      spec[1].allow_spilling =
+         devinfo->ver < 20 && INTEL_SIMD(FS, 8) ? false : allow_spilling;
+      spec[2].allow_spilling =
+         (spec_mask & (1u << 1)) ? false : spec[1].allow_spilling;
+
+      if (util_bitcount(spec_mask) < 2)
+         spec_mask = 0;
+
+      u_foreach_bit(simd, spec_mask) {
+         spec[simd].params = params->base;
+         spec[simd].params.mem_ctx = ralloc_context(NULL);
+         spec[simd].prog_data = *prog_data;
+      }
+
+      brw_simd_run_parallel(compiler, spec_mask, [&](unsigned simd) {
+         spec[simd].v = std::make_unique<brw_shader>(compiler,
+                                                     &spec[simd].params, key,
+                                                     &spec[simd].prog_data,
+                                                     nir, 8u << simd, 1,
+                                                     params->base.stats != NULL,
+                                                     false);
+         spec[simd].v->import_per_primitive_offsets(per_primitive_offsets);
+         spec[simd].compiled =
+            run_fs(*spec[simd].v, spec[simd].allow_spilling,
+                   simd == 1 && params->use_rep_send);
+      });
+
+      u_foreach_bit(simd, spec_mask)
+         ralloc_steal(params->base.mem_ctx, spec[simd].params.mem_ctx);
+   }
+
+   /* Use the speculatively compiled variant if it was compiled the way the
+    * code below wants it.  Importing uniforms makes no difference for
+    * fragment shaders, they all set them up the same.
+    */
+   auto use_spec = [&](unsigned simd, bool allow,
+                       std::unique_ptr<brw_shader> &v, bool *compiled) {
+      if (!(spec_mask & (1u << simd)) || spec[simd].allow_spilling != allow)
+         return false;
+
+      v = std::move(spec[simd].v);
+      *compiled = spec[simd].compiled;
+      fs_merge_variant_prog_data(prog_data, &spec[simd].prog_data);
+      return true;
+   };
+
    if (devinfo->ver < 20) {
-      v8 = std::make_unique<brw_shader>(compiler, &params->base, key,
-                                        prog_data, nir, 8, 1,
-                                        params->base.stats != NULL,
-                                        debug_enabled);
-      v8->import_per_primitive_offsets(per_primitive_offsets);
-      if (!run_fs(*v8, allow_spilling, false /* do_rep_send */)) {
+      bool compiled;
+      if (!use_spec(0, allow_spilling, v8, &compiled)) {
+         v8 = std::make_unique<brw_shader>(compiler, &params->base, key,
+                                           prog_data, nir, 8, 1,
+                                           params->base.stats != NULL,
+                                           debug_enabled);
+         v8->import_per_primitive_offsets(per_primitive_offsets);
+         compiled = run_fs(*v8, allow_spilling, false /* do_rep_send */);
+      }
+      if (!compiled) {
          params->base.error_str = ralloc_strdup(params->base.mem_ctx,
                                                 v8->fail_msg);
          return NULL;
@@ -1737,14 +1853,18 @@ brw_compile_fs(const struct brw_compiler *compiler,
            INTEL_SIMD(FS, 16)) ||
           reqd_dispatch_width == SUBGROUP_SIZE_REQUIRE_16) {
          /* Try a SIMD16 compile */
-         v16 = std::make_unique<brw_shader>(compiler, &params->base, key,
-                                            prog_data, nir, 16, 1,
-                                            params->base.stats != NULL,
-                                            debug_enabled);
-         v16->import_per_primitive_offsets(per_primitive_offsets);
-         if (v8)
-            v16->import_uniforms(v8.get());
-         if (!run_fs(*v16, allow_spilling, params->use_rep_send)) {
+         bool compiled;
+         if (!use_spec(1, allow_spilling, v16, &compiled)) {
+            v16 = std::make_unique<brw_shader>(compiler, &params->base, key,
+                                               prog_data, nir, 16, 1,
+                                               params->base.stats != NULL,
+                                               debug_enabled);
+            v16->import_per_primitive_offsets(per_primitive_offsets);
+            if (v8)
+               v16->import_uniforms(v8.get());
+            compiled = run_fs(*v16, allow_spilling, params->use_rep_send);
+         }
+         if (!compiled) {
             brw_shader_perf_log(compiler, params->base.log_data,
                                 "SIMD16 shader failed to compile: %s\n",
                                 v16->fail_msg);
@@ -1772,17 +1892,21 @@ brw_compile_fs(const struct brw_compiler *compiler,
           reqd_dispatch_width == SUBGROUP_SIZE_VARYING &&
           !simd16_failed && INTEL_SIMD(FS, 32)) {
          /* Try a SIMD32 compile */
-         v32 = std::make_unique<brw_shader>(compiler, &params->base, key,
-                                            prog_data, nir, 32, 1,
-                                            params->base.stats != NULL,
-                                            debug_enabled);
-         v32->import_per_primitive_offsets(per_primitive_offsets);
-         if (v8)
-            v32->import_uniforms(v8.get());
-         else if (v16)
-            v32->import_uniforms(v16.get());
-
-         if (!run_fs(*v32, allow_spilling, false)) {
+         bool compiled;
+         if (!use_spec(2, allow_spilling, v32, &compiled)) {
+            v32 = std::make_unique<brw_shader>(compiler, &params->base, key,
+                                               prog_data, nir, 32, 1,
+                                               params->base.stats != NULL,
+                                               debug_enabled);
+            v32->import_per_primitive_offsets(per_primitive_offsets);
+            if (v8)
+               v32->import_uniforms(v8.get());
+            else if (v16)
+               v32->import_uniforms(v16.get());
+
+            compiled = run_fs(*v32, allow_spilling, false);
+         }
+         if (!compiled) {
             brw_shader_perf_log(compiler, params->base.log_data,
                                 "SIMD32 shader failed to compile: %s\n",
                                 v32->fail_msg);
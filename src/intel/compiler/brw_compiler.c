@@ -29,6 +29,7 @@
 #include "compiler/nir/nir.h"
 #include "isl/isl.h"
 #include "util/u_debug.h"
+#include "util/u_queue.h"
 
 const struct nir_shader_compiler_options brw_scalar_nir_options = {
    .avoid_ternary_with_two_constants = true,
@@ -91,6 +92,15 @@ const struct nir_shader_compiler_options brw_scalar_nir_options = {
    .compact_view_index = true,
 };
 
+static void
+brw_compiler_destroy(void *ptr)
+{
+   struct brw_compiler *compiler = ptr;
+
+   if (compiler->simd_queue)
+      util_queue_destroy(compiler->simd_queue);
+}
+
 struct brw_compiler *
 brw_compiler_create(void *mem_ctx, const struct intel_device_info *devinfo)
 {
@@ -112,6 +122,17 @@ brw_compiler_create(void *mem_ctx, const struct intel_device_info *devinfo)
    compiler->lower_dpas = !devinfo->has_systolic ||
                           debug_get_bool_option("INTEL_LOWER_DPAS", false);
 
+   const unsigned simd_threads =
+      debug_get_num_option("INTEL_SIMD_COMPILE_THREADS", 0);
+   if (simd_threads > 0) {
+      struct util_queue *queue = rzalloc(compiler, struct util_queue);
+      if (queue && util_queue_init(queue, "brw_simd", 16, simd_threads,
+                                   UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL)) {
+         compiler->simd_queue = queue;
+         ralloc_set_destructor(compiler, brw_compiler_destroy);
+      }
+   }
+
    nir_lower_int64_options int64_options =
       nir_lower_imul64 |
       nir_lower_isign64 |
@@ -130,6 +130,12 @@ struct brw_compiler {
     */
    int spilling_rate;
 
+   /**
+    * Thread pool compiling the SIMD variants of a shader concurrently, NULL
+    * unless enabled with INTEL_SIMD_COMPILE_THREADS.
+    */
+   struct util_queue *simd_queue;
+
    struct nir_shader *clc_shader;
 
    /**
@@ -43,6 +43,7 @@ extern const char *const pred_ctrl_align16[16];
 
 #ifdef __cplusplus
 
+#include <functional>
 #include <variant>
 
 unsigned brw_required_dispatch_width(const struct shader_info *info);
@@ -89,6 +90,9 @@ int brw_simd_select_for_workgroup_size(const struct intel_device_info *devinfo,
                                        const struct brw_cs_prog_data *prog_data,
                                        const unsigned *sizes);
 
+void brw_simd_run_parallel(const struct brw_compiler *compiler, unsigned mask,
+                           const std::function<void(unsigned)> &compile);
+
 bool brw_should_print_shader(const nir_shader *shader, uint64_t debug_flag, uint32_t source_hash);
 
 #endif // __cplusplus
@@ -26,6 +26,7 @@
 #include "intel/dev/intel_debug.h"
 #include "intel/dev/intel_device_info.h"
 #include "util/ralloc.h"
+#include "util/u_queue.h"
 
 unsigned
 brw_required_dispatch_width(const struct shader_info *info)
@@ -272,3 +273,59 @@ brw_simd_select_for_workgroup_size(const struct intel_device_info *devinfo,
 
    return brw_simd_select(simd_state);
 }
+
+namespace {
+
+struct simd_compile_job {
+   struct util_queue_fence fence;
+   const std::function<void(unsigned)> *compile;
+   unsigned simd;
+};
+
+void
+simd_compile_job_execute(void *data, void *gdata, int thread_index)
+{
+   simd_compile_job *job = (simd_compile_job *) data;
+   (*job->compile)(job->simd);
+}
+
+}
+
+/**
+ * Call compile(simd) for every SIMD width in mask and wait for all of them.
+ *
+ * With the compiler's thread pool, all but the widest variant go to the
+ * pool and the widest, usually the slowest to compile, runs on the calling
+ * thread.  The callback must only touch state private to its variant.
+ */
+void
+brw_simd_run_parallel(const struct brw_compiler *compiler, unsigned mask,
+                      const std::function<void(unsigned)> &compile)
+{
+   simd_compile_job jobs[SIMD_COUNT];
+   unsigned queued = 0;
+
+   assert(mask < (1u << SIMD_COUNT));
+
+   if (compiler->simd_queue) {
+      const unsigned widest = util_last_bit(mask) - 1;
+
+      u_foreach_bit(simd, mask & ~(1u << widest)) {
+         jobs[simd].compile = &compile;
+         jobs[simd].simd = simd;
+         util_queue_fence_init(&jobs[simd].fence);
+         util_queue_add_job(compiler->simd_queue, &jobs[simd],
+                            &jobs[simd].fence, simd_compile_job_execute,
+                            NULL, 0);
+         queued |= 1u << simd;
+      }
+   }
+
+   u_foreach_bit(simd, mask & ~queued)
+      compile(simd);
+
+   u_foreach_bit(simd, queued) {
+      util_queue_fence_wait(&jobs[simd].fence);
+      util_queue_fence_destroy(&jobs[simd].fence);
+   }
+}
@@ -0,0 +1,326 @@
+/*
+ * Copyright 2025 Intel Corporation
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "brw_compiler.h"
+#include "brw_nir.h"
+#include "compiler/nir/nir_builder.h"
+#include "dev/intel_debug.h"
+#include "dev/intel_device_info.h"
+#include "util/ralloc.h"
+#include "util/u_queue.h"
+
+#include <gtest/gtest.h>
+
+#include <functional>
+
+/* Compiling the SIMD variants concurrently must not change the output,
+ * check the prog_data and assembly against a compile without the queue.
+ */
+
+static void
+ignore_log(void *, unsigned *, const char *, ...)
+{
+}
+
+static const char *gfx_names[] = {
+   "skl",
+   "tgl",
+   "dg2",
+   "lnl",
+   "ptl",
+};
+
+class simd_parallel_test : public ::testing::TestWithParam<const char *> {
+protected:
+   void SetUp() override
+   {
+      mem_ctx = ralloc_context(NULL);
+
+      const int devid = intel_device_name_to_pci_device_id(GetParam());
+      ASSERT_TRUE(intel_get_device_info_from_pci_id(devid, &devinfo));
+
+      process_intel_debug_variable();
+
+      compiler = brw_compiler_create(mem_ctx, &devinfo);
+      compiler->shader_debug_log = ignore_log;
+      compiler->shader_perf_log = ignore_log;
+      compiler->simd_queue = NULL;
+
+      ASSERT_TRUE(util_queue_init(&queue, "brw_simd_test", 16, 3,
+                                  UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL));
+   }
+
+   void TearDown() override
+   {
+      util_queue_destroy(&queue);
+      ralloc_free(mem_ctx);
+   }
+
+   nir_shader *
+   build(mesa_shader_stage stage,
+         const std::function<void(nir_builder *)> &body)
+   {
+      nir_builder b =
+         nir_builder_init_simple_shader(stage, compiler->nir_options[stage],
+                                        "simd_parallel_test");
+      ralloc_steal(mem_ctx, b.shader);
+      body(&b);
+
+      struct brw_nir_compiler_opts opts = {};
+      brw_preprocess_nir(compiler, b.shader, &opts);
+      nir_shader_gather_info(b.shader, nir_shader_get_entrypoint(b.shader));
+      return b.shader;
+   }
+
+   template <typename PROG_DATA>
+   static void
+   expect_same_output(PROG_DATA *serial, const unsigned *serial_code,
+                      PROG_DATA *parallel, const unsigned *parallel_code)
+   {
+      ASSERT_TRUE(serial_code);
+      ASSERT_TRUE(parallel_code);
+
+      ASSERT_EQ(serial->base.program_size, parallel->base.program_size);
+      EXPECT_EQ(memcmp(serial_code, parallel_code,
+                       serial->base.program_size), 0);
+
+      /* The params and relocations live in the mem_ctx of each compile. */
+      ASSERT_EQ(serial->base.nr_params, parallel->base.nr_params);
+      EXPECT_EQ(memcmp(serial->base.param, parallel->base.param,
+                       serial->base.nr_params *
+                       sizeof(*serial->base.param)), 0);
+      serial->base.param = parallel->base.param = NULL;
+
+      ASSERT_EQ(serial->base.num_relocs, parallel->base.num_relocs);
+      EXPECT_EQ(memcmp(serial->base.relocs, parallel->base.relocs,
+                       serial->base.num_relocs *
+                       sizeof(*serial->base.relocs)), 0);
+      serial->base.relocs = parallel->base.relocs = NULL;
+
+      EXPECT_EQ(memcmp(serial, parallel, sizeof(*serial)), 0);
+   }
+
+   void
+   check_cs(const std::function<void(nir_builder *)> &body)
+   {
+      const struct brw_cs_prog_key key = {};
+      struct brw_cs_prog_data *prog_data[2];
+      const unsigned *code[2];
+
+      for (unsigned i = 0; i < 2; i++) {
+         compiler->simd_queue = i ? &queue : NULL;
+
+         nir_shader *nir = build(MESA_SHADER_COMPUTE, body);
+         prog_data[i] = rzalloc(mem_ctx, struct brw_cs_prog_data);
+         NIR_PASS(_, nir, brw_nir_lower_cs_intrinsics, &devinfo,
+                  prog_data[i]);
+
+         struct brw_compile_cs_params params = {
+            .base = {
+               .mem_ctx = mem_ctx,
+               .nir = nir,
+            },
+            .key = &key,
+            .prog_data = prog_data[i],
+         };
+         code[i] = brw_compile_cs(compiler, &params);
+         EXPECT_TRUE(code[i]) << params.base.error_str;
+      }
+      compiler->simd_queue = NULL;
+
+      expect_same_output(prog_data[0], code[0], prog_data[1], code[1]);
+   }
+
+   void
+   check_fs(const std::function<void(nir_builder *)> &body,
+            const struct brw_wm_prog_key &key)
+   {
+      struct brw_wm_prog_data *prog_data[2];
+      const unsigned *code[2];
+
+      for (unsigned i = 0; i < 2; i++) {
+         compiler->simd_queue = i ? &queue : NULL;
+
+         nir_shader *nir = build(MESA_SHADER_FRAGMENT, body);
+         prog_data[i] = rzalloc(mem_ctx, struct brw_wm_prog_data);
+
+         struct brw_compile_fs_params params = {
+            .base = {
+               .mem_ctx = mem_ctx,
+               .nir = nir,
+            },
+            .key = &key,
+            .prog_data = prog_data[i],
+            .max_polygons = 1,
+         };
+         code[i] = brw_compile_fs(compiler, &params);
+         EXPECT_TRUE(code[i]) << params.base.error_str;
+      }
+      compiler->simd_queue = NULL;
+
+      expect_same_output(prog_data[0], code[0], prog_data[1], code[1]);
+   }
+
+   void *mem_ctx;
+   struct intel_device_info devinfo;
+   struct brw_compiler *compiler;
+   struct util_queue queue;
+};
+
+static nir_def *
+invocation_addr(nir_builder *b, nir_def *index)
+{
+   return nir_iadd(b, nir_imm_int64(b, 0x100000),
+                      nir_u2u64(b, nir_imul_imm(b, index, 16)));
+}
+
+/* Loads enough values and keeps them alive long enough for the wider
+ * variants to run out of registers.
+ */
+static nir_def *
+register_pressure(nir_builder *b, nir_def *index, unsigned count)
+{
+   nir_def *values[64];
+   assert(count <= ARRAY_SIZE(values));
+
+   for (unsigned i = 0; i < count; i++) {
+      nir_def *addr = invocation_addr(b, nir_iadd_imm(b, index, i * 1024));
+      values[i] = nir_load_global(b, addr, 16, 4, 32);
+   }
+
+   nir_def *sum = nir_imm_vec4(b, 0, 0, 0, 0);
+   for (unsigned i = 0; i < count; i++)
+      sum = nir_ffma(b, values[i], values[count - 1 - i], sum);
+
+   return sum;
+}
+
+static void
+write_result(nir_builder *b, nir_def *index, nir_def *value)
+{
+   nir_store_global(b, invocation_addr(b, index), 16, value, 0xf);
+}
+
+TEST_P(simd_parallel_test, cs)
+{
+   check_cs([](nir_builder *b) {
+      b->shader->info.workgroup_size[0] = 64;
+      b->shader->info.workgroup_size[1] = 1;
+      b->shader->info.workgroup_size[2] = 1;
+
+      nir_def *index = nir_load_local_invocation_index(b);
+      nir_def *value = nir_load_global(b, invocation_addr(b, index), 16, 4, 32);
+
+      nir_barrier(b, SCOPE_WORKGROUP, SCOPE_WORKGROUP,
+                  NIR_MEMORY_ACQ_REL, nir_var_mem_global);
+
+      nir_def *groups = nir_u2f32(b, nir_load_num_workgroups(b));
+      write_result(b, nir_iadd_imm(b, index, 64),
+                   nir_fmul(b, value, nir_pad_vec4(b, groups)));
+   });
+}
+
+TEST_P(simd_parallel_test, cs_register_pressure)
+{
+   check_cs([](nir_builder *b) {
+      b->shader->info.workgroup_size[0] = 128;
+      b->shader->info.workgroup_size[1] = 1;
+      b->shader->info.workgroup_size[2] = 1;
+
+      nir_def *index = nir_load_local_invocation_index(b);
+      write_result(b, index, register_pressure(b, index, 48));
+   });
+}
+
+TEST_P(simd_parallel_test, cs_variable_workgroup_size)
+{
+   check_cs([](nir_builder *b) {
+      b->shader->info.workgroup_size_variable = true;
+
+      nir_def *index = nir_load_local_invocation_index(b);
+      write_result(b, index, register_pressure(b, index, 24));
+   });
+}
+
+TEST_P(simd_parallel_test, fs)
+{
+   struct brw_wm_prog_key key = {};
+   key.nr_color_regions = 1;
+
+   check_fs([](nir_builder *b) {
+      b->shader->info.fs.origin_upper_left = true;
+
+      nir_variable *in = nir_variable_create(b->shader, nir_var_shader_in,
+                                             glsl_vec4_type(), "in");
+      in->data.location = VARYING_SLOT_VAR0;
+      in->data.interpolation = INTERP_MODE_NOPERSPECTIVE;
+
+      nir_variable *out = nir_variable_create(b->shader, nir_var_shader_out,
+                                              glsl_vec4_type(), "color");
+      out->data.location = FRAG_RESULT_DATA0;
+
+      nir_def *pos = nir_load_frag_coord(b);
+      nir_store_var(b, out, nir_fmul(b, nir_load_var(b, in), pos), 0xf);
+   }, key);
+}
+
+/* Without inputs this also takes the Gfx9 header-only workaround. */
+TEST_P(simd_parallel_test, fs_register_pressure)
+{
+   struct brw_wm_prog_key key = {};
+   key.nr_color_regions = 1;
+
+   check_fs([](nir_builder *b) {
+      b->shader->info.fs.origin_upper_left = true;
+
+      nir_variable *out = nir_variable_create(b->shader, nir_var_shader_out,
+                                              glsl_vec4_type(), "color");
+      out->data.location = FRAG_RESULT_DATA0;
+
+      nir_def *pos = nir_f2u32(b, nir_load_frag_coord(b));
+      nir_def *index = nir_iadd(b, nir_channel(b, pos, 0),
+                                   nir_imul_imm(b, nir_channel(b, pos, 1),
+                                                4096));
+      nir_store_var(b, out, register_pressure(b, index, 16), 0xf);
+   }, key);
+}
+
+/* Whether the SIMD8 variant writes dual source blending decides if the
+ * coarse pixel shader can use SIMD16.
+ */
+TEST_P(simd_parallel_test, fs_dual_src_blend_coarse_pixel)
+{
+   struct brw_wm_prog_key key = {};
+   key.nr_color_regions = 1;
+   key.coarse_pixel = true;
+
+   check_fs([](nir_builder *b) {
+      b->shader->info.fs.origin_upper_left = true;
+
+      nir_variable *in = nir_variable_create(b->shader, nir_var_shader_in,
+                                             glsl_vec4_type(), "in");
+      in->data.location = VARYING_SLOT_VAR0;
+
+      nir_variable *out[2];
+      for (unsigned i = 0; i < 2; i++) {
+         out[i] = nir_variable_create(b->shader, nir_var_shader_out,
+                                      glsl_vec4_type(), "color");
+         out[i]->data.location = FRAG_RESULT_DATA0;
+         out[i]->data.index = i;
+      }
+
+      nir_def *value = nir_load_var(b, in);
+      nir_store_var(b, out[0], value, 0xf);
+      nir_store_var(b, out[1], nir_fneg(b, value), 0xf);
+   }, key);
+}
+
+INSTANTIATE_TEST_SUITE_P(
+   intel, simd_parallel_test,
+   ::testing::ValuesIn(gfx_names),
+   [](const ::testing::TestParamInfo<const char *> &info) {
+      return std::string(info.param);
+   }
+);
@@ -570,10 +570,11 @@ bufferobj_copy_subdata(struct gl_context *ctx,
    struct pipe_context *pipe = ctx->pipe;
    struct pipe_box box;
 
-   dst->MinMaxCacheDirty = true;
    if (!size)
       return;
 
+   vbo_minmax_cache_invalidate(dst, writeOffset, size);
+
    /* buffer should not already be mapped */
    assert(!_mesa_check_disallowed_mapping(src));
    /* dst can be mapped, just not the same range as the target range */
@@ -2573,7 +2574,7 @@ _mesa_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
       return;
 
    bufObj->NumSubDataCalls++;
-   bufObj->MinMaxCacheDirty = true;
+   vbo_minmax_cache_invalidate(bufObj, offset, size);
 
    _mesa_bufferobj_subdata(ctx, offset, size, data, bufObj);
 }
@@ -2778,7 +2779,7 @@ clear_buffer_sub_data(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    if (size == 0)
       return;
 
-   bufObj->MinMaxCacheDirty = true;
+   vbo_minmax_cache_invalidate(bufObj, offset, size);
 
    if (!ctx->pipe->clear_buffer) {
       clear_buffer_subdata_sw(ctx, offset, size,
@@ -3702,7 +3703,7 @@ map_buffer_range(struct gl_context *ctx, struct gl_buffer_object *bufObj,
    }
 
    if (access & GL_MAP_WRITE_BIT) {
-      bufObj->MinMaxCacheDirty = true;
+      vbo_minmax_cache_invalidate(bufObj, offset, length);
    }
 
 #ifdef VBO_DEBUG
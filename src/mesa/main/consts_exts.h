@@ -906,6 +906,9 @@ struct gl_constants
    /** Whether out-of-order draw (Begin/End) optimizations are allowed. */
    bool AllowDrawOutOfOrder;
 
+   /** enum util_format_bptc_quality used when compressing texture uploads */
+   unsigned BPTCCompressQuality;
+
    /** Whether to force the fast path for binding VAOs. It has much lower
     *  overhead due to not spending CPU cycles on trying to find interleaved
     *  vertex attribs and binding them.
@@ -80,6 +80,7 @@ struct gl_debug_state;
 struct gl_context;
 struct st_context;
 struct gl_uniform_storage;
+struct vbo_minmax_cache;
 struct prog_instruction;
 struct gl_program_parameter_list;
 struct gl_shader_spirv_data;
@@ -1464,7 +1465,7 @@ struct gl_buffer_object
    /** Memoization of min/max index computations for static index buffers */
    unsigned MinMaxCacheHitIndices;
    unsigned MinMaxCacheMissIndices;
-   struct hash_table *MinMaxCache;
+   struct vbo_minmax_cache *MinMaxCache;
    simple_mtx_t MinMaxCacheMutex;
    bool MinMaxCacheDirty:1;
 
@@ -93,3 +93,94 @@ _mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
    *min_index = min_ui;
    *max_index = max_ui;
 }
+
+#define DEFINE_ARRAY_MIN_MAX(type, bits)                                      \
+static void                                                                   \
+array_min_max_##bits(const type *indices, unsigned *min_index, unsigned *max_index,           \
+     unsigned count, bool restart, unsigned restart_index)                    \
+{                                                                             \
+   const unsigned lanes = 16 / sizeof(type);                                  \
+   const __m128i restart4 = _mm_set1_epi##bits((type)restart_index);          \
+   __m128i min4 = _mm_set1_epi32(~0);                                         \
+   __m128i max4 = _mm_setzero_si128();                                        \
+   unsigned i = 0;                                                            \
+                                                                              \
+   /* An index of this size can't be equal to a larger restart index. */      \
+   if (restart_index > (type)~0)                                              \
+      restart = false;                                                        \
+                                                                              \
+   if (restart) {                                                             \
+      /* Turn restart indices into ~0 for the minimum and 0 for the maximum */ \
+      for (; i + lanes <= count; i += lanes) {                                \
+         __m128i v = _mm_loadu_si128((const __m128i *)&indices[i]);           \
+         __m128i is_restart = _mm_cmpeq_epi##bits(v, restart4);               \
+         min4 = _mm_min_epu##bits(min4, _mm_or_si128(v, is_restart));         \
+         max4 = _mm_max_epu##bits(max4, _mm_andnot_si128(is_restart, v));     \
+      }                                                                       \
+   } else {                                                                   \
+      for (; i + lanes <= count; i += lanes) {                                \
+         __m128i v = _mm_loadu_si128((const __m128i *)&indices[i]);           \
+         min4 = _mm_min_epu##bits(min4, v);                                   \
+         max4 = _mm_max_epu##bits(max4, v);                                   \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   alignas(16) type min_arr[16 / sizeof(type)];                               \
+   alignas(16) type max_arr[16 / sizeof(type)];                               \
+   _mm_store_si128((__m128i *)min_arr, min4);                                 \
+   _mm_store_si128((__m128i *)max_arr, max4);                                 \
+                                                                              \
+   unsigned min_ui = ~0U;                                                     \
+   unsigned max_ui = 0;                                                       \
+   bool found = false;                                                        \
+   for (unsigned j = 0; j < lanes; j++) {                                     \
+      /* A lane which only saw restart indices has min > max. */              \
+      if (min_arr[j] <= max_arr[j]) {                                         \
+         min_ui = MIN2(min_ui, min_arr[j]);                                   \
+         max_ui = MAX2(max_ui, max_arr[j]);                                   \
+         found = true;                                                        \
+      }                                                                       \
+   }                                                                          \
+                                                                              \
+   for (; i < count; i++) {                                                   \
+      if (restart && indices[i] == restart_index)                             \
+         continue;                                                            \
+      min_ui = MIN2(min_ui, indices[i]);                                      \
+      max_ui = MAX2(max_ui, indices[i]);                                      \
+      found = true;                                                           \
+   }                                                                          \
+                                                                              \
+   *min_index = found ? min_ui : ~0U;                                         \
+   *max_index = found ? max_ui : 0;                                           \
+}
+
+DEFINE_ARRAY_MIN_MAX(uint8_t, 8)
+DEFINE_ARRAY_MIN_MAX(uint16_t, 16)
+DEFINE_ARRAY_MIN_MAX(uint32_t, 32)
+
+void
+_mesa_ubyte_array_min_max(const uint8_t *indices, unsigned *min_index,
+                          unsigned *max_index, unsigned count,
+                          bool restart, unsigned restart_index)
+{
+   array_min_max_8(indices, min_index, max_index, count, restart,
+                   restart_index);
+}
+
+void
+_mesa_ushort_array_min_max(const uint16_t *indices, unsigned *min_index,
+                           unsigned *max_index, unsigned count,
+                           bool restart, unsigned restart_index)
+{
+   array_min_max_16(indices, min_index, max_index, count, restart,
+                    restart_index);
+}
+
+void
+_mesa_uint_array_min_max_restart(const uint32_t *indices, unsigned *min_index,
+                                 unsigned *max_index, unsigned count,
+                                 unsigned restart_index)
+{
+   array_min_max_32(indices, min_index, max_index, count, true,
+                    restart_index);
+}
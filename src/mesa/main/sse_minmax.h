@@ -28,8 +28,29 @@
 #ifndef SSE_MINMAX_H
 #define SSE_MINMAX_H
 
+#include <stdbool.h>
+#include <stdint.h>
+
 void
 _mesa_uint_array_min_max(const unsigned *ui_indices, unsigned *min_index,
                          unsigned *max_index, const unsigned count);
 
+/* These skip indices equal to restart_index if restart is set.  If there
+ * are no other indices, *min_index is ~0 and *max_index is 0.
+ */
+void
+_mesa_ubyte_array_min_max(const uint8_t *indices, unsigned *min_index,
+                          unsigned *max_index, unsigned count,
+                          bool restart, unsigned restart_index);
+
+void
+_mesa_ushort_array_min_max(const uint16_t *indices, unsigned *min_index,
+                           unsigned *max_index, unsigned count,
+                           bool restart, unsigned restart_index);
+
+void
+_mesa_uint_array_min_max_restart(const uint32_t *indices, unsigned *min_index,
+                                 unsigned *max_index, unsigned count,
+                                 unsigned restart_index);
+
 #endif /* SSE_MINMAX_H */
@@ -0,0 +1,392 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "frontend/api.h"
+#include "main/mtypes.h"
+#include "pipe/p_context.h"
+#include "util/macros.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+#include "vbo/vbo.h"
+
+extern "C" {
+#include "main/sse_minmax.h"
+}
+
+/* xorshift32, so that failures reproduce everywhere. */
+static uint32_t
+next_random(uint32_t *state)
+{
+   uint32_t x = *state;
+   x ^= x << 13;
+   x ^= x >> 17;
+   x ^= x << 5;
+   return *state = x;
+}
+
+template <typename T>
+static void
+scalar_min_max(const T *indices, unsigned count, bool restart,
+               unsigned restart_index, unsigned *min_index,
+               unsigned *max_index)
+{
+   *min_index = ~0u;
+   *max_index = 0;
+   for (unsigned i = 0; i < count; i++) {
+      if (restart && indices[i] == restart_index)
+         continue;
+      *min_index = MIN2(*min_index, indices[i]);
+      *max_index = MAX2(*max_index, indices[i]);
+   }
+}
+
+#if defined(USE_SSE41)
+static void
+sse_min_max(const uint8_t *indices, unsigned count, bool restart,
+            unsigned restart_index, unsigned *min_index, unsigned *max_index)
+{
+   _mesa_ubyte_array_min_max(indices, min_index, max_index, count, restart,
+                             restart_index);
+}
+
+static void
+sse_min_max(const uint16_t *indices, unsigned count, bool restart,
+            unsigned restart_index, unsigned *min_index, unsigned *max_index)
+{
+   _mesa_ushort_array_min_max(indices, min_index, max_index, count, restart,
+                              restart_index);
+}
+
+static void
+sse_min_max(const uint32_t *indices, unsigned count, bool restart,
+            unsigned restart_index, unsigned *min_index, unsigned *max_index)
+{
+   if (restart) {
+      _mesa_uint_array_min_max_restart(indices, min_index, max_index, count,
+                                       restart_index);
+   } else {
+      _mesa_uint_array_min_max(indices, min_index, max_index, count);
+   }
+}
+#endif
+
+/* Checks the SSE kernels, if there are any, and vbo_get_minmax_index_mapped
+ * against the scalar loop, for every count up to a few vectors and every
+ * misalignment of the first index.
+ */
+template <typename T>
+static void
+check_kernels(const std::vector<T> &indices, bool restart,
+              unsigned restart_index, const char *what)
+{
+   const unsigned lanes = 16 / sizeof(T);
+
+   for (unsigned start = 0; start < lanes && start < indices.size(); start++) {
+      for (unsigned count = 0; start + count <= indices.size();
+           count += count < 4 * lanes + 1 ? 1 : 7) {
+         const T *data = &indices[start];
+         unsigned min_ref, max_ref, min, max;
+
+         scalar_min_max(data, count, restart, restart_index, &min_ref,
+                        &max_ref);
+
+         vbo_get_minmax_index_mapped(count, sizeof(T), restart_index, restart,
+                                     data, &min, &max);
+         ASSERT_EQ(min, min_ref) << what << ": start " << start
+                                 << " count " << count;
+         ASSERT_EQ(max, max_ref) << what << ": start " << start
+                                 << " count " << count;
+
+#if defined(USE_SSE41)
+         if (util_get_cpu_caps()->has_sse4_1) {
+            sse_min_max(data, count, restart, restart_index, &min, &max);
+            ASSERT_EQ(min, min_ref) << what << " (sse): start " << start
+                                    << " count " << count;
+            ASSERT_EQ(max, max_ref) << what << " (sse): start " << start
+                                    << " count " << count;
+         }
+#endif
+      }
+   }
+}
+
+template <typename T>
+static void
+check_kernels_for_type()
+{
+   const unsigned lanes = 16 / sizeof(T);
+   const unsigned type_max = (T)~0;
+   const unsigned size = 8 * lanes + 5;
+   uint32_t seed = sizeof(T);
+   std::vector<T> indices(size);
+
+   for (unsigned i = 0; i < size; i++)
+      indices[i] = next_random(&seed);
+   check_kernels(indices, false, 0, "random");
+
+   /* The usual restart index, scattered around. */
+   for (unsigned i = 0; i < size; i++)
+      indices[i] = next_random(&seed) % 4 ? next_random(&seed) % type_max : type_max;
+   check_kernels(indices, true, type_max, "restart ~0");
+   check_kernels(indices, false, type_max, "restart ~0 disabled");
+
+   /* A restart index in the middle of the range, only in some lanes, so
+    * that the other lanes never see anything but restart indices.
+    */
+   const unsigned restart_index = type_max / 2;
+   for (unsigned i = 0; i < size; i++)
+      indices[i] = i % lanes < 2 ? next_random(&seed) : restart_index;
+   check_kernels(indices, true, restart_index, "restart in some lanes");
+
+   /* Nothing but restart indices. */
+   std::fill(indices.begin(), indices.end(), (T)restart_index);
+   check_kernels(indices, true, restart_index, "all restart");
+
+   /* A restart index wider than the type never matches, even if its low
+    * bits do and skipping those would change the result.
+    */
+   if (sizeof(T) < 4) {
+      for (unsigned i = 0; i < size; i++)
+         indices[i] = i % 3 ? 1 + next_random(&seed) % (type_max - 1) : 0;
+      indices[size / 2] = type_max;
+      check_kernels(indices, true, type_max + 1, "wide restart");
+      check_kernels(indices, true, ~0u, "wide restart ~0");
+   }
+}
+
+TEST(minmax_index, kernels_8)
+{
+   check_kernels_for_type<uint8_t>();
+}
+
+TEST(minmax_index, kernels_16)
+{
+   check_kernels_for_type<uint16_t>();
+}
+
+TEST(minmax_index, kernels_32)
+{
+   check_kernels_for_type<uint32_t>();
+}
+
+/* Just enough of a context and pipe for vbo_get_minmax_index to map an
+ * index buffer kept in host memory.
+ */
+class minmax_cache : public ::testing::Test {
+protected:
+   static void *
+   buffer_map(struct pipe_context *pipe, struct pipe_resource *resource,
+              unsigned level, unsigned usage, const struct pipe_box *box,
+              struct pipe_transfer **out_transfer)
+   {
+      minmax_cache *test = (minmax_cache *)pipe->priv;
+      test->maps++;
+      *out_transfer = &test->transfer;
+      return &test->data[box->x];
+   }
+
+   static void
+   buffer_unmap(struct pipe_context *pipe, struct pipe_transfer *transfer)
+   {
+   }
+
+   void
+   init(unsigned size)
+   {
+      data.assign(size, 0);
+
+      memset(&pipe, 0, sizeof(pipe));
+      pipe.priv = this;
+      pipe.buffer_map = buffer_map;
+      pipe.buffer_unmap = buffer_unmap;
+
+      memset(&resource, 0, sizeof(resource));
+      resource.target = PIPE_BUFFER;
+      resource.width0 = size;
+
+      memset(&transfer, 0, sizeof(transfer));
+      transfer.resource = &resource;
+
+      memset(&opts, 0, sizeof(opts));
+      ctx = (struct gl_context *)calloc(1, sizeof(*ctx));
+      ctx->pipe = &pipe;
+      ctx->st_opts = &opts;
+
+      memset(&obj, 0, sizeof(obj));
+      obj.Size = size;
+      obj.buffer = &resource;
+      simple_mtx_init(&obj.MinMaxCacheMutex, mtx_plain);
+   }
+
+   void
+   TearDown() override
+   {
+      if (ctx) {
+         vbo_delete_minmax_cache(&obj);
+         simple_mtx_destroy(&obj.MinMaxCacheMutex);
+         free(ctx);
+      }
+   }
+
+   /* Like glBufferSubData. */
+   template <typename T>
+   void
+   write(unsigned first, const std::vector<T> &indices)
+   {
+      vbo_minmax_cache_invalidate(&obj, first * sizeof(T),
+                                  indices.size() * sizeof(T));
+      memcpy(&data[first * sizeof(T)], indices.data(),
+             indices.size() * sizeof(T));
+   }
+
+   /* Queries [first, first + count) and checks it against the scalar loop.
+    * Returns how many indices were read from the buffer to answer it.
+    */
+   template <typename T>
+   unsigned
+   query(unsigned first, unsigned count, bool restart, unsigned restart_index)
+   {
+      unsigned min_ref, max_ref, min, max;
+      unsigned misses = obj.MinMaxCacheMissIndices;
+
+      scalar_min_max((const T *)data.data() + first, count, restart,
+                     restart_index, &min_ref, &max_ref);
+      vbo_get_minmax_index(ctx, &obj, NULL, first * sizeof(T), count,
+                           sizeof(T), restart, restart_index, &min, &max);
+
+      EXPECT_EQ(min, min_ref) << sizeof(T) << "-byte indices "
+                              << first << "+" << count;
+      EXPECT_EQ(max, max_ref) << sizeof(T) << "-byte indices "
+                              << first << "+" << count;
+      return obj.MinMaxCacheMissIndices - misses;
+   }
+
+   template <typename T> void check_tree(bool restart);
+
+   struct pipe_context pipe;
+   struct pipe_resource resource;
+   struct pipe_transfer transfer;
+   struct st_config_options opts;
+   struct gl_context *ctx = NULL;
+   struct gl_buffer_object obj;
+   std::vector<uint8_t> data;
+   unsigned maps = 0;
+};
+
+/* Must match MINMAX_BLOCK_INDICES in vbo_minmax_index.c. */
+#define BLOCK 256
+
+/* The indices of a range that aren't in one of its whole blocks. */
+static unsigned
+partial_indices(unsigned first, unsigned count)
+{
+   const unsigned end = first + count;
+   const unsigned head = MIN2(align(first, BLOCK), end) - first;
+
+   return head + end - MAX2(end / BLOCK * BLOCK, first + head);
+}
+
+template <typename T>
+void
+minmax_cache::check_tree(bool restart)
+{
+   const unsigned type_max = (T)~0;
+   const unsigned restart_index = restart ? type_max : 0;
+   const unsigned num_indices = 64 * BLOCK + 77;
+   uint32_t seed = sizeof(T) * 2 + restart;
+
+   init(num_indices * sizeof(T));
+
+   /* Leave room above and below for the writes further down. */
+   std::vector<T> indices(num_indices);
+   for (unsigned i = 0; i < num_indices; i++) {
+      indices[i] = 16 + next_random(&seed) % MIN2(type_max - 40, 100000u);
+      if (restart && i % 5 == 0)
+         indices[i] = restart_index;
+   }
+   write(0, indices);
+
+   /* The first query fills the whole tree. */
+   EXPECT_EQ(query<T>(0, num_indices, restart, restart_index), num_indices);
+
+   /* Other ranges only read their unaligned head and tail. */
+   static const struct {
+      unsigned first, count;
+   } ranges[] = {
+      { 300, 40 * BLOCK + 123 },
+      { BLOCK, 8 * BLOCK },
+      { 1, 64 * BLOCK - 1 },
+      { 3 * BLOCK + 255, BLOCK + 2 },
+      { 17 * BLOCK - 1, 2 },
+   };
+
+   for (unsigned i = 0; i < ARRAY_SIZE(ranges); i++) {
+      const unsigned first = ranges[i].first, count = ranges[i].count;
+
+      EXPECT_EQ(query<T>(first, count, restart, restart_index),
+                partial_indices(first, count))
+         << "range " << first << "+" << count;
+
+      /* Repeating it hits the range hash and doesn't map the buffer. */
+      const unsigned old_maps = maps;
+      EXPECT_EQ(query<T>(first, count, restart, restart_index), 0u);
+      EXPECT_EQ(maps, old_maps);
+   }
+
+   /* A partial write straddling blocks 20 and 21 with a new minimum and
+    * maximum only drops those two blocks, and the ranges overlapping it.
+    */
+   std::vector<T> update(BLOCK / 2);
+   for (unsigned i = 0; i < update.size(); i++)
+      update[i] = 20 + i % 7;
+   update[3] = 3;
+   update[update.size() - 2] = type_max - 1;
+   write(20 * BLOCK + BLOCK * 3 / 4, update);
+
+   EXPECT_EQ(query<T>(300, 40 * BLOCK + 123, restart, restart_index),
+             partial_indices(300, 40 * BLOCK + 123) + 2 * BLOCK);
+   EXPECT_EQ(query<T>(0, num_indices, restart, restart_index), 77u);
+   EXPECT_EQ(query<T>(1, 64 * BLOCK - 1, restart, restart_index),
+             partial_indices(1, 64 * BLOCK - 1));
+
+   /* Ranges that don't overlap the write are still in the hash. */
+   EXPECT_EQ(query<T>(BLOCK, 8 * BLOCK, restart, restart_index), 0u);
+   EXPECT_EQ(query<T>(17 * BLOCK - 1, 2, restart, restart_index), 0u);
+}
+
+TEST_F(minmax_cache, tree_8)
+{
+   check_tree<uint8_t>(false);
+}
+
+TEST_F(minmax_cache, tree_8_restart)
+{
+   check_tree<uint8_t>(true);
+}
+
+TEST_F(minmax_cache, tree_16)
+{
+   check_tree<uint16_t>(false);
+}
+
+TEST_F(minmax_cache, tree_16_restart)
+{
+   check_tree<uint16_t>(true);
+}
+
+TEST_F(minmax_cache, tree_32)
+{
+   check_tree<uint32_t>(false);
+}
+
+TEST_F(minmax_cache, tree_32_restart)
+{
+   check_tree<uint32_t>(true);
+}
@@ -0,0 +1,200 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "main/texcompress_astc.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+
+static const struct {
+   mesa_format format;
+   unsigned block_w, block_h;
+} astc_formats[] = {
+#define ASTC_FORMATS(w, h) \
+   { MESA_FORMAT_RGBA_ASTC_##w##x##h, w, h }, \
+   { MESA_FORMAT_SRGB8_ALPHA8_ASTC_##w##x##h, w, h },
+   ASTC_FORMATS(4, 4)
+   ASTC_FORMATS(5, 4)
+   ASTC_FORMATS(5, 5)
+   ASTC_FORMATS(6, 5)
+   ASTC_FORMATS(6, 6)
+   ASTC_FORMATS(8, 5)
+   ASTC_FORMATS(8, 6)
+   ASTC_FORMATS(8, 8)
+   ASTC_FORMATS(10, 5)
+   ASTC_FORMATS(10, 6)
+   ASTC_FORMATS(10, 8)
+   ASTC_FORMATS(10, 10)
+   ASTC_FORMATS(12, 10)
+   ASTC_FORMATS(12, 12)
+#undef ASTC_FORMATS
+};
+
+static bool
+is_error_colour(const uint8_t *texel)
+{
+   return texel[0] == 0xff && texel[1] == 0 && texel[2] == 0xff && texel[3] == 0xff;
+}
+
+/* Numerical Recipes LCG, so that the blocks are the same on every platform
+ * and the golden hashes below stay valid.
+ */
+static uint8_t
+next_random(uint32_t *state)
+{
+   *state = *state * 1664525u + 1013904223u;
+   return *state >> 24;
+}
+
+/* Random blocks, rerolled until they decode without error so that the
+ * image exercises the actual decoding rather than the error path.  Every
+ * raw_every-th block is kept as generated instead, to also cover void
+ * extent and illegal encodings.
+ */
+static std::vector<uint8_t>
+random_blocks(mesa_format format, unsigned block_w, unsigned block_h,
+              unsigned num_blocks, uint32_t seed, unsigned raw_every = 0)
+{
+   std::vector<uint8_t> blocks(num_blocks * 16);
+   uint8_t texels[12 * 12 * 4];
+
+   for (unsigned b = 0; b < num_blocks; b++) {
+      uint8_t *block = &blocks[b * 16];
+      const bool raw = raw_every && b % raw_every == 0;
+      do {
+         for (unsigned i = 0; i < 16; i++)
+            block[i] = next_random(&seed);
+         if (raw)
+            break;
+         _mesa_unpack_astc_2d_ldr(texels, block_w * 4, block, 16,
+                                  block_w, block_h, format);
+      } while (is_error_colour(texels));
+   }
+
+   return blocks;
+}
+
+/* Decoding a whole image, split across threads, produces the same texels
+ * as decoding every block on its own, including the partial blocks at the
+ * right and bottom edges.
+ */
+TEST(texcompress_astc, image_matches_blocks)
+{
+   for (unsigned f = 0; f < ARRAY_SIZE(astc_formats); f++) {
+      const mesa_format format = astc_formats[f].format;
+      const unsigned bw = astc_formats[f].block_w, bh = astc_formats[f].block_h;
+      const unsigned width = 41 * bw + 3, height = 29 * bh + 1;
+      const unsigned blocks_x = DIV_ROUND_UP(width, bw);
+      const unsigned blocks_y = DIV_ROUND_UP(height, bh);
+      std::vector<uint8_t> blocks =
+         random_blocks(format, bw, bh, blocks_x * blocks_y, f);
+      std::vector<uint8_t> image(width * height * 4);
+
+      _mesa_unpack_astc_2d_ldr(image.data(), width * 4, blocks.data(),
+                               blocks_x * 16, width, height, format);
+
+      for (unsigned by = 0; by < blocks_y; by++) {
+         for (unsigned bx = 0; bx < blocks_x; bx++) {
+            uint8_t texels[12 * 12 * 4];
+            _mesa_unpack_astc_2d_ldr(texels, bw * 4,
+                                     &blocks[(by * blocks_x + bx) * 16], 16,
+                                     bw, bh, format);
+
+            for (unsigned y = 0; y < bh && by * bh + y < height; y++) {
+               const unsigned w = MIN2(bw, width - bx * bw);
+               const uint8_t *row = &image[((by * bh + y) * width + bx * bw) * 4];
+               ASSERT_EQ(memcmp(row, &texels[y * bw * 4], w * 4), 0)
+                  << bw << "x" << bh << " format " << format
+                  << " block " << bx << "," << by << " row " << y;
+            }
+         }
+      }
+   }
+}
+
+/* FNV-1a hashes of images decoded by the per-block decoder that the
+ * table-driven one replaced, in astc_formats order.  The images are 37x29
+ * blocks with partial blocks at the right and bottom edges, so that they
+ * are also split across threads.
+ */
+static const uint64_t old_decoder_hashes[] = {
+   0xf54673a3bd4d4bacull, 0xbd593a7d68744ee4ull, /* 4x4 */
+   0x5588216912bf2aceull, 0x311d758fe2db0c23ull, /* 5x4 */
+   0x4080c89d7965d3dbull, 0xba29a0c0b1471f49ull, /* 5x5 */
+   0xa35d1ed43e36040dull, 0x58852664ddfdab88ull, /* 6x5 */
+   0xdb9654d20bec0e40ull, 0xe4696241a223d337ull, /* 6x6 */
+   0x24305ba234db0f02ull, 0x00e1c982e4f79120ull, /* 8x5 */
+   0xf6e5a348d37cd6c9ull, 0x78f30f3061a7a522ull, /* 8x6 */
+   0x77a648a3a86bb415ull, 0x9e2247a9bca6d257ull, /* 8x8 */
+   0x5a48ca4766548f42ull, 0xf3912b49b51c55f4ull, /* 10x5 */
+   0xd40e51c698305cceull, 0xe6794947975dafe0ull, /* 10x6 */
+   0xb8bba4d4c29df970ull, 0x78d40df658dcfd6eull, /* 10x8 */
+   0x90bb1b88df592698ull, 0xb6a90bc38ed97066ull, /* 10x10 */
+   0x2de27e3bb91736bcull, 0x04c445c7ef0e08a0ull, /* 12x10 */
+   0x5e23a761c9fb9da9ull, 0x97c9e92f59cbddd6ull, /* 12x12 */
+};
+
+static uint64_t
+fnv1a(const uint8_t *data, size_t size)
+{
+   uint64_t hash = 0xcbf29ce484222325ull;
+   for (size_t i = 0; i < size; i++)
+      hash = (hash ^ data[i]) * 0x100000001b3ull;
+   return hash;
+}
+
+/* The decoder produces the same texels as the one it replaced, for valid,
+ * void extent and illegal blocks of every footprint.
+ */
+TEST(texcompress_astc, matches_old_decoder)
+{
+   STATIC_ASSERT(ARRAY_SIZE(old_decoder_hashes) == ARRAY_SIZE(astc_formats));
+
+   for (unsigned f = 0; f < ARRAY_SIZE(astc_formats); f++) {
+      const mesa_format format = astc_formats[f].format;
+      const unsigned bw = astc_formats[f].block_w, bh = astc_formats[f].block_h;
+      const unsigned width = 36 * bw + bw / 2 + 1, height = 28 * bh + bh / 2 + 1;
+      const unsigned blocks_x = DIV_ROUND_UP(width, bw);
+      const unsigned blocks_y = DIV_ROUND_UP(height, bh);
+      std::vector<uint8_t> blocks =
+         random_blocks(format, bw, bh, blocks_x * blocks_y, 0x9e3779b9u + f, 4);
+      std::vector<uint8_t> image(width * height * 4);
+
+      _mesa_unpack_astc_2d_ldr(image.data(), width * 4, blocks.data(),
+                               blocks_x * 16, width, height, format);
+
+      EXPECT_EQ(fnv1a(image.data(), image.size()), old_decoder_hashes[f])
+         << bw << "x" << bh << (f % 2 ? " sRGB" : " linear")
+         << std::hex << " hash 0x" << fnv1a(image.data(), image.size());
+   }
+}
+
+/* Decode throughput of every footprint. */
+TEST(texcompress_astc, throughput)
+{
+   const unsigned width = 1024, height = 1024;
+   std::vector<uint8_t> image(width * height * 4);
+
+   for (unsigned f = 0; f < ARRAY_SIZE(astc_formats); f += 2) {
+      const mesa_format format = astc_formats[f].format;
+      const unsigned bw = astc_formats[f].block_w, bh = astc_formats[f].block_h;
+      const unsigned blocks_x = DIV_ROUND_UP(width, bw);
+      std::vector<uint8_t> blocks =
+         random_blocks(format, bw, bh, blocks_x * DIV_ROUND_UP(height, bh), f);
+
+      int64_t t0 = os_time_get_nano();
+      _mesa_unpack_astc_2d_ldr(image.data(), width * 4, blocks.data(),
+                               blocks_x * 16, width, height, format);
+      int64_t t1 = os_time_get_nano();
+
+      printf("%2ux%-2u %8.2f MPix/s\n", bw, bh,
+             (double)width * height * 1000.0 / (t1 - t0));
+   }
+}
@@ -36,8 +36,12 @@
 #include "texcompress_astc.h"
 #include "macros.h"
 #include "util/half_float.h"
+#include "util/u_call_once.h"
+#include "util/u_math.h"
+#include "util/u_queue.h"
 #include <stdio.h>
 #include <cstdlib>  // for abort() on windows
+#include <new>
 
 static bool VERBOSE_DECODE = false;
 static bool VERBOSE_WRITE = false;
@@ -380,52 +384,32 @@ struct InputBitVector
    uint32_t get_bits(int offset, int count)
    {
       assert(count >= 0 && count < 32);
-
-      uint32_t out = 0;
-      if (offset < 32)
-         out |= data[0] >> offset;
-
-      if (0 < offset && offset <= 32)
-         out |= data[1] << (32 - offset);
-      if (32 < offset && offset < 64)
-         out |= data[1] >> (offset - 32);
-
-      if (32 < offset && offset <= 64)
-         out |= data[2] << (64 - offset);
-      if (64 < offset && offset < 96)
-         out |= data[2] >> (offset - 64);
-
-      if (64 < offset && offset <= 96)
-         out |= data[3] << (96 - offset);
-      if (96 < offset && offset < 128)
-         out |= data[3] >> (offset - 96);
-
-      out &= (1 << count) - 1;
-      return out;
+      return get_bits64(offset, count);
    }
 
    uint64_t get_bits64(int offset, int count)
    {
       assert(count >= 0 && count < 64);
 
-      uint64_t out = 0;
-      if (offset < 32)
-         out |= data[0] >> offset;
-
-      if (offset <= 32)
-         out |= (uint64_t)data[1] << (32 - offset);
-      if (32 < offset && offset < 64)
-         out |= data[1] >> (offset - 32);
-
-      if (0 < offset && offset <= 64)
-         out |= (uint64_t)data[2] << (64 - offset);
-      if (64 < offset && offset < 96)
-         out |= data[2] >> (offset - 64);
-
-      if (32 < offset && offset <= 96)
-         out |= (uint64_t)data[3] << (96 - offset);
-      if (96 < offset && offset < 128)
-         out |= data[3] >> (offset - 96);
+      /* Invalid blocks can ask for fields outside of the block before they
+       * are rejected.
+       */
+      if (offset < 0 || offset >= 128)
+         return 0;
+
+      /* Shift the 128 bits as two 64-bit halves rather than going through
+       * each 32-bit word.
+       */
+      uint64_t lo = data[0] | (uint64_t)data[1] << 32;
+      uint64_t hi = data[2] | (uint64_t)data[3] << 32;
+
+      uint64_t out;
+      if (offset == 0)
+         out = lo;
+      else if (offset < 64)
+         out = (lo >> offset) | (hi << (64 - offset));
+      else
+         out = hi >> (offset - 64);
 
       out &= ((uint64_t)1 << count) - 1;
       return out;
@@ -434,11 +418,10 @@ struct InputBitVector
    uint32_t get_bits_rev(int offset, int count)
    {
       assert(offset >= count);
+      if (count == 0)
+         return 0;
       uint32_t tmp = get_bits(offset - count, count);
-      uint32_t out = 0;
-      for (int i = 0; i < count; ++i)
-         out |= ((tmp >> i) & 1) << (count - 1 - i);
-      return out;
+      return util_bitreverse(tmp) >> (32 - count);
    }
 };
 
@@ -533,6 +516,43 @@ struct OutputBitVector
 };
 
 
+/**
+ * Where a texel takes its weight from in the weight grid: the first of the
+ * four grid points around it, and their bilinear factors.
+ */
+struct infill_texel
+{
+   uint8_t v0;
+   uint8_t w00, w01, w10, w11;
+};
+
+/**
+ * Tables that only depend on the block footprint and a few fields of a
+ * block, kept by each thread decoding blocks of the same footprint.
+ */
+struct decode_cache
+{
+   /* Partition assignments of the texels for recently seen partition seeds,
+    * direct-mapped by seed. Blocks of a texture tend to reuse a small set of
+    * partitionings, and computing one costs a hash per texel. The key is
+    * (partition count - 1) * 1024 + seed, 0 for empty entries.
+    */
+   uint16_t partition_key[256];
+   uint8_t partitions[256][216]; /* large enough for 6x6x6 */
+
+   /* Infill positions of the texels for each weight grid size, indexed by
+    * (wt_h - 2) * 11 + wt_w - 2.
+    */
+   bool infill_valid[11 * 11];
+   infill_texel infill[11 * 11][216];
+
+   decode_cache()
+   {
+      memset(partition_key, 0, sizeof(partition_key));
+      memset(infill_valid, 0, sizeof(infill_valid));
+   }
+};
+
 class Decoder
 {
 public:
@@ -540,7 +560,11 @@ public:
       : block_w(block_w), block_h(block_h), block_d(block_d), srgb(srgb),
         output_unorm8(output_unorm8) {}
 
-   decode_error::type decode(const uint8_t *in, uint16_t *output) const;
+   decode_error::type decode(const uint8_t *in, uint16_t *output,
+                             decode_cache *cache = NULL) const;
+
+   void compute_partitions(int seed, int num_parts, uint8_t *out) const;
+   void compute_infill_texels(int wt_w, int wt_h, infill_texel *out) const;
 
    int block_w, block_h, block_d;
    bool srgb, output_unorm8;
@@ -609,6 +633,7 @@ struct Block
    int ce_trits;
    int ce_quints;
    int ce_bits;
+   int ce_range; /* index into cem_ranges[] */
 
    /* Calculated by compute_infill_weights(); */
    uint8_t infill_weights[2][216]; /* large enough for 6x6x6 */
@@ -623,7 +648,8 @@ struct Block
    void unquantise_weights();
    void unquantise_colour_endpoints();
 
-   decode_error::type decode(const Decoder &decoder, InputBitVector in);
+   decode_error::type decode(const Decoder &decoder, InputBitVector in,
+                             decode_cache *cache);
 
    decode_error::type decode_block_mode(InputBitVector in);
    decode_error::type decode_void_extent(InputBitVector in);
@@ -631,20 +657,113 @@ struct Block
    void unpack_colour_endpoints(InputBitVector in);
    void decode_colour_endpoints();
    void unpack_weights(InputBitVector in);
-   void compute_infill_weights(int block_w, int block_h, int block_d);
+   void compute_infill_weights(const Decoder &decoder, decode_cache *cache);
 
-   void write_decoded(const Decoder &decoder, uint16_t *output);
+   void write_decoded(const Decoder &decoder, uint16_t *output,
+                      const uint8_t *partitions);
 };
 
+/**
+ * Everything that only depends on the 11 bits of block mode, for all of
+ * them, so that decoding a block starts with a table lookup.
+ */
+struct block_mode_info
+{
+   decode_error::type err;
+   bool is_void_extent;
+   uint8_t dual_plane, high_prec, wt_range, wt_w, wt_h;
+   uint8_t wt_trits, wt_quints, wt_bits, wt_max;
+   uint16_t num_weights, weight_bits;
+};
 
-decode_error::type Decoder::decode(const uint8_t *in, uint16_t *output) const
+static block_mode_info block_modes[1 << 11];
+
+static void init_block_modes(void)
+{
+   for (unsigned mode = 0; mode < ARRAY_SIZE(block_modes); ++mode) {
+      block_mode_info *info = &block_modes[mode];
+      memset(info, 0, sizeof(*info));
+
+      if ((mode & 0x1ff) == 0x1fc) {
+         info->err = decode_error::ok;
+         info->is_void_extent = true;
+         continue;
+      }
+
+      InputBitVector in;
+      memset(&in, 0, sizeof(in));
+      in.data[0] = mode;
+
+      Block blk;
+      blk.wt_d = 1;
+      blk.is_void_extent = false;
+      info->err = blk.decode_block_mode(in);
+      if (info->err != decode_error::ok)
+         continue;
+
+      blk.calculate_from_weights();
+
+      info->dual_plane = blk.dual_plane;
+      info->high_prec = blk.high_prec;
+      info->wt_range = blk.wt_range;
+      info->wt_w = blk.wt_w;
+      info->wt_h = blk.wt_h;
+      info->wt_trits = blk.wt_trits;
+      info->wt_quints = blk.wt_quints;
+      info->wt_bits = blk.wt_bits;
+      info->wt_max = blk.wt_max;
+      info->num_weights = blk.num_weights;
+      info->weight_bits = blk.weight_bits;
+   }
+}
+
+
+void Decoder::compute_partitions(int seed, int num_parts, uint8_t *out) const
+{
+   int small_block = (block_w * block_h * block_d) < 31;
+
+   int idx = 0;
+   for (int z = 0; z < block_d; ++z) {
+      for (int y = 0; y < block_h; ++y) {
+         for (int x = 0; x < block_w; ++x) {
+            out[idx] = select_partition(seed, x, y, z, num_parts, small_block);
+            assert(out[idx] < num_parts);
+            idx++;
+         }
+      }
+   }
+}
+
+decode_error::type Decoder::decode(const uint8_t *in, uint16_t *output,
+                                   decode_cache *cache) const
 {
    Block blk;
    InputBitVector in_vec;
    memcpy(&in_vec.data, in, 16);
-   decode_error::type err = blk.decode(*this, in_vec);
+   decode_error::type err = blk.decode(*this, in_vec, cache);
    if (err == decode_error::ok) {
-      blk.write_decoded(*this, output);
+      const uint8_t *partitions = NULL;
+      uint8_t partitions_tmp[216];
+
+      if (!blk.is_void_extent && blk.num_parts > 1) {
+         uint16_t key = (blk.num_parts - 1) * 1024 + blk.partition_index;
+
+         if (cache) {
+            unsigned slot = key % ARRAY_SIZE(cache->partition_key);
+            if (cache->partition_key[slot] != key) {
+               compute_partitions(blk.partition_index, blk.num_parts,
+                                  cache->partitions[slot]);
+               cache->partition_key[slot] = key;
+            }
+            partitions = cache->partitions[slot];
+         } else {
+            compute_partitions(blk.partition_index, blk.num_parts,
+                               partitions_tmp);
+            partitions = partitions_tmp;
+         }
+      }
+
+      blk.write_decoded(*this, output, partitions);
    } else {
       /* Fill output with the error colour */
       for (int i = 0; i < block_w * block_h * block_d; ++i) {
@@ -1158,107 +1277,115 @@ void Block::unpack_weights(InputBitVector in)
    }
 }
 
-void Block::unquantise_weights()
+static uint8_t unquantise_weight(int wt_trits, int wt_quints, int wt_bits, uint8_t v)
 {
-   assert(num_weights <= (int)ARRAY_SIZE(weights_quant));
-   assert(num_weights <= (int)ARRAY_SIZE(weights));
+   uint8_t w;
 
-   memset(weights, 0, sizeof(weights));
-
-   for (int i = 0; i < num_weights; ++i) {
-
-      uint8_t v = weights_quant[i];
-      uint8_t w;
-
-      if (wt_trits) {
+   if (wt_trits) {
 
-         if (wt_bits == 0) {
-            w = v * 32;
-         } else {
-            uint8_t A, B, C, D;
-            A = (v & 0x1) ? 0x7F : 0x00;
-            switch (wt_bits) {
-            case 1:
-               B = 0;
-               C = 50;
-               D = v >> 1;
-               break;
-            case 2:
-               B = (v & 0x2) ? 0x45 : 0x00;
-               C = 23;
-               D = v >> 2;
-               break;
-            case 3:
-               B = ((v & 0x6) >> 1) | ((v & 0x6) << 4);
-               C = 11;
-               D = v >> 3;
-               break;
-            default:
-               UNREACHABLE("");
-            }
-            uint16_t T = D * C + B;
-            T = T ^ A;
-            T = (A & 0x20) | (T >> 2);
-            assert(T < 64);
-            if (T > 32)
-               T++;
-            w = T;
+      if (wt_bits == 0) {
+         w = v * 32;
+      } else {
+         uint8_t A, B, C, D;
+         A = (v & 0x1) ? 0x7F : 0x00;
+         switch (wt_bits) {
+         case 1:
+            B = 0;
+            C = 50;
+            D = v >> 1;
+            break;
+         case 2:
+            B = (v & 0x2) ? 0x45 : 0x00;
+            C = 23;
+            D = v >> 2;
+            break;
+         case 3:
+            B = ((v & 0x6) >> 1) | ((v & 0x6) << 4);
+            C = 11;
+            D = v >> 3;
+            break;
+         default:
+            UNREACHABLE("");
          }
+         uint16_t T = D * C + B;
+         T = T ^ A;
+         T = (A & 0x20) | (T >> 2);
+         assert(T < 64);
+         if (T > 32)
+            T++;
+         w = T;
+      }
 
-      } else if (wt_quints) {
-
-         if (wt_bits == 0) {
-            w = v * 16;
-         } else {
-            uint8_t A, B, C, D;
-            A = (v & 0x1) ? 0x7F : 0x00;
-            switch (wt_bits) {
-            case 1:
-               B = 0;
-               C = 28;
-               D = v >> 1;
-               break;
-            case 2:
-               B = (v & 0x2) ? 0x42 : 0x00;
-               C = 13;
-               D = v >> 2;
-               break;
-            default:
-               UNREACHABLE("");
-            }
-            uint16_t T = D * C + B;
-            T = T ^ A;
-            T = (A & 0x20) | (T >> 2);
-            assert(T < 64);
-            if (T > 32)
-               T++;
-            w = T;
-         }
-         weights[i] = w;
+   } else if (wt_quints) {
 
+      if (wt_bits == 0) {
+         w = v * 16;
       } else {
-
+         uint8_t A, B, C, D;
+         A = (v & 0x1) ? 0x7F : 0x00;
          switch (wt_bits) {
-         case 1: w = v ? 0x3F : 0x00; break;
-         case 2: w = v | (v << 2) | (v << 4); break;
-         case 3: w = v | (v << 3); break;
-         case 4: w = (v >> 2) | (v << 2); break;
-         case 5: w = (v >> 4) | (v << 1); break;
-         default: UNREACHABLE("");
+         case 1:
+            B = 0;
+            C = 28;
+            D = v >> 1;
+            break;
+         case 2:
+            B = (v & 0x2) ? 0x42 : 0x00;
+            C = 13;
+            D = v >> 2;
+            break;
+         default:
+            UNREACHABLE("");
          }
-         assert(w < 64);
-         if (w > 32)
-            w++;
+         uint16_t T = D * C + B;
+         T = T ^ A;
+         T = (A & 0x20) | (T >> 2);
+         assert(T < 64);
+         if (T > 32)
+            T++;
+         w = T;
+      }
+
+   } else {
+
+      switch (wt_bits) {
+      case 1: w = v ? 0x3F : 0x00; break;
+      case 2: w = v | (v << 2) | (v << 4); break;
+      case 3: w = v | (v << 3); break;
+      case 4: w = (v >> 2) | (v << 2); break;
+      case 5: w = (v >> 4) | (v << 1); break;
+      default: UNREACHABLE("");
       }
-      weights[i] = w;
+      assert(w < 64);
+      if (w > 32)
+         w++;
    }
+   return w;
 }
 
-void Block::compute_infill_weights(int block_w, int block_h, int block_d)
+/* Unquantised weights, indexed by the high precision bit and range of the
+ * block mode, then by the quantised weight.
+ */
+static uint8_t weight_unquant[2 * 8][32];
+
+void Block::unquantise_weights()
+{
+   assert(num_weights <= (int)ARRAY_SIZE(weights_quant));
+   assert(num_weights <= (int)ARRAY_SIZE(weights));
+
+   const uint8_t *table = weight_unquant[high_prec * 8 + wt_range];
+   for (int i = 0; i < num_weights; ++i)
+      weights[i] = table[weights_quant[i]];
+
+   memset(weights + num_weights, 0, sizeof(weights) - num_weights);
+}
+
+void Decoder::compute_infill_texels(int wt_w, int wt_h, infill_texel *out) const
 {
    int Ds = block_w <= 1 ? 0 : (1024 + block_w / 2) / (block_w - 1);
    int Dt = block_h <= 1 ? 0 : (1024 + block_h / 2) / (block_h - 1);
    int Dr = block_d <= 1 ? 0 : (1024 + block_d / 2) / (block_d - 1);
+   int wt_d = 1;
    for (int r = 0; r < block_d; ++r) {
       for (int t = 0; t < block_h; ++t) {
          for (int s = 0; s < block_w; ++s) {
@@ -1287,153 +1414,213 @@ void Block::compute_infill_weights(int block_w, int block_h, int block_d)
             int w01 = fs - w11;
             int w00 = 16 - fs - ft + w11;
 
-            if (dual_plane) {
-               int p00, p01, p10, p11, i0, i1;
-               int v0 = js + jt * wt_w;
-               p00 = weights[(v0) * 2];
-               p01 = weights[(v0 + 1) * 2];
-               p10 = weights[(v0 + wt_w) * 2];
-               p11 = weights[(v0 + wt_w + 1) * 2];
-               i0 = (p00*w00 + p01*w01 + p10*w10 + p11*w11 + 8) >> 4;
-               p00 = weights[(v0) * 2 + 1];
-               p01 = weights[(v0 + 1) * 2 + 1];
-               p10 = weights[(v0 + wt_w) * 2 + 1];
-               p11 = weights[(v0 + wt_w + 1) * 2 + 1];
-               assert((v0 + wt_w + 1) * 2 + 1 < (int)ARRAY_SIZE(weights));
-               i1 = (p00*w00 + p01*w01 + p10*w10 + p11*w11 + 8) >> 4;
-               assert(0 <= i0 && i0 <= 64);
-               infill_weights[0][s + t*block_w + r*block_w*block_h] = i0;
-               infill_weights[1][s + t*block_w + r*block_w*block_h] = i1;
-            } else {
-               int p00, p01, p10, p11, i;
-               int v0 = js + jt * wt_w;
-               p00 = weights[v0];
-               p01 = weights[v0 + 1];
-               p10 = weights[v0 + wt_w];
-               p11 = weights[v0 + wt_w + 1];
-               assert(v0 + wt_w + 1 < (int)ARRAY_SIZE(weights));
-               i = (p00*w00 + p01*w01 + p10*w10 + p11*w11 + 8) >> 4;
-               assert(0 <= i && i <= 64);
-               infill_weights[0][s + t*block_w + r*block_w*block_h] = i;
-            }
+            infill_texel *texel = &out[s + t*block_w + r*block_w*block_h];
+            texel->v0 = js + jt * wt_w;
+            texel->w00 = w00;
+            texel->w01 = w01;
+            texel->w10 = w10;
+            texel->w11 = w11;
          }
       }
    }
 }
 
+void Block::compute_infill_weights(const Decoder &decoder, decode_cache *cache)
+{
+   const int num_texels = decoder.block_w * decoder.block_h * decoder.block_d;
+   const infill_texel *texels;
+   infill_texel texels_tmp[216];
+
+   if (cache) {
+      int idx = (wt_h - 2) * 11 + wt_w - 2;
+      if (!cache->infill_valid[idx]) {
+         decoder.compute_infill_texels(wt_w, wt_h, cache->infill[idx]);
+         cache->infill_valid[idx] = true;
+      }
+      texels = cache->infill[idx];
+   } else {
+      decoder.compute_infill_texels(wt_w, wt_h, texels_tmp);
+      texels = texels_tmp;
+   }
+
+   for (int idx = 0; idx < num_texels; ++idx) {
+      const infill_texel *texel = &texels[idx];
+      int v0 = texel->v0;
+      int w00 = texel->w00, w01 = texel->w01, w10 = texel->w10, w11 = texel->w11;
+
+      if (dual_plane) {
+         int p00, p01, p10, p11, i0, i1;
+         p00 = weights[(v0) * 2];
+         p01 = weights[(v0 + 1) * 2];
+         p10 = weights[(v0 + wt_w) * 2];
+         p11 = weights[(v0 + wt_w + 1) * 2];
+         i0 = (p00*w00 + p01*w01 + p10*w10 + p11*w11 + 8) >> 4;
+         p00 = weights[(v0) * 2 + 1];
+         p01 = weights[(v0 + 1) * 2 + 1];
+         p10 = weights[(v0 + wt_w) * 2 + 1];
+         p11 = weights[(v0 + wt_w + 1) * 2 + 1];
+         assert((v0 + wt_w + 1) * 2 + 1 < (int)ARRAY_SIZE(weights));
+         i1 = (p00*w00 + p01*w01 + p10*w10 + p11*w11 + 8) >> 4;
+         assert(0 <= i0 && i0 <= 64);
+         infill_weights[0][idx] = i0;
+         infill_weights[1][idx] = i1;
+      } else {
+         int p00, p01, p10, p11, i;
+         p00 = weights[v0];
+         p01 = weights[v0 + 1];
+         p10 = weights[v0 + wt_w];
+         p11 = weights[v0 + wt_w + 1];
+         assert(v0 + wt_w + 1 < (int)ARRAY_SIZE(weights));
+         i = (p00*w00 + p01*w01 + p10*w10 + p11*w11 + 8) >> 4;
+         assert(0 <= i && i <= 64);
+         infill_weights[0][idx] = i;
+      }
+   }
+}
+
+static uint8_t unquantise_colour_endpoint(int ce_trits, int ce_quints, int ce_bits, uint8_t v)
+{
+   if (ce_trits) {
+      uint16_t A, B, C, D;
+      uint16_t t;
+      A = (v & 0x1) ? 0x1FF : 0x000;
+      switch (ce_bits) {
+      case 1:
+         B = 0;
+         C = 204;
+         D = v >> 1;
+         break;
+      case 2:
+         B = (v & 0x2) ? 0x116 : 0x000;
+         C = 93;
+         D = v >> 2;
+         break;
+      case 3:
+         t = ((v >> 1) & 0x3);
+         B = t | (t << 2) | (t << 7);
+         C = 44;
+         D = v >> 3;
+         break;
+      case 4:
+         t = ((v >> 1) & 0x7);
+         B = t | (t << 6);
+         C = 22;
+         D = v >> 4;
+         break;
+      case 5:
+         t = ((v >> 1) & 0xF);
+         B = (t >> 2) | (t << 5);
+         C = 11;
+         D = v >> 5;
+         break;
+      case 6:
+         B = ((v & 0x3E) << 3) | ((v >> 5) & 0x1);
+         C = 5;
+         D = v >> 6;
+         break;
+      default:
+         UNREACHABLE("");
+      }
+      uint16_t T = D * C + B;
+      T = T ^ A;
+      T = (A & 0x80) | (T >> 2);
+      assert(T < 256);
+      return T;
+   } else if (ce_quints) {
+      uint16_t A, B, C, D;
+      uint16_t t;
+      A = (v & 0x1) ? 0x1FF : 0x000;
+      switch (ce_bits) {
+      case 1:
+         B = 0;
+         C = 113;
+         D = v >> 1;
+         break;
+      case 2:
+         B = (v & 0x2) ? 0x10C : 0x000;
+         C = 54;
+         D = v >> 2;
+         break;
+      case 3:
+         t = ((v >> 1) & 0x3);
+         B = (t >> 1) | (t << 1) | (t << 7);
+         C = 26;
+         D = v >> 3;
+         break;
+      case 4:
+         t = ((v >> 1) & 0x7);
+         B = (t >> 1) | (t << 6);
+         C = 13;
+         D = v >> 4;
+         break;
+      case 5:
+         t = ((v >> 1) & 0xF);
+         B = (t >> 4) | (t << 5);
+         C = 6;
+         D = v >> 5;
+         break;
+      default:
+         UNREACHABLE("");
+      }
+      uint16_t T = D * C + B;
+      T = T ^ A;
+      T = (A & 0x80) | (T >> 2);
+      assert(T < 256);
+      return T;
+   } else {
+      switch (ce_bits) {
+      case 1: v = v ? 0xFF : 0x00; break;
+      case 2: v = (v << 6) | (v << 4) | (v << 2) | v; break;
+      case 3: v = (v << 5) | (v << 2) | (v >> 1); break;
+      case 4: v = (v << 4) | v; break;
+      case 5: v = (v << 3) | (v >> 2); break;
+      case 6: v = (v << 2) | (v >> 4); break;
+      case 7: v = (v << 1) | (v >> 6); break;
+      case 8: break;
+      default: UNREACHABLE("");
+      }
+      return v;
+   }
+}
+
+/* Unquantised colour endpoint values, indexed by cem_ranges[] and the
+ * quantised value.
+ */
+static uint8_t colour_endpoint_unquant[ARRAY_SIZE(cem_ranges)][256];
+
 void Block::unquantise_colour_endpoints()
 {
    assert(num_cem_values <= (int)ARRAY_SIZE(colour_endpoints_quant));
    assert(num_cem_values <= (int)ARRAY_SIZE(colour_endpoints));
 
-   for (int i = 0; i < num_cem_values; ++i) {
-      uint8_t v = colour_endpoints_quant[i];
+   const uint8_t *table = colour_endpoint_unquant[ce_range];
+   for (int i = 0; i < num_cem_values; ++i)
+      colour_endpoints[i] = table[colour_endpoints_quant[i]];
+}
 
-      if (ce_trits) {
-         uint16_t A, B, C, D;
-         uint16_t t;
-         A = (v & 0x1) ? 0x1FF : 0x000;
-         switch (ce_bits) {
-         case 1:
-            B = 0;
-            C = 204;
-            D = v >> 1;
-            break;
-         case 2:
-            B = (v & 0x2) ? 0x116 : 0x000;
-            C = 93;
-            D = v >> 2;
-            break;
-         case 3:
-            t = ((v >> 1) & 0x3);
-            B = t | (t << 2) | (t << 7);
-            C = 44;
-            D = v >> 3;
-            break;
-         case 4:
-            t = ((v >> 1) & 0x7);
-            B = t | (t << 6);
-            C = 22;
-            D = v >> 4;
-            break;
-         case 5:
-            t = ((v >> 1) & 0xF);
-            B = (t >> 2) | (t << 5);
-            C = 11;
-            D = v >> 5;
-            break;
-         case 6:
-            B = ((v & 0x3E) << 3) | ((v >> 5) & 0x1);
-            C = 5;
-            D = v >> 6;
-            break;
-         default:
-            UNREACHABLE("");
-         }
-         uint16_t T = D * C + B;
-         T = T ^ A;
-         T = (A & 0x80) | (T >> 2);
-         assert(T < 256);
-         colour_endpoints[i] = T;
-      } else if (ce_quints) {
-         uint16_t A, B, C, D;
-         uint16_t t;
-         A = (v & 0x1) ? 0x1FF : 0x000;
-         switch (ce_bits) {
-         case 1:
-            B = 0;
-            C = 113;
-            D = v >> 1;
-            break;
-         case 2:
-            B = (v & 0x2) ? 0x10C : 0x000;
-            C = 54;
-            D = v >> 2;
-            break;
-         case 3:
-            t = ((v >> 1) & 0x3);
-            B = (t >> 1) | (t << 1) | (t << 7);
-            C = 26;
-            D = v >> 3;
-            break;
-         case 4:
-            t = ((v >> 1) & 0x7);
-            B = (t >> 1) | (t << 6);
-            C = 13;
-            D = v >> 4;
-            break;
-         case 5:
-            t = ((v >> 1) & 0xF);
-            B = (t >> 4) | (t << 5);
-            C = 6;
-            D = v >> 5;
-            break;
-         default:
-            UNREACHABLE("");
-         }
-         uint16_t T = D * C + B;
-         T = T ^ A;
-         T = (A & 0x80) | (T >> 2);
-         assert(T < 256);
-         colour_endpoints[i] = T;
-      } else {
-         switch (ce_bits) {
-         case 1: v = v ? 0xFF : 0x00; break;
-         case 2: v = (v << 6) | (v << 4) | (v << 2) | v; break;
-         case 3: v = (v << 5) | (v << 2) | (v >> 1); break;
-         case 4: v = (v << 4) | v; break;
-         case 5: v = (v << 3) | (v >> 2); break;
-         case 6: v = (v << 2) | (v >> 4); break;
-         case 7: v = (v << 1) | (v >> 6); break;
-         case 8: break;
-         default: UNREACHABLE("");
-         }
-         colour_endpoints[i] = v;
-      }
+static void init_decode_tables(void)
+{
+   init_block_modes();
+
+   for (unsigned mode = 0; mode < ARRAY_SIZE(block_modes); ++mode) {
+      const block_mode_info *info = &block_modes[mode];
+      if (info->err != decode_error::ok || info->is_void_extent)
+         continue;
+
+      uint8_t *table = weight_unquant[info->high_prec * 8 + info->wt_range];
+      for (unsigned v = 0; v <= info->wt_max; ++v)
+         table[v] = unquantise_weight(info->wt_trits, info->wt_quints, info->wt_bits, v);
+   }
+
+   for (unsigned i = 0; i < ARRAY_SIZE(cem_ranges); ++i) {
+      for (unsigned v = 0; v <= cem_ranges[i].max; ++v)
+         colour_endpoint_unquant[i][v] =
+            unquantise_colour_endpoint(cem_ranges[i].t, cem_ranges[i].q, cem_ranges[i].b, v);
    }
 }
 
-decode_error::type Block::decode(const Decoder &decoder, InputBitVector in)
+decode_error::type Block::decode(const Decoder &decoder, InputBitVector in,
+                                 decode_cache *cache)
 {
    decode_error::type err;
 
@@ -1450,16 +1637,27 @@ decode_error::type Block::decode(const Decoder &decoder, InputBitVector in)
    if (VERBOSE_DECODE)
       in.printf_bits(0, 128);
 
-   err = decode_block_mode(in);
-   if (err != decode_error::ok)
-      return err;
+   const block_mode_info &mode = block_modes[in.get_bits(0, 11)];
+   if (mode.err != decode_error::ok)
+      return mode.err;
+
+   if (mode.is_void_extent)
+      return decode_void_extent(in);
 
-   if (is_void_extent)
-      return decode_error::ok;
+   dual_plane = mode.dual_plane;
+   high_prec = mode.high_prec;
+   wt_range = mode.wt_range;
+   wt_w = mode.wt_w;
+   wt_h = mode.wt_h;
 
    /* TODO: 3D */
 
-   calculate_from_weights();
+   wt_trits = mode.wt_trits;
+   wt_quints = mode.wt_quints;
+   wt_bits = mode.wt_bits;
+   wt_max = mode.wt_max;
+   num_weights = mode.num_weights;
+   weight_bits = mode.weight_bits;
 
    if (VERBOSE_DECODE)
       printf("weights_grid=%dx%dx%d dual_plane=%d num_weights=%d high_prec=%d r=%d range=0..%d (%dt %dq %db) weight_bits=%d\n",
@@ -1574,7 +1772,7 @@ decode_error::type Block::decode(const Decoder &decoder, InputBitVector in)
       }
    }
 
-   compute_infill_weights(decoder.block_w, decoder.block_h, decoder.block_d);
+   compute_infill_weights(decoder, cache);
 
    if (VERBOSE_DECODE) {
       for (int plane = 0; plane <= dual_plane; ++plane) {
@@ -1600,13 +1798,16 @@ decode_error::type Block::decode(const Decoder &decoder, InputBitVector in)
    return decode_error::ok;
 }
 
-void Block::write_decoded(const Decoder &decoder, uint16_t *output)
+void Block::write_decoded(const Decoder &decoder, uint16_t *output,
+                          const uint8_t *partitions)
 {
    /* sRGB can only be stored as unorm8. */
    assert(!decoder.srgb || decoder.output_unorm8);
 
+   const int num_texels = decoder.block_w * decoder.block_h * decoder.block_d;
+
    if (is_void_extent) {
-      for (int idx = 0; idx < decoder.block_w*decoder.block_h*decoder.block_d; ++idx) {
+      for (int idx = 0; idx < num_texels; ++idx) {
          if (decoder.output_unorm8) {
             output[idx*4+0] = void_extent_colour_r >> 8;
             output[idx*4+1] = void_extent_colour_g >> 8;
@@ -1623,85 +1824,57 @@ void Block::write_decoded(const Decoder &decoder, uint16_t *output)
       return;
    }
 
-   int small_block = (decoder.block_w * decoder.block_h * decoder.block_d) < 31;
+   assert(num_parts == 1 || partitions);
 
-   int idx = 0;
-   for (int z = 0; z < decoder.block_d; ++z) {
-      for (int y = 0; y < decoder.block_h; ++y) {
-         for (int x = 0; x < decoder.block_w; ++x) {
-
-            int partition;
-            if (num_parts > 1) {
-               partition = select_partition(partition_index, x, y, z, num_parts, small_block);
-               assert(partition < num_parts);
-            } else {
-               partition = 0;
-            }
+   /* Expand the endpoints of each partition to 16 bits once, rather than
+    * for every texel.
+    */
+   uint32_t c0[4][4], c1[4][4];
+   for (int part = 0; part < num_parts; ++part) {
+      uint8x4_t e0 = endpoints_decoded[0][part];
+      uint8x4_t e1 = endpoints_decoded[1][part];
 
-            /* TODO: HDR */
-
-            uint8x4_t e0 = endpoints_decoded[0][partition];
-            uint8x4_t e1 = endpoints_decoded[1][partition];
-            uint16_t c0[4], c1[4];
-
-            /* Expand to 16 bits. */
-            if (decoder.srgb) {
-               c0[0] = (uint16_t)((e0.v[0] << 8) | 0x80);
-               c0[1] = (uint16_t)((e0.v[1] << 8) | 0x80);
-               c0[2] = (uint16_t)((e0.v[2] << 8) | 0x80);
-               c0[3] = (uint16_t)((e0.v[3] << 8) | 0x80);
-
-               c1[0] = (uint16_t)((e1.v[0] << 8) | 0x80);
-               c1[1] = (uint16_t)((e1.v[1] << 8) | 0x80);
-               c1[2] = (uint16_t)((e1.v[2] << 8) | 0x80);
-               c1[3] = (uint16_t)((e1.v[3] << 8) | 0x80);
-            } else {
-               c0[0] = (uint16_t)((e0.v[0] << 8) | e0.v[0]);
-               c0[1] = (uint16_t)((e0.v[1] << 8) | e0.v[1]);
-               c0[2] = (uint16_t)((e0.v[2] << 8) | e0.v[2]);
-               c0[3] = (uint16_t)((e0.v[3] << 8) | e0.v[3]);
-
-               c1[0] = (uint16_t)((e1.v[0] << 8) | e1.v[0]);
-               c1[1] = (uint16_t)((e1.v[1] << 8) | e1.v[1]);
-               c1[2] = (uint16_t)((e1.v[2] << 8) | e1.v[2]);
-               c1[3] = (uint16_t)((e1.v[3] << 8) | e1.v[3]);
-            }
+      for (int c = 0; c < 4; ++c) {
+         if (decoder.srgb) {
+            c0[part][c] = (e0.v[c] << 8) | 0x80;
+            c1[part][c] = (e1.v[c] << 8) | 0x80;
+         } else {
+            c0[part][c] = (e0.v[c] << 8) | e0.v[c];
+            c1[part][c] = (e1.v[c] << 8) | e1.v[c];
+         }
+      }
+   }
 
-            int w[4];
-            if (dual_plane) {
-               int w0 = infill_weights[0][idx];
-               int w1 = infill_weights[1][idx];
-               w[0] = w[1] = w[2] = w[3] = w0;
-               w[colour_component_selector] = w1;
-            } else {
-               int w0 = infill_weights[0][idx];
-               w[0] = w[1] = w[2] = w[3] = w0;
-            }
+   for (int idx = 0; idx < num_texels; ++idx) {
+      const int part = partitions ? partitions[idx] : 0;
+      const uint32_t w = infill_weights[0][idx];
+      uint32_t c[4];
 
-            /* Interpolate to produce UNORM16, applying weights. */
-            uint16_t c[4] = {
-               (uint16_t)((c0[0] * (64 - w[0]) + c1[0] * w[0] + 32) >> 6),
-               (uint16_t)((c0[1] * (64 - w[1]) + c1[1] * w[1] + 32) >> 6),
-               (uint16_t)((c0[2] * (64 - w[2]) + c1[2] * w[2] + 32) >> 6),
-               (uint16_t)((c0[3] * (64 - w[3]) + c1[3] * w[3] + 32) >> 6),
-            };
-
-            if (decoder.output_unorm8) {
-               output[idx*4+0] = c[0] >> 8;
-               output[idx*4+1] = c[1] >> 8;
-               output[idx*4+2] = c[2] >> 8;
-               output[idx*4+3] = c[3] >> 8;
-            } else {
-               /* Store the color as FP16. */
-               output[idx*4+0] = c[0] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[0]);
-               output[idx*4+1] = c[1] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[1]);
-               output[idx*4+2] = c[2] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[2]);
-               output[idx*4+3] = c[3] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(c[3]);
-            }
+      /* TODO: HDR */
 
-            idx++;
-         }
+      /* Interpolate to produce UNORM16, applying weights. The channels are
+       * independent, which lets the compiler vectorize this.
+       */
+      for (int i = 0; i < 4; ++i)
+         c[i] = (c0[part][i] * (64 - w) + c1[part][i] * w + 32) >> 6;
+
+      if (dual_plane) {
+         const int i = colour_component_selector;
+         const uint32_t w1 = infill_weights[1][idx];
+         c[i] = (c0[part][i] * (64 - w1) + c1[part][i] * w1 + 32) >> 6;
       }
+
+      for (int i = 0; i < 4; ++i)
+         output[idx*4+i] = c[i];
+   }
+
+   if (decoder.output_unorm8) {
+      for (int i = 0; i < num_texels * 4; ++i)
+         output[i] >>= 8;
+   } else {
+      /* Store the color as FP16. */
+      for (int i = 0; i < num_texels * 4; ++i)
+         output[i] = output[i] == 65535 ? FP16_ONE : _mesa_uint16_div_64k_to_half(output[i]);
    }
 }
 
@@ -1770,7 +1943,7 @@ decode_error::type Block::calculate_colour_endpoints_size()
 {
    /* Specified as illegal */
    if (remaining_bits < (13 * num_cem_values + 4) / 5) {
-      colour_endpoint_bits = ce_max = ce_trits = ce_quints = ce_bits = 0;
+      colour_endpoint_bits = ce_max = ce_trits = ce_quints = ce_bits = ce_range = 0;
       return decode_error::invalid_colour_endpoints_size;
    }
 
@@ -1788,6 +1961,7 @@ decode_error::type Block::calculate_colour_endpoints_size()
          ce_trits = cem_ranges[i].t;
          ce_quints = cem_ranges[i].q;
          ce_bits = cem_ranges[i].b;
+         ce_range = i;
          return decode_error::ok;
       }
    }
@@ -1796,9 +1970,72 @@ decode_error::type Block::calculate_colour_endpoints_size()
    return decode_error::invalid_colour_endpoints_size;
 }
 
+/* Images with fewer blocks than this are decoded on the calling thread,
+ * handing them to other threads would cost more than it saves.
+ */
+#define ASTC_MIN_PARALLEL_BLOCKS 1024
+
+struct astc_decode_job {
+   const Decoder *dec;
+   uint8_t *dst_row;
+   unsigned dst_stride;
+   const uint8_t *src_row;
+   unsigned src_stride;
+   unsigned src_width, src_height;
+};
+
+static bool
+astc_decode_band(void *data, unsigned first_row, unsigned num_rows)
+{
+   const astc_decode_job *job = (const astc_decode_job *)data;
+   const Decoder &dec = *job->dec;
+   const unsigned blk_w = dec.block_w, blk_h = dec.block_h;
+
+   const unsigned block_size = 16;
+   unsigned x_blocks = (job->src_width + blk_w - 1) / blk_w;
+   unsigned y_end = MIN2(job->src_height, (first_row + num_rows) * blk_h);
+
+   /* Not worth it for a handful of blocks, and fine to go without. */
+   decode_cache *cache = NULL;
+   if (x_blocks * num_rows >= 64)
+      cache = new (std::nothrow) decode_cache;
+
+   const uint8_t *src_row = job->src_row + (size_t)first_row * job->src_stride;
+   uint8_t *dst_row = job->dst_row + (size_t)first_row * blk_h * job->dst_stride;
+
+   for (unsigned y = first_row; y < first_row + num_rows; ++y) {
+      for (unsigned x = 0; x < x_blocks; ++x) {
+         /* Same size as the largest block. */
+         uint16_t block_out[12 * 12 * 4];
+
+         dec.decode(src_row + x * block_size, block_out, cache);
+
+         /* This can be smaller with NPOT dimensions. */
+         unsigned dst_blk_w = MIN2(blk_w, job->src_width - x*blk_w);
+         unsigned dst_blk_h = MIN2(blk_h, y_end - y*blk_h);
+
+         for (unsigned sub_y = 0; sub_y < dst_blk_h; ++sub_y) {
+            uint8_t *dst = dst_row + sub_y * job->dst_stride + x * blk_w * 4;
+            const uint16_t *src = &block_out[sub_y * blk_w * 4];
+
+            for (unsigned i = 0; i < dst_blk_w * 4; ++i)
+               dst[i] = src[i];
+         }
+      }
+      src_row += job->src_stride;
+      dst_row += job->dst_stride * blk_h;
+   }
+
+   delete cache;
+   return true;
+}
+
 /**
  * Decode ASTC 2D LDR texture data.
  *
+ * Large images are split into bands of block rows that are decoded in
+ * parallel.
+ *
  * \param src_width in pixels
  * \param src_height in pixels
  * \param dst_stride in bytes
@@ -1812,43 +2049,31 @@ _mesa_unpack_astc_2d_ldr(uint8_t *dst_row,
                          unsigned src_height,
                          mesa_format format)
 {
+   static util_once_flag once = UTIL_ONCE_FLAG_INIT;
+
    assert(_mesa_is_format_astc_2d(format));
    bool srgb = _mesa_is_format_srgb(format);
 
    unsigned blk_w, blk_h;
    _mesa_get_format_block_size(format, &blk_w, &blk_h);
 
-   const unsigned block_size = 16;
    unsigned x_blocks = (src_width + blk_w - 1) / blk_w;
    unsigned y_blocks = (src_height + blk_h - 1) / blk_h;
 
-   Decoder dec(blk_w, blk_h, 1, srgb, true);
-
-   for (unsigned y = 0; y < y_blocks; ++y) {
-      for (unsigned x = 0; x < x_blocks; ++x) {
-         /* Same size as the largest block. */
-         uint16_t block_out[12 * 12 * 4];
-
-         dec.decode(src_row + x * block_size, block_out);
+   util_call_once(&once, init_decode_tables);
 
-         /* This can be smaller with NPOT dimensions. */
-         unsigned dst_blk_w = MIN2(blk_w, src_width  - x*blk_w);
-         unsigned dst_blk_h = MIN2(blk_h, src_height - y*blk_h);
+   Decoder dec(blk_w, blk_h, 1, srgb, true);
 
-         for (unsigned sub_y = 0; sub_y < dst_blk_h; ++sub_y) {
-            for (unsigned sub_x = 0; sub_x < dst_blk_w; ++sub_x) {
-               uint8_t *dst = dst_row + sub_y * dst_stride +
-                              (x * blk_w + sub_x) * 4;
-               const uint16_t *src = &block_out[(sub_y * blk_w + sub_x) * 4];
-
-               dst[0] = src[0];
-               dst[1] = src[1];
-               dst[2] = src[2];
-               dst[3] = src[3];
-            }
-         }
-      }
-      src_row += src_stride;
-      dst_row += dst_stride * blk_h;
-   }
+   astc_decode_job job;
+   job.dec = &dec;
+   job.dst_row = dst_row;
+   job.dst_stride = dst_stride;
+   job.src_row = src_row;
+   job.src_stride = src_stride;
+   job.src_width = src_width;
+   job.src_height = src_height;
+
+   const bool parallel = x_blocks * y_blocks >= ASTC_MIN_PARALLEL_BLOCKS;
+   util_queue_run_bands(y_blocks, 1, parallel ? UINT_MAX : 1,
+                        astc_decode_band, &job);
 }
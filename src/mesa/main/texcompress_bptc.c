@@ -30,6 +30,7 @@
 #include "texcompress.h"
 #include "texcompress_bptc.h"
 #include "util/format/texcompress_bptc_tmp.h"
+#include "util/format/u_format_bptc.h"
 #include "texstore.h"
 #include "image.h"
 #include "mtypes.h"
@@ -161,9 +162,10 @@ _mesa_texstore_bptc_rgba_unorm(TEXSTORE_PARAMS)
                                          srcFormat, srcType);
    }
 
-   compress_rgba_unorm(srcWidth, srcHeight,
-                       pixels, rowstride,
-                       dstSlices[0], dstRowStride);
+   util_format_bptc_rgba_unorm_compress(dstSlices[0], dstRowStride,
+                                        pixels, rowstride,
+                                        srcWidth, srcHeight,
+                                        ctx->Const.BPTCCompressQuality);
 
    free((void *) tempImage);
 
@@ -206,10 +208,10 @@ texstore_bptc_rgb_float(TEXSTORE_PARAMS,
                                          srcFormat, srcType);
    }
 
-   compress_rgb_float(srcWidth, srcHeight,
-                      pixels, rowstride,
-                      dstSlices[0], dstRowStride,
-                      is_signed);
+   util_format_bptc_rgb_float_compress(dstSlices[0], dstRowStride,
+                                       pixels, rowstride,
+                                       srcWidth, srcHeight,
+                                       is_signed);
 
    free((void *) tempImage);
 
@@ -1208,6 +1208,8 @@ void st_init_extensions(struct pipe_screen *screen,
 
    consts->ForceCompatShaders = options->force_compat_shaders;
 
+   consts->BPTCCompressQuality = options->bptc_compress_quality;
+
    consts->AllowExtraPPTokens = options->allow_extra_pp_tokens;
 
    consts->AllowHigherCompatVersion = options->allow_higher_compat_version;
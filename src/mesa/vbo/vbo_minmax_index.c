@@ -32,14 +32,21 @@
 #include "main/varray.h"
 #include "main/macros.h"
 #include "main/sse_minmax.h"
+#include "util/bitset.h"
 #include "util/hash_table.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "pipe/p_state.h"
 
+/* Number of indices summarized by each leaf of a min/max tree */
+#define MINMAX_BLOCK_INDICES 256
+
 struct minmax_cache_key {
    GLintptr offset;
    GLuint count;
    unsigned index_size;
+   unsigned primitive_restart;
+   unsigned restart_index;
 };
 
 
@@ -50,6 +57,40 @@ struct minmax_cache_entry {
 };
 
 
+struct minmax_node {
+   GLuint min;
+   GLuint max;
+};
+
+
+/**
+ * Min/max of the indices of a buffer object in blocks of
+ * MINMAX_BLOCK_INDICES, stored as an implicit binary tree: nodes[1] is the
+ * root, the children of node n are 2n and 2n + 1 and the leaf of block b is
+ * nodes[num_leaves + b].  A node is only valid if both of its children are,
+ * so once the tree is filled, any range of whole blocks is answered by
+ * O(log n) nodes, and a write to the buffer only invalidates the leaves it
+ * touches and their ancestors.
+ */
+struct minmax_tree {
+   bool primitive_restart;
+   unsigned restart_index;
+   unsigned num_blocks;
+   unsigned num_leaves;
+   struct minmax_node *nodes;
+   BITSET_WORD *valid;
+};
+
+
+struct vbo_minmax_cache {
+   /** Previous results by exact range, which don't need the buffer mapped */
+   struct hash_table *ranges;
+
+   /** One tree per index size, indexed by util_logbase2(index_size) */
+   struct minmax_tree trees[3];
+};
+
+
 static uint32_t
 vbo_minmax_cache_hash(const struct minmax_cache_key *key)
 {
@@ -62,7 +103,9 @@ vbo_minmax_cache_key_equal(const struct minmax_cache_key *a,
                            const struct minmax_cache_key *b)
 {
    return (a->offset == b->offset) && (a->count == b->count) &&
-          (a->index_size == b->index_size);
+          (a->index_size == b->index_size) &&
+          (a->primitive_restart == b->primitive_restart) &&
+          (a->restart_index == b->restart_index);
 }
 
 
@@ -93,138 +136,408 @@ vbo_use_minmax_cache(struct gl_buffer_object *bufferObj)
 }
 
 
+static void
+vbo_minmax_tree_finish(struct minmax_tree *tree)
+{
+   free(tree->nodes);
+   free(tree->valid);
+   memset(tree, 0, sizeof(*tree));
+}
+
+
+/**
+ * Sets up the tree for the given index size and restart state, which
+ * throws away its contents if they were computed for another restart
+ * state.  Returns false if the buffer is too small or allocation failed.
+ */
+static bool
+vbo_minmax_tree_init(struct minmax_tree *tree,
+                     const struct gl_buffer_object *bufferObj,
+                     const struct minmax_cache_key *key)
+{
+   if (tree->nodes) {
+      if (tree->primitive_restart == key->primitive_restart &&
+          (!key->primitive_restart ||
+           tree->restart_index == key->restart_index))
+         return true;
+
+      vbo_minmax_tree_finish(tree);
+   }
+
+   unsigned num_blocks =
+      bufferObj->Size / key->index_size / MINMAX_BLOCK_INDICES;
+   if (num_blocks == 0)
+      return false;
+
+   unsigned num_leaves = util_next_power_of_two(num_blocks);
+   tree->nodes = malloc(2 * num_leaves * sizeof(*tree->nodes));
+   tree->valid = calloc(BITSET_WORDS(2 * num_leaves), sizeof(BITSET_WORD));
+   if (!tree->nodes || !tree->valid) {
+      vbo_minmax_tree_finish(tree);
+      return false;
+   }
+
+   tree->primitive_restart = key->primitive_restart;
+   tree->restart_index = key->restart_index;
+   tree->num_blocks = num_blocks;
+   tree->num_leaves = num_leaves;
+   return true;
+}
+
+
+/**
+ * Makes sure the node is valid, computing it from indices if needed, where
+ * indices holds the index first_index onwards.  Returns false if the node
+ * isn't valid and there are no indices.
+ */
+static bool
+vbo_minmax_tree_node(struct minmax_tree *tree, unsigned node,
+                     unsigned index_size, const char *indices,
+                     unsigned first_index, unsigned *scanned)
+{
+   if (BITSET_TEST(tree->valid, node))
+      return true;
+   if (!indices)
+      return false;
+
+   struct minmax_node *n = &tree->nodes[node];
+
+   if (node >= tree->num_leaves) {
+      unsigned start = (node - tree->num_leaves) * MINMAX_BLOCK_INDICES;
+
+      assert(start >= first_index);
+      vbo_get_minmax_index_mapped(MINMAX_BLOCK_INDICES, index_size,
+                                  tree->restart_index, tree->primitive_restart,
+                                  indices + (size_t)(start - first_index) *
+                                            index_size,
+                                  &n->min, &n->max);
+      *scanned += MINMAX_BLOCK_INDICES;
+   } else {
+      vbo_minmax_tree_node(tree, 2 * node, index_size, indices, first_index,
+                           scanned);
+      vbo_minmax_tree_node(tree, 2 * node + 1, index_size, indices,
+                           first_index, scanned);
+      n->min = MIN2(tree->nodes[2 * node].min, tree->nodes[2 * node + 1].min);
+      n->max = MAX2(tree->nodes[2 * node].max, tree->nodes[2 * node + 1].max);
+   }
+
+   BITSET_SET(tree->valid, node);
+   return true;
+}
+
+
+/**
+ * Computes the min/max of the blocks [first_block, end_block).
+ */
+static bool
+vbo_minmax_tree_query(struct minmax_tree *tree, unsigned first_block,
+                      unsigned end_block, unsigned index_size,
+                      const char *indices, unsigned first_index,
+                      GLuint *min_index, GLuint *max_index, unsigned *scanned)
+{
+   unsigned l = first_block + tree->num_leaves;
+   unsigned r = end_block + tree->num_leaves;
+
+   assert(end_block <= tree->num_blocks);
+
+   for (; l < r; l >>= 1, r >>= 1) {
+      unsigned nodes[2], num_nodes = 0;
+
+      if (l & 1)
+         nodes[num_nodes++] = l++;
+      if (r & 1)
+         nodes[num_nodes++] = --r;
+
+      for (unsigned i = 0; i < num_nodes; i++) {
+         if (!vbo_minmax_tree_node(tree, nodes[i], index_size, indices,
+                                   first_index, scanned))
+            return false;
+
+         *min_index = MIN2(*min_index, tree->nodes[nodes[i]].min);
+         *max_index = MAX2(*max_index, tree->nodes[nodes[i]].max);
+      }
+   }
+
+   return true;
+}
+
+
+static void
+vbo_minmax_tree_invalidate(struct minmax_tree *tree, unsigned first_block,
+                           unsigned end_block)
+{
+   end_block = MIN2(end_block, tree->num_blocks);
+
+   for (unsigned b = first_block; b < end_block; b++) {
+      /* The ancestors of an invalid node are invalid too. */
+      for (unsigned node = tree->num_leaves + b;
+           node && BITSET_TEST(tree->valid, node); node >>= 1)
+         BITSET_CLEAR(tree->valid, node);
+   }
+}
+
+
+static void
+vbo_minmax_cache_clear(struct vbo_minmax_cache *cache)
+{
+   _mesa_hash_table_clear(cache->ranges, vbo_minmax_cache_delete_entry);
+
+   /* The buffer may have been resized. */
+   for (unsigned i = 0; i < ARRAY_SIZE(cache->trees); i++)
+      vbo_minmax_tree_finish(&cache->trees[i]);
+}
+
+
 void
 vbo_delete_minmax_cache(struct gl_buffer_object *bufferObj)
 {
-   _mesa_hash_table_destroy(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
+   struct vbo_minmax_cache *cache = bufferObj->MinMaxCache;
+
+   if (!cache)
+      return;
+
+   _mesa_hash_table_destroy(cache->ranges, vbo_minmax_cache_delete_entry);
+   for (unsigned i = 0; i < ARRAY_SIZE(cache->trees); i++)
+      vbo_minmax_tree_finish(&cache->trees[i]);
+   free(cache);
    bufferObj->MinMaxCache = NULL;
 }
 
 
-static GLboolean
-vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
-                      unsigned index_size, GLintptr offset, GLuint count,
-                      GLuint *min_index, GLuint *max_index)
+/**
+ * Disable the cache permanently for this BO if the number of hits is
+ * asymptotically less than the number of misses. This happens when
+ * applications use the BO for streaming.
+ *
+ * However, some initial optimism allows applications that interleave
+ * draw calls with glBufferSubData during warmup.
+ */
+static bool
+vbo_minmax_cache_disable_if_streaming(struct gl_buffer_object *bufferObj)
 {
-   GLboolean found = GL_FALSE;
-   struct minmax_cache_key key;
-   uint32_t hash;
-   struct hash_entry *result;
+   unsigned optimism = bufferObj->Size;
+   if (bufferObj->MinMaxCacheMissIndices > optimism &&
+       bufferObj->MinMaxCacheHitIndices < bufferObj->MinMaxCacheMissIndices - optimism) {
+      bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
+      vbo_delete_minmax_cache(bufferObj);
+      return true;
+   }
 
-   if (!bufferObj->MinMaxCache)
-      return GL_FALSE;
-   if (!vbo_use_minmax_cache(bufferObj))
-      return GL_FALSE;
+   return false;
+}
+
+
+/**
+ * Called when [offset, offset + size) of the buffer has been or is about to
+ * be written, to drop the cached min/max of the indices in that range.
+ */
+void
+vbo_minmax_cache_invalidate(struct gl_buffer_object *bufferObj,
+                            GLintptr offset, GLsizeiptr size)
+{
+   if (!bufferObj->MinMaxCache || size <= 0)
+      return;
 
    simple_mtx_lock(&bufferObj->MinMaxCacheMutex);
 
-   if (bufferObj->MinMaxCacheDirty) {
-      /* Disable the cache permanently for this BO if the number of hits
-       * is asymptotically less than the number of misses. This happens when
-       * applications use the BO for streaming.
-       *
-       * However, some initial optimism allows applications that interleave
-       * draw calls with glBufferSubData during warmup.
-       */
-      unsigned optimism = bufferObj->Size;
-      if (bufferObj->MinMaxCacheMissIndices > optimism &&
-          bufferObj->MinMaxCacheHitIndices < bufferObj->MinMaxCacheMissIndices - optimism) {
-         bufferObj->UsageHistory |= USAGE_DISABLE_MINMAX_CACHE;
-         vbo_delete_minmax_cache(bufferObj);
-         goto out_disable;
-      }
+   struct vbo_minmax_cache *cache = bufferObj->MinMaxCache;
 
-      _mesa_hash_table_clear(bufferObj->MinMaxCache, vbo_minmax_cache_delete_entry);
-      bufferObj->MinMaxCacheDirty = false;
-      goto out_invalidate;
-   }
+   /* Nothing to do if everything is going to be thrown away anyway. */
+   if (!cache || bufferObj->MinMaxCacheDirty)
+      goto out;
 
-   key.index_size = index_size;
-   key.offset = offset;
-   key.count = count;
-   hash = vbo_minmax_cache_hash(&key);
-   result = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache, hash, &key);
-   if (result) {
-      struct minmax_cache_entry *entry = result->data;
-      *min_index = entry->min;
-      *max_index = entry->max;
-      found = GL_TRUE;
+   if (vbo_minmax_cache_disable_if_streaming(bufferObj))
+      goto out;
+
+   hash_table_foreach(cache->ranges, entry) {
+      struct minmax_cache_entry *cached = entry->data;
+      GLintptr end = cached->key.offset +
+                     (GLintptr)cached->key.count * cached->key.index_size;
+
+      if (cached->key.offset < offset + size && offset < end) {
+         _mesa_hash_table_remove(cache->ranges, entry);
+         free(cached);
+      }
    }
 
-out_invalidate:
-   if (found) {
-      /* The hit counter saturates so that we don't accidently disable the
-       * cache in a long-running program.
-       */
-      unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices + count;
+   for (unsigned i = 0; i < ARRAY_SIZE(cache->trees); i++) {
+      struct minmax_tree *tree = &cache->trees[i];
+      GLsizeiptr block_size = MINMAX_BLOCK_INDICES << i;
 
-      if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
-         bufferObj->MinMaxCacheHitIndices = new_hit_count;
-      else
-         bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
-   } else {
-      bufferObj->MinMaxCacheMissIndices += count;
+      if (tree->nodes) {
+         vbo_minmax_tree_invalidate(tree, offset / block_size,
+                                    DIV_ROUND_UP(offset + size, block_size));
+      }
    }
 
-out_disable:
+out:
    simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
-   return found;
 }
 
 
-static void
-vbo_minmax_cache_store(struct gl_context *ctx,
-                       struct gl_buffer_object *bufferObj,
-                       unsigned index_size, GLintptr offset, GLuint count,
-                       GLuint min, GLuint max)
+/**
+ * Looks up the min/max of the range of indices described by key.
+ *
+ * Without indices, this only succeeds if no index needs to be read.  With
+ * indices, which then point to the mapped range, everything that isn't
+ * cached yet is computed from them and added to the cache.
+ */
+static GLboolean
+vbo_get_minmax_cached(struct gl_buffer_object *bufferObj,
+                      const struct minmax_cache_key *key, const char *indices,
+                      GLuint *min_index, GLuint *max_index)
 {
+   struct vbo_minmax_cache *cache;
    struct minmax_cache_entry *entry;
-   struct hash_entry *table_entry;
+   struct minmax_tree *tree;
+   struct hash_entry *result;
+   unsigned first, end, scanned = 0;
+   GLuint min = ~0U, max = 0;
    uint32_t hash;
 
+   if (!indices && !bufferObj->MinMaxCache)
+      return GL_FALSE;
    if (!vbo_use_minmax_cache(bufferObj))
-      return;
+      return GL_FALSE;
 
    simple_mtx_lock(&bufferObj->MinMaxCacheMutex);
 
-   if (!bufferObj->MinMaxCache) {
-      bufferObj->MinMaxCache =
+   if (bufferObj->MinMaxCacheDirty) {
+      if (vbo_minmax_cache_disable_if_streaming(bufferObj))
+         goto out_disable;
+
+      if (bufferObj->MinMaxCache)
+         vbo_minmax_cache_clear(bufferObj->MinMaxCache);
+      bufferObj->MinMaxCacheDirty = false;
+   }
+
+   cache = bufferObj->MinMaxCache;
+   if (!cache) {
+      if (!indices)
+         goto out_disable;
+
+      cache = CALLOC_STRUCT(vbo_minmax_cache);
+      if (!cache)
+         goto out_disable;
+
+      cache->ranges =
          _mesa_hash_table_create(NULL,
                                  (uint32_t (*)(const void *))vbo_minmax_cache_hash,
                                  (bool (*)(const void *, const void *))vbo_minmax_cache_key_equal);
-      if (!bufferObj->MinMaxCache)
-         goto out;
+      if (!cache->ranges) {
+         free(cache);
+         goto out_disable;
+      }
+      bufferObj->MinMaxCache = cache;
    }
 
+   hash = vbo_minmax_cache_hash(key);
+   result = _mesa_hash_table_search_pre_hashed(cache->ranges, hash, key);
+   if (result) {
+      entry = result->data;
+      *min_index = entry->min;
+      *max_index = entry->max;
+      goto out_found;
+   }
+
+   /* The tree only works with whole indices inside the buffer. */
+   first = key->offset / key->index_size;
+   end = first + key->count;
+   tree = &cache->trees[util_logbase2(key->index_size)];
+
+   if (key->offset % key->index_size == 0 &&
+       (GLsizeiptr)end * key->index_size <= bufferObj->Size &&
+       vbo_minmax_tree_init(tree, bufferObj, key)) {
+      unsigned first_block = DIV_ROUND_UP(first, MINMAX_BLOCK_INDICES);
+      unsigned end_block = end / MINMAX_BLOCK_INDICES;
+
+      if (first_block < end_block) {
+         if (!vbo_minmax_tree_query(tree, first_block, end_block,
+                                    key->index_size, indices, first,
+                                    &min, &max, &scanned))
+            goto out_not_found;
+
+         /* Read the indices before and after the whole blocks. */
+         first_block *= MINMAX_BLOCK_INDICES;
+         end_block *= MINMAX_BLOCK_INDICES;
+         if (first < first_block || end_block < end) {
+            if (!indices)
+               goto out_not_found;
+
+            GLuint part_min, part_max;
+            vbo_get_minmax_index_mapped(first_block - first, key->index_size,
+                                        key->restart_index,
+                                        key->primitive_restart, indices,
+                                        &part_min, &part_max);
+            min = MIN2(min, part_min);
+            max = MAX2(max, part_max);
+
+            vbo_get_minmax_index_mapped(end - end_block, key->index_size,
+                                        key->restart_index,
+                                        key->primitive_restart,
+                                        indices + (size_t)(end_block - first) *
+                                                  key->index_size,
+                                        &part_min, &part_max);
+            min = MIN2(min, part_min);
+            max = MAX2(max, part_max);
+
+            scanned += (first_block - first) + (end - end_block);
+         }
+      } else {
+         if (!indices)
+            goto out_not_found;
+
+         vbo_get_minmax_index_mapped(key->count, key->index_size,
+                                     key->restart_index,
+                                     key->primitive_restart, indices,
+                                     &min, &max);
+         scanned += key->count;
+      }
+   } else {
+      if (!indices)
+         goto out_not_found;
+
+      vbo_get_minmax_index_mapped(key->count, key->index_size,
+                                  key->restart_index, key->primitive_restart,
+                                  indices, &min, &max);
+      scanned += key->count;
+   }
+
+   *min_index = min;
+   *max_index = max;
+
    entry = MALLOC_STRUCT(minmax_cache_entry);
-   if (!entry)
-      goto out;
+   if (entry) {
+      entry->key = *key;
+      entry->min = min;
+      entry->max = max;
+      if (!_mesa_hash_table_insert_pre_hashed(cache->ranges, hash,
+                                              &entry->key, entry))
+         free(entry);
+   }
 
-   entry->key.offset = offset;
-   entry->key.count = count;
-   entry->key.index_size = index_size;
-   entry->min = min;
-   entry->max = max;
-   hash = vbo_minmax_cache_hash(&entry->key);
-
-   table_entry = _mesa_hash_table_search_pre_hashed(bufferObj->MinMaxCache,
-                                                    hash, &entry->key);
-   if (table_entry) {
-      /* It seems like this could happen when two contexts are rendering using
-       * the same buffer object from multiple threads.
-       */
-      _mesa_debug(ctx, "duplicate entry in minmax cache\n");
-      free(entry);
-      goto out;
+out_found:
+   /* The hit counter saturates so that we don't accidently disable the
+    * cache in a long-running program.
+    */
+   if (key->count > scanned) {
+      unsigned new_hit_count = bufferObj->MinMaxCacheHitIndices +
+                               (key->count - scanned);
+
+      if (new_hit_count >= bufferObj->MinMaxCacheHitIndices)
+         bufferObj->MinMaxCacheHitIndices = new_hit_count;
+      else
+         bufferObj->MinMaxCacheHitIndices = ~(unsigned)0;
    }
+   bufferObj->MinMaxCacheMissIndices += scanned;
 
-   table_entry = _mesa_hash_table_insert_pre_hashed(bufferObj->MinMaxCache,
-                                                    hash, &entry->key, entry);
-   if (!table_entry)
-      free(entry);
+   simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
+   return GL_TRUE;
 
-out:
+out_not_found:
+out_disable:
    simple_mtx_unlock(&bufferObj->MinMaxCacheMutex);
+   return GL_FALSE;
 }
 
 
@@ -234,6 +547,31 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
                             const void *indices,
                             unsigned *min_index, unsigned *max_index)
 {
+#if defined(USE_SSE41)
+   if (util_get_cpu_caps()->has_sse4_1) {
+      switch (index_size) {
+      case 4:
+         if (restart) {
+            _mesa_uint_array_min_max_restart(indices, min_index, max_index,
+                                             count, restartIndex);
+         } else {
+            _mesa_uint_array_min_max(indices, min_index, max_index, count);
+         }
+         return;
+      case 2:
+         _mesa_ushort_array_min_max(indices, min_index, max_index, count,
+                                    restart, restartIndex);
+         return;
+      case 1:
+         _mesa_ubyte_array_min_max(indices, min_index, max_index, count,
+                                   restart, restartIndex);
+         return;
+      default:
+         UNREACHABLE("not reached");
+      }
+   }
+#endif
+
    switch (index_size) {
    case 4: {
       const GLuint *ui_indices = (const GLuint *)indices;
@@ -248,16 +586,10 @@ vbo_get_minmax_index_mapped(unsigned count, unsigned index_size,
          }
       }
       else {
-#if defined(USE_SSE41)
-         if (util_get_cpu_caps()->has_sse4_1) {
-            _mesa_uint_array_min_max(ui_indices, &min_ui, &max_ui, count);
+         for (unsigned i = 0; i < count; i++) {
+            if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
+            if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
          }
-         else
-#endif
-            for (unsigned i = 0; i < count; i++) {
-               if (ui_indices[i] > max_ui) max_ui = ui_indices[i];
-               if (ui_indices[i] < min_ui) min_ui = ui_indices[i];
-            }
       }
       *min_index = min_ui;
       *max_index = max_ui;
@@ -330,26 +662,34 @@ vbo_get_minmax_index(struct gl_context *ctx, struct gl_buffer_object *obj,
 
    if (!obj) {
       indices = (const char *)ptr + offset;
-   } else {
-      GLsizeiptr size = MIN2((GLsizeiptr)count * index_size, obj->Size);
+      vbo_get_minmax_index_mapped(count, index_size, restart_index,
+                                  primitive_restart, indices,
+                                  min_index, max_index);
+      return;
+   }
 
-      if (vbo_get_minmax_cached(obj, index_size, offset, count, min_index,
-                                max_index))
-         return;
+   const struct minmax_cache_key key = {
+      .offset = offset,
+      .count = count,
+      .index_size = index_size,
+      .primitive_restart = primitive_restart,
+      .restart_index = primitive_restart ? restart_index : 0,
+   };
 
-      indices = _mesa_bufferobj_map_range(ctx, offset, size, GL_MAP_READ_BIT,
-                                          obj, MAP_INTERNAL);
-   }
+   if (vbo_get_minmax_cached(obj, &key, NULL, min_index, max_index))
+      return;
 
-   vbo_get_minmax_index_mapped(count, index_size, restart_index,
-                               primitive_restart, indices,
-                               min_index, max_index);
+   GLsizeiptr size = MIN2((GLsizeiptr)count * index_size, obj->Size);
+   indices = _mesa_bufferobj_map_range(ctx, offset, size, GL_MAP_READ_BIT,
+                                       obj, MAP_INTERNAL);
 
-   if (obj) {
-      vbo_minmax_cache_store(ctx, obj, index_size, offset, count, *min_index,
-                             *max_index);
-      _mesa_bufferobj_unmap(ctx, obj, MAP_INTERNAL);
+   if (!vbo_get_minmax_cached(obj, &key, indices, min_index, max_index)) {
+      vbo_get_minmax_index_mapped(count, index_size, restart_index,
+                                  primitive_restart, indices,
+                                  min_index, max_index);
    }
+
+   _mesa_bufferobj_unmap(ctx, obj, MAP_INTERNAL);
 }
 
 /**
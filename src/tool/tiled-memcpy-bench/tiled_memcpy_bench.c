@@ -0,0 +1,274 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Compares the CPU tiling paths of the drivers built into this tree with the
+ * common tiled memcpy in src/util, on the same image and the same tile
+ * layout. Each layout is first checked to produce the same bytes both ways,
+ * then timed storing a whole linear image into tiles and loading it back.
+ * Plain memcpy of the same image is the bandwidth to aim for.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/u_tiled_memcpy.h"
+
+#ifdef HAVE_ASAHI_LAYOUT
+#include "asahi/layout/layout.h"
+#endif
+#ifdef HAVE_ISL
+#include "isl/isl.h"
+#endif
+#ifdef HAVE_PANFROST_TILING
+#include "panfrost/shared/pan_tiling.h"
+#endif
+
+#define WIDTH  2048
+#define HEIGHT 2048
+#define CPP    4
+#define ITERS  8
+
+#define LINEAR_STRIDE_B (WIDTH * CPP)
+#define IMAGE_SIZE_B    ((size_t)LINEAR_STRIDE_B * HEIGHT)
+
+typedef void (*tiled_copy_fn)(void *tiled, void *linear, uint32_t tiled_stride_B);
+
+struct bench_layout {
+   const char *name;
+   unsigned tile_w_el, tile_h_el;
+   uint32_t x_mask, y_mask, y_xor_mask;
+
+   /* The driver's own path */
+   tiled_copy_fn store, load;
+};
+
+#ifdef HAVE_ISL
+static void
+isl_store(void *tiled, void *linear, uint32_t tiled_stride_B,
+          enum isl_tiling tiling)
+{
+   /* isl takes the pitch of a row of elements, not of a row of tiles */
+   uint32_t tile_w_B, tile_h;
+   isl_get_tile_dims(tiling, CPP, &tile_w_B, &tile_h);
+
+   isl_memcpy_linear_to_tiled(0, LINEAR_STRIDE_B, 0, HEIGHT, tiled, linear,
+                              tiled_stride_B / tile_h, LINEAR_STRIDE_B, false,
+                              tiling, ISL_MEMCPY);
+}
+
+static void
+isl_load(void *tiled, void *linear, uint32_t tiled_stride_B,
+         enum isl_tiling tiling)
+{
+   uint32_t tile_w_B, tile_h;
+   isl_get_tile_dims(tiling, CPP, &tile_w_B, &tile_h);
+
+   isl_memcpy_tiled_to_linear(0, LINEAR_STRIDE_B, 0, HEIGHT, linear, tiled,
+                              LINEAR_STRIDE_B, tiled_stride_B / tile_h, false,
+                              tiling, ISL_MEMCPY);
+}
+
+static void
+isl_x_store(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   isl_store(tiled, linear, tiled_stride_B, ISL_TILING_X);
+}
+
+static void
+isl_x_load(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   isl_load(tiled, linear, tiled_stride_B, ISL_TILING_X);
+}
+
+static void
+isl_y_store(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   isl_store(tiled, linear, tiled_stride_B, ISL_TILING_Y0);
+}
+
+static void
+isl_y_load(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   isl_load(tiled, linear, tiled_stride_B, ISL_TILING_Y0);
+}
+#endif
+
+#ifdef HAVE_PANFROST_TILING
+static void
+pan_store(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   pan_store_tiled_image(tiled, linear, 0, 0, WIDTH, HEIGHT, tiled_stride_B,
+                         LINEAR_STRIDE_B, PIPE_FORMAT_R8G8B8A8_UNORM,
+                         PAN_INTERLEAVE_NONE);
+}
+
+static void
+pan_load(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   pan_load_tiled_image(linear, tiled, 0, 0, WIDTH, HEIGHT, LINEAR_STRIDE_B,
+                        tiled_stride_B, PIPE_FORMAT_R8G8B8A8_UNORM,
+                        PAN_INTERLEAVE_NONE);
+}
+#endif
+
+#ifdef HAVE_ASAHI_LAYOUT
+/* Built in main(), the stride follows from it */
+static struct ail_layout agx_layout;
+
+static void
+agx_store(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   ail_tile(tiled, linear, &agx_layout, 0, LINEAR_STRIDE_B, 0, 0, WIDTH,
+            HEIGHT);
+}
+
+static void
+agx_load(void *tiled, void *linear, uint32_t tiled_stride_B)
+{
+   ail_detile(tiled, linear, &agx_layout, 0, LINEAR_STRIDE_B, 0, 0, WIDTH,
+              HEIGHT);
+}
+#endif
+
+/* The masks are the ones of the util tiled memcpy test, for a 4-byte element */
+static const struct bench_layout layouts[] = {
+#ifdef HAVE_ISL
+   { "intel-x", 128, 8, 0x07f, 0x380, 0, isl_x_store, isl_x_load },
+   { "intel-y", 32, 32, 0x383, 0x07c, 0, isl_y_store, isl_y_load },
+#endif
+#ifdef HAVE_PANFROST_TILING
+   { "mali-u-interleaved", 16, 16, 0x55, 0xaa, 0x55, pan_store, pan_load },
+#endif
+#ifdef HAVE_ASAHI_LAYOUT
+   { "agx-twiddled", 64, 64, 0x555, 0xaaa, 0, agx_store, agx_load },
+#endif
+   { "z-order-2x1", 32, 16, 0x155, 0x0aa, 0, NULL, NULL },
+};
+
+static double
+gbps(int64_t ns)
+{
+   return (double)IMAGE_SIZE_B * ITERS / ns;
+}
+
+static bool
+bench_layout(const struct bench_layout *desc, uint8_t *linear, uint8_t *tiled,
+             uint8_t *scratch)
+{
+   const uint32_t tiled_stride_B = LINEAR_STRIDE_B * desc->tile_h_el;
+   struct util_tiled_layout layout;
+
+   if (!util_tiled_layout_init(&layout, CPP, desc->tile_w_el, desc->tile_h_el,
+                               desc->x_mask, desc->y_mask,
+                               desc->y_xor_mask)) {
+      fprintf(stderr, "%s: tile too large for the tables\n", desc->name);
+      return false;
+   }
+
+   /* Both paths must agree before their speed means anything */
+   if (desc->store) {
+      desc->store(tiled, linear, tiled_stride_B);
+      util_tiled_store(&layout, scratch, tiled_stride_B, linear,
+                       LINEAR_STRIDE_B, 0, 0, WIDTH, HEIGHT);
+      if (memcmp(tiled, scratch, IMAGE_SIZE_B)) {
+         fprintf(stderr, "%s: driver and util tiled images differ\n",
+                 desc->name);
+         return false;
+      }
+
+      desc->load(tiled, scratch, tiled_stride_B);
+      if (memcmp(linear, scratch, IMAGE_SIZE_B)) {
+         fprintf(stderr, "%s: driver load doesn't round-trip\n", desc->name);
+         return false;
+      }
+   }
+
+   int64_t t0 = os_time_get_nano();
+   for (unsigned it = 0; it < ITERS; it++) {
+      util_tiled_store(&layout, tiled, tiled_stride_B, linear,
+                       LINEAR_STRIDE_B, 0, 0, WIDTH, HEIGHT);
+   }
+   int64_t t1 = os_time_get_nano();
+   for (unsigned it = 0; it < ITERS; it++) {
+      util_tiled_load(&layout, scratch, LINEAR_STRIDE_B, tiled,
+                      tiled_stride_B, 0, 0, WIDTH, HEIGHT);
+   }
+   int64_t t2 = os_time_get_nano();
+
+   printf("%-20s %-6s %6.2f GB/s store, %6.2f GB/s load (%uB chunks)\n",
+          desc->name, "util", gbps(t1 - t0), gbps(t2 - t1), layout.chunk_B);
+
+   if (desc->store) {
+      t0 = os_time_get_nano();
+      for (unsigned it = 0; it < ITERS; it++)
+         desc->store(tiled, linear, tiled_stride_B);
+      t1 = os_time_get_nano();
+      for (unsigned it = 0; it < ITERS; it++)
+         desc->load(tiled, scratch, tiled_stride_B);
+      t2 = os_time_get_nano();
+
+      printf("%-20s %-6s %6.2f GB/s store, %6.2f GB/s load\n", desc->name,
+             "driver", gbps(t1 - t0), gbps(t2 - t1));
+   }
+
+   return true;
+}
+
+int
+main(int argc, char **argv)
+{
+   uint8_t *linear = malloc(IMAGE_SIZE_B);
+   uint8_t *tiled = malloc(IMAGE_SIZE_B);
+   uint8_t *scratch = malloc(IMAGE_SIZE_B);
+   bool success = true;
+
+   if (!linear || !tiled || !scratch) {
+      fprintf(stderr, "out of memory\n");
+      return EXIT_FAILURE;
+   }
+
+   /* Fault every page in up front, memcpy would pay for it otherwise */
+   for (size_t i = 0; i < IMAGE_SIZE_B; i++)
+      linear[i] = (i * 7) ^ (i >> 11);
+   memset(tiled, 0, IMAGE_SIZE_B);
+   memset(scratch, 0, IMAGE_SIZE_B);
+
+#ifdef HAVE_ASAHI_LAYOUT
+   agx_layout = (struct ail_layout){
+      .width_px = WIDTH,
+      .height_px = HEIGHT,
+      .depth_px = 1,
+      .sample_count_sa = 1,
+      .levels = 1,
+      .tiling = AIL_TILING_GPU,
+      .format = PIPE_FORMAT_R8G8B8A8_UNORM,
+   };
+   ail_make_miptree(&agx_layout);
+   assert(agx_layout.size_B <= IMAGE_SIZE_B);
+#endif
+
+   printf("%ux%u, %uB per element\n", WIDTH, HEIGHT, CPP);
+
+   int64_t t0 = os_time_get_nano();
+   for (unsigned it = 0; it < ITERS; it++)
+      memcpy(tiled, linear, IMAGE_SIZE_B);
+   int64_t t1 = os_time_get_nano();
+   printf("%-27s %6.2f GB/s\n", "memcpy", gbps(t1 - t0));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(layouts); i++)
+      success &= bench_layout(&layouts[i], linear, tiled, scratch);
+
+   free(scratch);
+   free(tiled);
+   free(linear);
+   return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
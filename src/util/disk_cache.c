@@ -159,6 +159,10 @@ disk_cache_type_create(const char *gpu_name,
 
    cache->max_size = max_size;
 
+   /* The LRU index only speeds up eviction, carry on without it. */
+   if (cache->type == DISK_CACHE_MULTI_FILE)
+      disk_cache_mmap_lru_index(cache);
+
    if (cache->type == DISK_CACHE_DATABASE)
       mesa_cache_db_multipart_set_size_limit(&cache->cache_db, cache->max_size);
 
@@ -367,6 +371,7 @@ disk_cache_remove(struct disk_cache *cache, const cache_key key)
       return;
    }
 
+   disk_cache_lru_index_remove(cache, key);
    disk_cache_evict_item(cache, filename);
 }
 
@@ -618,7 +623,7 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
       } else if (cache->type == DISK_CACHE_MULTI_FILE) {
          char *filename = disk_cache_get_cache_filename(cache, key);
          if (filename)
-            buf = disk_cache_load_item(cache, filename, size);
+            buf = disk_cache_load_item(cache, key, filename, size);
       }
    }
 
@@ -103,6 +103,7 @@ disk_cache_get_function_identifier(void *ptr, struct mesa_sha1 *ctx)
 #include "util/u_debug.h"
 #include "util/ralloc.h"
 #include "util/rand_xor.h"
+#include "util/u_math.h"
 
 /* Check if directory exists or if mkdir_if_needed param is set create a
  * directory named 'path' if it does not already exist.
@@ -481,12 +482,435 @@ write_all(int fd, const void *buf, size_t count)
    return done;
 }
 
+/* Access ordered index of the multi-file cache.
+ *
+ * The "index_lru" file next to "index" holds an open addressing hash
+ * table of the cache files, keyed by cache key, followed by a binary
+ * min-heap of table slots ordered by last access. Eviction pops the
+ * heap instead of scanning and stat'ing the cache directories.
+ *
+ * A cache hit only bumps the stamp of its entry, without taking any
+ * lock. The heap is ordered by heap_stamp, the stamp the entry had when
+ * it was last placed in the heap; an entry reaching the top of the heap
+ * with a newer stamp is re-placed instead of evicted. That keeps hits
+ * cheap and eviction O(log n) amortized while still being exact LRU.
+ *
+ * All other updates are serialized across processes with flock() and
+ * within the process with lru_index_mtx. A process dying in the middle
+ * of an update leaves the dirty flag set and the next writer starts over
+ * from an empty index. Files the index doesn't know about (e.g. written
+ * before it existed) are still found by the directory scan fallback.
+ */
+
+#define LRU_INDEX_MAGIC 0x4d4c5255 /* "URLM" */
+#define LRU_INDEX_VERSION 1
+
+/* Smallest and largest number of entries in the index. */
+#define LRU_INDEX_MIN_ENTRIES (1u << 12)
+#define LRU_INDEX_MAX_ENTRIES (1u << 21)
+
+struct lru_index_header {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t capacity;   /* number of entries, a power of two */
+   uint32_t count;      /* entries in use, also the size of the heap */
+   uint32_t dirty;
+   uint32_t pad;
+   uint64_t clock;      /* last access stamp handed out */
+};
+
+struct lru_index_entry {
+   cache_key key;
+   uint32_t blocks;     /* file size in 512 byte blocks */
+   uint64_t stamp;      /* last access */
+   uint64_t heap_stamp; /* stamp the heap is ordered by */
+   uint32_t heap_pos;
+   uint32_t used;
+};
+
+struct lru_index {
+   struct lru_index_header *hdr;
+   struct lru_index_entry *entries;
+   uint32_t *heap;
+   uint32_t mask;
+};
+
+static size_t
+lru_index_file_size(uint32_t capacity)
+{
+   return sizeof(struct lru_index_header) +
+          (size_t)capacity * (sizeof(struct lru_index_entry) + sizeof(uint32_t));
+}
+
+/* Returns false if the index is unavailable or was recreated by another
+ * process with a layout that doesn't fit our mapping.
+ */
+static bool
+lru_index_get(struct disk_cache *cache, struct lru_index *idx)
+{
+   if (!cache->lru_index_mmap)
+      return false;
+
+   idx->hdr = (struct lru_index_header *)cache->lru_index_mmap;
+
+   uint32_t capacity = p_atomic_read(&idx->hdr->capacity);
+   if (!util_is_power_of_two_nonzero(capacity) ||
+       lru_index_file_size(capacity) > cache->lru_index_mmap_size)
+      return false;
+
+   idx->entries = (struct lru_index_entry *)(idx->hdr + 1);
+   idx->heap = (uint32_t *)(idx->entries + capacity);
+   idx->mask = capacity - 1;
+
+   return true;
+}
+
+static inline uint32_t
+lru_index_home(const struct lru_index *idx, const uint8_t *key)
+{
+   /* The keys are SHA-1 hashes, any four bytes are as good as a hash. */
+   return (key[4] | key[5] << 8 | key[6] << 16 | (uint32_t)key[7] << 24) &
+          idx->mask;
+}
+
+static struct lru_index_entry *
+lru_index_find(const struct lru_index *idx, const cache_key key)
+{
+   uint32_t slot = lru_index_home(idx, key);
+
+   /* Also used without the lock, so bound the probe sequence rather than
+    * rely on finding an empty slot.
+    */
+   for (uint32_t n = 0; n <= idx->mask; n++, slot = (slot + 1) & idx->mask) {
+      struct lru_index_entry *entry = &idx->entries[slot];
+      if (!entry->used)
+         return NULL;
+      if (memcmp(entry->key, key, CACHE_KEY_SIZE) == 0)
+         return entry;
+   }
+
+   return NULL;
+}
+
+static inline uint64_t
+lru_index_heap_stamp(const struct lru_index *idx, uint32_t pos)
+{
+   return idx->entries[idx->heap[pos]].heap_stamp;
+}
+
+static inline void
+lru_index_heap_set(const struct lru_index *idx, uint32_t pos, uint32_t slot)
+{
+   idx->heap[pos] = slot;
+   idx->entries[slot].heap_pos = pos;
+}
+
+static void
+lru_index_sift_up(const struct lru_index *idx, uint32_t pos)
+{
+   uint32_t slot = idx->heap[pos];
+   uint64_t stamp = idx->entries[slot].heap_stamp;
+
+   while (pos > 0) {
+      uint32_t parent = (pos - 1) / 2;
+      if (lru_index_heap_stamp(idx, parent) <= stamp)
+         break;
+      lru_index_heap_set(idx, pos, idx->heap[parent]);
+      pos = parent;
+   }
+
+   lru_index_heap_set(idx, pos, slot);
+}
+
+static void
+lru_index_sift_down(const struct lru_index *idx, uint32_t pos)
+{
+   const uint32_t count = idx->hdr->count;
+   uint32_t slot = idx->heap[pos];
+   uint64_t stamp = idx->entries[slot].heap_stamp;
+
+   for (;;) {
+      uint32_t child = pos * 2 + 1;
+      if (child >= count)
+         break;
+      if (child + 1 < count &&
+          lru_index_heap_stamp(idx, child + 1) < lru_index_heap_stamp(idx, child))
+         child++;
+      if (stamp <= lru_index_heap_stamp(idx, child))
+         break;
+      lru_index_heap_set(idx, pos, idx->heap[child]);
+      pos = child;
+   }
+
+   lru_index_heap_set(idx, pos, slot);
+}
+
+static void
+lru_index_reset(const struct lru_index *idx)
+{
+   memset(idx->entries, 0, (size_t)(idx->mask + 1) * sizeof(*idx->entries));
+   idx->hdr->count = 0;
+}
+
+static void
+lru_index_insert_locked(const struct lru_index *idx, const cache_key key,
+                        uint32_t blocks, uint64_t stamp)
+{
+   uint32_t slot = lru_index_home(idx, key);
+   while (idx->entries[slot].used)
+      slot = (slot + 1) & idx->mask;
+
+   struct lru_index_entry *entry = &idx->entries[slot];
+   memcpy(entry->key, key, CACHE_KEY_SIZE);
+   entry->blocks = blocks;
+   entry->stamp = stamp;
+   entry->heap_stamp = stamp;
+   entry->used = 1;
+
+   uint32_t pos = idx->hdr->count++;
+   lru_index_heap_set(idx, pos, slot);
+   lru_index_sift_up(idx, pos);
+}
+
+static void
+lru_index_remove_locked(const struct lru_index *idx, uint32_t slot)
+{
+   /* Take the entry out of the heap. */
+   uint32_t pos = idx->entries[slot].heap_pos;
+   uint32_t last = --idx->hdr->count;
+   if (pos != last) {
+      lru_index_heap_set(idx, pos, idx->heap[last]);
+      if (pos > 0 &&
+          lru_index_heap_stamp(idx, pos) < lru_index_heap_stamp(idx, (pos - 1) / 2))
+         lru_index_sift_up(idx, pos);
+      else
+         lru_index_sift_down(idx, pos);
+   }
+
+   /* Backward shift deletion, so lookups never need tombstones: move
+    * following entries of the probe sequence into the hole unless their
+    * home slot lies cyclically between the hole and themselves.
+    */
+   uint32_t hole = slot, next = slot;
+   for (;;) {
+      next = (next + 1) & idx->mask;
+      if (!idx->entries[next].used)
+         break;
+
+      uint32_t home = lru_index_home(idx, idx->entries[next].key);
+      bool movable = hole <= next ? (home <= hole || home > next)
+                                  : (home <= hole && home > next);
+      if (movable) {
+         idx->entries[hole] = idx->entries[next];
+         idx->heap[idx->entries[hole].heap_pos] = hole;
+         hole = next;
+      }
+   }
+
+   memset(&idx->entries[hole], 0, sizeof(idx->entries[hole]));
+}
+
+/* Pop the least recently used entry, returns false if the index is empty. */
+static bool
+lru_index_pop_locked(const struct lru_index *idx, cache_key key,
+                     uint32_t *blocks)
+{
+   while (idx->hdr->count) {
+      uint32_t slot = idx->heap[0];
+      struct lru_index_entry *entry = &idx->entries[slot];
+
+      /* Entries touched since they were placed go back in the heap. */
+      uint64_t stamp = p_atomic_read(&entry->stamp);
+      if (stamp != entry->heap_stamp) {
+         entry->heap_stamp = stamp;
+         lru_index_sift_down(idx, 0);
+         continue;
+      }
+
+      memcpy(key, entry->key, CACHE_KEY_SIZE);
+      *blocks = entry->blocks;
+      lru_index_remove_locked(idx, slot);
+      return true;
+   }
+
+   return false;
+}
+
+static int
+lru_index_flock(int fd, bool lock)
+{
+   int ret;
+   do {
+#ifdef HAVE_FLOCK
+      ret = flock(fd, lock ? LOCK_EX : LOCK_UN);
+#else
+      struct flock fl = {
+         .l_start = 0,
+         .l_len = 0, /* entire file */
+         .l_type = lock ? F_WRLCK : F_UNLCK,
+         .l_whence = SEEK_SET
+      };
+      ret = fcntl(fd, F_SETLKW, &fl);
+#endif
+   } while (ret < 0 && errno == EINTR);
+   return ret;
+}
+
+static bool
+lru_index_lock(struct disk_cache *cache, struct lru_index *idx)
+{
+   if (!cache->lru_index_mmap)
+      return false;
+
+   simple_mtx_lock(&cache->lru_index_mtx);
+
+   if (lru_index_flock(cache->lru_index_fd, true) < 0) {
+      simple_mtx_unlock(&cache->lru_index_mtx);
+      return false;
+   }
+
+   if (!lru_index_get(cache, idx)) {
+      lru_index_flock(cache->lru_index_fd, false);
+      simple_mtx_unlock(&cache->lru_index_mtx);
+      return false;
+   }
+
+   /* A writer died half way through, or the header got clobbered. */
+   if (idx->hdr->dirty || idx->hdr->count > idx->mask)
+      lru_index_reset(idx);
+
+   idx->hdr->dirty = 1;
+   return true;
+}
+
+static void
+lru_index_unlock(struct disk_cache *cache, struct lru_index *idx)
+{
+   idx->hdr->dirty = 0;
+   lru_index_flock(cache->lru_index_fd, false);
+   simple_mtx_unlock(&cache->lru_index_mtx);
+}
+
+/* Unlink the file of a popped entry, returns the bytes freed. */
+static uint64_t
+lru_index_unlink(struct disk_cache *cache, const cache_key key, uint32_t blocks)
+{
+   char *filename = disk_cache_get_cache_filename(cache, key);
+   if (filename == NULL)
+      return 0;
+
+   int ret = unlink(filename);
+   free(filename);
+
+   return ret == 0 ? (uint64_t)blocks * 512 : 0;
+}
+
+static void
+lru_index_add(struct disk_cache *cache, const cache_key key, uint64_t blocks)
+{
+   struct lru_index idx;
+
+   if (!lru_index_lock(cache, &idx))
+      return;
+
+   uint64_t stamp = p_atomic_inc_return(&idx.hdr->clock);
+   struct lru_index_entry *entry = lru_index_find(&idx, key);
+   if (entry) {
+      /* Rewritten by another process after an eviction. */
+      entry->blocks = blocks;
+      p_atomic_set(&entry->stamp, stamp);
+   } else {
+      /* Leave some slots free to keep the probe sequences short. This
+       * only triggers when the files are smaller than the index was sized
+       * for, e.g. on file systems with small blocks.
+       */
+      while (idx.hdr->count >= idx.mask + 1 - (idx.mask + 1) / 8) {
+         cache_key lru_key;
+         uint32_t lru_blocks;
+         if (!lru_index_pop_locked(&idx, lru_key, &lru_blocks))
+            break;
+         uint64_t size = lru_index_unlink(cache, lru_key, lru_blocks);
+         if (size)
+            p_atomic_add(&cache->size->value, -size);
+      }
+
+      lru_index_insert_locked(&idx, key, MIN2(blocks, UINT32_MAX), stamp);
+   }
+
+   lru_index_unlock(cache, &idx);
+}
+
+static void
+lru_index_touch(struct disk_cache *cache, const cache_key key, uint64_t blocks)
+{
+   struct lru_index idx;
+   if (!lru_index_get(cache, &idx))
+      return;
+
+   struct lru_index_entry *entry = lru_index_find(&idx, key);
+   if (entry) {
+      p_atomic_set(&entry->stamp, p_atomic_inc_return(&idx.hdr->clock));
+      return;
+   }
+
+   lru_index_add(cache, key, blocks);
+}
+
+void
+disk_cache_lru_index_remove(struct disk_cache *cache, const cache_key key)
+{
+   struct lru_index idx;
+
+   if (!lru_index_lock(cache, &idx))
+      return;
+
+   struct lru_index_entry *entry = lru_index_find(&idx, key);
+   if (entry)
+      lru_index_remove_locked(&idx, entry - idx.entries);
+
+   lru_index_unlock(cache, &idx);
+}
+
+/* Evict the least recently used file known to the index, returns the
+ * bytes freed or 0 if the index had nothing to evict.
+ */
+static uint64_t
+lru_index_evict(struct disk_cache *cache)
+{
+   uint64_t size = 0;
+
+   /* Files may have been removed behind our back, skip those. */
+   for (unsigned i = 0; i < 64 && !size; i++) {
+      struct lru_index idx;
+      cache_key key;
+      uint32_t blocks;
+
+      if (!lru_index_lock(cache, &idx))
+         break;
+      bool found = lru_index_pop_locked(&idx, key, &blocks);
+      lru_index_unlock(cache, &idx);
+
+      if (!found)
+         break;
+
+      size = lru_index_unlink(cache, key, blocks);
+   }
+
+   return size;
+}
+
 /* Evict least recently used cache item */
 void
 disk_cache_evict_lru_item(struct disk_cache *cache)
 {
    char *dir_path;
 
+   uint64_t evicted = lru_index_evict(cache);
+   if (evicted) {
+      p_atomic_add(&cache->size->value, -evicted);
+      return;
+   }
+
    /* With a reasonably-sized, full cache, (and with keys generated
     * from a cryptographic hash), we can choose two random hex digits
     * and reasonably expect the directory to exist with a file in it.
@@ -631,7 +1055,8 @@ parse_and_validate_cache_item(struct disk_cache *cache, void *cache_item,
 }
 
 void *
-disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size)
+disk_cache_load_item(struct disk_cache *cache, const cache_key key,
+                     char *filename, size_t *size)
 {
    uint8_t *data = NULL;
 
@@ -657,6 +1082,8 @@ disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size)
    if (!uncompressed_data)
       goto fail;
 
+   lru_index_touch(cache, key, sb.st_blocks);
+
    free(data);
    free(filename);
    close(fd);
@@ -865,6 +1292,7 @@ disk_cache_write_item_to_disk(struct disk_cache_put_job *dc_job,
    }
 
    p_atomic_add(&dc_job->cache->size->value, sb.st_blocks * 512);
+   lru_index_add(dc_job->cache, dc_job->key, sb.st_blocks);
 
  done:
    if (fd_final != -1)
@@ -1175,6 +1603,93 @@ void
 disk_cache_destroy_mmap(struct disk_cache *cache)
 {
    munmap(cache->index_mmap, cache->index_mmap_size);
+
+   if (cache->lru_index_mmap) {
+      munmap(cache->lru_index_mmap, cache->lru_index_mmap_size);
+      close(cache->lru_index_fd);
+      simple_mtx_destroy(&cache->lru_index_mtx);
+      cache->lru_index_mmap = NULL;
+   }
+}
+
+/* Map the LRU index of a multi-file cache, see lru_index_get. Must be
+ * called once max_size is known, which sizes a newly created index.
+ */
+bool
+disk_cache_mmap_lru_index(struct disk_cache *cache)
+{
+   struct lru_index_header *hdr;
+   char *path = NULL;
+   bool mapped = false;
+   uint8_t *map = MAP_FAILED;
+   size_t size = 0;
+
+   if (asprintf(&path, "%s/index_lru", cache->path) == -1)
+      return false;
+
+   int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   free(path);
+   if (fd == -1)
+      return false;
+
+   if (lru_index_flock(fd, true) < 0)
+      goto fail;
+
+   struct stat sb;
+   if (fstat(fd, &sb) == -1)
+      goto unlock;
+
+   /* Size a new index for files of at least 4K. */
+   uint32_t capacity =
+      util_next_power_of_two64(CLAMP(cache->max_size / 4096,
+                                     LRU_INDEX_MIN_ENTRIES,
+                                     LRU_INDEX_MAX_ENTRIES));
+
+   /* Other processes may have the file mapped, so it is only ever grown,
+    * never truncated.
+    */
+   size = MAX2(lru_index_file_size(capacity), sb.st_size);
+   if (sb.st_size < size) {
+#if HAVE_POSIX_FALLOCATE
+      if (posix_fallocate(fd, 0, size) != 0)
+         goto unlock;
+#else
+      if (ftruncate(fd, size) == -1)
+         goto unlock;
+#endif
+   }
+
+   map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (map == MAP_FAILED)
+      goto unlock;
+
+   /* Keep an existing index that fits, start a new one otherwise. */
+   hdr = (struct lru_index_header *)map;
+   if (hdr->magic != LRU_INDEX_MAGIC || hdr->version != LRU_INDEX_VERSION ||
+       !util_is_power_of_two_nonzero(hdr->capacity) ||
+       lru_index_file_size(hdr->capacity) > size) {
+      memset(map, 0, lru_index_file_size(capacity));
+      hdr->magic = LRU_INDEX_MAGIC;
+      hdr->version = LRU_INDEX_VERSION;
+      hdr->capacity = capacity;
+   }
+
+   cache->lru_index_mmap = map;
+   cache->lru_index_mmap_size = size;
+   cache->lru_index_fd = fd;
+   simple_mtx_init(&cache->lru_index_mtx, mtx_plain);
+   mapped = true;
+
+unlock:
+   lru_index_flock(fd, false);
+fail:
+   if (!mapped) {
+      if (map != MAP_FAILED)
+         munmap(map, size);
+      close(fd);
+   }
+
+   return mapped;
 }
 
 void *
@@ -35,6 +35,7 @@
 #include "util/fossilize_db.h"
 #include "util/mesa_cache_db.h"
 #include "util/mesa_cache_db_multipart.h"
+#include "util/simple_mtx.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -86,6 +87,14 @@ struct disk_cache {
    /* Maximum size of all cached objects (in bytes). */
    uint64_t max_size;
 
+   /* Access ordered index of the multi-file cache entries, used for
+    * eviction (see disk_cache_mmap_lru_index). NULL if unavailable.
+    */
+   uint8_t *lru_index_mmap;
+   size_t lru_index_mmap_size;
+   int lru_index_fd;
+   simple_mtx_t lru_index_mtx;
+
    /* Driver cache keys. */
    uint8_t *driver_keys_blob;
    size_t driver_keys_blob_size;
@@ -145,7 +154,8 @@ disk_cache_load_item_foz(struct disk_cache *cache, const cache_key key,
                          size_t *size);
 
 void *
-disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size);
+disk_cache_load_item(struct disk_cache *cache, const cache_key key,
+                     char *filename, size_t *size);
 
 char *
 disk_cache_get_cache_filename(struct disk_cache *cache, const cache_key key);
@@ -173,6 +183,12 @@ disk_cache_mmap_cache_index(void *mem_ctx, struct disk_cache *cache,
 void
 disk_cache_destroy_mmap(struct disk_cache *cache);
 
+bool
+disk_cache_mmap_lru_index(struct disk_cache *cache);
+
+void
+disk_cache_lru_index_remove(struct disk_cache *cache, const cache_key key);
+
 void *
 disk_cache_db_load_item(struct disk_cache *cache, const cache_key key,
                         size_t *size);
@@ -384,6 +384,10 @@
    DRI_CONF_OPT_B(precise_trig, def, \
                   "Prefer accuracy over performance in trig functions")
 
+#define DRI_CONF_BPTC_COMPRESS_QUALITY(def) \
+   DRI_CONF_OPT_I(bptc_compress_quality, def, 0, 2, \
+                  "Quality of the software BPTC compressor used for uploads to BPTC formats. 0 is the fastest, 2 the best")
+
 #define DRI_CONF_PP_CELSHADE(def) \
    DRI_CONF_OPT_E(pp_celshade, def, 0, 1, \
                   "A post-processing filter to cel-shade the output", \
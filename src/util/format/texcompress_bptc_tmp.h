@@ -28,7 +28,10 @@
 #ifndef TEXCOMPRESS_BPTC_TMP_H
 #define TEXCOMPRESS_BPTC_TMP_H
 
+#include <float.h>
+
 #include "util/bitscan.h"
+#include "util/format/u_format_bptc.h"
 #include "util/format_srgb.h"
 #include "util/half_float.h"
 #include "util/u_math.h"
@@ -1566,10 +1569,374 @@ compress_rgba_unorm_block(int src_width, int src_height,
                              endpoints);
 }
 
+/* The texels of a block in separate arrays per component. The loops over
+ * them have a fixed trip count of 16 so that the compiler can vectorize them.
+ * Texels outside of the image repeat the nearest texel inside of it and have
+ * a zero weight.
+ */
+struct bptc_block_texels {
+   int32_t c[4][BLOCK_SIZE * BLOCK_SIZE];
+   int32_t weight[BLOCK_SIZE * BLOCK_SIZE];
+};
+
 static void
-compress_rgba_unorm(int width, int height,
-                    const uint8_t *src, int src_rowstride,
-                    uint8_t *dst, int dst_rowstride)
+load_block_texels_unorm(int src_width, int src_height,
+                        const uint8_t *src, int src_rowstride,
+                        struct bptc_block_texels *texels)
+{
+   int i, component;
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      int x = i % BLOCK_SIZE, y = i / BLOCK_SIZE;
+      const uint8_t *p = src + (MIN2(y, src_height - 1) * src_rowstride +
+                                MIN2(x, src_width - 1) * 4);
+
+      for (component = 0; component < 4; component++)
+         texels->c[component][i] = p[component];
+      texels->weight[i] = x < src_width && y < src_height;
+   }
+}
+
+/* Finds the direction in which the texels vary the most, as the dominant
+ * eigenvector of their covariance matrix, by power iteration.
+ */
+static void
+get_principal_axis_unorm(const struct bptc_block_texels *texels,
+                         float mean[4], float axis[4])
+{
+   float covariance[4][4];
+   float sum_weight = 0.0f;
+   float v[4], max_variance = 0.0f;
+   int i, j, k = 0, iteration;
+
+   for (j = 0; j < 4; j++)
+      mean[j] = 0.0f;
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      sum_weight += texels->weight[i];
+      for (j = 0; j < 4; j++)
+         mean[j] += texels->weight[i] * texels->c[j][i];
+   }
+
+   for (j = 0; j < 4; j++)
+      mean[j] /= sum_weight;
+
+   for (j = 0; j < 4; j++) {
+      for (k = j; k < 4; k++) {
+         float sum = 0.0f;
+         for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+            sum += (texels->weight[i] *
+                    (texels->c[j][i] - mean[j]) *
+                    (texels->c[k][i] - mean[k]));
+         }
+         covariance[j][k] = covariance[k][j] = sum;
+      }
+   }
+
+   /* Start from the column of the component with the largest variance */
+   for (j = 0; j < 4; j++) {
+      axis[j] = 0.0f;
+      if (covariance[j][j] > max_variance) {
+         max_variance = covariance[j][j];
+         k = j;
+      }
+   }
+
+   if (max_variance == 0.0f)
+      return;
+
+   for (j = 0; j < 4; j++)
+      axis[j] = covariance[j][k];
+
+   for (iteration = 0; iteration < 8; iteration++) {
+      float max = 0.0f;
+
+      for (j = 0; j < 4; j++) {
+         v[j] = 0.0f;
+         for (k = 0; k < 4; k++)
+            v[j] += covariance[j][k] * axis[k];
+         max = MAX2(max, fabsf(v[j]));
+      }
+
+      if (max == 0.0f)
+         break;
+
+      for (j = 0; j < 4; j++)
+         axis[j] = v[j] / max;
+   }
+}
+
+/* Quantizes an endpoint for mode 6, which stores 7 bits per component and
+ * one p-bit shared by all of the components. The result is the 8-bit value
+ * the decoder will see.
+ */
+static void
+quantize_endpoint_mode6(const float value[4], uint8_t endpoint[4])
+{
+   float best_error = FLT_MAX;
+   int pbit, component;
+
+   for (pbit = 0; pbit < 2; pbit++) {
+      uint8_t quantized[4];
+      float error = 0.0f;
+
+      for (component = 0; component < 4; component++) {
+         int q = CLAMP((int) roundf((value[component] - pbit) / 2.0f), 0, 127);
+         float diff;
+
+         quantized[component] = (q << 1) | pbit;
+         diff = quantized[component] - value[component];
+         error += diff * diff;
+      }
+
+      if (error < best_error) {
+         best_error = error;
+         memcpy(endpoint, quantized, 4);
+      }
+   }
+}
+
+/* Picks the nearest palette entry for each texel and returns the total
+ * squared error of the block. This is the inner loop of the encoder, it is
+ * done on integers and local arrays so that it vectorizes.
+ */
+static int32_t
+find_indices_mode6(const struct bptc_block_texels *texels,
+                   uint8_t endpoints[][4],
+                   int32_t indices[BLOCK_SIZE * BLOCK_SIZE])
+{
+   int32_t palette[16][4];
+   int32_t best_error[BLOCK_SIZE * BLOCK_SIZE];
+   int32_t best_index[BLOCK_SIZE * BLOCK_SIZE];
+   int32_t total_error = 0;
+   int i, j, component;
+
+   for (j = 0; j < 16; j++) {
+      for (component = 0; component < 4; component++) {
+         palette[j][component] = interpolate(endpoints[0][component],
+                                             endpoints[1][component],
+                                             j, 4);
+      }
+   }
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      best_error[i] = INT32_MAX;
+      best_index[i] = 0;
+   }
+
+   for (j = 0; j < 16; j++) {
+      for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+         int32_t dr = texels->c[0][i] - palette[j][0];
+         int32_t dg = texels->c[1][i] - palette[j][1];
+         int32_t db = texels->c[2][i] - palette[j][2];
+         int32_t da = texels->c[3][i] - palette[j][3];
+         int32_t error = dr * dr + dg * dg + db * db + da * da;
+
+         best_index[i] = error < best_error[i] ? j : best_index[i];
+         best_error[i] = MIN2(error, best_error[i]);
+      }
+   }
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      indices[i] = best_index[i];
+      total_error += texels->weight[i] * best_error[i];
+   }
+
+   return total_error;
+}
+
+/* Moves the endpoints to the least-squares fit of the texels for the given
+ * indices. Returns false if the indices don't determine the endpoints.
+ */
+static bool
+refine_endpoints_mode6(const struct bptc_block_texels *texels,
+                       const int32_t indices[BLOCK_SIZE * BLOCK_SIZE],
+                       float endpoints[][4])
+{
+   float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+   float ax[4] = { 0 }, bx[4] = { 0 };
+   float det;
+   int i, component;
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      /* Interpolating between 0 and 64 gives back the weight */
+      float b = interpolate(0, 64, indices[i], 4) / 64.0f;
+      float a = 1.0f - b;
+      float w = texels->weight[i];
+
+      aa += w * a * a;
+      ab += w * a * b;
+      bb += w * b * b;
+      for (component = 0; component < 4; component++) {
+         ax[component] += w * a * texels->c[component][i];
+         bx[component] += w * b * texels->c[component][i];
+      }
+   }
+
+   det = aa * bb - ab * ab;
+   if (fabsf(det) < 1e-6f)
+      return false;
+
+   for (component = 0; component < 4; component++) {
+      endpoints[0][component] =
+         CLAMP((bb * ax[component] - ab * bx[component]) / det, 0.0f, 255.0f);
+      endpoints[1][component] =
+         CLAMP((aa * bx[component] - ab * ax[component]) / det, 0.0f, 255.0f);
+   }
+
+   return true;
+}
+
+static void
+write_block_mode6(uint8_t *dst,
+                  uint8_t endpoints[][4],
+                  int32_t indices[BLOCK_SIZE * BLOCK_SIZE])
+{
+   struct bit_writer writer;
+   uint8_t temp[4];
+   int component, endpoint, i;
+
+   /* The most-significant bit of the first index is implicitly zero. The
+    * weights are symmetric so swapping the endpoints and inverting the
+    * indices gives the same texels.
+    */
+   if (indices[0] & 8) {
+      memcpy(temp, endpoints[0], 4);
+      memcpy(endpoints[0], endpoints[1], 4);
+      memcpy(endpoints[1], temp, 4);
+      for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++)
+         indices[i] = 15 - indices[i];
+   }
+
+   writer.dst = dst;
+   writer.pos = 0;
+   writer.buf = 0;
+
+   write_bits(&writer, 7, 0x40); /* mode 6 */
+
+   for (component = 0; component < 4; component++)
+      for (endpoint = 0; endpoint < 2; endpoint++)
+         write_bits(&writer, 7, endpoints[endpoint][component] >> 1);
+
+   for (endpoint = 0; endpoint < 2; endpoint++)
+      write_bits(&writer, 1, endpoints[endpoint][0] & 1);
+
+   write_bits(&writer, 3, indices[0]);
+   for (i = 1; i < BLOCK_SIZE * BLOCK_SIZE; i++)
+      write_bits(&writer, 4, indices[i]);
+}
+
+static int32_t
+get_block_error_unorm(const struct bptc_block_texels *texels,
+                      const uint8_t *block)
+{
+   uint8_t decoded[BLOCK_SIZE * BLOCK_SIZE * 4];
+   int32_t error = 0;
+   int i, component;
+
+   decompress_rgba_unorm_block(BLOCK_SIZE, BLOCK_SIZE, block,
+                               decoded, BLOCK_SIZE * 4);
+
+   for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+      for (component = 0; component < 4; component++) {
+         int32_t diff = decoded[i * 4 + component] - texels->c[component][i];
+         error += texels->weight[i] * diff * diff;
+      }
+   }
+
+   return error;
+}
+
+/* Encodes a block in mode 6 with endpoints along the principal axis of the
+ * texels. The best quality also fits the endpoints to the chosen indices and
+ * falls back to the fast encoding for blocks where that does better.
+ */
+static void
+compress_rgba_unorm_block_pca(int src_width, int src_height,
+                              const uint8_t *src, int src_rowstride,
+                              uint8_t *dst,
+                              enum util_format_bptc_quality quality)
+{
+   struct bptc_block_texels texels;
+   float mean[4], axis[4], axis_length2 = 0.0f;
+   float t_min = FLT_MAX, t_max = -FLT_MAX;
+   float ideal[2][4];
+   uint8_t endpoints[2][4];
+   int32_t indices[BLOCK_SIZE * BLOCK_SIZE];
+   int32_t error;
+   int i, component, iteration;
+
+   load_block_texels_unorm(src_width, src_height, src, src_rowstride, &texels);
+   get_principal_axis_unorm(&texels, mean, axis);
+
+   for (component = 0; component < 4; component++)
+      axis_length2 += axis[component] * axis[component];
+
+   if (axis_length2 > 0.0f) {
+      for (component = 0; component < 4; component++)
+         axis[component] /= sqrtf(axis_length2);
+
+      for (i = 0; i < BLOCK_SIZE * BLOCK_SIZE; i++) {
+         float t = 0.0f;
+         for (component = 0; component < 4; component++)
+            t += (texels.c[component][i] - mean[component]) * axis[component];
+         t_min = MIN2(t_min, t);
+         t_max = MAX2(t_max, t);
+      }
+   } else {
+      t_min = t_max = 0.0f;
+   }
+
+   for (component = 0; component < 4; component++) {
+      ideal[0][component] =
+         CLAMP(mean[component] + t_min * axis[component], 0.0f, 255.0f);
+      ideal[1][component] =
+         CLAMP(mean[component] + t_max * axis[component], 0.0f, 255.0f);
+   }
+
+   quantize_endpoint_mode6(ideal[0], endpoints[0]);
+   quantize_endpoint_mode6(ideal[1], endpoints[1]);
+   error = find_indices_mode6(&texels, endpoints, indices);
+
+   if (quality >= UTIL_FORMAT_BPTC_QUALITY_BEST) {
+      for (iteration = 0; iteration < 2 && error > 0; iteration++) {
+         uint8_t refined_endpoints[2][4];
+         int32_t refined_indices[BLOCK_SIZE * BLOCK_SIZE];
+         int32_t refined_error;
+
+         if (!refine_endpoints_mode6(&texels, indices, ideal))
+            break;
+
+         quantize_endpoint_mode6(ideal[0], refined_endpoints[0]);
+         quantize_endpoint_mode6(ideal[1], refined_endpoints[1]);
+         refined_error = find_indices_mode6(&texels, refined_endpoints,
+                                            refined_indices);
+         if (refined_error >= error)
+            break;
+
+         error = refined_error;
+         memcpy(endpoints, refined_endpoints, sizeof endpoints);
+         memcpy(indices, refined_indices, sizeof indices);
+      }
+   }
+
+   write_block_mode6(dst, endpoints, indices);
+
+   if (quality >= UTIL_FORMAT_BPTC_QUALITY_BEST && error > 0) {
+      uint8_t block[BLOCK_BYTES];
+
+      compress_rgba_unorm_block(src_width, src_height, src, src_rowstride,
+                                block);
+      if (get_block_error_unorm(&texels, block) < error)
+         memcpy(dst, block, BLOCK_BYTES);
+   }
+}
+
+static void
+compress_rgba_unorm_quality(int width, int height,
+                            const uint8_t *src, int src_rowstride,
+                            uint8_t *dst, int dst_rowstride,
+                            enum util_format_bptc_quality quality)
 {
    int dst_row_diff;
    int y, x;
@@ -1581,17 +1948,35 @@ compress_rgba_unorm(int width, int height,
 
    for (y = 0; y < height; y += BLOCK_SIZE) {
       for (x = 0; x < width; x += BLOCK_SIZE) {
-         compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
-                                   MIN2(height - y, BLOCK_SIZE),
-                                   src + x * 4 + y * src_rowstride,
-                                   src_rowstride,
-                                   dst);
+         if (quality == UTIL_FORMAT_BPTC_QUALITY_FAST) {
+            compress_rgba_unorm_block(MIN2(width - x, BLOCK_SIZE),
+                                      MIN2(height - y, BLOCK_SIZE),
+                                      src + x * 4 + y * src_rowstride,
+                                      src_rowstride,
+                                      dst);
+         } else {
+            compress_rgba_unorm_block_pca(MIN2(width - x, BLOCK_SIZE),
+                                          MIN2(height - y, BLOCK_SIZE),
+                                          src + x * 4 + y * src_rowstride,
+                                          src_rowstride,
+                                          dst, quality);
+         }
          dst += BLOCK_BYTES;
       }
       dst += dst_row_diff;
    }
 }
 
+static void
+compress_rgba_unorm(int width, int height,
+                    const uint8_t *src, int src_rowstride,
+                    uint8_t *dst, int dst_rowstride)
+{
+   compress_rgba_unorm_quality(width, height, src, src_rowstride,
+                               dst, dst_rowstride,
+                               UTIL_FORMAT_BPTC_QUALITY_FAST);
+}
+
 static float
 get_average_luminance_float(int width, int height,
                             const float *src, int src_rowstride)
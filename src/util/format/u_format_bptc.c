@@ -28,6 +28,7 @@
 #include "u_format_pack.h"
 #include "util/format_srgb.h"
 #include "util/u_math.h"
+#include "util/u_queue.h"
 
 #include "util/format/texcompress_bptc_tmp.h"
 
@@ -298,3 +299,99 @@ util_format_bptc_rgb_ufloat_fetch_rgba(void *restrict dst, const uint8_t *restri
    fetch_rgb_float_from_block(src + ((width * sizeof(uint8_t)) * (height / 4) + (width / 4)) * 16,
                               dst, (width % 4) + (height % 4) * 4, false);
 }
+
+/* Images with fewer blocks than this are compressed on the calling thread,
+ * handing them to other threads would cost more than it saves.
+ */
+#define BPTC_MIN_PARALLEL_BLOCKS 4096
+
+struct bptc_compress_job {
+   uint8_t *dst;
+   unsigned dst_stride;
+   const void *src;
+   unsigned src_stride;
+   unsigned width, height;
+   bool is_float;
+   bool is_signed;
+   enum util_format_bptc_quality quality;
+};
+
+static bool
+bptc_compress_band(void *data, unsigned first_row, unsigned num_rows)
+{
+   const struct bptc_compress_job *job = data;
+   const unsigned blocks_w = DIV_ROUND_UP(job->width, BLOCK_SIZE);
+   const unsigned y = first_row * BLOCK_SIZE;
+   const unsigned height = MIN2(job->height - y, num_rows * BLOCK_SIZE);
+
+   /* Matches how compress_rgba_unorm() and compress_rgb_float() step from
+    * one row of blocks to the next.
+    */
+   const unsigned dst_row_pitch = job->dst_stride >= job->width * 4 ?
+                                  job->dst_stride : blocks_w * BLOCK_BYTES;
+   uint8_t *dst = job->dst + (size_t)first_row * dst_row_pitch;
+   const uint8_t *src = (const uint8_t *)job->src + (size_t)y * job->src_stride;
+
+   if (job->is_float) {
+      compress_rgb_float(job->width, height,
+                         (const float *)src, job->src_stride,
+                         dst, job->dst_stride,
+                         job->is_signed);
+   } else {
+      compress_rgba_unorm_quality(job->width, height,
+                                  src, job->src_stride,
+                                  dst, job->dst_stride,
+                                  job->quality);
+   }
+   return true;
+}
+
+static void
+bptc_compress(const struct bptc_compress_job *job)
+{
+   const unsigned blocks_w = DIV_ROUND_UP(job->width, BLOCK_SIZE);
+   const unsigned blocks_h = DIV_ROUND_UP(job->height, BLOCK_SIZE);
+   const bool parallel = blocks_w * blocks_h >= BPTC_MIN_PARALLEL_BLOCKS;
+
+   util_queue_run_bands(blocks_h, 1, parallel ? UINT_MAX : 1,
+                        bptc_compress_band, (void *)job);
+}
+
+void
+util_format_bptc_rgba_unorm_compress(uint8_t *dst, unsigned dst_stride,
+                                     const uint8_t *src, unsigned src_stride,
+                                     unsigned width, unsigned height,
+                                     enum util_format_bptc_quality quality)
+{
+   struct bptc_compress_job job = {
+      .dst = dst,
+      .dst_stride = dst_stride,
+      .src = src,
+      .src_stride = src_stride,
+      .width = width,
+      .height = height,
+      .quality = quality,
+   };
+
+   bptc_compress(&job);
+}
+
+void
+util_format_bptc_rgb_float_compress(uint8_t *dst, unsigned dst_stride,
+                                    const float *src, unsigned src_stride,
+                                    unsigned width, unsigned height,
+                                    bool is_signed)
+{
+   struct bptc_compress_job job = {
+      .dst = dst,
+      .dst_stride = dst_stride,
+      .src = src,
+      .src_stride = src_stride,
+      .width = width,
+      .height = height,
+      .is_float = true,
+      .is_signed = is_signed,
+   };
+
+   bptc_compress(&job);
+}
@@ -30,6 +30,9 @@
 #define U_FORMAT_BPTC_H_
 
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include "util/compiler.h"
 
 #include "c99_compat.h"
@@ -38,6 +41,19 @@
 extern "C" {
 #endif
 
+/**
+ * Trade-off between speed and quality when compressing to BPTC unorm
+ * formats.
+ */
+enum util_format_bptc_quality {
+   /** Single-mode encoding with endpoints split by luminance. */
+   UTIL_FORMAT_BPTC_QUALITY_FAST,
+   /** Endpoints along the principal axis of each block. */
+   UTIL_FORMAT_BPTC_QUALITY_NORMAL,
+   /** As above, with least-squares endpoint refinement. */
+   UTIL_FORMAT_BPTC_QUALITY_BEST,
+};
+
 void
 util_format_bptc_rgba_unorm_unpack_rgba_8unorm(uint8_t *restrict dst_row, unsigned dst_stride,
                                                const uint8_t *restrict src_row, unsigned src_stride,
@@ -117,6 +133,22 @@ util_format_bptc_rgb_ufloat_pack_rgba_float(uint8_t *restrict dst_row, unsigned
 void
 util_format_bptc_rgb_ufloat_fetch_rgba(void *restrict dst, const uint8_t *restrict src,
                                              unsigned width, unsigned height);
+
+/**
+ * Compress a whole image, splitting large ones into bands of block rows
+ * that are compressed on a pool of threads. Strides are in bytes.
+ */
+void
+util_format_bptc_rgba_unorm_compress(uint8_t *dst, unsigned dst_stride,
+                                     const uint8_t *src, unsigned src_stride,
+                                     unsigned width, unsigned height,
+                                     enum util_format_bptc_quality quality);
+void
+util_format_bptc_rgb_float_compress(uint8_t *dst, unsigned dst_stride,
+                                    const float *src, unsigned src_stride,
+                                    unsigned width, unsigned height,
+                                    bool is_signed);
+
 #ifdef __cplusplus
 }
 #endif
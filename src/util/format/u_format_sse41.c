@@ -0,0 +1,759 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * SSE4.1 versions of the pack and unpack functions of frequently used
+ * formats. They return the same bits as the generated code in
+ * u_format_table.c; NaNs may differ in payload but stay NaNs.
+ *
+ * Built with -msse4.1, see util_format_unpack_description() and
+ * util_format_pack_description() for the runtime selection.
+ */
+
+#include "util/format/u_format.h"
+
+#if defined(USE_SSE41)
+
+#include <smmintrin.h>
+
+#include "u_format_pack.h"
+#include "util/format/u_format_other.h"
+#include "util/format/u_format_zs.h"
+#include "util/u_cpu_detect.h"
+
+/* One 16 byte shuffle that swaps the R and B bytes of four pixels. */
+static inline __m128i
+swap_rb_8(__m128i v)
+{
+   return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7,
+                                            10, 9, 8, 11, 14, 13, 12, 15));
+}
+
+/* Four 8-bit components to floats in [0, 1], as ubyte_to_float(). */
+static inline __m128
+ubyte4_to_float(int32_t pixel)
+{
+   __m128i v = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(pixel));
+   return _mm_mul_ps(_mm_cvtepi32_ps(v), _mm_set1_ps(1.0f / 255.0f));
+}
+
+/* Four floats to 8-bit components, as float_to_ubyte(). The result is in the
+ * low byte of each lane.
+ */
+static inline __m128i
+float4_to_ubyte(__m128 f)
+{
+   /* _mm_max_ps() returns its second operand for NaN, like the scalar code
+    * which returns 0.
+    */
+   f = _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   f = _mm_add_ps(_mm_mul_ps(f, _mm_set1_ps(255.0f / 256.0f)),
+                  _mm_set1_ps(32768.0f));
+   return _mm_and_si128(_mm_castps_si128(f), _mm_set1_epi32(0xff));
+}
+
+static inline __m128i
+pack_ubyte_lanes(__m128i p0, __m128i p1, __m128i p2, __m128i p3)
+{
+   return _mm_packus_epi16(_mm_packus_epi32(p0, p1), _mm_packus_epi32(p2, p3));
+}
+
+/*
+ * 8-bit RGBA
+ */
+
+static void
+util_format_r8g8b8a8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src,
+                                                    unsigned width)
+{
+   memcpy(dst, src, width * 4);
+}
+
+static void
+util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src,
+                                                    unsigned width)
+{
+   for (; width >= 4; width -= 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src);
+      _mm_storeu_si128((__m128i *)dst, swap_rb_8(v));
+      src += 16;
+      dst += 16;
+   }
+   if (width)
+      util_format_b8g8r8a8_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static void
+util_format_r8g8b8x8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src,
+                                                    unsigned width)
+{
+   for (; width >= 4; width -= 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src);
+      v = _mm_or_si128(v, _mm_set1_epi32(0xff000000));
+      _mm_storeu_si128((__m128i *)dst, v);
+      src += 16;
+      dst += 16;
+   }
+   if (width)
+      util_format_r8g8b8x8_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static void
+util_format_b8g8r8x8_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src,
+                                                    unsigned width)
+{
+   for (; width >= 4; width -= 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src);
+      v = _mm_or_si128(swap_rb_8(v), _mm_set1_epi32(0xff000000));
+      _mm_storeu_si128((__m128i *)dst, v);
+      src += 16;
+      dst += 16;
+   }
+   if (width)
+      util_format_b8g8r8x8_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static ALWAYS_INLINE void
+unpack_8unorm_rgba_float(float *restrict dst, const uint8_t *restrict src,
+                         unsigned width, bool swap_rb, bool has_alpha)
+{
+   for (unsigned x = 0; x < width; x++) {
+      int32_t pixel;
+      memcpy(&pixel, src, 4);
+
+      __m128 f = ubyte4_to_float(pixel);
+      if (swap_rb)
+         f = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 0, 1, 2));
+      if (!has_alpha)
+         f = _mm_blend_ps(f, _mm_set1_ps(1.0f), 0x8);
+      _mm_storeu_ps(dst, f);
+
+      src += 4;
+      dst += 4;
+   }
+}
+
+static void
+util_format_r8g8b8a8_unorm_unpack_rgba_float_sse41(void *restrict dst, const uint8_t *restrict src,
+                                                   unsigned width)
+{
+   unpack_8unorm_rgba_float(dst, src, width, false, true);
+}
+
+static void
+util_format_b8g8r8a8_unorm_unpack_rgba_float_sse41(void *restrict dst, const uint8_t *restrict src,
+                                                   unsigned width)
+{
+   unpack_8unorm_rgba_float(dst, src, width, true, true);
+}
+
+static void
+util_format_r8g8b8x8_unorm_unpack_rgba_float_sse41(void *restrict dst, const uint8_t *restrict src,
+                                                   unsigned width)
+{
+   unpack_8unorm_rgba_float(dst, src, width, false, false);
+}
+
+static void
+util_format_b8g8r8x8_unorm_unpack_rgba_float_sse41(void *restrict dst, const uint8_t *restrict src,
+                                                   unsigned width)
+{
+   unpack_8unorm_rgba_float(dst, src, width, true, false);
+}
+
+static void
+util_format_r8g8b8a8_unorm_pack_rgba_8unorm_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                  const uint8_t *restrict src_row, unsigned src_stride,
+                                                  unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      memcpy(dst_row, src_row, width * 4);
+      dst_row += dst_stride;
+      src_row += src_stride;
+   }
+}
+
+static void
+util_format_b8g8r8a8_unorm_pack_rgba_8unorm_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                  const uint8_t *restrict src_row, unsigned src_stride,
+                                                  unsigned width, unsigned height)
+{
+   /* Swapping R and B is its own inverse. */
+   for (unsigned y = 0; y < height; y++) {
+      util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_sse41(dst_row, src_row, width);
+      dst_row += dst_stride;
+      src_row += src_stride;
+   }
+}
+
+static ALWAYS_INLINE void
+pack_8unorm_rgba_float(uint8_t *restrict dst_row, unsigned dst_stride,
+                       const float *restrict src_row, unsigned src_stride,
+                       unsigned width, unsigned height, bool swap_rb)
+{
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i p[4];
+         for (unsigned i = 0; i < 4; i++) {
+            __m128 f = _mm_loadu_ps(src + i * 4);
+            if (swap_rb)
+               f = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 0, 1, 2));
+            p[i] = float4_to_ubyte(f);
+         }
+         _mm_storeu_si128((__m128i *)dst, pack_ubyte_lanes(p[0], p[1], p[2], p[3]));
+         src += 16;
+         dst += 16;
+      }
+
+      for (; x < width; x++) {
+         __m128 f = _mm_loadu_ps(src);
+         if (swap_rb)
+            f = _mm_shuffle_ps(f, f, _MM_SHUFFLE(3, 0, 1, 2));
+         __m128i p = float4_to_ubyte(f);
+         p = _mm_packus_epi16(_mm_packus_epi32(p, p), p);
+         int32_t pixel = _mm_cvtsi128_si32(p);
+         memcpy(dst, &pixel, 4);
+         src += 4;
+         dst += 4;
+      }
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_r8g8b8a8_unorm_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                 const float *restrict src_row, unsigned src_stride,
+                                                 unsigned width, unsigned height)
+{
+   pack_8unorm_rgba_float(dst_row, dst_stride, src_row, src_stride, width, height, false);
+}
+
+static void
+util_format_b8g8r8a8_unorm_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                 const float *restrict src_row, unsigned src_stride,
+                                                 unsigned width, unsigned height)
+{
+   pack_8unorm_rgba_float(dst_row, dst_stride, src_row, src_stride, width, height, true);
+}
+
+/*
+ * R10G10B10A2
+ */
+
+static void
+util_format_r10g10b10a2_unorm_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, const uint8_t *restrict src,
+                                                       unsigned width)
+{
+   const __m128i mask = _mm_set1_epi32(0x3ff);
+
+   for (; width >= 4; width -= 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src);
+      __m128i r = _mm_and_si128(v, mask);
+      __m128i g = _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+      __m128i b = _mm_and_si128(_mm_srli_epi32(v, 20), mask);
+      __m128i a = _mm_srli_epi32(v, 30);
+
+      /* _mesa_unorm_to_unorm(x, 10, 8) is (x * 255 + 511) / 1023, which is
+       * exactly ((x * 255 + 511) * 1025) >> 20 for 10-bit x.
+       */
+#define UNORM10_TO_UNORM8(x)                                                   \
+      _mm_srli_epi32(_mm_mullo_epi32(_mm_add_epi32(_mm_mullo_epi32(x,          \
+                        _mm_set1_epi32(255)), _mm_set1_epi32(511)),            \
+                     _mm_set1_epi32(1025)), 20)
+      r = UNORM10_TO_UNORM8(r);
+      g = UNORM10_TO_UNORM8(g);
+      b = UNORM10_TO_UNORM8(b);
+#undef UNORM10_TO_UNORM8
+      a = _mm_mullo_epi32(a, _mm_set1_epi32(85));
+
+      v = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                       _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+      _mm_storeu_si128((__m128i *)dst, v);
+      src += 16;
+      dst += 16;
+   }
+   if (width)
+      util_format_r10g10b10a2_unorm_unpack_rgba_8unorm(dst, src, width);
+}
+
+static void
+util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src,
+                                                      unsigned width)
+{
+   const __m128i shift = _mm_setr_epi32(1 << 22, 1 << 12, 1 << 2, 1);
+   const __m128 scale = _mm_setr_ps(1.0f / 0x3ff, 1.0f / 0x3ff, 1.0f / 0x3ff, 1.0f / 0x3);
+   float *dst = dst_row;
+
+   for (unsigned x = 0; x < width; x++) {
+      int32_t pixel;
+      memcpy(&pixel, src, 4);
+
+      /* Move each component to the top of its lane, then down to the bottom */
+      __m128i v = _mm_mullo_epi32(_mm_set1_epi32(pixel), shift);
+      v = _mm_srli_epi32(_mm_and_si128(v, _mm_setr_epi32(0xffc00000, 0xffc00000,
+                                                         0xffc00000, 0xc0000000)), 22);
+      v = _mm_blend_epi16(v, _mm_srli_epi32(v, 8), 0xc0);
+      _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+
+      src += 4;
+      dst += 4;
+   }
+}
+
+static void
+util_format_r10g10b10a2_unorm_pack_rgba_float_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                    const float *restrict src_row, unsigned src_stride,
+                                                    unsigned width, unsigned height)
+{
+   const __m128 scale = _mm_setr_ps(0x3ff, 0x3ff, 0x3ff, 0x3);
+   const __m128i mask = _mm_setr_epi32(0x3ff, 0x3ff, 0x3ff, 0x3);
+   const __m128i shift = _mm_setr_epi32(1, 1 << 10, 1 << 20, 1 << 30);
+
+   for (unsigned y = 0; y < height; y++) {
+      const float *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      /* CLAMP() and util_iround() of the generated code. The components
+       * don't overlap once shifted, so adding them up ORs them together.
+       */
+#define PACK_PIXEL(f)                                                          \
+      _mm_mullo_epi32(_mm_and_si128(_mm_cvtps_epi32(_mm_mul_ps(                \
+         _mm_min_ps(_mm_max_ps(f, _mm_setzero_ps()), _mm_set1_ps(1.0f)),       \
+         scale)), mask), shift)
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i p0 = PACK_PIXEL(_mm_loadu_ps(src + 0));
+         __m128i p1 = PACK_PIXEL(_mm_loadu_ps(src + 4));
+         __m128i p2 = PACK_PIXEL(_mm_loadu_ps(src + 8));
+         __m128i p3 = PACK_PIXEL(_mm_loadu_ps(src + 12));
+         __m128i v = _mm_hadd_epi32(_mm_hadd_epi32(p0, p1), _mm_hadd_epi32(p2, p3));
+         _mm_storeu_si128((__m128i *)dst, v);
+         src += 16;
+         dst += 16;
+      }
+
+      for (; x < width; x++) {
+         __m128i p = PACK_PIXEL(_mm_loadu_ps(src));
+         p = _mm_hadd_epi32(p, p);
+         p = _mm_hadd_epi32(p, p);
+         int32_t pixel = _mm_cvtsi128_si32(p);
+         memcpy(dst, &pixel, 4);
+         src += 4;
+         dst += 4;
+      }
+#undef PACK_PIXEL
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+/*
+ * Floating point
+ */
+
+/* Eight halfs to floats, as _mesa_half_to_float_slow(). */
+static inline void
+half8_to_float(__m128i h, __m128 *lo, __m128 *hi)
+{
+   const __m128 magic = _mm_castsi128_ps(_mm_set1_epi32(0xef << 23));
+   const __m128 infnan = _mm_set1_ps(65536.0f);
+   __m128i v[2] = { _mm_cvtepu16_epi32(h), _mm_unpackhi_epi16(h, _mm_setzero_si128()) };
+   __m128 f[2];
+
+   for (unsigned i = 0; i < 2; i++) {
+      __m128i sign = _mm_slli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0x8000)), 16);
+      __m128 mag = _mm_castsi128_ps(
+         _mm_slli_epi32(_mm_and_si128(v[i], _mm_set1_epi32(0x7fff)), 13));
+
+      mag = _mm_mul_ps(mag, magic);
+      mag = _mm_or_ps(mag, _mm_and_ps(_mm_cmpge_ps(mag, infnan),
+                                      _mm_castsi128_ps(_mm_set1_epi32(0xff << 23))));
+      f[i] = _mm_or_ps(mag, _mm_castsi128_ps(sign));
+   }
+
+   *lo = f[0];
+   *hi = f[1];
+}
+
+static void
+util_format_r16g16b16a16_float_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src,
+                                                       unsigned width)
+{
+   float *dst = dst_row;
+   __m128 lo, hi;
+
+   for (; width >= 2; width -= 2) {
+      half8_to_float(_mm_loadu_si128((const __m128i *)src), &lo, &hi);
+      _mm_storeu_ps(dst, lo);
+      _mm_storeu_ps(dst + 4, hi);
+      src += 16;
+      dst += 8;
+   }
+
+   if (width) {
+      half8_to_float(_mm_loadl_epi64((const __m128i *)src), &lo, &hi);
+      _mm_storeu_ps(dst, lo);
+   }
+}
+
+/* The unsigned 11 and 10-bit floats of R11G11B10_FLOAT, as uf11_to_f32()
+ * and uf10_to_f32().
+ */
+static inline __m128
+ufloat_to_float(__m128i v, unsigned mantissa_bits)
+{
+   const __m128i mantissa_mask = _mm_set1_epi32((1 << mantissa_bits) - 1);
+   __m128i exponent = _mm_srli_epi32(v, mantissa_bits);
+   __m128i mantissa = _mm_and_si128(v, mantissa_mask);
+
+   /* Normal numbers only need their exponent rebiased */
+   __m128i normal = _mm_or_si128(_mm_slli_epi32(_mm_add_epi32(exponent, _mm_set1_epi32(112)), 23),
+                                 _mm_slli_epi32(mantissa, 23 - mantissa_bits));
+
+   /* Denormals are mantissa * 2^(-14 - mantissa_bits) */
+   __m128 denormal = _mm_mul_ps(_mm_cvtepi32_ps(mantissa),
+                                _mm_set1_ps(1.0f / (1 << (14 + mantissa_bits))));
+
+   /* Inf and NaN keep the mantissa in the low bits */
+   __m128i infnan = _mm_or_si128(_mm_set1_epi32(0x7f800000), mantissa);
+
+   __m128i is_denormal = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+   __m128i is_infnan = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(31));
+
+   __m128i result = _mm_blendv_epi8(normal, _mm_castps_si128(denormal), is_denormal);
+   return _mm_castsi128_ps(_mm_blendv_epi8(result, infnan, is_infnan));
+}
+
+static void
+util_format_r11g11b10_float_unpack_rgba_float_sse41(void *restrict dst_row, const uint8_t *restrict src,
+                                                    unsigned width)
+{
+   float *dst = dst_row;
+
+   for (; width >= 4; width -= 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)src);
+      __m128 r = ufloat_to_float(_mm_and_si128(v, _mm_set1_epi32(0x7ff)), 6);
+      __m128 g = ufloat_to_float(_mm_and_si128(_mm_srli_epi32(v, 11), _mm_set1_epi32(0x7ff)), 6);
+      __m128 b = ufloat_to_float(_mm_srli_epi32(v, 22), 5);
+      __m128 a = _mm_set1_ps(1.0f);
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+      _mm_storeu_ps(dst + 0, r);
+      _mm_storeu_ps(dst + 4, g);
+      _mm_storeu_ps(dst + 8, b);
+      _mm_storeu_ps(dst + 12, a);
+      src += 16;
+      dst += 16;
+   }
+   if (width)
+      util_format_r11g11b10_float_unpack_rgba_float(dst, src, width);
+}
+
+/*
+ * Depth and stencil
+ */
+
+static void
+util_format_z16_unorm_unpack_z_float_sse41(float *restrict dst_row, unsigned dst_stride,
+                                           const uint8_t *restrict src_row, unsigned src_stride,
+                                           unsigned width, unsigned height)
+{
+   const __m128 scale = _mm_set1_ps((float)(1.0 / 0xffff));
+
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      float *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i z = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *)src));
+         _mm_storeu_ps(dst, _mm_mul_ps(_mm_cvtepi32_ps(z), scale));
+         src += 8;
+         dst += 4;
+      }
+      if (x < width)
+         util_format_z16_unorm_unpack_z_float(dst, 0, src, 0, width - x, 1);
+
+      src_row += src_stride;
+      dst_row += dst_stride / sizeof(*dst_row);
+   }
+}
+
+/* Z24 in the low bits of 32-bit words, as in Z24_UNORM_S8_UINT and
+ * Z24X8_UNORM. The scalar code converts through doubles, so does this.
+ */
+static inline void
+unpack_z24_z_float(float *restrict dst_row, unsigned dst_stride,
+                   const uint8_t *restrict src_row, unsigned src_stride,
+                   unsigned width, unsigned height)
+{
+   const __m128d scale = _mm_set1_pd(1.0 / 0xffffff);
+
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      float *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i z = _mm_and_si128(_mm_loadu_si128((const __m128i *)src),
+                                   _mm_set1_epi32(0xffffff));
+         __m128 lo = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(z), scale));
+         __m128 hi = _mm_cvtpd_ps(_mm_mul_pd(_mm_cvtepi32_pd(_mm_unpackhi_epi64(z, z)), scale));
+         _mm_storeu_ps(dst, _mm_movelh_ps(lo, hi));
+         src += 16;
+         dst += 4;
+      }
+      for (; x < width; x++) {
+         uint32_t z;
+         memcpy(&z, src, 4);
+         *dst++ = (float)((z & 0xffffff) * (1.0 / 0xffffff));
+         src += 4;
+      }
+
+      src_row += src_stride;
+      dst_row += dst_stride / sizeof(*dst_row);
+   }
+}
+
+static inline void
+unpack_z24_z_32unorm(uint32_t *restrict dst_row, unsigned dst_stride,
+                     const uint8_t *restrict src_row, unsigned src_stride,
+                     unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      uint32_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i z = _mm_and_si128(_mm_loadu_si128((const __m128i *)src),
+                                   _mm_set1_epi32(0xffffff));
+         z = _mm_or_si128(_mm_slli_epi32(z, 8), _mm_srli_epi32(z, 16));
+         _mm_storeu_si128((__m128i *)dst, z);
+         src += 16;
+         dst += 4;
+      }
+      for (; x < width; x++) {
+         uint32_t z;
+         memcpy(&z, src, 4);
+         z &= 0xffffff;
+         *dst++ = (z << 8) | (z >> 16);
+         src += 4;
+      }
+
+      src_row += src_stride;
+      dst_row += dst_stride / sizeof(*dst_row);
+   }
+}
+
+/* Replaces Z24 and keeps the top 8 bits of the destination. */
+static inline void
+pack_z24_z_32unorm(uint8_t *restrict dst_row, unsigned dst_stride,
+                   const uint32_t *restrict src_row, unsigned src_stride,
+                   unsigned width, unsigned height)
+{
+   for (unsigned y = 0; y < height; y++) {
+      const uint32_t *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i z = _mm_srli_epi32(_mm_loadu_si128((const __m128i *)src), 8);
+         __m128i d = _mm_loadu_si128((const __m128i *)dst);
+         d = _mm_and_si128(d, _mm_set1_epi32(0xff000000));
+         _mm_storeu_si128((__m128i *)dst, _mm_or_si128(z, d));
+         src += 4;
+         dst += 16;
+      }
+      for (; x < width; x++) {
+         uint32_t value;
+         memcpy(&value, dst, 4);
+         value = (value & 0xff000000) | (*src++ >> 8);
+         memcpy(dst, &value, 4);
+         dst += 4;
+      }
+
+      dst_row += dst_stride;
+      src_row += src_stride / sizeof(*src_row);
+   }
+}
+
+static void
+util_format_z24_unorm_s8_uint_unpack_z_float_sse41(float *restrict dst_row, unsigned dst_stride,
+                                                   const uint8_t *restrict src_row, unsigned src_stride,
+                                                   unsigned width, unsigned height)
+{
+   unpack_z24_z_float(dst_row, dst_stride, src_row, src_stride, width, height);
+}
+
+static void
+util_format_z24_unorm_s8_uint_unpack_z_32unorm_sse41(uint32_t *restrict dst_row, unsigned dst_stride,
+                                                     const uint8_t *restrict src_row, unsigned src_stride,
+                                                     unsigned width, unsigned height)
+{
+   unpack_z24_z_32unorm(dst_row, dst_stride, src_row, src_stride, width, height);
+}
+
+static void
+util_format_z24_unorm_s8_uint_pack_z_32unorm_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                   const uint32_t *restrict src_row, unsigned src_stride,
+                                                   unsigned width, unsigned height)
+{
+   pack_z24_z_32unorm(dst_row, dst_stride, src_row, src_stride, width, height);
+}
+
+static void
+util_format_z24_unorm_s8_uint_unpack_s_8uint_sse41(uint8_t *restrict dst_row, unsigned dst_stride,
+                                                   const uint8_t *restrict src_row, unsigned src_stride,
+                                                   unsigned width, unsigned height)
+{
+   const __m128i top_bytes = _mm_setr_epi8(3, 7, 11, 15, -1, -1, -1, -1,
+                                           -1, -1, -1, -1, -1, -1, -1, -1);
+
+   for (unsigned y = 0; y < height; y++) {
+      const uint8_t *src = src_row;
+      uint8_t *dst = dst_row;
+      unsigned x = 0;
+
+      for (; x + 4 <= width; x += 4) {
+         __m128i s = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)src), top_bytes);
+         int32_t stencil = _mm_cvtsi128_si32(s);
+         memcpy(dst, &stencil, 4);
+         src += 16;
+         dst += 4;
+      }
+      for (; x < width; x++) {
+         *dst++ = src[3];
+         src += 4;
+      }
+
+      src_row += src_stride;
+      dst_row += dst_stride;
+   }
+}
+
+static void
+util_format_z24x8_unorm_unpack_z_float_sse41(float *restrict dst_row, unsigned dst_stride,
+                                             const uint8_t *restrict src_row, unsigned src_stride,
+                                             unsigned width, unsigned height)
+{
+   unpack_z24_z_float(dst_row, dst_stride, src_row, src_stride, width, height);
+}
+
+static void
+util_format_z24x8_unorm_unpack_z_32unorm_sse41(uint32_t *restrict dst_row, unsigned dst_stride,
+                                               const uint8_t *restrict src_row, unsigned src_stride,
+                                               unsigned width, unsigned height)
+{
+   unpack_z24_z_32unorm(dst_row, dst_stride, src_row, src_stride, width, height);
+}
+
+static const struct util_format_unpack_description util_format_unpack_descriptions_sse41[] = {
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r8g8b8a8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r8g8b8a8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b8g8r8a8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b8g8r8a8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R8G8B8X8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r8g8b8x8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r8g8b8x8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8X8_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b8g8r8x8_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b8g8r8x8_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r10g10b10a2_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r16g16b16a16_float_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r16g16b16a16_float_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R11G11B10_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r11g11b10_float_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r11g11b10_float_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_Z16_UNORM] = {
+      .unpack_z_32unorm = &util_format_z16_unorm_unpack_z_32unorm,
+      .unpack_z_float = &util_format_z16_unorm_unpack_z_float_sse41,
+   },
+   [PIPE_FORMAT_Z24_UNORM_S8_UINT] = {
+      .unpack_z_32unorm = &util_format_z24_unorm_s8_uint_unpack_z_32unorm_sse41,
+      .unpack_z_float = &util_format_z24_unorm_s8_uint_unpack_z_float_sse41,
+      .unpack_s_8uint = &util_format_z24_unorm_s8_uint_unpack_s_8uint_sse41,
+   },
+   [PIPE_FORMAT_Z24X8_UNORM] = {
+      .unpack_z_32unorm = &util_format_z24x8_unorm_unpack_z_32unorm_sse41,
+      .unpack_z_float = &util_format_z24x8_unorm_unpack_z_float_sse41,
+   },
+};
+
+static const struct util_format_pack_description util_format_pack_descriptions_sse41[] = {
+   [PIPE_FORMAT_R8G8B8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r8g8b8a8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_r8g8b8a8_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B8G8R8A8_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b8g8r8a8_unorm_pack_rgba_8unorm_sse41,
+      .pack_rgba_float = &util_format_b8g8r8a8_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r10g10b10a2_unorm_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r10g10b10a2_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_Z24_UNORM_S8_UINT] = {
+      .pack_z_32unorm = &util_format_z24_unorm_s8_uint_pack_z_32unorm_sse41,
+      .pack_z_float = &util_format_z24_unorm_s8_uint_pack_z_float,
+      .pack_s_8uint = &util_format_z24_unorm_s8_uint_pack_s_8uint,
+   },
+};
+
+const struct util_format_unpack_description *
+util_format_unpack_description_sse41(enum pipe_format format)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      return NULL;
+
+   if (format >= ARRAY_SIZE(util_format_unpack_descriptions_sse41))
+      return NULL;
+
+   const struct util_format_unpack_description *unpack =
+      &util_format_unpack_descriptions_sse41[format];
+   if (!unpack->unpack_rgba && !unpack->unpack_z_float)
+      return NULL;
+
+   return unpack;
+}
+
+const struct util_format_pack_description *
+util_format_pack_description_sse41(enum pipe_format format)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      return NULL;
+
+   if (format >= ARRAY_SIZE(util_format_pack_descriptions_sse41))
+      return NULL;
+
+   const struct util_format_pack_description *pack =
+      &util_format_pack_descriptions_sse41[format];
+   if (!pack->pack_rgba_float && !pack->pack_z_32unorm)
+      return NULL;
+
+   return pack;
+}
+
+#endif /* USE_SSE41 */
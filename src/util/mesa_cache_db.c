@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "crc32.h"
@@ -23,6 +25,7 @@
 #include "hash_table.h"
 #include "mesa-sha1.h"
 #include "mesa_cache_db.h"
+#include "os_misc.h"
 #include "os_time.h"
 #include "ralloc.h"
 #include "u_debug.h"
@@ -31,6 +34,11 @@
 #define MESA_CACHE_DB_VERSION          1
 #define MESA_CACHE_DB_MAGIC            "MESA_DB"
 
+/* Number of cache hits after which the read path tries to write back the
+ * batched LRU access times to the index file.
+ */
+#define MESA_CACHE_DB_ACCESS_FLUSH_BATCH 64
+
 struct PACKED mesa_db_file_header {
    char magic[8];
    uint32_t version;
@@ -56,6 +64,7 @@ struct mesa_index_db_hash_entry {
    uint64_t last_access_time;
    uint32_t size;
    bool evicted;
+   bool access_pending;
 };
 
 static inline bool mesa_db_seek_end(FILE *file)
@@ -109,7 +118,7 @@ mesa_db_flock(FILE *file, int op)
 }
 
 static bool
-mesa_db_lock(struct mesa_cache_db *db)
+mesa_db_lock_op(struct mesa_cache_db *db, int op)
 {
    simple_mtx_lock(&db->flock_mtx);
 
@@ -117,10 +126,10 @@ mesa_db_lock(struct mesa_cache_db *db)
        !mesa_db_reopen_file(&db->cache))
       goto close_files;
 
-   if (mesa_db_flock(db->cache.file, LOCK_EX) < 0)
+   if (mesa_db_flock(db->cache.file, op) < 0)
       goto close_files;
 
-   if (mesa_db_flock(db->index.file, LOCK_EX) < 0)
+   if (mesa_db_flock(db->index.file, op) < 0)
       goto unlock_cache;
 
    return true;
@@ -136,6 +145,21 @@ close_files:
    return false;
 }
 
+static bool
+mesa_db_lock(struct mesa_cache_db *db)
+{
+   return mesa_db_lock_op(db, LOCK_EX);
+}
+
+/* Shared lock only allows reading the files, multiple processes may
+ * hold it simultaneously.
+ */
+static bool
+mesa_db_lock_shared(struct mesa_cache_db *db)
+{
+   return mesa_db_lock_op(db, LOCK_SH);
+}
+
 static void
 mesa_db_unlock(struct mesa_cache_db *db)
 {
@@ -270,7 +294,7 @@ mesa_db_index_entry_valid(struct mesa_index_db_file_entry *entry)
 }
 
 static bool
-mesa_db_cache_entry_valid(struct mesa_cache_db_file_entry *entry)
+mesa_db_cache_entry_valid(const struct mesa_cache_db_file_entry *entry)
 {
    return entry->size && entry->crc;
 }
@@ -318,6 +342,7 @@ mesa_db_update_index(struct mesa_cache_db *db)
       hash_entry->index_db_file_offset = db->index.offset;
       hash_entry->last_access_time = index_entry->last_access_time;
       hash_entry->size = index_entry->size;
+      hash_entry->access_pending = false;
 
       _mesa_hash_table_u64_insert(db->index_db, index_entry->hash, hash_entry);
 
@@ -336,6 +361,12 @@ error:
 static void
 mesa_db_hash_table_reset(struct mesa_cache_db *db)
 {
+   /* Pending access times refer to the freed hash entries and to the
+    * stale index file offsets, drop them.
+    */
+   util_dynarray_clear(&db->pending_access);
+   db->num_pending_accesses = 0;
+
    _mesa_hash_table_u64_clear(db->index_db);
    ralloc_free(db->mem_ctx);
    db->mem_ctx = ralloc_context(NULL);
@@ -490,6 +521,100 @@ mesa_db_remove_file(struct mesa_cache_db_file *db_file,
    return true;
 }
 
+static void
+mesa_db_mark_accessed(struct mesa_cache_db *db,
+                      struct mesa_index_db_hash_entry *hash_entry)
+{
+   hash_entry->last_access_time = os_time_get_nano();
+
+   if (!hash_entry->access_pending) {
+      hash_entry->access_pending = true;
+      util_dynarray_append(&db->pending_access,
+                           struct mesa_index_db_hash_entry *, hash_entry);
+   }
+
+   db->num_pending_accesses++;
+}
+
+static void
+mesa_db_drop_access_times(struct mesa_cache_db *db)
+{
+   util_dynarray_foreach(&db->pending_access,
+                         struct mesa_index_db_hash_entry *, hash_entry)
+      (*hash_entry)->access_pending = false;
+
+   util_dynarray_clear(&db->pending_access);
+   db->num_pending_accesses = 0;
+}
+
+/* Write back the batched last access times to the index file.
+ *
+ * Must be called with the exclusive lock held and with the up to date UUID.
+ */
+static bool
+mesa_db_flush_access_times(struct mesa_cache_db *db)
+{
+   struct mesa_index_db_file_entry index_entry;
+   bool success = true;
+
+   if (!util_dynarray_num_elements(&db->pending_access,
+                                   struct mesa_index_db_hash_entry *))
+      return true;
+
+   util_dynarray_foreach(&db->pending_access,
+                         struct mesa_index_db_hash_entry *, entry) {
+      struct mesa_index_db_hash_entry *hash_entry = *entry;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_read(db->index.file, &index_entry) ||
+          !mesa_db_index_entry_valid(&index_entry) ||
+          index_entry.cache_db_file_offset != hash_entry->cache_db_file_offset ||
+          index_entry.size != hash_entry->size) {
+         success = false;
+         break;
+      }
+
+      index_entry.last_access_time = hash_entry->last_access_time;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
+          !mesa_db_write(db->index.file, &index_entry)) {
+         success = false;
+         break;
+      }
+   }
+
+   fflush(db->index.file);
+
+   mesa_db_drop_access_times(db);
+
+   return success;
+}
+
+/* Opportunistically write back the batched access times from the read
+ * path. The held shared lock is converted to the exclusive lock without
+ * blocking, if other process holds the lock, then we will try again on
+ * the next read.
+ */
+static void
+mesa_db_try_flush_access_times(struct mesa_cache_db *db)
+{
+   if (db->num_pending_accesses < MESA_CACHE_DB_ACCESS_FLUSH_BATCH)
+      return;
+
+   if (mesa_db_flock(db->cache.file, LOCK_EX | LOCK_NB) < 0 ||
+       mesa_db_flock(db->index.file, LOCK_EX | LOCK_NB) < 0)
+      return;
+
+   /* Lock conversion isn't atomic, DB could be changed meanwhile */
+   if (mesa_db_uuid_changed(db)) {
+      mesa_db_drop_access_times(db);
+      return;
+   }
+
+   if (!mesa_db_flush_access_times(db))
+      mesa_db_zap(db);
+}
+
 static int
 entry_sort_lru(const void *_a, const void *_b, void *arg)
 {
@@ -539,7 +664,8 @@ mesa_db_compact(struct mesa_cache_db *db, int64_t blob_size,
    unsigned int i = 0;
 
    /* reload index to sync the last access times */
-   if (!remove_entry && !mesa_db_reload(db))
+   if (!remove_entry &&
+       (!mesa_db_flush_access_times(db) || !mesa_db_reload(db)))
       return false;
 
    num_entries = _mesa_hash_table_num_entries(db->index_db->table);
@@ -696,6 +822,7 @@ mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
       goto close_index;
 
    simple_mtx_init(&db->flock_mtx, mtx_plain);
+   util_dynarray_init(&db->pending_access, NULL);
 
    db->index_db = _mesa_hash_table_u64_create(NULL);
    if (!db->index_db)
@@ -709,6 +836,7 @@ mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
 destroy_hash:
    _mesa_hash_table_u64_destroy(db->index_db);
 destroy_mtx:
+   util_dynarray_fini(&db->pending_access);
    simple_mtx_destroy(&db->flock_mtx);
 
    ralloc_free(db->mem_ctx);
@@ -739,6 +867,15 @@ mesa_db_wipe_path(const char *cache_path)
 void
 mesa_cache_db_close(struct mesa_cache_db *db)
 {
+   /* Write back the access times batched by the read path */
+   if (db->alive && db->num_pending_accesses && mesa_db_lock(db)) {
+      if (!mesa_db_uuid_changed(db) && !mesa_db_flush_access_times(db))
+         mesa_db_zap(db);
+
+      mesa_db_unlock(db);
+   }
+
+   util_dynarray_fini(&db->pending_access);
    _mesa_hash_table_u64_destroy(db->index_db);
    simple_mtx_destroy(&db->flock_mtx);
    ralloc_free(db->mem_ctx);
@@ -760,17 +897,195 @@ mesa_cache_db_file_entry_size(void)
    return sizeof(struct mesa_cache_db_file_entry);
 }
 
+enum mesa_db_read_result {
+   MESA_DB_READ_HIT,
+   MESA_DB_READ_MISS,
+   MESA_DB_READ_CORRUPTED,
+};
+
+/* Cache file entry of the read path, either the pages of the file holding
+ * it mapped or, if that isn't possible, a copy read from the file.
+ */
+struct mesa_db_entry_view {
+   const struct mesa_cache_db_file_entry *entry;
+   void *map;
+   size_t map_size;
+   void *copy;
+};
+
+static void
+mesa_db_release_entry(struct mesa_db_entry_view *view)
+{
+   if (view->map)
+      munmap(view->map, view->map_size);
+
+   free(view->copy);
+}
+
+static enum mesa_db_read_result
+mesa_db_copy_cache_entry(struct mesa_cache_db *db, uint64_t offset,
+                         uint64_t size, struct mesa_db_entry_view *view)
+{
+   ssize_t ret;
+
+   view->copy = malloc(size);
+   if (!view->copy)
+      return MESA_DB_READ_MISS;
+
+   ret = pread(fileno(db->cache.file), view->copy, size, offset);
+   if (ret < 0)
+      return MESA_DB_READ_MISS;
+
+   if ((uint64_t)ret != size)
+      return MESA_DB_READ_CORRUPTED;
+
+   view->entry = view->copy;
+
+   return MESA_DB_READ_HIT;
+}
+
+/* Maps the pages of the cache file holding the entry. Failing to map it,
+ * e.g. for lack of memory or address space, isn't a sign of corruption,
+ * read the entry instead.
+ *
+ * Must be called with the file lock held and after validating the DB UUID,
+ * the file can't shrink under the lock without changing the UUID.
+ */
+static enum mesa_db_read_result
+mesa_db_get_cache_entry(struct mesa_cache_db *db, uint64_t offset,
+                        uint64_t size, struct mesa_db_entry_view *view)
+{
+   uint64_t page_size, map_offset;
+   struct stat st;
+   void *map;
+
+   memset(view, 0, sizeof(*view));
+
+   if (fstat(fileno(db->cache.file), &st) < 0 || !os_get_page_size(&page_size))
+      return mesa_db_copy_cache_entry(db, offset, size, view);
+
+   if (offset + size > (uint64_t)st.st_size)
+      return MESA_DB_READ_CORRUPTED;
+
+   map_offset = offset & ~(page_size - 1);
+
+   map = mmap(NULL, offset + size - map_offset, PROT_READ, MAP_SHARED,
+              fileno(db->cache.file), map_offset);
+   if (map == MAP_FAILED)
+      return mesa_db_copy_cache_entry(db, offset, size, view);
+
+   view->map = map;
+   view->map_size = offset + size - map_offset;
+   view->entry = (const void *)((const uint8_t *)map + offset - map_offset);
+
+   return MESA_DB_READ_HIT;
+}
+
+/* Looks up cache entry in the cache file. The caller must hold the file
+ * lock and ensure that in-memory index is up to date.
+ */
+static enum mesa_db_read_result
+mesa_db_read_entry_mapped(struct mesa_cache_db *db,
+                          const uint8_t *cache_key_160bit,
+                          void **data, size_t *size)
+{
+   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
+   const struct mesa_cache_db_file_entry *cache_entry;
+   struct mesa_index_db_hash_entry *hash_entry;
+   struct mesa_db_entry_view view;
+   enum mesa_db_read_result result;
+   const void *blob;
+
+   hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
+   if (!hash_entry)
+      return MESA_DB_READ_MISS;
+
+   result = mesa_db_get_cache_entry(db, hash_entry->cache_db_file_offset,
+                                    blob_file_size(hash_entry->size), &view);
+   if (result != MESA_DB_READ_HIT)
+      goto out;
+
+   cache_entry = view.entry;
+
+   if (!mesa_db_cache_entry_valid(cache_entry) ||
+       cache_entry->size != hash_entry->size) {
+      result = MESA_DB_READ_CORRUPTED;
+      goto out;
+   }
+
+   if (memcmp(cache_entry->key, cache_key_160bit, sizeof(cache_entry->key))) {
+      result = MESA_DB_READ_MISS;
+      goto out;
+   }
+
+   blob = cache_entry + 1;
+
+   if (util_hash_crc32(blob, cache_entry->size) != cache_entry->crc) {
+      result = MESA_DB_READ_CORRUPTED;
+      goto out;
+   }
+
+   /* The entry is unmapped below, return a copy */
+   *data = malloc(cache_entry->size);
+   if (!*data) {
+      result = MESA_DB_READ_MISS;
+      goto out;
+   }
+
+   memcpy(*data, blob, cache_entry->size);
+   *size = cache_entry->size;
+
+   mesa_db_mark_accessed(db, hash_entry);
+
+out:
+   mesa_db_release_entry(&view);
+
+   return result;
+}
+
+/* Fast path of the read that takes the shared lock, allowing multiple
+ * processes to read the DB concurrently. Returns false if DB needs to be
+ * reloaded or repaired, which requires the exclusive lock.
+ */
+static bool
+mesa_db_read_entry_shared(struct mesa_cache_db *db,
+                          const uint8_t *cache_key_160bit,
+                          void **data, size_t *size)
+{
+   enum mesa_db_read_result result;
+
+   if (!mesa_db_lock_shared(db))
+      return false;
+
+   if (!db->alive) {
+      mesa_db_unlock(db);
+      return true;
+   }
+
+   if (mesa_db_uuid_changed(db) || !mesa_db_update_index(db)) {
+      mesa_db_unlock(db);
+      return false;
+   }
+
+   result = mesa_db_read_entry_mapped(db, cache_key_160bit, data, size);
+   if (result == MESA_DB_READ_HIT)
+      mesa_db_try_flush_access_times(db);
+
+   mesa_db_unlock(db);
+
+   return result != MESA_DB_READ_CORRUPTED;
+}
+
 void *
 mesa_cache_db_read_entry(struct mesa_cache_db *db,
                          const uint8_t *cache_key_160bit,
                          size_t *size)
 {
-   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
-   struct mesa_cache_db_file_entry cache_entry;
-   struct mesa_index_db_file_entry index_entry;
-   struct mesa_index_db_hash_entry *hash_entry;
    void *data = NULL;
 
+   if (mesa_db_read_entry_shared(db, cache_key_160bit, &data, size))
+      return data;
+
    if (!mesa_db_lock(db))
       return NULL;
 
@@ -783,46 +1098,20 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    if (!mesa_db_update_index(db))
       goto fail_fatal;
 
-   hash_entry = _mesa_hash_table_u64_search(db->index_db, hash);
-   if (!hash_entry)
+   switch (mesa_db_read_entry_mapped(db, cache_key_160bit, &data, size)) {
+   case MESA_DB_READ_HIT:
+      break;
+   case MESA_DB_READ_MISS:
       goto fail;
-
-   if (!mesa_db_seek(db->cache.file, hash_entry->cache_db_file_offset) ||
-       !mesa_db_read(db->cache.file, &cache_entry) ||
-       !mesa_db_cache_entry_valid(&cache_entry))
-      goto fail_fatal;
-
-   if (memcmp(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key)))
-      goto fail;
-
-   data = malloc(cache_entry.size);
-   if (!data)
-      goto fail;
-
-   if (!mesa_db_read_data(db->cache.file, data, cache_entry.size) ||
-       util_hash_crc32(data, cache_entry.size) != cache_entry.crc)
+   case MESA_DB_READ_CORRUPTED:
       goto fail_fatal;
+   }
 
-   if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
-       !mesa_db_read(db->index.file, &index_entry) ||
-       !mesa_db_index_entry_valid(&index_entry) ||
-       index_entry.cache_db_file_offset != hash_entry->cache_db_file_offset ||
-       index_entry.size != hash_entry->size)
+   if (!mesa_db_flush_access_times(db))
       goto fail_fatal;
 
-   index_entry.last_access_time = os_time_get_nano();
-   hash_entry->last_access_time = index_entry.last_access_time;
-
-   if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset) ||
-       !mesa_db_write(db->index.file, &index_entry))
-      goto fail_fatal;
-
-   fflush(db->index.file);
-
    mesa_db_unlock(db);
 
-   *size = cache_entry.size;
-
    return data;
 
 fail_fatal:
@@ -867,6 +1156,9 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
       goto fail_fatal;
 
+   if (!mesa_db_flush_access_times(db))
+      goto fail_fatal;
+
    if (!mesa_db_seek_end(db->cache.file))
       goto fail_fatal;
 
@@ -906,6 +1198,7 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    hash_entry->index_db_file_offset = ftell(db->index.file);
    hash_entry->last_access_time = index_entry.last_access_time;
    hash_entry->size = index_entry.size;
+   hash_entry->access_pending = false;
 
    if (!mesa_db_write(db->cache.file, &cache_entry) ||
        !mesa_db_write_data(db->cache.file, blob, blob_size) ||
@@ -951,6 +1244,9 @@ mesa_cache_db_entry_remove(struct mesa_cache_db *db,
    if (mesa_db_uuid_changed(db) && !mesa_db_reload(db))
       goto fail_fatal;
 
+   if (!mesa_db_flush_access_times(db))
+      goto fail_fatal;
+
    if (!mesa_db_update_index(db))
       goto fail_fatal;
 
@@ -1034,6 +1330,9 @@ mesa_cache_db_eviction_score(struct mesa_cache_db *db)
    if (!db->alive)
       goto fail;
 
+   if (!mesa_db_uuid_changed(db) && !mesa_db_flush_access_times(db))
+      goto fail_fatal;
+
    if (!mesa_db_reload(db))
       goto fail_fatal;
 
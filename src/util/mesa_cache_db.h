@@ -16,6 +16,7 @@
 
 #include "detect_os.h"
 #include "simple_mtx.h"
+#include "u_dynarray.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -37,6 +38,10 @@ struct mesa_cache_db {
    void *mem_ctx;
    uint64_t uuid;
    bool alive;
+
+   /* Index entries whose last_access_time wasn't written back yet */
+   struct util_dynarray pending_access;
+   unsigned num_pending_accesses;
 };
 
 #if DETECT_OS_WINDOWS == 0
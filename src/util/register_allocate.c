@@ -72,6 +72,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "blob.h"
 #include "ralloc.h"
@@ -487,39 +488,60 @@ ra_set_deserialize(void *mem_ctx, struct blob_reader *blob)
 }
 
 static uint64_t
-ra_get_num_adjacency_bits(uint64_t n)
+ra_get_num_adjacency_blocks(uint64_t node_alloc)
 {
-   return (n * (n - 1)) / 2;
+   uint64_t b = node_alloc / BITSET_WORDBITS;
+   return (b * (b + 1)) / 2;
 }
 
-static uint64_t
-ra_get_adjacency_bit_index(unsigned n1, unsigned n2)
+/**
+ * Returns the adjacency matrix row holding the bit for (n1, n2), or NULL if
+ * the block has never been touched and @alloc is false.  The bit within the
+ * row is BITSET_BIT(MIN2(n1, n2)).
+ */
+static BITSET_WORD *
+ra_get_adjacency_row(struct ra_graph *g, unsigned n1, unsigned n2, bool alloc)
 {
    assert(n1 != n2);
    unsigned k1 = MAX2(n1, n2);
    unsigned k2 = MIN2(n1, n2);
-   return ra_get_num_adjacency_bits(k1) + k2;
+   uint64_t b1 = k1 / BITSET_WORDBITS;
+   uint64_t b2 = k2 / BITSET_WORDBITS;
+   uint64_t index = (b1 * (b1 + 1)) / 2 + b2;
+
+   BITSET_WORD *block = g->adjacency_blocks[index];
+   if (!block) {
+      if (!alloc)
+         return NULL;
+
+      block = linear_zalloc_array(g->adjacency_lin_ctx, BITSET_WORD,
+                                  BITSET_WORDBITS);
+      g->adjacency_blocks[index] = block;
+   }
+
+   return &block[k1 % BITSET_WORDBITS];
 }
 
 static bool
 ra_test_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 {
-   uint64_t index = ra_get_adjacency_bit_index(n1, n2);
-   return BITSET_TEST(g->adjacency, index);
+   BITSET_WORD *row = ra_get_adjacency_row(g, n1, n2, false);
+   return row && (*row & BITSET_BIT(MIN2(n1, n2)));
 }
 
 static void
 ra_set_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 {
-   unsigned index = ra_get_adjacency_bit_index(n1, n2);
-   BITSET_SET(g->adjacency, index);
+   BITSET_WORD *row = ra_get_adjacency_row(g, n1, n2, true);
+   *row |= BITSET_BIT(MIN2(n1, n2));
 }
 
 static void
 ra_clear_adjacency_bit(struct ra_graph *g, unsigned n1, unsigned n2)
 {
-   unsigned index = ra_get_adjacency_bit_index(n1, n2);
-   BITSET_CLEAR(g->adjacency, index);
+   BITSET_WORD *row = ra_get_adjacency_row(g, n1, n2, false);
+   if (row)
+      *row &= ~BITSET_BIT(MIN2(n1, n2));
 }
 
 static void
@@ -572,9 +594,11 @@ ra_realloc_interference_graph(struct ra_graph *g, unsigned int alloc)
    alloc = align(alloc, BITSET_WORDBITS);
    g->nodes = rerzalloc(g, g->nodes, struct ra_node, g->alloc, alloc);
    g->nodes_extra = rerzalloc(g, g->nodes_extra, struct ra_node_extra, g->alloc, alloc);
-   g->adjacency = rerzalloc(g, g->adjacency, BITSET_WORD,
-                            BITSET_WORDS(ra_get_num_adjacency_bits(g->alloc)),
-                            BITSET_WORDS(ra_get_num_adjacency_bits(alloc)));
+
+   /* Growing only appends block rows, so existing blocks keep their index. */
+   g->adjacency_blocks = rerzalloc(g, g->adjacency_blocks, BITSET_WORD *,
+                                   ra_get_num_adjacency_blocks(g->alloc),
+                                   ra_get_num_adjacency_blocks(alloc));
 
    /* Initialize new nodes. */
    for (unsigned i = g->alloc; i < alloc; i++) {
@@ -610,6 +634,7 @@ ra_alloc_interference_graph(struct ra_regs *regs, unsigned int count)
    g = rzalloc(NULL, struct ra_graph);
    g->regs = regs;
    g->count = count;
+   g->adjacency_lin_ctx = linear_context(g);
    ra_realloc_interference_graph(g, count);
 
    return g;
@@ -620,7 +645,7 @@ ra_resize_interference_graph(struct ra_graph *g, unsigned int count)
 {
    g->count = count;
    if (count > g->alloc)
-      ra_realloc_interference_graph(g, g->alloc * 2);
+      ra_realloc_interference_graph(g, MAX2(count, g->alloc * 2));
 }
 
 void ra_set_select_reg_callback(struct ra_graph *g,
@@ -679,6 +704,188 @@ ra_reset_node_interference(struct ra_graph *g, unsigned int n)
    adj->size = 0;
 }
 
+void
+ra_remove_node_interference(struct ra_graph *g,
+                            unsigned int n1, unsigned int n2)
+{
+   assert(n1 < g->count && n2 < g->count);
+   if (n1 != n2 && ra_test_adjacency_bit(g, n1, n2)) {
+      ra_node_remove_adjacency(g, n1, n2);
+      ra_node_remove_adjacency(g, n2, n1);
+   }
+}
+
+bool
+ra_test_node_interference(struct ra_graph *g,
+                          unsigned int n1, unsigned int n2)
+{
+   assert(n1 < g->count && n2 < g->count);
+   return n1 != n2 && ra_test_adjacency_bit(g, n1, n2);
+}
+
+/**
+ * Returns the nodes interfering with @n.  The list is owned by the graph and
+ * is only valid until the next change to @n's interference.
+ */
+const unsigned int *
+ra_get_node_interference(struct ra_graph *g, unsigned int n,
+                         unsigned int *count)
+{
+   *count = g->nodes[n].adjacency.size;
+   return g->nodes[n].adjacency.elems;
+}
+
+/**
+ * Makes @dst interfere with everything @src interferes with.  This is meant
+ * for live range splitting after a spill, where the new node starts out
+ * covering (part of) the range of the old one and gets pruned afterwards
+ * with ra_remove_node_interference().
+ */
+void
+ra_copy_node_interference(struct ra_graph *g,
+                          unsigned int dst, unsigned int src)
+{
+   assert(dst < g->count && src < g->count);
+
+   /* Adding interference can grow the source list, so walk it by index. */
+   for (unsigned i = 0; i < g->nodes[src].adjacency.size; i++) {
+      unsigned int n = g->nodes[src].adjacency.elems[i];
+      if (n != dst)
+         ra_add_node_interference(g, dst, n);
+   }
+}
+
+/**
+ * Writes the nodes and interference of a graph so it can be replayed through
+ * ra_allocate() later, e.g. to benchmark the allocator on graphs recorded
+ * from real shaders.  The register set is not included; serialize it with
+ * ra_set_serialize().  Adjacency lists are stored in order so the replayed
+ * graph allocates exactly like the original.
+ */
+void
+ra_graph_serialize(const struct ra_graph *g, struct blob *blob)
+{
+   blob_write_uint32(blob, g->count);
+
+   for (unsigned n = 0; n < g->count; n++) {
+      const struct ra_list *adj = &g->nodes[n].adjacency;
+
+      blob_write_uint32(blob, g->nodes[n].class);
+      blob_write_uint32(blob, g->nodes_extra[n].forced_reg);
+      blob_write_bytes(blob, &g->nodes_extra[n].spill_cost,
+                       sizeof(g->nodes_extra[n].spill_cost));
+      blob_write_uint32(blob, adj->size);
+      blob_write_bytes(blob, adj->elems, adj->size * sizeof(*adj->elems));
+   }
+}
+
+/**
+ * Reads a graph written by ra_graph_serialize() for the register set @regs.
+ * Returns NULL if the data is truncated or doesn't describe a valid graph
+ * for @regs.
+ */
+struct ra_graph *
+ra_graph_deserialize(struct ra_regs *regs, struct blob_reader *blob)
+{
+   /* Class, forced register, spill cost and adjacency size of a node. */
+   const size_t min_node_size = 3 * sizeof(uint32_t) + sizeof(float);
+   unsigned int count = blob_read_uint32(blob);
+
+   if (blob->overrun ||
+       count > (size_t)(blob->end - blob->current) / min_node_size)
+      return NULL;
+
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+
+   for (unsigned n = 0; n < count; n++) {
+      struct ra_list *adj = &g->nodes[n].adjacency;
+
+      g->nodes[n].class = blob_read_uint32(blob);
+      g->nodes_extra[n].forced_reg = blob_read_uint32(blob);
+      blob_copy_bytes(blob, &g->nodes_extra[n].spill_cost,
+                      sizeof(g->nodes_extra[n].spill_cost));
+
+      /* A node can interfere with every other node at most once. */
+      unsigned int size = blob_read_uint32(blob);
+      if (blob->overrun || size >= count)
+         goto fail;
+
+      const unsigned int *elems =
+         blob_read_bytes(blob, (size_t)size * sizeof(*elems));
+      if (blob->overrun)
+         goto fail;
+
+      if (g->nodes[n].class >= regs->class_count ||
+          (g->nodes_extra[n].forced_reg != NO_REG &&
+           g->nodes_extra[n].forced_reg >= regs->count))
+         goto fail;
+
+      adj->cap = MAX2(64, size);
+      adj->elems = ralloc_array(g, unsigned int, adj->cap);
+      memcpy(adj->elems, elems, size * sizeof(*elems));
+      adj->size = size;
+   }
+
+   /* Every edge must be listed exactly once by each of its two nodes.  Set
+    * the bit of the edge when the higher node lists it and clear it again
+    * when the lower one does, duplicates and one-sided edges then show up
+    * as a bit in the wrong state or one left set.
+    */
+   unsigned int num_edges = 0;
+   for (unsigned n = 0; n < count; n++) {
+      const struct ra_list *adj = &g->nodes[n].adjacency;
+
+      for (unsigned i = 0; i < adj->size; i++) {
+         unsigned int n2 = adj->elems[i];
+         if (n2 >= count || n2 == n)
+            goto fail;
+
+         if (n2 < n) {
+            if (ra_test_adjacency_bit(g, n, n2))
+               goto fail;
+            ra_set_adjacency_bit(g, n, n2);
+            num_edges++;
+         }
+      }
+   }
+
+   for (unsigned n = 0; n < count; n++) {
+      const struct ra_list *adj = &g->nodes[n].adjacency;
+
+      for (unsigned i = 0; i < adj->size; i++) {
+         unsigned int n2 = adj->elems[i];
+         if (n2 > n) {
+            if (!ra_test_adjacency_bit(g, n, n2))
+               goto fail;
+            ra_clear_adjacency_bit(g, n, n2);
+            num_edges--;
+         }
+      }
+   }
+
+   if (num_edges)
+      goto fail;
+
+   /* Classes are only known once every node has been read. */
+   for (unsigned n = 0; n < count; n++) {
+      const struct ra_list *adj = &g->nodes[n].adjacency;
+      const unsigned int *q = regs->classes[g->nodes[n].class]->q;
+
+      for (unsigned i = 0; i < adj->size; i++) {
+         unsigned int n2 = adj->elems[i];
+         g->nodes[n].q_total += q[g->nodes[n2].class];
+         if (n2 < n)
+            ra_set_adjacency_bit(g, n, n2);
+      }
+   }
+
+   return g;
+
+fail:
+   ralloc_free(g);
+   return NULL;
+}
+
 static void
 update_pq_info(struct ra_graph *g, unsigned int n)
 {
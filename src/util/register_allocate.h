@@ -116,6 +116,19 @@ void ra_set_select_reg_callback(struct ra_graph *g,
 void ra_add_node_interference(struct ra_graph *g,
                               unsigned int n1, unsigned int n2);
 void ra_reset_node_interference(struct ra_graph *g, unsigned int n);
+void ra_remove_node_interference(struct ra_graph *g,
+                                 unsigned int n1, unsigned int n2);
+bool ra_test_node_interference(struct ra_graph *g,
+                               unsigned int n1, unsigned int n2);
+const unsigned int *ra_get_node_interference(struct ra_graph *g,
+                                             unsigned int n,
+                                             unsigned int *count);
+void ra_copy_node_interference(struct ra_graph *g,
+                               unsigned int dst, unsigned int src);
+
+void ra_graph_serialize(const struct ra_graph *g, struct blob *blob);
+struct ra_graph *ra_graph_deserialize(struct ra_regs *regs,
+                                      struct blob_reader *blob);
 /** @} */
 
 /** @{ Graph-coloring register allocation */
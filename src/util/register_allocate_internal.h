@@ -145,7 +145,16 @@ struct ra_graph {
    /* Less used per-node data.  Keep it out of the tight loops. */
    struct ra_node_extra *nodes_extra;
 
-   BITSET_WORD *adjacency;
+   /**
+    * Lower triangle of the adjacency matrix, cut into blocks of
+    * BITSET_WORDBITS x BITSET_WORDBITS nodes.  Block (b1, b2) with b1 >= b2
+    * lives at index b1 * (b1 + 1) / 2 + b2 and is only allocated once one
+    * of its bits gets set, so sparse graphs with many nodes don't pay for
+    * the full n^2 / 2 bits.  Each block holds one BITSET_WORD per row.
+    */
+   BITSET_WORD **adjacency_blocks;
+   struct linear_ctx *adjacency_lin_ctx;
+
    unsigned int count; /**< count of nodes. */
 
    unsigned int alloc; /**< count of nodes allocated. */
@@ -37,11 +37,13 @@
 #include <time.h>
 #include <unistd.h>
 #include <utime.h>
+#include <sys/resource.h>
 
 #include "util/detect_os.h"
 #include "util/mesa-sha1.h"
 #include "util/disk_cache.h"
 #include "util/disk_cache_os.h"
+#include "util/os_time.h"
 #include "util/ralloc.h"
 
 #ifdef FOZ_DB_UTIL_DYNAMIC_LIST
@@ -723,6 +725,74 @@ test_put_big_sized_entry_to_empty_cache(const char *driver_id)
 
    disk_cache_destroy(cache);
 }
+
+/* Overfill a multi-file cache while keeping one entry hot, the LRU index
+ * must evict strictly in access order. Also reports the put rate, which
+ * is dominated by eviction once the cache is full.
+ */
+static void
+test_multi_file_lru_eviction(const char *driver_id)
+{
+   const unsigned num_entries = 2048;
+   static uint8_t blob[1000];
+   cache_key *keys = (cache_key *) calloc(num_entries, sizeof(cache_key));
+   cache_key hot_key;
+   char *result;
+   size_t size;
+   unsigned i;
+
+   setenv("MESA_SHADER_CACHE_MAX_SIZE", "1M", 1);
+   struct disk_cache *cache = disk_cache_create("test", driver_id, 0);
+
+   EXPECT_NE(cache->lru_index_mmap, nullptr) << "LRU index created";
+
+   disk_cache_compute_key(cache, "hot", 3, hot_key);
+   disk_cache_put(cache, hot_key, blob, sizeof(blob), NULL);
+   disk_cache_wait_for_idle(cache);
+
+   int64_t start = os_time_get_nano();
+
+   for (i = 0; i < num_entries; i++) {
+      snprintf((char *) blob, sizeof(blob), "entry %u", i);
+      disk_cache_compute_key(cache, blob, sizeof(blob), keys[i]);
+      disk_cache_put(cache, keys[i], blob, sizeof(blob), NULL);
+
+      /* Keep the hot entry the most recently used one. */
+      if (i % 16 == 15) {
+         disk_cache_wait_for_idle(cache);
+
+         result = (char *) disk_cache_get(cache, hot_key, &size);
+         EXPECT_NE(result, nullptr) << "hot entry evicted after " << i << " puts";
+         free(result);
+      }
+   }
+   disk_cache_wait_for_idle(cache);
+
+   int64_t elapsed = os_time_get_nano() - start;
+   printf("multi-file cache: %.0f puts/s with eviction\n",
+          num_entries / (elapsed / 1e9));
+
+   EXPECT_LE(p_atomic_read(&cache->size->value), cache->max_size)
+      << "cache size within the limit";
+
+   /* Whatever survived must be the most recently put entries. */
+   unsigned first = num_entries;
+   for (i = 0; i < num_entries; i++) {
+      result = (char *) disk_cache_get(cache, keys[i], &size);
+      if (result) {
+         if (first == num_entries)
+            first = i;
+      } else {
+         EXPECT_EQ(first, num_entries) << "entry " << i << " evicted out of order";
+      }
+      free(result);
+   }
+   EXPECT_LT(first, num_entries - 1) << "recent entries present";
+   EXPECT_GT(first, 0u) << "old entries evicted";
+
+   free(keys);
+   disk_cache_destroy(cache);
+}
 #endif /* ENABLE_SHADER_CACHE */
 
 class Cache : public ::testing::Test {
@@ -772,6 +842,26 @@ run_tests:
 #endif
 }
 
+TEST_F(Cache, MultiFileLruEviction)
+{
+   const char *driver_id = "make_check_uncompressed";
+
+#ifndef ENABLE_SHADER_CACHE
+   GTEST_SKIP() << "ENABLE_SHADER_CACHE not defined.";
+#else
+   setenv("MESA_DISK_CACHE_MULTI_FILE", "true", 1);
+
+   test_disk_cache_create(mem_ctx, CACHE_DIR_NAME, driver_id);
+
+   test_multi_file_lru_eviction(driver_id);
+
+   setenv("MESA_DISK_CACHE_MULTI_FILE", "false", 1);
+
+   int err = rmrf_local(CACHE_TEST_TMP);
+   EXPECT_EQ(err, 0) << "Removing " CACHE_TEST_TMP " again";
+#endif
+}
+
 TEST_F(Cache, SingleFile)
 {
    const char *driver_id;
@@ -812,6 +902,64 @@ run_tests:
 #endif
 }
 
+#if DETECT_OS_LINUX
+/* Failing to map a cache entry, e.g. for a 32-bit process running short
+ * of address space, isn't a sign of a corrupted cache that needs to be
+ * dropped.
+ */
+static void
+test_get_without_address_space(const char *driver_id)
+{
+   const size_t blob_size = 4 * 1024 * 1024;
+   struct rlimit old_limit, limit;
+   unsigned long vm_pages;
+   uint8_t key[20];
+   char *result;
+   size_t size;
+
+   char *blob = (char *) malloc(blob_size);
+   for (size_t i = 0; i < blob_size; i++)
+      blob[i] = i * 7 + i / 4096;
+
+   struct disk_cache *cache = disk_cache_create("test", driver_id, 0);
+
+   disk_cache_compute_key(cache, blob, blob_size, key);
+   disk_cache_put(cache, key, blob, blob_size, NULL);
+   disk_cache_wait_for_idle(cache);
+
+   FILE *statm = fopen("/proc/self/statm", "r");
+   ASSERT_NE(statm, nullptr);
+   ASSERT_EQ(fscanf(statm, "%lu", &vm_pages), 1);
+   fclose(statm);
+
+   /* Leave less address space than the entry needs. */
+   ASSERT_EQ(getrlimit(RLIMIT_AS, &old_limit), 0);
+   limit = old_limit;
+   limit.rlim_cur = vm_pages * sysconf(_SC_PAGESIZE) + blob_size / 2;
+   ASSERT_EQ(setrlimit(RLIMIT_AS, &limit), 0);
+
+   result = (char *) disk_cache_get(cache, key, &size);
+
+   ASSERT_EQ(setrlimit(RLIMIT_AS, &old_limit), 0);
+
+   if (result) {
+      EXPECT_EQ(size, blob_size) << "disk_cache_get with existent item (size)";
+      EXPECT_EQ(memcmp(result, blob, blob_size), 0);
+      free(result);
+   }
+
+   result = (char *) disk_cache_get(cache, key, &size);
+   EXPECT_NE(result, nullptr) << "disk_cache_get with existent item (pointer)";
+   EXPECT_EQ(size, blob_size) << "disk_cache_get with existent item (size)";
+   if (result)
+      EXPECT_EQ(memcmp(result, blob, blob_size), 0);
+   free(result);
+
+   disk_cache_destroy(cache);
+   free(blob);
+}
+#endif
+
 TEST_F(Cache, Database)
 {
    const char *driver_id = "make_check_uncompressed";
@@ -847,6 +995,10 @@ TEST_F(Cache, Database)
 
    test_put_big_sized_entry_to_empty_cache(driver_id);
 
+#if DETECT_OS_LINUX
+   test_get_without_address_space(driver_id);
+#endif
+
    setenv("MESA_DISK_CACHE_DATABASE", "false", 1);
    unsetenv("MESA_DISK_CACHE_DATABASE_NUM_PARTS");
 
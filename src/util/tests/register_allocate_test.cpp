@@ -22,11 +22,13 @@
  */
 
 #include <gtest/gtest.h>
+#include <vector>
 #include "ralloc.h"
 #include "register_allocate.h"
 #include "register_allocate_internal.h"
 
 #include "util/blob.h"
+#include "util/os_time.h"
 
 class ra_test : public ::testing::Test {
 public:
@@ -279,3 +281,277 @@ TEST_F(ra_test, serialization_roundtrip)
    blob_finish(&blob);
 }
 
+
+/* Builds the interference graph of @count live ranges of @width nodes each,
+ * starting one node apart, so every node interferes with its 2 * (width - 1)
+ * neighbours.  That's the banded shape long straight-line shaders produce.
+ */
+static struct ra_graph *
+build_banded_graph(struct ra_regs *regs, struct ra_class *c,
+                   unsigned count, unsigned width)
+{
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+
+   for (unsigned n = 0; n < count; n++) {
+      ra_set_node_class(g, n, c);
+      ra_set_node_spill_cost(g, n, (float)(n % 7));
+      for (unsigned i = 1; i < width && n + i < count; i++)
+         ra_add_node_interference(g, n, n + i);
+   }
+
+   return g;
+}
+
+static void
+check_allocation(struct ra_graph *g, unsigned count)
+{
+   for (unsigned n = 0; n < count; n++) {
+      unsigned adj_count;
+      const unsigned *adj = ra_get_node_interference(g, n, &adj_count);
+
+      ASSERT_NE(ra_get_node_reg(g, n), NO_REG);
+      for (unsigned i = 0; i < adj_count; i++)
+         ASSERT_NE(ra_get_node_reg(g, n), ra_get_node_reg(g, adj[i]));
+   }
+}
+
+TEST_F(ra_test, incremental_interference)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, 8, true);
+   struct ra_class *c = ra_alloc_reg_class(regs);
+   for (unsigned i = 0; i < 8; i++)
+      ra_class_add_reg(c, i);
+   ra_set_finalize(regs, NULL);
+
+   /* Straddle several adjacency blocks, both within and across block rows. */
+   const unsigned count = 1000;
+   struct ra_graph *g = ra_alloc_interference_graph(regs, count);
+   for (unsigned n = 0; n < count; n++)
+      ra_set_node_class(g, n, c);
+
+   for (unsigned n = 0; n + 37 < count; n += 3)
+      ra_add_node_interference(g, n, n + 37);
+
+   for (unsigned n = 0; n < count; n++) {
+      for (unsigned m : { n + 1, n + 37, n + 38 }) {
+         if (m < count) {
+            EXPECT_EQ(ra_test_node_interference(g, n, m),
+                      m == n + 37 && n % 3 == 0);
+            EXPECT_EQ(ra_test_node_interference(g, m, n),
+                      ra_test_node_interference(g, n, m));
+         }
+      }
+   }
+
+   ra_remove_node_interference(g, 960, 997);
+   EXPECT_FALSE(ra_test_node_interference(g, 997, 960));
+
+   unsigned adj_count;
+   ra_get_node_interference(g, 997, &adj_count);
+   EXPECT_EQ(adj_count, 0);
+
+   /* Removing an edge that doesn't exist is a no-op. */
+   ra_remove_node_interference(g, 0, 1);
+   ra_get_node_interference(g, 0, &adj_count);
+   EXPECT_EQ(adj_count, 1);
+
+   /* Split node 3 after a "spill": the new node inherits its interference
+    * and then gets pruned back to the part of the range it covers.
+    */
+   unsigned split = ra_add_node(g, c);
+   ra_copy_node_interference(g, split, 3);
+   ra_add_node_interference(g, split, 3);
+   EXPECT_TRUE(ra_test_node_interference(g, split, 40));
+   EXPECT_TRUE(ra_test_node_interference(g, 3, split));
+
+   ra_remove_node_interference(g, split, 40);
+   ra_get_node_interference(g, split, &adj_count);
+   EXPECT_EQ(adj_count, 1);
+   ra_get_node_interference(g, 40, &adj_count);
+   EXPECT_EQ(adj_count, 1);
+
+   ra_reset_node_interference(g, 3);
+   EXPECT_FALSE(ra_test_node_interference(g, 3, 40));
+   EXPECT_FALSE(ra_test_node_interference(g, 3, split));
+
+   ASSERT_TRUE(ra_allocate(g));
+   check_allocation(g, count + 1);
+
+   ralloc_free(g);
+}
+
+TEST_F(ra_test, graph_serialization_roundtrip)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, 16, true);
+   struct ra_class *c = ra_alloc_reg_class(regs);
+   for (unsigned i = 0; i < 16; i++)
+      ra_class_add_reg(c, i);
+   ra_set_finalize(regs, NULL);
+
+   const unsigned count = 3000;
+   struct ra_graph *g = build_banded_graph(regs, c, count, 12);
+   ra_set_node_reg(g, 5, 3);
+
+   struct blob blob;
+   blob_init(&blob);
+   ra_graph_serialize(g, &blob);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   struct ra_graph *g2 = ra_graph_deserialize(regs, &reader);
+   ASSERT_NE(g2, nullptr);
+
+   ASSERT_TRUE(ra_allocate(g));
+   ASSERT_TRUE(ra_allocate(g2));
+   check_allocation(g2, count);
+
+   for (unsigned n = 0; n < count; n++)
+      ASSERT_EQ(ra_get_node_reg(g, n), ra_get_node_reg(g2, n));
+
+   /* Truncated input is rejected rather than read past the end. */
+   blob_reader_init(&reader, blob.data, blob.size / 2);
+   EXPECT_EQ(ra_graph_deserialize(regs, &reader), nullptr);
+
+   blob_finish(&blob);
+   ralloc_free(g2);
+   ralloc_free(g);
+}
+
+static void
+write_node(struct blob *blob, unsigned class_index, unsigned forced_reg,
+           const std::vector<unsigned> &adjacency)
+{
+   const float spill_cost = 0.0f;
+
+   blob_write_uint32(blob, class_index);
+   blob_write_uint32(blob, forced_reg);
+   blob_write_bytes(blob, &spill_cost, sizeof(spill_cost));
+   blob_write_uint32(blob, adjacency.size());
+   blob_write_bytes(blob, adjacency.data(),
+                    adjacency.size() * sizeof(unsigned));
+}
+
+static struct ra_graph *
+deserialize_graph(struct ra_regs *regs,
+                  const std::vector<std::vector<unsigned>> &adjacency,
+                  unsigned class_index = 0, unsigned forced_reg = NO_REG)
+{
+   struct blob blob;
+   blob_init(&blob);
+   blob_write_uint32(&blob, adjacency.size());
+   for (unsigned n = 0; n < adjacency.size(); n++)
+      write_node(&blob, n == 0 ? class_index : 0,
+                 n == 0 ? forced_reg : NO_REG, adjacency[n]);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, blob.data, blob.size);
+   struct ra_graph *g = ra_graph_deserialize(regs, &reader);
+   blob_finish(&blob);
+   return g;
+}
+
+TEST_F(ra_test, graph_deserialization_rejects_invalid)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, 4, true);
+   struct ra_class *c = ra_alloc_reg_class(regs);
+   for (unsigned i = 0; i < 4; i++)
+      ra_class_add_reg(c, i);
+   ra_set_finalize(regs, NULL);
+
+   struct ra_graph *g = deserialize_graph(regs, {{1, 2}, {0}, {0}});
+   ASSERT_NE(g, nullptr);
+   EXPECT_TRUE(ra_test_node_interference(g, 0, 2));
+   EXPECT_FALSE(ra_test_node_interference(g, 1, 2));
+   ralloc_free(g);
+
+   /* Class and forced register out of range. */
+   EXPECT_EQ(deserialize_graph(regs, {{1}, {0}}, 1), nullptr);
+   EXPECT_EQ(deserialize_graph(regs, {{1}, {0}}, 0, 4), nullptr);
+
+   /* Neighbours out of range, the node itself, listed twice or only by
+    * one side of the edge.
+    */
+   EXPECT_EQ(deserialize_graph(regs, {{2}, {0}}), nullptr);
+   EXPECT_EQ(deserialize_graph(regs, {{0}, {}}), nullptr);
+   EXPECT_EQ(deserialize_graph(regs, {{1, 1}, {0, 0}}), nullptr);
+   EXPECT_EQ(deserialize_graph(regs, {{1, 2}, {0}, {}}), nullptr);
+   EXPECT_EQ(deserialize_graph(regs, {{}, {0}, {}}), nullptr);
+
+   /* An adjacency size whose byte size overflows 32 bits, and a node count
+    * far larger than the data could hold.
+    */
+   struct blob blob;
+   struct blob_reader reader;
+   blob_init(&blob);
+   blob_write_uint32(&blob, 2);
+   write_node(&blob, 0, NO_REG, {});
+   blob_write_uint32(&blob, 0);
+   blob_write_uint32(&blob, NO_REG);
+   blob_write_uint32(&blob, 0);
+   blob_write_uint32(&blob, 0x40000001);
+   blob_reader_init(&reader, blob.data, blob.size);
+   EXPECT_EQ(ra_graph_deserialize(regs, &reader), nullptr);
+
+   blob_finish(&blob);
+   blob_init(&blob);
+   blob_write_uint32(&blob, UINT32_MAX);
+   write_node(&blob, 0, NO_REG, {});
+   blob_reader_init(&reader, blob.data, blob.size);
+   EXPECT_EQ(ra_graph_deserialize(regs, &reader), nullptr);
+   blob_finish(&blob);
+}
+
+/* A graph with far more nodes than any shader used to have.  The dense
+ * adjacency matrix would need count^2 / 16 bytes here.
+ */
+TEST_F(ra_test, large_sparse_graph)
+{
+   struct ra_regs *regs = ra_alloc_reg_set(mem_ctx, 32, true);
+   struct ra_class *c = ra_alloc_reg_class(regs);
+   for (unsigned i = 0; i < 32; i++)
+      ra_class_add_reg(c, i);
+   ra_set_finalize(regs, NULL);
+
+   const unsigned count = 50000;
+   struct ra_graph *g = build_banded_graph(regs, c, count, 24);
+
+   ASSERT_TRUE(ra_allocate(g));
+   check_allocation(g, count);
+
+   ralloc_free(g);
+}
+
+/* Replays a graph recorded with ra_set_serialize() followed by
+ * ra_graph_serialize() into the file named by RA_TEST_GRAPH and reports how
+ * long ra_allocate() takes on it.
+ */
+TEST_F(ra_test, replay_recorded_graph)
+{
+   const char *path = getenv("RA_TEST_GRAPH");
+   if (!path)
+      GTEST_SKIP() << "RA_TEST_GRAPH not set";
+
+   FILE *f = fopen(path, "rb");
+   ASSERT_NE(f, nullptr);
+   fseek(f, 0, SEEK_END);
+   long size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   void *data = ralloc_size(mem_ctx, size);
+   ASSERT_EQ(fread(data, 1, size, f), (size_t)size);
+   fclose(f);
+
+   struct blob_reader reader;
+   blob_reader_init(&reader, data, size);
+   struct ra_regs *regs = ra_set_deserialize(mem_ctx, &reader);
+   struct ra_graph *g = ra_graph_deserialize(regs, &reader);
+   ASSERT_NE(g, nullptr);
+
+   int64_t start = os_time_get_nano();
+   bool success = ra_allocate(g);
+   int64_t end = os_time_get_nano();
+
+   printf("%s: %u nodes, %s in %.3f ms\n", path, g->count,
+          success ? "allocated" : "failed", (end - start) / 1000000.0);
+
+   ralloc_free(g);
+}
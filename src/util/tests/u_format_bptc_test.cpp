@@ -0,0 +1,188 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "util/format/u_format_bptc.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+
+/* Synthetic reference images covering the kinds of content that get
+ * uploaded: smooth photographic gradients, hard-edged UI art, noise, and
+ * images with an independent alpha channel.
+ */
+enum reference_image {
+   IMAGE_GRADIENT,
+   IMAGE_PLASMA,
+   IMAGE_UI,
+   IMAGE_NOISE,
+   IMAGE_ALPHA,
+};
+
+static const char *reference_image_names[] = {
+   "gradient", "plasma", "ui", "noise", "alpha",
+};
+
+static std::vector<uint8_t>
+make_reference_image(enum reference_image image, unsigned width, unsigned height)
+{
+   std::vector<uint8_t> pixels(width * height * 4);
+
+   srand(image);
+   for (unsigned y = 0; y < height; y++) {
+      for (unsigned x = 0; x < width; x++) {
+         uint8_t *p = &pixels[(y * width + x) * 4];
+         float fx = (float)x / width, fy = (float)y / height;
+
+         switch (image) {
+         case IMAGE_GRADIENT:
+            p[0] = 255 * fx;
+            p[1] = 255 * fy;
+            p[2] = 255 * (1.0f - fx) * fy;
+            p[3] = 255;
+            break;
+         case IMAGE_PLASMA:
+            p[0] = 127.5f + 127.5f * sinf(fx * 23.0f + sinf(fy * 7.0f) * 3.0f);
+            p[1] = 127.5f + 127.5f * sinf(fy * 17.0f + fx * 5.0f);
+            p[2] = 127.5f + 127.5f * cosf((fx + fy) * 11.0f);
+            p[3] = 255;
+            break;
+         case IMAGE_UI: {
+            bool border = (x % 64) < 2 || (y % 32) < 2;
+            bool text = ((x / 3) ^ (y / 5)) % 7 == 0 && (y % 32) > 8;
+            p[0] = border ? 40 : text ? 250 : 200;
+            p[1] = border ? 40 : text ? 250 : 210;
+            p[2] = border ? 60 : text ? 250 : 230;
+            p[3] = 255;
+            break;
+         }
+         case IMAGE_NOISE:
+            p[0] = rand();
+            p[1] = rand();
+            p[2] = rand();
+            p[3] = rand();
+            break;
+         case IMAGE_ALPHA:
+            p[0] = 255 * fx;
+            p[1] = 128;
+            p[2] = 255 * fy;
+            p[3] = 127.5f + 127.5f * sinf(fx * 40.0f) * cosf(fy * 30.0f);
+            break;
+         }
+      }
+   }
+
+   return pixels;
+}
+
+static double
+psnr(const std::vector<uint8_t> &a, const std::vector<uint8_t> &b)
+{
+   double sum = 0.0;
+
+   for (size_t i = 0; i < a.size(); i++) {
+      double diff = (double)a[i] - b[i];
+      sum += diff * diff;
+   }
+
+   if (sum == 0.0)
+      return INFINITY;
+
+   return 10.0 * log10(255.0 * 255.0 * a.size() / sum);
+}
+
+static std::vector<uint8_t>
+compress(const std::vector<uint8_t> &pixels, unsigned width, unsigned height,
+         enum util_format_bptc_quality quality)
+{
+   const unsigned stride = DIV_ROUND_UP(width, 4) * 16;
+   std::vector<uint8_t> blocks(stride * DIV_ROUND_UP(height, 4));
+
+   util_format_bptc_rgba_unorm_compress(blocks.data(), stride,
+                                        pixels.data(), width * 4,
+                                        width, height, quality);
+   return blocks;
+}
+
+static std::vector<uint8_t>
+decompress(const std::vector<uint8_t> &blocks, unsigned width, unsigned height)
+{
+   std::vector<uint8_t> pixels(width * height * 4);
+
+   util_format_bptc_rgba_unorm_unpack_rgba_8unorm(pixels.data(), width * 4,
+                                                  blocks.data(),
+                                                  DIV_ROUND_UP(width, 4) * 16,
+                                                  width, height);
+   return pixels;
+}
+
+/* The threaded encoder produces the same blocks as the serial one. */
+TEST(u_format_bptc, threaded_matches_serial)
+{
+   const unsigned width = 509, height = 517;
+   const unsigned stride = DIV_ROUND_UP(width, 4) * 16;
+   std::vector<uint8_t> pixels = make_reference_image(IMAGE_PLASMA, width, height);
+   std::vector<uint8_t> serial(stride * DIV_ROUND_UP(height, 4));
+
+   util_format_bptc_rgba_unorm_pack_rgba_8unorm(serial.data(), stride,
+                                                pixels.data(), width * 4,
+                                                width, height);
+
+   EXPECT_EQ(compress(pixels, width, height, UTIL_FORMAT_BPTC_QUALITY_FAST), serial);
+}
+
+/* Higher qualities never do worse than lower ones, and partial blocks at the
+ * right and bottom edges decode to the source texels.
+ */
+TEST(u_format_bptc, quality)
+{
+   const unsigned width = 130, height = 67;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(reference_image_names); i++) {
+      std::vector<uint8_t> pixels =
+         make_reference_image((enum reference_image)i, width, height);
+      double last_psnr = 0.0;
+
+      for (int q = UTIL_FORMAT_BPTC_QUALITY_FAST;
+           q <= UTIL_FORMAT_BPTC_QUALITY_BEST; q++) {
+         std::vector<uint8_t> blocks =
+            compress(pixels, width, height, (enum util_format_bptc_quality)q);
+         double value = psnr(pixels, decompress(blocks, width, height));
+
+         EXPECT_GE(value, last_psnr - 0.01)
+            << reference_image_names[i] << " quality " << q;
+         last_psnr = value;
+      }
+   }
+}
+
+/* Speed and quality of every level on every reference image. */
+TEST(u_format_bptc, benchmark)
+{
+   const unsigned width = 1024, height = 1024;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(reference_image_names); i++) {
+      std::vector<uint8_t> pixels =
+         make_reference_image((enum reference_image)i, width, height);
+
+      for (int q = UTIL_FORMAT_BPTC_QUALITY_FAST;
+           q <= UTIL_FORMAT_BPTC_QUALITY_BEST; q++) {
+         int64_t t0 = os_time_get_nano();
+         std::vector<uint8_t> blocks =
+            compress(pixels, width, height, (enum util_format_bptc_quality)q);
+         int64_t t1 = os_time_get_nano();
+
+         printf("%-10s quality %d: %8.2f MPix/s, %6.2f dB\n",
+                reference_image_names[i], q,
+                (double)width * height * 1000.0 / (t1 - t0),
+                psnr(pixels, decompress(blocks, width, height)));
+      }
+   }
+}
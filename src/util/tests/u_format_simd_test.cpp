@@ -0,0 +1,264 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "util/format/u_format.h"
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+
+#if defined(USE_SSE41)
+
+/* Every format that has SSE4.1 code. */
+static const enum pipe_format simd_formats[] = {
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_R8G8B8X8_UNORM,
+   PIPE_FORMAT_B8G8R8X8_UNORM,
+   PIPE_FORMAT_R10G10B10A2_UNORM,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+   PIPE_FORMAT_R11G11B10_FLOAT,
+   PIPE_FORMAT_Z16_UNORM,
+   PIPE_FORMAT_Z24_UNORM_S8_UINT,
+   PIPE_FORMAT_Z24X8_UNORM,
+};
+
+/* Widths that cover the vector loops and the scalar tails. */
+static const unsigned widths[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 33, 64 };
+
+static const unsigned height = 3;
+
+static std::vector<uint8_t>
+random_bytes(size_t size, unsigned seed)
+{
+   std::vector<uint8_t> bytes(size);
+
+   srand(seed);
+   for (auto &b : bytes)
+      b = rand();
+   return bytes;
+}
+
+/* Floats around the interesting points of unorm conversions: the ends of
+ * [0, 1], rounding ties, out-of-range values, infinities and NaNs.
+ */
+static std::vector<float>
+random_floats(size_t count, unsigned seed)
+{
+   static const float specials[] = {
+      0.0f, -0.0f, 1.0f, -1.0f, 2.0f, INFINITY, -INFINITY, NAN, -NAN,
+      0.5f / 255.0f, 1.5f / 255.0f, 254.5f / 255.0f, 0.5f / 1023.0f,
+      511.5f / 1023.0f, 1.0f / 3.0f, 0.5f, 1e-30f, 1.0000001f,
+   };
+   std::vector<float> floats(count);
+
+   srand(seed);
+   for (auto &f : floats) {
+      if (rand() % 4 == 0)
+         f = specials[rand() % ARRAY_SIZE(specials)];
+      else
+         f = (float)rand() / RAND_MAX * 1.2f - 0.1f;
+   }
+   return floats;
+}
+
+/* Bitwise equality, except that NaNs only need to stay NaNs. */
+static bool
+same_float(float a, float b)
+{
+   if (isnan(a) || isnan(b))
+      return isnan(a) && isnan(b);
+   return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void
+check_unpack(enum pipe_format format)
+{
+   const struct util_format_unpack_description *simd =
+      util_format_unpack_description_sse41(format);
+   const struct util_format_unpack_description *generic =
+      util_format_unpack_description_generic(format);
+   const char *name = util_format_short_name(format);
+   const unsigned bpp = util_format_get_blocksize(format);
+
+   ASSERT_NE(simd, nullptr) << name;
+
+   for (unsigned w : widths) {
+      const unsigned src_stride = w * bpp + 4;
+      std::vector<uint8_t> src = random_bytes(src_stride * height, w);
+
+      if (simd->unpack_rgba_8unorm) {
+         std::vector<uint8_t> a(w * 4), b(w * 4);
+         simd->unpack_rgba_8unorm(a.data(), src.data(), w);
+         generic->unpack_rgba_8unorm(b.data(), src.data(), w);
+         EXPECT_EQ(a, b) << name << " unpack_rgba_8unorm width " << w;
+      }
+
+      if (simd->unpack_rgba) {
+         std::vector<float> a(w * 4), b(w * 4);
+         simd->unpack_rgba(a.data(), src.data(), w);
+         generic->unpack_rgba(b.data(), src.data(), w);
+         for (unsigned i = 0; i < w * 4; i++) {
+            EXPECT_TRUE(same_float(a[i], b[i]))
+               << name << " unpack_rgba width " << w << " at " << i
+               << ": " << a[i] << " != " << b[i];
+         }
+      }
+
+      if (simd->unpack_z_float) {
+         std::vector<float> a(w * height), b(w * height);
+         simd->unpack_z_float(a.data(), w * 4, src.data(), src_stride, w, height);
+         generic->unpack_z_float(b.data(), w * 4, src.data(), src_stride, w, height);
+         EXPECT_EQ(a, b) << name << " unpack_z_float width " << w;
+      }
+
+      if (simd->unpack_z_32unorm) {
+         std::vector<uint32_t> a(w * height), b(w * height);
+         simd->unpack_z_32unorm(a.data(), w * 4, src.data(), src_stride, w, height);
+         generic->unpack_z_32unorm(b.data(), w * 4, src.data(), src_stride, w, height);
+         EXPECT_EQ(a, b) << name << " unpack_z_32unorm width " << w;
+      }
+
+      if (simd->unpack_s_8uint) {
+         std::vector<uint8_t> a(w * height), b(w * height);
+         simd->unpack_s_8uint(a.data(), w, src.data(), src_stride, w, height);
+         generic->unpack_s_8uint(b.data(), w, src.data(), src_stride, w, height);
+         EXPECT_EQ(a, b) << name << " unpack_s_8uint width " << w;
+      }
+   }
+}
+
+static void
+check_pack(enum pipe_format format)
+{
+   const struct util_format_pack_description *simd =
+      util_format_pack_description_sse41(format);
+   const struct util_format_pack_description *generic =
+      util_format_pack_description_generic(format);
+   const char *name = util_format_short_name(format);
+   const unsigned bpp = util_format_get_blocksize(format);
+
+   if (!simd)
+      return;
+
+   for (unsigned w : widths) {
+      /* Padding at the end of each destination row must be left alone. */
+      const unsigned dst_stride = w * bpp + 4;
+
+      if (simd->pack_rgba_8unorm) {
+         std::vector<uint8_t> src = random_bytes(w * 4 * height, w);
+         std::vector<uint8_t> a(dst_stride * height, 0xcd), b = a;
+         simd->pack_rgba_8unorm(a.data(), dst_stride, src.data(), w * 4, w, height);
+         generic->pack_rgba_8unorm(b.data(), dst_stride, src.data(), w * 4, w, height);
+         EXPECT_EQ(a, b) << name << " pack_rgba_8unorm width " << w;
+      }
+
+      if (simd->pack_rgba_float) {
+         std::vector<float> src = random_floats(w * 4 * height, w);
+         std::vector<uint8_t> a(dst_stride * height, 0xcd), b = a;
+         simd->pack_rgba_float(a.data(), dst_stride, src.data(), w * 16, w, height);
+         generic->pack_rgba_float(b.data(), dst_stride, src.data(), w * 16, w, height);
+         EXPECT_EQ(a, b) << name << " pack_rgba_float width " << w;
+      }
+
+      if (simd->pack_z_32unorm) {
+         std::vector<uint8_t> src = random_bytes(w * 4 * height, w);
+         std::vector<uint8_t> a = random_bytes(dst_stride * height, w + 1), b = a;
+         simd->pack_z_32unorm(a.data(), dst_stride, (const uint32_t *)src.data(),
+                              w * 4, w, height);
+         generic->pack_z_32unorm(b.data(), dst_stride, (const uint32_t *)src.data(),
+                                 w * 4, w, height);
+         EXPECT_EQ(a, b) << name << " pack_z_32unorm width " << w;
+      }
+   }
+}
+
+/* The SSE4.1 functions produce the same results as the generated code. */
+TEST(u_format_simd, sse41_matches_generic)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      GTEST_SKIP() << "no SSE4.1";
+
+   for (enum pipe_format format : simd_formats) {
+      check_unpack(format);
+      check_pack(format);
+   }
+}
+
+static double
+mpix_per_s(int64_t t0, int64_t t1, unsigned pixels)
+{
+   return (double)pixels * 1000.0 / (t1 - t0);
+}
+
+/* Throughput of the SSE4.1 and generated code, per function. */
+TEST(u_format_simd, throughput)
+{
+   if (!util_get_cpu_caps()->has_sse4_1)
+      GTEST_SKIP() << "no SSE4.1";
+
+   const unsigned width = 1024, rows = 512;
+   std::vector<uint8_t> packed = random_bytes(width * 8, 0);
+   std::vector<float> floats = random_floats(width * 4, 0);
+   std::vector<uint8_t> bytes(width * 4 * sizeof(float));
+
+   for (enum pipe_format format : simd_formats) {
+      const struct util_format_unpack_description *descs[2] = {
+         util_format_unpack_description_generic(format),
+         util_format_unpack_description_sse41(format),
+      };
+      const struct util_format_pack_description *pack_descs[2] = {
+         util_format_pack_description_generic(format),
+         util_format_pack_description_sse41(format),
+      };
+      double unpack[2] = { 0 }, unpack_8unorm[2] = { 0 };
+      double pack[2] = { 0 }, unpack_z[2] = { 0 };
+
+      for (unsigned i = 0; i < 2; i++) {
+         const struct util_format_unpack_description *desc = descs[i];
+         int64_t t0;
+
+         if (desc->unpack_rgba) {
+            t0 = os_time_get_nano();
+            for (unsigned y = 0; y < rows; y++)
+               desc->unpack_rgba(bytes.data(), packed.data(), width);
+            unpack[i] = mpix_per_s(t0, os_time_get_nano(), width * rows);
+         }
+
+         if (desc->unpack_rgba_8unorm) {
+            t0 = os_time_get_nano();
+            for (unsigned y = 0; y < rows; y++)
+               desc->unpack_rgba_8unorm(bytes.data(), packed.data(), width);
+            unpack_8unorm[i] = mpix_per_s(t0, os_time_get_nano(), width * rows);
+         }
+
+         if (desc->unpack_z_float) {
+            t0 = os_time_get_nano();
+            desc->unpack_z_float((float *)bytes.data(), 0, packed.data(), 0, width, rows);
+            unpack_z[i] = mpix_per_s(t0, os_time_get_nano(), width * rows);
+         }
+
+         if (pack_descs[1] && pack_descs[i]->pack_rgba_float) {
+            t0 = os_time_get_nano();
+            pack_descs[i]->pack_rgba_float(packed.data(), 0, floats.data(), 0, width, rows);
+            pack[i] = mpix_per_s(t0, os_time_get_nano(), width * rows);
+         }
+      }
+
+      printf("%-22s unpack_rgba %7.1f -> %7.1f, unpack_rgba_8unorm %7.1f -> %7.1f, "
+             "unpack_z_float %7.1f -> %7.1f, pack_rgba_float %7.1f -> %7.1f MPix/s\n",
+             util_format_short_name(format), unpack[0], unpack[1],
+             unpack_8unorm[0], unpack_8unorm[1], unpack_z[0], unpack_z[1],
+             pack[0], pack[1]);
+   }
+}
+
+#endif
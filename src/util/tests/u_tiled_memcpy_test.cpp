@@ -0,0 +1,173 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+#include "util/u_tiled_memcpy.h"
+
+struct tiled_layout_desc {
+   const char *name;
+   unsigned tile_w_el, tile_h_el;
+   uint32_t x_mask, y_mask, y_xor_mask;
+};
+
+/* The tile layouts of a few drivers, as seen by a 4-byte element. */
+static const struct tiled_layout_desc layouts[] = {
+   /* Intel X-tiling: 512B x 8 rows, row-major. */
+   { "intel-x", 128, 8, 0x07f, 0x380, 0 },
+   /* Intel Y-tiling: 16B x 32 row columns, 8 columns wide. */
+   { "intel-y", 32, 32, 0x383, 0x07c, 0 },
+   /* Mali u-interleaved: 16x16, [y3 x3^y3 ... y0 x0^y0]. */
+   { "mali-u-interleaved", 16, 16, 0x55, 0xaa, 0x55 },
+   /* AGX twiddled: Z-order. */
+   { "agx-twiddled", 64, 64, 0x555, 0xaaa, 0 },
+   /* Z-order on 2:1 tiles. */
+   { "z-order-2x1", 32, 16, 0x155, 0x0aa, 0 },
+};
+
+static uint32_t
+scatter(uint32_t value, uint32_t mask)
+{
+   uint32_t result = 0;
+   for (unsigned bit = 0; bit < 32; bit++) {
+      if (mask & (1u << bit)) {
+         if (value & 1)
+            result |= 1u << bit;
+         value >>= 1;
+      }
+   }
+   return result;
+}
+
+/* Byte offset of an element, written for clarity. */
+static size_t
+reference_offset(const struct tiled_layout_desc *desc, unsigned cpp,
+                 uint32_t tiled_stride_B, unsigned x, unsigned y)
+{
+   unsigned tx = x % desc->tile_w_el, ty = y % desc->tile_h_el;
+   uint32_t index = scatter(tx, desc->x_mask) ^ scatter(ty, desc->y_mask) ^
+                    scatter(ty, desc->y_xor_mask);
+
+   return (size_t)(y / desc->tile_h_el) * tiled_stride_B +
+          (size_t)(x / desc->tile_w_el) * desc->tile_w_el * desc->tile_h_el * cpp +
+          (size_t)index * cpp;
+}
+
+static void
+check_layout(const struct tiled_layout_desc *desc, unsigned cpp)
+{
+   const unsigned width = desc->tile_w_el * 5, height = desc->tile_h_el * 3;
+   const uint32_t tiled_stride_B = desc->tile_w_el * desc->tile_h_el * cpp * 5;
+   const size_t size = (size_t)tiled_stride_B * 3;
+
+   struct util_tiled_layout layout;
+   ASSERT_TRUE(util_tiled_layout_init(&layout, cpp, desc->tile_w_el, desc->tile_h_el,
+                                      desc->x_mask, desc->y_mask, desc->y_xor_mask));
+
+   /* A region that starts and ends in the middle of tiles and chunks. */
+   const unsigned x = desc->tile_w_el / 2 + 1, y = desc->tile_h_el / 2 + 3;
+   const unsigned w = width - x - 3, h = height - y - 1;
+   const uint32_t linear_stride_B = (w + 7) * cpp;
+
+   std::vector<uint8_t> linear(linear_stride_B * h);
+   std::vector<uint8_t> tiled(size, 0);
+   std::vector<uint8_t> readback(linear.size(), 0);
+
+   srand(cpp * width);
+   for (auto &b : linear)
+      b = rand();
+
+   util_tiled_store(&layout, tiled.data(), tiled_stride_B,
+                    linear.data(), linear_stride_B, x, y, w, h);
+
+   for (unsigned j = 0; j < h; j++) {
+      for (unsigned i = 0; i < w; i++) {
+         size_t offset = reference_offset(desc, cpp, tiled_stride_B, x + i, y + j);
+         ASSERT_EQ(memcmp(&tiled[offset], &linear[j * linear_stride_B + i * cpp], cpp), 0)
+            << desc->name << " cpp " << cpp << " at " << x + i << "," << y + j;
+      }
+   }
+
+   /* Nothing outside of the region was written. */
+   size_t written = 0;
+   for (auto b : tiled)
+      written += b != 0;
+   EXPECT_LE(written, (size_t)w * h * cpp) << desc->name << " cpp " << cpp;
+
+   util_tiled_load(&layout, readback.data(), linear_stride_B,
+                   tiled.data(), tiled_stride_B, x, y, w, h);
+
+   for (unsigned j = 0; j < h; j++) {
+      EXPECT_EQ(memcmp(&readback[j * linear_stride_B], &linear[j * linear_stride_B],
+                       w * cpp), 0)
+         << desc->name << " cpp " << cpp << " row " << j;
+   }
+}
+
+TEST(u_tiled_memcpy, layouts)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(layouts); i++) {
+      for (unsigned cpp = 1; cpp <= 16; cpp *= 2)
+         check_layout(&layouts[i], cpp);
+   }
+}
+
+TEST(u_tiled_memcpy, tile_too_large)
+{
+   struct util_tiled_layout layout;
+
+   /* A fully twiddled 4096x4096 image is a single tile. */
+   EXPECT_FALSE(util_tiled_layout_init(&layout, 4, 4096, 4096,
+                                       0x555555, 0xaaaaaa, 0));
+}
+
+/* Copy throughput of every layout, to compare them with each other and with
+ * plain memcpy.
+ */
+TEST(u_tiled_memcpy, throughput)
+{
+   const unsigned width = 2048, height = 2048, cpp = 4, iters = 4;
+   const uint32_t stride_B = width * cpp;
+   const size_t size = (size_t)stride_B * height;
+
+   std::vector<uint8_t> linear(size, 1), tiled(size, 2);
+
+   int64_t t0 = os_time_get_nano();
+   for (unsigned it = 0; it < iters; it++)
+      memcpy(tiled.data(), linear.data(), size);
+   int64_t t1 = os_time_get_nano();
+   printf("%-20s %6.2f GB/s\n", "memcpy", (double)size * iters / (t1 - t0));
+
+   for (unsigned i = 0; i < ARRAY_SIZE(layouts); i++) {
+      const struct tiled_layout_desc *desc = &layouts[i];
+      const uint32_t tiled_stride_B = stride_B * desc->tile_h_el;
+
+      struct util_tiled_layout layout;
+      ASSERT_TRUE(util_tiled_layout_init(&layout, cpp, desc->tile_w_el, desc->tile_h_el,
+                                         desc->x_mask, desc->y_mask, desc->y_xor_mask));
+
+      t0 = os_time_get_nano();
+      for (unsigned it = 0; it < iters; it++) {
+         util_tiled_store(&layout, tiled.data(), tiled_stride_B,
+                          linear.data(), stride_B, 0, 0, width, height);
+      }
+      t1 = os_time_get_nano();
+      for (unsigned it = 0; it < iters; it++) {
+         util_tiled_load(&layout, linear.data(), stride_B,
+                         tiled.data(), tiled_stride_B, 0, 0, width, height);
+      }
+      int64_t t2 = os_time_get_nano();
+
+      printf("%-20s %6.2f GB/s store, %6.2f GB/s load (%uB chunks)\n",
+             desc->name, (double)size * iters / (t1 - t0),
+             (double)size * iters / (t2 - t1), layout.chunk_B);
+   }
+}
@@ -27,7 +27,9 @@
 #include "u_queue.h"
 
 #include "c11/threads.h"
+#include "util/u_call_once.h"
 #include "util/u_cpu_detect.h"
+#include "util/u_math.h"
 #include "util/os_time.h"
 #include "util/u_string.h"
 #include "util/u_thread.h"
@@ -735,3 +737,110 @@ util_queue_get_thread_time_nano(struct util_queue *queue, unsigned thread_index)
 
    return util_thread_get_time_nano(queue->threads[thread_index]);
 }
+
+/* Upper bound on the bands of util_queue_run_bands(), and on the threads
+ * of the queue shared by all its callers.
+ */
+#define UTIL_QUEUE_MAX_BANDS 16
+
+struct util_queue_band {
+   struct util_queue_fence fence;
+   util_queue_band_func func;
+   void *data;
+   unsigned first_row;
+   unsigned num_rows;
+   bool executed;
+   bool result;
+};
+
+static struct util_queue band_queue;
+static bool band_queue_initialized;
+
+static void
+band_queue_init(void)
+{
+   unsigned num_threads = MIN2(util_get_cpu_caps()->nr_cpus,
+                               UTIL_QUEUE_MAX_BANDS);
+
+   /* The calling thread does a band too. */
+   if (num_threads > 1) {
+      band_queue_initialized =
+         util_queue_init(&band_queue, "bands", UTIL_QUEUE_MAX_BANDS,
+                         num_threads - 1, UTIL_QUEUE_INIT_RESIZE_IF_FULL,
+                         NULL);
+   }
+}
+
+static void
+band_execute(void *job, void *gdata, int thread_index)
+{
+   struct util_queue_band *band = job;
+
+   band->result = band->func(band->data, band->first_row, band->num_rows);
+   band->executed = true;
+}
+
+/**
+ * Split the rows [0, num_rows) into at most max_bands bands of a multiple
+ * of row_align rows, and run func on each of them in parallel.  The calling
+ * thread does the first band, the others go to a queue shared by all
+ * callers, with a thread per CPU.  func must not wait for other bands.
+ *
+ * Callers decide whether the work is large enough to be split, passing
+ * max_bands = 1 runs func on the calling thread only.
+ *
+ * \return whether func returned true for all bands
+ */
+bool
+util_queue_run_bands(unsigned num_rows, unsigned row_align, unsigned max_bands,
+                     util_queue_band_func func, void *data)
+{
+   static util_once_flag once = UTIL_ONCE_FLAG_INIT;
+   struct util_queue_band bands[UTIL_QUEUE_MAX_BANDS];
+
+   assert(row_align);
+   unsigned num_bands = MIN3(max_bands, UTIL_QUEUE_MAX_BANDS,
+                             DIV_ROUND_UP(num_rows, row_align));
+   if (num_bands > 1) {
+      util_call_once(&once, band_queue_init);
+      num_bands = band_queue_initialized ?
+                  MIN2(num_bands, band_queue.num_threads + 1) : 1;
+   }
+
+   if (num_bands <= 1)
+      return func(data, 0, num_rows);
+
+   const unsigned band_rows = align(DIV_ROUND_UP(num_rows, num_bands),
+                                    row_align);
+   num_bands = DIV_ROUND_UP(num_rows, band_rows);
+
+   for (unsigned b = 0; b < num_bands; b++) {
+      bands[b].func = func;
+      bands[b].data = data;
+      bands[b].first_row = b * band_rows;
+      bands[b].num_rows = MIN2(band_rows, num_rows - b * band_rows);
+      bands[b].executed = false;
+
+      if (b > 0) {
+         util_queue_fence_init(&bands[b].fence);
+         util_queue_add_job(&band_queue, &bands[b], &bands[b].fence,
+                            band_execute, NULL, 0);
+      }
+   }
+
+   band_execute(&bands[0], NULL, 0);
+
+   bool result = bands[0].result;
+   for (unsigned b = 1; b < num_bands; b++) {
+      util_queue_fence_wait(&bands[b].fence);
+      util_queue_fence_destroy(&bands[b].fence);
+
+      /* The queue drops jobs once its threads are stopped at exit. */
+      if (!bands[b].executed)
+         band_execute(&bands[b], NULL, 0);
+
+      result &= bands[b].result;
+   }
+
+   return result;
+}
@@ -273,6 +273,14 @@ util_queue_adjust_num_threads(struct util_queue *queue, unsigned num_threads,
 int64_t util_queue_get_thread_time_nano(struct util_queue *queue,
                                         unsigned thread_index);
 
+/* Process a band of rows [first_row, first_row + num_rows). */
+typedef bool (*util_queue_band_func)(void *data, unsigned first_row,
+                                     unsigned num_rows);
+
+bool util_queue_run_bands(unsigned num_rows, unsigned row_align,
+                          unsigned max_bands, util_queue_band_func func,
+                          void *data);
+
 /* util_queue needs to be cleared to zeroes for this to work */
 static inline bool
 util_queue_is_initialized(struct util_queue *queue)
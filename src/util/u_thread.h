@@ -83,6 +83,26 @@ util_set_thread_affinity(thrd_t thread,
                          uint32_t *old_mask,
                          unsigned num_mask_bits);
 
+/**
+ * Get thread affinity.
+ *
+ * \param thread         Thread
+ * \param mask           Returns the current affinity mask
+ * \param num_mask_bits  Number of bits in the mask
+ * \return  true on success
+ */
+bool
+util_get_thread_affinity(thrd_t thread,
+                         uint32_t *mask,
+                         unsigned num_mask_bits);
+
+static inline bool
+util_get_current_thread_affinity(uint32_t *mask,
+                                 unsigned num_mask_bits)
+{
+   return util_get_thread_affinity(thrd_current(), mask, num_mask_bits);
+}
+
 static inline bool
 util_set_current_thread_affinity(const uint32_t *mask,
                                  uint32_t *old_mask,
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <assert.h>
+
+#include "util/bitscan.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_tiled_memcpy.h"
+
+#define UTIL_TILED_NAME(name) util_tiled_##name##_generic
+#include "util/u_tiled_memcpy_tmp.h"
+#undef UTIL_TILED_NAME
+
+#if defined(USE_SSE41)
+void
+util_tiled_access_sse41(const struct util_tiled_layout *layout,
+                        uint8_t *tiled, uint32_t tiled_stride_B,
+                        uint8_t *linear, uint32_t linear_stride_B,
+                        unsigned x_el, unsigned y_el,
+                        unsigned w_el, unsigned h_el, bool is_store);
+#endif
+
+bool
+util_tiled_layout_init(struct util_tiled_layout *layout, unsigned cpp,
+                       unsigned tile_w_el, unsigned tile_h_el,
+                       uint32_t x_mask, uint32_t y_mask, uint32_t y_xor_mask)
+{
+   assert(util_is_power_of_two_nonzero(cpp) && cpp <= 16);
+   assert(util_is_power_of_two_nonzero(tile_w_el));
+   assert(util_is_power_of_two_nonzero(tile_h_el));
+   assert(util_bitcount(x_mask) == util_logbase2(tile_w_el));
+   assert(util_bitcount(y_mask) == util_logbase2(tile_h_el));
+   assert((x_mask & y_mask) == 0);
+   assert((x_mask | y_mask) == tile_w_el * tile_h_el - 1);
+   assert((y_xor_mask & ~(x_mask | y_mask)) == 0);
+
+   const unsigned cpp_log2 = util_logbase2(cpp);
+   const unsigned tile_w_B_log2 = util_logbase2(tile_w_el) + cpp_log2;
+
+   /* Go to byte offsets, the bytes of an element come from x. */
+   const uint32_t x_mask_B = (x_mask << cpp_log2) | (cpp - 1);
+   const uint32_t y_mask_B = y_mask << cpp_log2;
+   const uint32_t y_xor_mask_B = y_xor_mask << cpp_log2;
+
+   /* The low bits that only depend on x give the bytes that are contiguous
+    * in both the tile and the linear image.
+    */
+   const uint32_t x_only_B = x_mask_B & ~y_xor_mask_B;
+   unsigned chunk_B_log2 = ffs(~x_only_B) - 1;
+   chunk_B_log2 = MIN3(chunk_B_log2, tile_w_B_log2, 6);
+
+   const unsigned chunks_per_tile = 1u << (tile_w_B_log2 - chunk_B_log2);
+   if (chunks_per_tile > UTIL_TILED_MAX_X_CHUNKS ||
+       tile_h_el > UTIL_TILED_MAX_TILE_HEIGHT)
+      return false;
+
+   layout->cpp = cpp;
+   layout->tile_w_el_log2 = util_logbase2(tile_w_el);
+   layout->tile_h_el_log2 = util_logbase2(tile_h_el);
+   layout->tile_size_B = tile_w_el * tile_h_el * cpp;
+   layout->chunk_B = 1u << chunk_B_log2;
+   layout->chunk_B_log2 = chunk_B_log2;
+
+   /* Step through the coordinates with (v - mask) & mask, which adds one
+    * to the bits of v in mask, carrying over the bits outside of it.
+    */
+   const uint32_t x_chunk_mask_B = x_mask_B & ~(layout->chunk_B - 1);
+   uint32_t x_offs = 0;
+   for (unsigned c = 0; c < chunks_per_tile; c++) {
+      layout->x_lut[c] = x_offs;
+      x_offs = (x_offs - x_chunk_mask_B) & x_chunk_mask_B;
+   }
+
+   uint32_t y_offs = 0, y_xor_offs = 0;
+   for (unsigned y = 0; y < tile_h_el; y++) {
+      layout->y_lut[y] = y_offs ^ y_xor_offs;
+      y_offs = (y_offs - y_mask_B) & y_mask_B;
+      if (y_xor_mask_B)
+         y_xor_offs = (y_xor_offs - y_xor_mask_B) & y_xor_mask_B;
+   }
+
+   return true;
+}
+
+void
+util_tiled_store(const struct util_tiled_layout *layout,
+                 void *tiled, uint32_t tiled_stride_B,
+                 const void *linear, uint32_t linear_stride_B,
+                 unsigned x_el, unsigned y_el, unsigned w_el, unsigned h_el)
+{
+   util_tiled_access_generic(layout, tiled, tiled_stride_B,
+                             (uint8_t *)linear, linear_stride_B,
+                             x_el, y_el, w_el, h_el, true);
+}
+
+void
+util_tiled_load(const struct util_tiled_layout *layout,
+                void *linear, uint32_t linear_stride_B,
+                const void *tiled, uint32_t tiled_stride_B,
+                unsigned x_el, unsigned y_el, unsigned w_el, unsigned h_el)
+{
+#if defined(USE_SSE41)
+   if (util_get_cpu_caps()->has_sse4_1) {
+      util_tiled_access_sse41(layout, (uint8_t *)tiled, tiled_stride_B,
+                              linear, linear_stride_B,
+                              x_el, y_el, w_el, h_el, false);
+      return;
+   }
+#endif
+
+   util_tiled_access_generic(layout, (uint8_t *)tiled, tiled_stride_B,
+                             linear, linear_stride_B,
+                             x_el, y_el, w_el, h_el, false);
+}
@@ -0,0 +1,99 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Generic CPU copies between linear memory and tiled images.
+ *
+ * A tiled image is made of rows of tiles. Each tile covers a power-of-two
+ * rectangle of elements and is stored contiguously, tiles of a row follow
+ * each other, and rows of tiles are tiled_stride_B bytes apart. Inside a
+ * tile, the element index is built by scattering the bits of the in-tile
+ * x and y coordinates into x_mask and y_mask, from the least significant bit
+ * up, and XORing the two together. This covers Z-order (Morton) layouts,
+ * column/row-major tiles like Intel X and Y tiling, and layouts which XOR a y
+ * bit into an x bit, like Mali's u-interleaving, through y_xor_mask.
+ *
+ * The layout is turned into lookup tables once, and copies then move the
+ * longest run of bytes the layout keeps contiguous at a time.
+ */
+
+#ifndef U_TILED_MEMCPY_H
+#define U_TILED_MEMCPY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define UTIL_TILED_MAX_TILE_HEIGHT 256
+#define UTIL_TILED_MAX_X_CHUNKS    512
+
+struct util_tiled_layout {
+   /* Bytes per element. */
+   uint32_t cpp;
+   uint32_t tile_w_el_log2;
+   uint32_t tile_h_el_log2;
+   uint32_t tile_size_B;
+
+   /* Bytes that stay contiguous along x, at most 64. */
+   uint32_t chunk_B;
+   uint32_t chunk_B_log2;
+
+   /* Byte offset within a tile of each chunk of a tile row, and of each
+    * row of a tile. The offset of a chunk is x_lut[] ^ y_lut[].
+    */
+   uint32_t x_lut[UTIL_TILED_MAX_X_CHUNKS];
+   uint32_t y_lut[UTIL_TILED_MAX_TILE_HEIGHT];
+};
+
+/**
+ * Build the lookup tables for a tiled layout.
+ *
+ * @cpp Bytes per element, a power of two up to 16
+ * @tile_w_el Width of a tile in elements, a power of two
+ * @tile_h_el Height of a tile in elements, a power of two
+ * @x_mask Bits of the in-tile element index that come from x
+ * @y_mask Bits of the in-tile element index that come from y
+ * @y_xor_mask Bits of the in-tile element index that y is additionally
+ *             XORed into, or 0
+ *
+ * Returns false if the tile is too large for the lookup tables.
+ */
+bool util_tiled_layout_init(struct util_tiled_layout *layout, unsigned cpp,
+                            unsigned tile_w_el, unsigned tile_h_el,
+                            uint32_t x_mask, uint32_t y_mask,
+                            uint32_t y_xor_mask);
+
+/**
+ * Copy a rectangle of elements from linear memory to a tiled image.
+ *
+ * @x_el,y_el Position of the rectangle in the tiled image, in elements
+ * @w_el,h_el Size of the rectangle, in elements
+ * @linear Points to the first element of the rectangle
+ */
+void util_tiled_store(const struct util_tiled_layout *layout,
+                      void *tiled, uint32_t tiled_stride_B,
+                      const void *linear, uint32_t linear_stride_B,
+                      unsigned x_el, unsigned y_el,
+                      unsigned w_el, unsigned h_el);
+
+/**
+ * Copy a rectangle of elements from a tiled image to linear memory. Reads
+ * from the tiled image use streaming loads where available, so that
+ * write-combined mappings are read efficiently.
+ */
+void util_tiled_load(const struct util_tiled_layout *layout,
+                     void *linear, uint32_t linear_stride_B,
+                     const void *tiled, uint32_t tiled_stride_B,
+                     unsigned x_el, unsigned y_el,
+                     unsigned w_el, unsigned h_el);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* U_TILED_MEMCPY_H */
@@ -0,0 +1,14 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Built with -msse4.1 for the streaming loads, see u_tiled_memcpy.c. */
+
+#if defined(USE_SSE41)
+
+#define UTIL_TILED_USE_SSE41
+#define UTIL_TILED_NAME(name) util_tiled_##name##_sse41
+#include "util/u_tiled_memcpy_tmp.h"
+
+#endif
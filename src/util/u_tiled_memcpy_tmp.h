@@ -0,0 +1,173 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Copy loops of u_tiled_memcpy.c, built once per instruction set.
+ *
+ * The including file defines UTIL_TILED_NAME(name) to give the entrypoint a
+ * unique name, and UTIL_TILED_USE_SSE41 to read whole chunks of the tiled
+ * image with streaming loads.
+ */
+
+#include <string.h>
+
+#include "util/macros.h"
+#include "util/u_math.h"
+#include "util/u_tiled_memcpy.h"
+
+#ifdef UTIL_TILED_USE_SSE41
+#include <smmintrin.h>
+#endif
+
+static ALWAYS_INLINE void
+UTIL_TILED_NAME(copy_chunk)(uint8_t *dst, const uint8_t *src,
+                            const unsigned chunk_B, bool stream)
+{
+#ifdef UTIL_TILED_USE_SSE41
+   if (stream && chunk_B >= 16) {
+      for (unsigned i = 0; i < chunk_B; i += 16) {
+         __m128i v = _mm_stream_load_si128((__m128i *)(src + i));
+         _mm_storeu_si128((__m128i *)(dst + i), v);
+      }
+      return;
+   }
+#endif
+   memcpy(dst, src, chunk_B);
+}
+
+/* chunk_B is a constant in every caller, so that whole chunks are moved with
+ * fixed-size loads and stores.
+ */
+static ALWAYS_INLINE void
+UTIL_TILED_NAME(access_rows)(const struct util_tiled_layout *layout,
+                             uint8_t *tiled, uint32_t tiled_stride_B,
+                             uint8_t *linear, uint32_t linear_stride_B,
+                             unsigned x_el, unsigned y_el,
+                             unsigned w_el, unsigned h_el,
+                             const unsigned chunk_B, bool is_store,
+                             bool stream)
+{
+   const unsigned chunk_B_log2 = util_logbase2(chunk_B);
+   const unsigned tile_w_B_log2 =
+      layout->tile_w_el_log2 + util_logbase2(layout->cpp);
+   const uint32_t tile_w_B_mask = (1u << tile_w_B_log2) - 1;
+   const uint32_t tile_h_mask = (1u << layout->tile_h_el_log2) - 1;
+   const uint32_t chunks_per_tile = 1u << (tile_w_B_log2 - chunk_B_log2);
+
+   /* The row is split into a partial chunk on either side and whole chunks
+    * in between. A partial chunk is still contiguous in the tile.
+    */
+   const uint32_t x0_B = x_el * layout->cpp;
+   const uint32_t x1_B = (x_el + w_el) * layout->cpp;
+   const uint32_t xa_B = MIN2(ALIGN_POT(x0_B, chunk_B), x1_B);
+   const uint32_t xb_B = MAX2(x1_B & ~(chunk_B - 1), xa_B);
+
+   for (unsigned y = y_el; y < y_el + h_el; y++) {
+      uint8_t *tiled_row =
+         tiled + (size_t)(y >> layout->tile_h_el_log2) * tiled_stride_B;
+      const uint32_t y_offs = layout->y_lut[y & tile_h_mask];
+      uint8_t *lin = linear;
+
+#define CHUNK_ADDR(x_B)                                                        \
+   (tiled_row + (size_t)((x_B) >> tile_w_B_log2) * layout->tile_size_B +       \
+    (layout->x_lut[((x_B) & tile_w_B_mask) >> chunk_B_log2] ^ y_offs) +        \
+    ((x_B) & (chunk_B - 1)))
+
+      if (x0_B != xa_B) {
+         uint8_t *t = CHUNK_ADDR(x0_B);
+         if (is_store)
+            memcpy(t, lin, xa_B - x0_B);
+         else
+            memcpy(lin, t, xa_B - x0_B);
+         lin += xa_B - x0_B;
+      }
+
+      /* Whole chunks, a tile at a time. */
+      for (uint32_t x_B = xa_B; x_B < xb_B;) {
+         uint8_t *tile =
+            tiled_row + (size_t)(x_B >> tile_w_B_log2) * layout->tile_size_B;
+         const uint32_t c0 = (x_B & tile_w_B_mask) >> chunk_B_log2;
+         const uint32_t c1 =
+            MIN2(chunks_per_tile, c0 + ((xb_B - x_B) >> chunk_B_log2));
+
+         for (uint32_t c = c0; c < c1; c++) {
+            uint8_t *t = tile + (layout->x_lut[c] ^ y_offs);
+            if (is_store)
+               UTIL_TILED_NAME(copy_chunk)(t, lin, chunk_B, false);
+            else
+               UTIL_TILED_NAME(copy_chunk)(lin, t, chunk_B, stream);
+            lin += chunk_B;
+         }
+
+         x_B += (c1 - c0) << chunk_B_log2;
+      }
+
+      if (xb_B != x1_B) {
+         uint8_t *t = CHUNK_ADDR(xb_B);
+         if (is_store)
+            memcpy(t, lin, x1_B - xb_B);
+         else
+            memcpy(lin, t, x1_B - xb_B);
+      }
+
+#undef CHUNK_ADDR
+
+      linear += linear_stride_B;
+   }
+}
+
+void
+UTIL_TILED_NAME(access)(const struct util_tiled_layout *layout,
+                        uint8_t *tiled, uint32_t tiled_stride_B,
+                        uint8_t *linear, uint32_t linear_stride_B,
+                        unsigned x_el, unsigned y_el,
+                        unsigned w_el, unsigned h_el, bool is_store);
+
+void
+UTIL_TILED_NAME(access)(const struct util_tiled_layout *layout,
+                        uint8_t *tiled, uint32_t tiled_stride_B,
+                        uint8_t *linear, uint32_t linear_stride_B,
+                        unsigned x_el, unsigned y_el,
+                        unsigned w_el, unsigned h_el, bool is_store)
+{
+   bool stream = false;
+
+#ifdef UTIL_TILED_USE_SSE41
+   stream = !is_store && layout->chunk_B >= 16 &&
+            (((uintptr_t)tiled | tiled_stride_B | layout->tile_size_B) & 15) == 0;
+   if (stream)
+      _mm_mfence();
+#endif
+
+#define ACCESS_CASE(n)                                                         \
+   case n:                                                                     \
+      if (is_store)                                                            \
+         UTIL_TILED_NAME(access_rows)(layout, tiled, tiled_stride_B, linear,   \
+                                      linear_stride_B, x_el, y_el, w_el, h_el, \
+                                      n, true, false);                         \
+      else if (stream)                                                         \
+         UTIL_TILED_NAME(access_rows)(layout, tiled, tiled_stride_B, linear,   \
+                                      linear_stride_B, x_el, y_el, w_el, h_el, \
+                                      n, false, true);                         \
+      else                                                                     \
+         UTIL_TILED_NAME(access_rows)(layout, tiled, tiled_stride_B, linear,   \
+                                      linear_stride_B, x_el, y_el, w_el, h_el, \
+                                      n, false, false);                        \
+      break;
+
+   switch (layout->chunk_B) {
+   ACCESS_CASE(1)
+   ACCESS_CASE(2)
+   ACCESS_CASE(4)
+   ACCESS_CASE(8)
+   ACCESS_CASE(16)
+   ACCESS_CASE(32)
+   ACCESS_CASE(64)
+   default:
+      UNREACHABLE("invalid chunk size");
+   }
+
+#undef ACCESS_CASE
+}
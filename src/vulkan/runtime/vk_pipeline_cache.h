@@ -147,6 +147,20 @@ void
 vk_pipeline_cache_object_unref(struct vk_device *device,
                                struct vk_pipeline_cache_object *object);
 
+/* The in-memory object index is split into shards by the top bits of the
+ * key hash, each with its own lock, so that threads creating pipelines
+ * against the same cache rarely wait on each other.
+ */
+#define VK_PIPELINE_CACHE_SHARD_BITS 4
+#define VK_PIPELINE_CACHE_NUM_SHARDS (1 << VK_PIPELINE_CACHE_SHARD_BITS)
+
+struct vk_pipeline_cache_shard {
+   /** Protects objects */
+   simple_mtx_t lock;
+
+   struct set *objects;
+};
+
 /** A generic implementation of VkPipelineCache */
 struct vk_pipeline_cache {
    struct vk_object_base base;
@@ -159,10 +173,10 @@ struct vk_pipeline_cache {
 
    struct vk_pipeline_cache_header header;
 
-   /** Protects object_cache */
-   simple_mtx_t lock;
+   /** False if objects are not cached in memory at all */
+   bool object_cache;
 
-   struct set *object_cache;
+   struct vk_pipeline_cache_shard shards[VK_PIPELINE_CACHE_NUM_SHARDS];
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(vk_pipeline_cache, base, VkPipelineCache,
@@ -23,18 +23,62 @@
 
 /** VK_EXT_headless_surface */
 
+#include "util/log.h"
 #include "util/macros.h"
+#include "util/os_misc.h"
+#include "util/os_time.h"
 #include "util/timespec.h"
+#include "util/u_atomic.h"
+#include "vk_alloc.h"
+#include "vk_format.h"
 #include "vk_util.h"
 #include "vk_instance.h"
 #include "vk_physical_device.h"
 #include "wsi_common_entrypoints.h"
+#include "wsi_common_headless.h"
 #include "wsi_common_private.h"
+#include "wsi_common_queue.h"
 
 #include "drm-uapi/drm_fourcc.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Where presented images go, selected with MESA_VK_WSI_HEADLESS_SINK:
+ *
+ *    fd:<n>       raw frames are written to the already open descriptor n
+ *    file:<path>  raw frames are written to the file at path
+ *    shm:<name>   images are kept in POSIX shared memory objects, laid out
+ *                 as described in wsi_common_headless.h
+ *
+ * Raw frames are the pixels of the image without padding between rows.
+ * Without the environment variable, presented images are dropped.
+ */
+enum wsi_headless_sink {
+   WSI_HEADLESS_SINK_NONE,
+   WSI_HEADLESS_SINK_FD,
+   WSI_HEADLESS_SINK_SHM,
+};
+
 struct wsi_headless {
    struct wsi_interface base;
+
+   enum wsi_headless_sink sink;
+
+   /* WSI_HEADLESS_SINK_FD */
+   int sink_fd;
+   bool owns_sink_fd;
+
+   /* WSI_HEADLESS_SINK_SHM */
+   char *sink_shm_name;
+   int shm_index_fd;
+   struct wsi_headless_shm_index *shm_index;
 };
 
 static VkResult
@@ -223,9 +267,13 @@ wsi_headless_surface_get_present_rectangles(VkIcdSurfaceBase *surface,
    return vk_outarray_status(&out);
 }
 
+struct wsi_headless_swapchain;
+
 struct wsi_headless_image {
    struct wsi_image base;
 
+   struct wsi_headless_swapchain *chain;
+
    /* whether the host side ownership is taken by the app or the display */
    bool busy_on_host;
 
@@ -237,10 +285,41 @@ struct wsi_headless_image {
     * in a loop.
     */
    bool busy_on_device;
+
+   /* The slot of the image in the shared memory object of the shm sink */
+   void *shm_map;
+   uint64_t shm_size;
+
+   /* whether the image memory was imported from shm_map */
+   bool shm_imported;
 };
 
 struct wsi_headless_swapchain {
    struct wsi_swapchain base;
+
+   enum wsi_headless_sink sink;
+   int sink_fd;
+
+   struct wsi_headless_shm_index *shm_index;
+   uint64_t shm_generation;
+   char *shm_name;
+   int shm_fd;
+   uint64_t shm_size;
+   struct wsi_headless_shm_header *shm_header;
+   uint64_t shm_header_size;
+
+   /* Protects busy_on_host and busy_on_device of the images */
+   mtx_t lock;
+
+   /* Signaled whenever an image is given back to the application */
+   struct u_cnd_monotonic image_released;
+
+   /* Presented images waiting to be handed to the sink */
+   struct wsi_queue present_queue;
+   thrd_t present_thread;
+   bool has_present_thread;
+   uint64_t frame_count;
+
    struct wsi_headless_image images[0];
 };
 VK_DEFINE_NONDISP_HANDLE_CASTS(wsi_headless_swapchain, base.base, VkSwapchainKHR,
@@ -255,6 +334,16 @@ wsi_headless_swapchain_get_wsi_image(struct wsi_swapchain *wsi_chain,
    return &chain->images[image_index].base;
 }
 
+static void
+wsi_headless_swapchain_release_image(struct wsi_headless_swapchain *chain,
+                                     uint32_t image_index)
+{
+   mtx_lock(&chain->lock);
+   chain->images[image_index].busy_on_host = false;
+   u_cnd_monotonic_broadcast(&chain->image_released);
+   mtx_unlock(&chain->lock);
+}
+
 static VkResult
 wsi_headless_swapchain_acquire_next_image(struct wsi_swapchain *wsi_chain,
                                           const VkAcquireNextImageInfoKHR *info,
@@ -262,21 +351,25 @@ wsi_headless_swapchain_acquire_next_image(struct wsi_swapchain *wsi_chain,
 {
    struct wsi_headless_swapchain *chain =
       (struct wsi_headless_swapchain *)wsi_chain;
-   struct timespec start_time, end_time;
-   struct timespec rel_timeout;
+   struct timespec abs_timeout;
+   VkResult result;
+   int ret;
 
-   timespec_from_nsec(&rel_timeout, info->timeout);
+   timespec_from_nsec(&abs_timeout,
+                      os_time_get_absolute_timeout(info->timeout));
 
-   clock_gettime(CLOCK_MONOTONIC, &start_time);
-   timespec_add(&end_time, &rel_timeout, &start_time);
+   mtx_lock(&chain->lock);
 
    while (1) {
+      bool skipped = false;
+
       /* Try to find a free image. */
       for (uint32_t i = 0; i < chain->base.image_count; i++) {
          if (!chain->images[i].busy_on_host) {
             if (chain->images[i].busy_on_device) {
                /* simple trick to avoid the just presented image */
                chain->images[i].busy_on_device = false;
+               skipped = true;
                continue;
             }
 
@@ -284,16 +377,165 @@ wsi_headless_swapchain_acquire_next_image(struct wsi_swapchain *wsi_chain,
             *image_index = i;
             chain->images[i].busy_on_host = true;
             chain->images[i].busy_on_device = true;
-            return VK_SUCCESS;
+            result = VK_SUCCESS;
+            goto out;
          }
       }
 
-      /* Check for timeout. */
-      struct timespec current_time;
-      clock_gettime(CLOCK_MONOTONIC, &current_time);
-      if (timespec_after(&current_time, &end_time))
-         return VK_NOT_READY;
+      if (skipped)
+         continue;
+
+      /* Every image is either owned by the app or still with the sink, wait
+       * for the presentation thread to give one back.
+       */
+      if (info->timeout == 0) {
+         result = VK_NOT_READY;
+         goto out;
+      }
+
+      if (info->timeout == UINT64_MAX) {
+         ret = u_cnd_monotonic_wait(&chain->image_released, &chain->lock);
+      } else {
+         ret = u_cnd_monotonic_timedwait(&chain->image_released, &chain->lock,
+                                         &abs_timeout);
+      }
+
+      if (ret == thrd_timedout) {
+         result = VK_TIMEOUT;
+         goto out;
+      } else if (ret != thrd_success) {
+         result = VK_ERROR_OUT_OF_DATE_KHR;
+         goto out;
+      }
+   }
+
+out:
+   mtx_unlock(&chain->lock);
+
+   /* Tell shm readers that the image is about to be rendered to. */
+   if (result == VK_SUCCESS && chain->shm_header)
+      p_atomic_set(&chain->shm_header->images[*image_index].seqno, 0);
+
+   return result;
+}
+
+static bool
+wsi_headless_write_all(int fd, const uint8_t *data, size_t size)
+{
+   while (size > 0) {
+      ssize_t ret = write(fd, data, size);
+      if (ret < 0) {
+         if (errno == EINTR)
+            continue;
+         return false;
+      }
+
+      data += ret;
+      size -= ret;
    }
+
+   return true;
+}
+
+/* Hands a presented image to the sink.  Called from the presentation
+ * thread while the image is still owned by the swapchain.
+ */
+static void
+wsi_headless_swapchain_sink_image(struct wsi_headless_swapchain *chain,
+                                  uint32_t image_index)
+{
+   struct wsi_headless_image *image = &chain->images[image_index];
+   const struct wsi_device *wsi = chain->base.wsi;
+   const VkImageCreateInfo *create = &chain->base.image_info.create;
+   const uint32_t row_pitch = image->base.row_pitches[0];
+   const uint8_t *data = image->base.cpu_map;
+
+   /* wsi_common_queue_present() already waited for software rendering */
+   if (!wsi->sw) {
+      wsi->WaitForFences(chain->base.device, 1,
+                         &chain->base.fences[image_index], true, UINT64_MAX);
+   }
+
+   chain->frame_count++;
+
+   switch (chain->sink) {
+   case WSI_HEADLESS_SINK_FD: {
+      const size_t row_size =
+         (size_t)create->extent.width * vk_format_get_blocksize(create->format);
+      bool written;
+
+      if (row_pitch == row_size) {
+         written = wsi_headless_write_all(chain->sink_fd, data,
+                                          row_size * create->extent.height);
+      } else {
+         written = true;
+         for (uint32_t y = 0; written && y < create->extent.height; y++) {
+            written = wsi_headless_write_all(chain->sink_fd,
+                                             data + (size_t)y * row_pitch,
+                                             row_size);
+         }
+      }
+
+      if (!written) {
+         mesa_logw("MESA: failed to write a headless frame, dropping all "
+                   "further frames: %s", strerror(errno));
+         chain->sink = WSI_HEADLESS_SINK_NONE;
+      }
+      break;
+   }
+
+   case WSI_HEADLESS_SINK_SHM: {
+      struct wsi_headless_shm_header *header = chain->shm_header;
+
+      if (!image->shm_imported)
+         memcpy(image->shm_map, data, (size_t)row_pitch * create->extent.height);
+
+      p_atomic_set(&header->images[image_index].seqno, chain->frame_count);
+      p_atomic_set(&header->latest, image_index);
+      p_atomic_set(&header->frame_count, chain->frame_count);
+      break;
+   }
+
+   case WSI_HEADLESS_SINK_NONE:
+      break;
+   }
+}
+
+static int
+wsi_headless_swapchain_present_thread(void *data)
+{
+   struct wsi_headless_swapchain *chain = data;
+   bool done = false;
+
+   while (!done) {
+      uint32_t image_index;
+      VkResult result = wsi_queue_pull(&chain->present_queue, &image_index,
+                                       INT64_MAX);
+      if (result != VK_SUCCESS || image_index == UINT32_MAX)
+         break;
+
+      /* In mailbox mode only the newest queued image is worth sinking, the
+       * older ones go straight back to the application.
+       */
+      if (chain->base.present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+         uint32_t next_index;
+         while (wsi_queue_pull(&chain->present_queue, &next_index,
+                               0) == VK_SUCCESS) {
+            if (next_index == UINT32_MAX) {
+               done = true;
+               break;
+            }
+
+            wsi_headless_swapchain_release_image(chain, image_index);
+            image_index = next_index;
+         }
+      }
+
+      wsi_headless_swapchain_sink_image(chain, image_index);
+      wsi_headless_swapchain_release_image(chain, image_index);
+   }
+
+   return 0;
 }
 
 static VkResult
@@ -307,7 +549,111 @@ wsi_headless_swapchain_queue_present(struct wsi_swapchain *wsi_chain,
 
    assert(image_index < chain->base.image_count);
 
-   chain->images[image_index].busy_on_host = false;
+   if (chain->has_present_thread) {
+      wsi_queue_push(&chain->present_queue, image_index);
+   } else {
+      wsi_headless_swapchain_release_image(chain, image_index);
+   }
+
+   return VK_SUCCESS;
+}
+
+/* Grows the shared memory object of the shm sink by size bytes, rounded up
+ * to whole pages, and maps the new range.
+ */
+static void *
+wsi_headless_swapchain_map_shm(struct wsi_headless_swapchain *chain,
+                               uint64_t *size, uint64_t *offset)
+{
+   uint64_t page_size = 4096;
+   os_get_page_size(&page_size);
+
+   const uint64_t map_size = align64(*size, page_size);
+   if (ftruncate(chain->shm_fd, chain->shm_size + map_size) < 0)
+      return NULL;
+
+   void *map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    chain->shm_fd, chain->shm_size);
+   if (map == MAP_FAILED)
+      return NULL;
+
+   *size = map_size;
+   *offset = chain->shm_size;
+   chain->shm_size += map_size;
+
+   return map;
+}
+
+static void *
+wsi_headless_image_map_shm(struct wsi_headless_image *image, uint64_t size)
+{
+   struct wsi_headless_swapchain *chain = image->chain;
+   const uint32_t index = image - chain->images;
+   uint64_t offset;
+
+   image->shm_map = wsi_headless_swapchain_map_shm(chain, &size, &offset);
+   if (image->shm_map == NULL)
+      return NULL;
+
+   image->shm_size = size;
+   chain->shm_header->images[index].offset = offset;
+
+   return image->shm_map;
+}
+
+static uint8_t *
+wsi_headless_alloc_shm(struct wsi_image *wsi_image, unsigned size)
+{
+   struct wsi_headless_image *image = (struct wsi_headless_image *)wsi_image;
+
+   if (wsi_headless_image_map_shm(image, size) == NULL)
+      return NULL;
+
+   image->shm_imported = true;
+   return image->shm_map;
+}
+
+/* Creates the shared memory object of a new swapchain generation.  Objects
+ * left behind by a process which didn't get to clean up are skipped.
+ */
+static VkResult
+wsi_headless_swapchain_init_shm(struct wsi_headless_swapchain *chain,
+                                struct wsi_headless *wsi,
+                                const VkAllocationCallbacks *alloc,
+                                uint32_t image_count)
+{
+   chain->shm_index = wsi->shm_index;
+
+   for (unsigned tries = 0; chain->shm_fd < 0 && tries < 64; tries++) {
+      vk_free(alloc, chain->shm_name);
+
+      chain->shm_generation = p_atomic_inc_return(&wsi->shm_index->generation);
+      chain->shm_name = vk_asprintf(alloc, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT,
+                                    "%s.%" PRIu64, wsi->sink_shm_name,
+                                    chain->shm_generation);
+      if (!chain->shm_name)
+         return VK_ERROR_OUT_OF_HOST_MEMORY;
+
+      chain->shm_fd = shm_open(chain->shm_name, O_RDWR | O_CREAT | O_EXCL,
+                               0600);
+      if (chain->shm_fd < 0 && errno != EEXIST)
+         break;
+   }
+
+   if (chain->shm_fd < 0) {
+      mesa_loge("MESA: failed to create the shared memory object '%s': %s",
+                chain->shm_name, strerror(errno));
+      return VK_ERROR_INITIALIZATION_FAILED;
+   }
+
+   uint64_t offset;
+   chain->shm_header_size = sizeof(*chain->shm_header) +
+      image_count * sizeof(chain->shm_header->images[0]);
+   chain->shm_header = wsi_headless_swapchain_map_shm(chain,
+                                                      &chain->shm_header_size,
+                                                      &offset);
+   if (chain->shm_header == NULL)
+      return VK_ERROR_OUT_OF_HOST_MEMORY;
 
    return VK_SUCCESS;
 }
@@ -319,10 +665,31 @@ wsi_headless_swapchain_destroy(struct wsi_swapchain *wsi_chain,
    struct wsi_headless_swapchain *chain =
       (struct wsi_headless_swapchain *)wsi_chain;
 
+   if (chain->has_present_thread) {
+      wsi_queue_push(&chain->present_queue, UINT32_MAX);
+      thrd_join(chain->present_thread, NULL);
+      wsi_queue_destroy(&chain->present_queue);
+   }
+
    for (uint32_t i = 0; i < chain->base.image_count; i++) {
       if (chain->images[i].base.image != VK_NULL_HANDLE)
          wsi_destroy_image(&chain->base, &chain->images[i].base);
+      if (chain->images[i].shm_map)
+         munmap(chain->images[i].shm_map, chain->images[i].shm_size);
+   }
+
+   if (chain->shm_header)
+      munmap(chain->shm_header, chain->shm_header_size);
+   if (chain->shm_fd >= 0) {
+      /* A newer swapchain may already have taken over the index */
+      p_atomic_cmpxchg(&chain->shm_index->current, chain->shm_generation, 0);
+      close(chain->shm_fd);
+      shm_unlink(chain->shm_name);
    }
+   vk_free(pAllocator, chain->shm_name);
+
+   u_cnd_monotonic_destroy(&chain->image_released);
+   mtx_destroy(&chain->lock);
 
    wsi_swapchain_finish(&chain->base);
 
@@ -339,6 +706,8 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
                                       const VkAllocationCallbacks* pAllocator,
                                       struct wsi_swapchain **swapchain_out)
 {
+   struct wsi_headless *wsi =
+      (struct wsi_headless *)wsi_device->wsi[VK_ICD_WSI_PLATFORM_HEADLESS];
    struct wsi_headless_swapchain *chain;
    VkResult result;
 
@@ -346,6 +715,8 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
 
    int num_images = pCreateInfo->minImageCount;
 
+   const enum wsi_headless_sink sink = wsi->sink;
+
    size_t size = sizeof(*chain) + num_images * sizeof(chain->images[0]);
    chain = vk_zalloc(pAllocator, size, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
    if (chain == NULL)
@@ -385,15 +756,36 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
       .modifiers = (const uint64_t **)&mods,
    };
 
+   /* Sinks read the pixels on the CPU.  Software drivers can render straight
+    * into the shared memory object of the shm sink.
+    */
+   struct wsi_cpu_image_params cpu_params = {
+      .base.image_type = WSI_IMAGE_TYPE_CPU,
+      .alloc_shm = sink == WSI_HEADLESS_SINK_SHM && wsi_device->sw &&
+                   wsi_device->has_import_memory_host ?
+                   wsi_headless_alloc_shm : NULL,
+   };
+
+   const struct wsi_base_image_params *image_params =
+      sink != WSI_HEADLESS_SINK_NONE ? &cpu_params.base : &drm_params.base;
+
    result = wsi_swapchain_init(wsi_device, &chain->base, device,
-                               pCreateInfo, &drm_params.base, pAllocator);
+                               pCreateInfo, image_params, pAllocator);
 
    STACK_ARRAY_FINISH(mods);
    STACK_ARRAY_FINISH(mod_props);
 
-   if (result != VK_SUCCESS) {
-      vk_free(pAllocator, chain);
-      return result;
+   if (result != VK_SUCCESS)
+      goto fail_free;
+
+   if (mtx_init(&chain->lock, mtx_plain) != thrd_success) {
+      result = VK_ERROR_OUT_OF_HOST_MEMORY;
+      goto fail_finish;
+   }
+
+   if (u_cnd_monotonic_init(&chain->image_released) != thrd_success) {
+      result = VK_ERROR_OUT_OF_HOST_MEMORY;
+      goto fail_lock;
    }
 
    chain->base.destroy = wsi_headless_swapchain_destroy;
@@ -402,15 +794,70 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
    chain->base.queue_present = wsi_headless_swapchain_queue_present;
    chain->base.present_mode = wsi_swapchain_get_present_mode(wsi_device, pCreateInfo);
    chain->base.image_count = num_images;
+   chain->sink = sink;
+   chain->sink_fd = wsi->sink_fd;
+   chain->shm_fd = -1;
+
+   if (sink == WSI_HEADLESS_SINK_SHM) {
+      result = wsi_headless_swapchain_init_shm(chain, wsi, pAllocator,
+                                               num_images);
+      if (result != VK_SUCCESS)
+         goto fail;
+   }
 
    for (uint32_t i = 0; i < chain->base.image_count; i++) {
+      struct wsi_headless_image *image = &chain->images[i];
+
+      image->chain = chain;
+
       result = wsi_create_image(&chain->base, &chain->base.image_info,
-                                &chain->images[i].base);
+                                &image->base);
       if (result != VK_SUCCESS)
          goto fail;
 
-      chain->images[i].busy_on_host = false;
-      chain->images[i].busy_on_device = false;
+      image->busy_on_host = false;
+      image->busy_on_device = false;
+
+      if (sink == WSI_HEADLESS_SINK_SHM) {
+         const uint64_t image_size = (uint64_t)image->base.row_pitches[0] *
+                                     pCreateInfo->imageExtent.height;
+         if (!image->shm_imported &&
+             wsi_headless_image_map_shm(image, image_size) == NULL) {
+            result = VK_ERROR_OUT_OF_HOST_MEMORY;
+            goto fail;
+         }
+
+         chain->shm_header->images[i].row_pitch = image->base.row_pitches[0];
+      }
+   }
+
+   if (chain->shm_header) {
+      struct wsi_headless_shm_header *header = chain->shm_header;
+
+      header->version = WSI_HEADLESS_SHM_VERSION;
+      header->generation = chain->shm_generation;
+      header->width = pCreateInfo->imageExtent.width;
+      header->height = pCreateInfo->imageExtent.height;
+      header->format = pCreateInfo->imageFormat;
+      header->image_count = num_images;
+      p_atomic_set(&header->magic, WSI_HEADLESS_SHM_MAGIC);
+      p_atomic_set(&chain->shm_index->current, chain->shm_generation);
+   }
+
+   if (sink != WSI_HEADLESS_SINK_NONE) {
+      if (wsi_queue_init(&chain->present_queue, num_images + 1)) {
+         result = VK_ERROR_OUT_OF_HOST_MEMORY;
+         goto fail;
+      }
+
+      if (thrd_create(&chain->present_thread,
+                      wsi_headless_swapchain_present_thread,
+                      chain) != thrd_success) {
+         wsi_queue_destroy(&chain->present_queue);
+         result = VK_ERROR_OUT_OF_HOST_MEMORY;
+         goto fail;
+      }
+      chain->has_present_thread = true;
    }
 
    *swapchain_out = &chain->base;
@@ -420,9 +867,56 @@ wsi_headless_surface_create_swapchain(VkIcdSurfaceBase *icd_surface,
 fail:
    wsi_headless_swapchain_destroy(&chain->base, pAllocator);
 
+   return result;
+
+fail_lock:
+   mtx_destroy(&chain->lock);
+fail_finish:
+   wsi_swapchain_finish(&chain->base);
+fail_free:
+   vk_free(pAllocator, chain);
+
    return result;
 }
 
+/* Opens the index of the shm sink, creating it if this is its first user. */
+static bool
+wsi_headless_open_shm_index(struct wsi_headless *wsi)
+{
+   const char *name = wsi->sink_shm_name;
+   struct stat st;
+
+   wsi->shm_index_fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+   if (wsi->shm_index_fd < 0 || fstat(wsi->shm_index_fd, &st) < 0)
+      goto fail;
+
+   /* Growing it only ever adds zeros, so racing users agree on the result */
+   if (st.st_size < (off_t)sizeof(*wsi->shm_index) &&
+       ftruncate(wsi->shm_index_fd, sizeof(*wsi->shm_index)) < 0)
+      goto fail;
+
+   void *map = mmap(NULL, sizeof(*wsi->shm_index), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, wsi->shm_index_fd, 0);
+   if (map == MAP_FAILED)
+      goto fail;
+
+   wsi->shm_index = map;
+   p_atomic_inc(&wsi->shm_index->users);
+   wsi->shm_index->version = WSI_HEADLESS_SHM_VERSION;
+   p_atomic_set(&wsi->shm_index->magic, WSI_HEADLESS_SHM_INDEX_MAGIC);
+
+   return true;
+
+fail:
+   mesa_logw("MESA: failed to open headless sink 'shm:%s': %s",
+             name, strerror(errno));
+   if (wsi->shm_index_fd >= 0)
+      close(wsi->shm_index_fd);
+   wsi->shm_index_fd = -1;
+
+   return false;
+}
+
 VkResult
 wsi_headless_init_wsi(struct wsi_device *wsi_device,
                       const VkAllocationCallbacks *alloc,
@@ -446,10 +940,48 @@ wsi_headless_init_wsi(struct wsi_device *wsi_device,
    wsi->base.get_present_rectangles = wsi_headless_surface_get_present_rectangles;
    wsi->base.create_swapchain = wsi_headless_surface_create_swapchain;
 
+   wsi->sink = WSI_HEADLESS_SINK_NONE;
+   wsi->sink_fd = -1;
+   wsi->owns_sink_fd = false;
+   wsi->sink_shm_name = NULL;
+   wsi->shm_index_fd = -1;
+   wsi->shm_index = NULL;
+
+   const char *sink = getenv("MESA_VK_WSI_HEADLESS_SINK");
+   if (sink == NULL || !*sink) {
+      /* Drop presented images */
+   } else if (!strncmp(sink, "fd:", 3)) {
+      wsi->sink = WSI_HEADLESS_SINK_FD;
+      wsi->sink_fd = atoi(sink + 3);
+   } else if (!strncmp(sink, "file:", 5)) {
+      wsi->sink_fd = open(sink + 5, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644);
+      if (wsi->sink_fd >= 0) {
+         wsi->sink = WSI_HEADLESS_SINK_FD;
+         wsi->owns_sink_fd = true;
+      } else {
+         mesa_logw("MESA: failed to open headless sink '%s': %s",
+                   sink + 5, strerror(errno));
+      }
+   } else if (!strncmp(sink, "shm:", 4)) {
+      wsi->sink_shm_name = vk_strdup(alloc, sink + 4,
+                                     VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE);
+      if (!wsi->sink_shm_name) {
+         result = VK_ERROR_OUT_OF_HOST_MEMORY;
+         goto fail_wsi;
+      }
+      if (wsi_headless_open_shm_index(wsi))
+         wsi->sink = WSI_HEADLESS_SINK_SHM;
+   } else {
+      mesa_logw("MESA: unknown MESA_VK_WSI_HEADLESS_SINK '%s'", sink);
+   }
+
    wsi_device->wsi[VK_ICD_WSI_PLATFORM_HEADLESS] = &wsi->base;
 
    return VK_SUCCESS;
 
+fail_wsi:
+   vk_free(alloc, wsi);
 fail:
    wsi_device->wsi[VK_ICD_WSI_PLATFORM_HEADLESS] = NULL;
 
@@ -465,6 +997,17 @@ wsi_headless_finish_wsi(struct wsi_device *wsi_device,
    if (!wsi)
       return;
 
+   if (wsi->owns_sink_fd)
+      close(wsi->sink_fd);
+   if (wsi->shm_index) {
+      if (p_atomic_dec_zero(&wsi->shm_index->users))
+         shm_unlink(wsi->sink_shm_name);
+      munmap(wsi->shm_index, sizeof(*wsi->shm_index));
+   }
+   if (wsi->shm_index_fd >= 0)
+      close(wsi->shm_index_fd);
+   vk_free(alloc, wsi->sink_shm_name);
+
    vk_free(alloc, wsi);
 }
 
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2025 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef WSI_COMMON_HEADLESS_H
+#define WSI_COMMON_HEADLESS_H
+
+#include <stdint.h>
+
+/* Shared memory objects of the MESA_VK_WSI_HEADLESS_SINK=shm:<name> sink,
+ * for the processes reading the frames.
+ */
+
+#define WSI_HEADLESS_SHM_MAGIC 0x4d534857 /* "WHSM" */
+#define WSI_HEADLESS_SHM_INDEX_MAGIC 0x49534857 /* "WHSI" */
+#define WSI_HEADLESS_SHM_VERSION 2
+
+/* Layout of the shared memory object named by the shm sink.  Every swapchain
+ * keeps its images in an object of its own, named <name>.<generation>, so a
+ * swapchain being recreated never touches the object of the old one.  The
+ * generations are handed out from this index, which also publishes the one of
+ * the newest swapchain, 0 while there is none.  The index is removed once no
+ * WSI instance uses it anymore.
+ */
+struct wsi_headless_shm_index {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t users;
+   uint32_t pad;
+   uint64_t generation;
+   uint64_t current;
+};
+
+/* Layout of the shared memory object of a swapchain.  The images follow at
+ * page aligned offsets.  While the application owns an image its seqno is 0;
+ * once it has been presented, seqno is set to the new frame_count and latest
+ * to its index.  A reader which sees the same non-zero seqno before and after
+ * copying an image got a complete frame.  The object is removed when the
+ * swapchain is destroyed.
+ */
+struct wsi_headless_shm_header {
+   uint32_t magic;
+   uint32_t version;
+   uint64_t generation;
+   uint32_t width;
+   uint32_t height;
+   uint32_t format; /* VkFormat */
+   uint32_t image_count;
+   uint64_t frame_count;
+   uint32_t latest;
+   uint32_t pad;
+   struct {
+      uint64_t offset;
+      uint64_t seqno;
+      uint32_t row_pitch;
+      uint32_t pad;
+   } images[];
+};
+
+#endif /* WSI_COMMON_HEADLESS_H */